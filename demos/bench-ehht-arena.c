@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-arena.c: short lived tables, per request */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-arena [requests] [keys_per_request] [seed]
+ *
+ * Each "request" fills a table with keys_per_request keys of varied
+ * length, looks each of them up twice, removes a few, and is then done
+ * with the table. The table is either reused with "clear", or created
+ * and freed with ehht_free, with each element allocated individually
+ * ("malloc"), with keys pooled (ehht_pool_keys), or from an arena
+ * (ehht_arena). Reports requests per second, ns per request, and
+ * allocations per request.
+ */
+
+#include <stdio.h>		/* printf sprintf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+#define BENCH_ARENA_CHUNK (16 * 1024)
+
+enum bench_mode { bench_malloc, bench_pool, bench_arena };
+
+static const char *bench_mode_names[] = { "malloc", "pool", "arena" };
+
+struct bench_keys {
+	char *bytes;
+	size_t *offsets;
+	size_t *lens;
+	size_t num_keys;
+};
+
+static int bench_keys_init(struct bench_keys *keys, size_t num_keys,
+			   unsigned long seed)
+{
+	size_t i = 0;
+	size_t pos = 0;
+	int len = 0;
+
+	keys->num_keys = num_keys;
+	keys->bytes = (char *)malloc(num_keys * 64);
+	keys->offsets = (size_t *)malloc(num_keys * sizeof(size_t));
+	keys->lens = (size_t *)malloc(num_keys * sizeof(size_t));
+	if (!keys->bytes || !keys->offsets || !keys->lens) {
+		return 1;
+	}
+	for (i = 0; i < num_keys; ++i) {
+		/* header-like names, 8 to 40 bytes */
+		len = sprintf(keys->bytes + pos, "x-field-%lu-%.*s",
+			      (unsigned long)i,
+			      (int)(bench_random(&seed) % 24),
+			      "abcdefghijklmnopqrstuvwxyz");
+		keys->offsets[i] = pos;
+		keys->lens[i] = (size_t)len;
+		pos += (size_t)len + 1;
+	}
+	return 0;
+}
+
+static void bench_keys_free(struct bench_keys *keys)
+{
+	free(keys->bytes);
+	free(keys->offsets);
+	free(keys->lens);
+}
+
+static struct ehht *bench_new(enum bench_mode mode,
+			      struct eembed_allocator *ea, size_t num_keys)
+{
+	struct ehht *table = NULL;
+
+	table = ehht_new_custom(num_keys, NULL, ea, NULL);
+	if (!table) {
+		return NULL;
+	}
+	if ((mode == bench_pool && ehht_pool_keys(table, BENCH_ARENA_CHUNK))
+	    || (mode == bench_arena && ehht_arena(table, BENCH_ARENA_CHUNK))) {
+		ehht_free(table);
+		return NULL;
+	}
+	return table;
+}
+
+/* returns the number of keys not found, or -1 on error */
+static long bench_request(struct ehht *table, struct bench_keys *keys)
+{
+	const char *key = NULL;
+	size_t i = 0;
+	long missing = 0;
+	int err = 0;
+
+	for (i = 0; i < keys->num_keys; ++i) {
+		key = keys->bytes + keys->offsets[i];
+		table->put(table, key, keys->lens[i], (void *)(i + 1), &err);
+	}
+	if (err) {
+		return -1;
+	}
+	for (i = 0; i < 2 * keys->num_keys; ++i) {
+		key = keys->bytes + keys->offsets[i % keys->num_keys];
+		if (!table->get(table, key, keys->lens[i % keys->num_keys])) {
+			++missing;
+		}
+	}
+	for (i = 0; i < keys->num_keys; i += 8) {
+		key = keys->bytes + keys->offsets[i];
+		table->remove(table, key, keys->lens[i]);
+	}
+	return missing;
+}
+
+static int bench_run(enum bench_mode mode, int reuse, unsigned long requests,
+		     struct bench_keys *keys)
+{
+	struct bench_tracking_context ctx;
+	struct eembed_allocator wrap;
+	struct ehht *table = NULL;
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long r = 0;
+	size_t allocs_before = 0;
+	long missing = 0;
+
+	bench_tracking_allocator_init(&wrap, &ctx, eembed_global_allocator);
+	if (reuse) {
+		table = bench_new(mode, &wrap, keys->num_keys);
+		if (!table) {
+			return 1;
+		}
+	}
+	allocs_before = ctx.allocs;
+
+	start = bench_now_ns(NULL);
+	for (r = 0; r < requests && missing == 0; ++r) {
+		if (!reuse) {
+			table = bench_new(mode, &wrap, keys->num_keys);
+			if (!table) {
+				return 1;
+			}
+		}
+		missing = bench_request(table, keys);
+		if (reuse) {
+			table->clear(table);
+		} else {
+			ehht_free(table);
+			table = NULL;
+		}
+	}
+	elapsed = bench_now_ns(NULL) - start;
+
+	if (table) {
+		ehht_free(table);
+	}
+	if (missing) {
+		fprintf(stderr, "%s: %ld keys missing\n",
+			bench_mode_names[mode], missing);
+		return 1;
+	}
+	printf("%-8s %-6s %12.0f %10.0f %10.1f %10lu\n",
+	       bench_mode_names[mode], reuse ? "clear" : "free",
+	       (double)requests / ((double)elapsed / 1000000000.0),
+	       (double)elapsed / requests,
+	       (double)(ctx.allocs - allocs_before) / requests,
+	       (unsigned long)ctx.bytes_peak);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long requests = 100000;
+	unsigned long num_keys = 64;
+	unsigned long seed = 1;
+	struct bench_keys keys;
+	int reuse = 0;
+	int mode = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		requests = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		num_keys = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		seed = strtoul(argv[3], NULL, 10);
+	}
+	if (requests == 0 || num_keys == 0) {
+		fprintf(stderr, "usage: %s [requests] [keys_per_request] "
+			"[seed]\n", argv[0]);
+		return 1;
+	}
+
+	err = bench_keys_init(&keys, num_keys, seed);
+	if (err) {
+		goto bench_end;
+	}
+
+	printf("%lu requests of %lu keys\n", requests, num_keys);
+	printf("%-8s %-6s %12s %10s %10s %10s\n", "keys", "table",
+	       "requests/s", "ns/req", "allocs/req", "peak bytes");
+	for (reuse = 0; reuse < 2; ++reuse) {
+		for (mode = bench_malloc; mode <= bench_arena; ++mode) {
+			err += bench_run((enum bench_mode)mode, reuse,
+					 requests, &keys);
+		}
+	}
+
+bench_end:
+	bench_keys_free(&keys);
+	return err ? 1 : 0;
+}
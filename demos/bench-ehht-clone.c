@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-clone.c: copy a table with keys and put, or ehht_clone */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-clone [num_keys] [rounds]
+ *
+ * Copies a table of num_keys keys:
+ *	keys+put	"keys" with copied keys, then a "put" of each
+ *	clone		ehht_clone
+ * and reports the time per element copied.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static struct ehht *bench_copy_by_keys(struct ehht *table)
+{
+	struct ehht_keys *keys = NULL;
+	struct ehht *copy = NULL;
+	size_t i = 0;
+	int err = 0;
+
+	copy = ehht_new();
+	keys = table->keys(table, 1);
+	if (!copy || !keys) {
+		table->free_keys(table, keys);
+		ehht_free(copy);
+		return NULL;
+	}
+	for (i = 0; i < keys->len && !err; ++i) {
+		copy->put(copy, keys->keys[i].str, keys->keys[i].len,
+			  table->get(table, keys->keys[i].str,
+				     keys->keys[i].len), &err);
+	}
+	table->free_keys(table, keys);
+	if (err) {
+		ehht_free(copy);
+		return NULL;
+	}
+	return copy;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long rounds = 4;
+	unsigned long by_keys_ns = 0;
+	unsigned long clone_ns = 0;
+	unsigned long start = 0;
+	unsigned long i = 0;
+	struct ehht *table = NULL;
+	struct ehht *copy = NULL;
+	char key[40];
+	int len = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		rounds = strtoul(argv[2], NULL, 10);
+	}
+	if (num_keys == 0 || rounds == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [rounds]\n", argv[0]);
+		return 1;
+	}
+
+	table = ehht_new();
+	if (!table) {
+		return 1;
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "key:%lu", i);
+		table->put(table, key, (size_t)len, NULL, &err);
+	}
+
+	for (i = 0; i < rounds && !err; ++i) {
+		start = bench_now_ns(NULL);
+		copy = bench_copy_by_keys(table);
+		by_keys_ns += bench_now_ns(NULL) - start;
+		err = (copy && copy->size(copy) == num_keys) ? 0 : 1;
+		ehht_free(copy);
+
+		start = bench_now_ns(NULL);
+		copy = ehht_clone(table);
+		clone_ns += bench_now_ns(NULL) - start;
+		err += (copy && copy->size(copy) == num_keys) ? 0 : 1;
+		ehht_free(copy);
+	}
+
+	printf("%lu keys, %lu rounds, ns per element copied\n", num_keys,
+	       rounds);
+	printf("%-10s %10.1f\n", "keys+put",
+	       (double)by_keys_ns / (num_keys * rounds));
+	printf("%-10s %10.1f\n", "clone",
+	       (double)clone_ns / (num_keys * rounds));
+
+	ehht_free(table);
+	return err ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-compact.c: memory and iteration of ehht_new_compact */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-compact [num_keys]
+ *
+ * Fills a chained table and a compact table with the same num_keys
+ * keys, each through a tracking allocator, and reports the bytes per
+ * key which each holds, and the number of allocations it holds them in
+ * (each of which costs the system allocator a header, not counted),
+ * the ns per key of the fastest of 5 passes of for_each, and the ns
+ * per get of every key in a random order.
+ */
+
+#include <stdio.h>		/* printf sprintf */
+#include <stdlib.h>		/* malloc free strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static int bench_sum_each(struct ehht_key each_key, void *each_val,
+			  void *context)
+{
+	unsigned long *sum = (unsigned long *)context;
+	*sum += each_key.len + (unsigned long)each_val;
+	return 0;
+}
+
+static int bench_table(const char *name, struct ehht *table,
+		       struct bench_tracking_context *ctx,
+		       unsigned long num_keys, const unsigned long *order)
+{
+	char key[40];
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long best = 0;
+	unsigned long sum = 0;
+	unsigned long found = 0;
+	unsigned long i = 0;
+	int len = 0;
+	int err = 0;
+
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "key:%lu", i);
+		table->put(table, key, (size_t)len, (void *)i, &err);
+	}
+	if (err) {
+		return 1;
+	}
+
+	for (i = 0; i < 5; ++i) {
+		start = bench_now_ns(NULL);
+		table->for_each(table, bench_sum_each, &sum);
+		elapsed = bench_now_ns(NULL) - start;
+		if (i == 0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys; ++i) {
+		len = sprintf(key, "key:%lu", order[i]);
+		found +=
+		    (table->get(table, key, (size_t)len) == (void *)order[i]);
+	}
+	elapsed = bench_now_ns(NULL) - start;
+
+	printf("%-8s %12.1f %10lu %12.2f %12.1f %20lu\n", name,
+	       (double)ctx->bytes_live / num_keys,
+	       (unsigned long)(ctx->allocs - ctx->frees),
+	       (double)best / num_keys,
+	       (double)elapsed / num_keys, sum);
+	if (found != num_keys) {
+		fprintf(stderr, "%s: found %lu of %lu\n", name, found,
+			num_keys);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long seed = 88172645463325252UL;
+	unsigned long *order = NULL;
+	unsigned long i = 0;
+	unsigned long j = 0;
+	unsigned long tmp = 0;
+	struct bench_tracking_context ctx;
+	struct eembed_allocator wrap;
+	struct ehht *table = NULL;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (num_keys == 0) {
+		fprintf(stderr, "usage: %s [num_keys]\n", argv[0]);
+		return 1;
+	}
+
+	order = (unsigned long *)malloc(sizeof(unsigned long) * num_keys);
+	if (!order) {
+		return 1;
+	}
+	for (i = 0; i < num_keys; ++i) {
+		order[i] = i;
+	}
+	for (i = num_keys - 1; i > 0; --i) {
+		j = bench_random(&seed) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	printf("%lu keys\n", num_keys);
+	printf("%-8s %12s %10s %12s %12s %20s\n", "table", "bytes/key",
+	       "allocs", "for_each ns", "get ns", "checksum");
+
+	bench_tracking_allocator_init(&wrap, &ctx, eembed_global_allocator);
+	table = ehht_new_custom(0, NULL, &wrap, NULL);
+	if (!table) {
+		err = 1;
+	} else {
+		err += bench_table("chained", table, &ctx, num_keys, order);
+		ehht_free(table);
+	}
+
+	bench_tracking_allocator_init(&wrap, &ctx, eembed_global_allocator);
+	table = ehht_new_compact(0, NULL, &wrap, NULL);
+	if (!table) {
+		err = 1;
+	} else {
+		err += bench_table("compact", table, &ctx, num_keys, order);
+		ehht_free(table);
+	}
+
+	free(order);
+	return err ? 1 : 0;
+}
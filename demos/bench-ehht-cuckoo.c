@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-cuckoo.c: read latency of ehht_new_cuckoo at high load */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-cuckoo [log2_buckets] [load_percent]
+ *
+ * Fills a cuckoo table of 4 * 2^log2_buckets slots to load_percent, and
+ * a chained table (with and without bucket tags) with the same keys,
+ * then times each lookup of every present key and as many absent keys,
+ * in a random order, and reports the mean and the percentiles of the
+ * latency, in ns. Each sample includes the cost of reading the clock.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* malloc qsort strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static int bench_cmp_ul(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+	return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static void bench_report(const char *name, const char *kind,
+			 unsigned long *samples, unsigned long n)
+{
+	unsigned long total = 0;
+	unsigned long i = 0;
+
+	for (i = 0; i < n; ++i) {
+		total += samples[i];
+	}
+	qsort(samples, n, sizeof(unsigned long), bench_cmp_ul);
+	printf("%-8s %-5s %8.1f %8lu %8lu %8lu %8lu\n", name, kind,
+	       (double)total / n, samples[n / 2], samples[(n * 99) / 100],
+	       samples[(n * 999) / 1000], samples[n - 1]);
+}
+
+static int bench_lookups(const char *name, struct ehht *table,
+			 unsigned long num_keys, const unsigned long *order,
+			 unsigned long *samples)
+{
+	char key[40];
+	unsigned long start = 0;
+	unsigned long found = 0;
+	unsigned long i = 0;
+	int len = 0;
+
+	for (i = 0; i < num_keys; ++i) {
+		len = sprintf(key, "present:%lu", order[i]);
+		start = bench_now_ns(NULL);
+		found += table->has_key(table, key, (size_t)len);
+		samples[i] = bench_now_ns(NULL) - start;
+	}
+	bench_report(name, "hit", samples, num_keys);
+
+	for (i = 0; i < num_keys; ++i) {
+		len = sprintf(key, "absent:%lu", order[i]);
+		start = bench_now_ns(NULL);
+		found += table->has_key(table, key, (size_t)len);
+		samples[i] = bench_now_ns(NULL) - start;
+	}
+	bench_report(name, "miss", samples, num_keys);
+
+	if (found != num_keys) {
+		fprintf(stderr, "%s: found %lu of %lu\n", name, found,
+			num_keys);
+		return 1;
+	}
+	return 0;
+}
+
+static int bench_fill(struct ehht *table, unsigned long num_keys)
+{
+	char key[40];
+	unsigned long i = 0;
+	int len = 0;
+	int err = 0;
+
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "present:%lu", i);
+		table->put(table, key, (size_t)len, NULL, &err);
+	}
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long log2_buckets = 18;
+	unsigned long load = 95;
+	unsigned long seed = 88172645463325252UL;
+	unsigned long *samples = NULL;
+	unsigned long *order = NULL;
+	unsigned long capacity = 0;
+	unsigned long num_keys = 0;
+	unsigned long i = 0;
+	unsigned long j = 0;
+	unsigned long tmp = 0;
+	struct ehht *table = NULL;
+	int err = 0;
+
+	if (argc > 1) {
+		log2_buckets = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		load = strtoul(argv[2], NULL, 10);
+	}
+	if (log2_buckets < 1 || log2_buckets > 26 || load == 0 || load > 99) {
+		fprintf(stderr, "usage: %s [log2_buckets] [load_percent]\n",
+			argv[0]);
+		return 1;
+	}
+	capacity = 4UL << log2_buckets;
+	num_keys = (capacity * load) / 100;
+
+	order = (unsigned long *)malloc(sizeof(unsigned long) * num_keys);
+	samples = (unsigned long *)malloc(sizeof(unsigned long) * num_keys);
+	if (!order || !samples) {
+		free(order);
+		free(samples);
+		return 1;
+	}
+	for (i = 0; i < num_keys; ++i) {
+		order[i] = i;
+	}
+	for (i = num_keys - 1; i > 0; --i) {
+		j = bench_random(&seed) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	printf("%lu keys, %lu%% of %lu cuckoo slots, ns per lookup\n",
+	       num_keys, load, capacity);
+	printf("%-8s %-5s %8s %8s %8s %8s %8s\n", "table", "op", "mean",
+	       "p50", "p99", "p99.9", "max");
+
+	table = ehht_new();
+	if (!table || bench_fill(table, num_keys)) {
+		err = 1;
+	} else {
+		err += bench_lookups("chained", table, num_keys, order,
+				     samples);
+	}
+	ehht_free(table);
+
+	table = ehht_new();
+	if (!table || ehht_bucket_tags(table, 1)
+	    || bench_fill(table, num_keys)) {
+		err = 1;
+	} else {
+		err += bench_lookups("tags", table, num_keys, order, samples);
+	}
+	ehht_free(table);
+
+	table = ehht_new_cuckoo(capacity, NULL, NULL, NULL);
+	if (!table || bench_fill(table, num_keys)) {
+		err = 1;
+	} else {
+		err += bench_lookups("cuckoo", table, num_keys, order,
+				     samples);
+	}
+	ehht_free(table);
+
+	free(samples);
+	free(order);
+	return err ? 1 : 0;
+}
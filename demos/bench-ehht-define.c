@@ -0,0 +1,225 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-define.c: compare EHHT_DEFINE tables to function pointers */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-define [num_keys] [rounds] [seed]
+ *
+ * Inserts num_keys random 64-bit integers, then looks all of them up
+ * "rounds" times, using:
+ *	define	an EHHT_DEFINE table, where everything may be inlined
+ *	u64	a "struct ehht_u64", which has the same element layout and
+ *		hash, but is called through function pointers
+ *	ehht	a "struct ehht" with 8 byte keys, which calls through
+ *		function pointers, hashes bytes, and compares with memcmp
+ *
+ * The default is a small table which fits in cache, so that the call
+ * overhead is visible; with millions of keys the gets are dominated by
+ * cache misses and the difference shrinks.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* malloc strtoul */
+
+#include "ehht.h"
+#include "ehht-fixed.h"
+#include "ehht-define.h"
+#include "bench-util.h"
+
+#define Bench_u64_eq(a, b) ((a) == (b))
+
+EHHT_DEFINE(bench_map, uint64_t, uint64_t *, ehht_mix64, Bench_u64_eq);
+
+struct bench_data {
+	uint64_t *keys;
+	uint64_t *order;
+	size_t num_keys;
+	unsigned long rounds;
+};
+
+struct bench_result {
+	unsigned long put_ns;
+	unsigned long get_ns;
+	size_t found;
+};
+
+static void bench_define(struct bench_data *data, struct bench_result *result)
+{
+	struct bench_map table;
+	unsigned long start = 0;
+	unsigned long round = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (bench_map_init(&table, 0, NULL, NULL)) {
+		return;
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < data->num_keys; ++i) {
+		bench_map_put(&table, data->keys[i], data->keys + i, NULL,
+			      &err);
+	}
+	result->put_ns = bench_now_ns(NULL) - start;
+
+	start = bench_now_ns(NULL);
+	for (round = 0; round < data->rounds; ++round) {
+		for (i = 0; i < data->num_keys; ++i) {
+			if (bench_map_get(&table, data->order[i])) {
+				++result->found;
+			}
+		}
+	}
+	result->get_ns = bench_now_ns(NULL) - start;
+
+	bench_map_destroy(&table);
+}
+
+static void bench_u64(struct bench_data *data, struct bench_result *result)
+{
+	struct ehht_u64 *table = NULL;
+	unsigned long start = 0;
+	unsigned long round = 0;
+	size_t i = 0;
+	int err = 0;
+
+	table = ehht_u64_new(0, NULL, NULL);
+	if (!table) {
+		return;
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < data->num_keys; ++i) {
+		table->put(table, data->keys[i], data->keys + i, &err);
+	}
+	result->put_ns = bench_now_ns(NULL) - start;
+
+	start = bench_now_ns(NULL);
+	for (round = 0; round < data->rounds; ++round) {
+		for (i = 0; i < data->num_keys; ++i) {
+			if (table->get(table, data->order[i])) {
+				++result->found;
+			}
+		}
+	}
+	result->get_ns = bench_now_ns(NULL) - start;
+
+	ehht_u64_free(table);
+}
+
+static void bench_ehht(struct bench_data *data, struct bench_result *result)
+{
+	struct ehht *table = NULL;
+	const size_t len = sizeof(uint64_t);
+	unsigned long start = 0;
+	unsigned long round = 0;
+	size_t i = 0;
+	int err = 0;
+
+	table = ehht_new();
+	if (!table) {
+		return;
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < data->num_keys; ++i) {
+		table->put(table, (const char *)(data->keys + i), len,
+			   data->keys + i, &err);
+	}
+	result->put_ns = bench_now_ns(NULL) - start;
+
+	start = bench_now_ns(NULL);
+	for (round = 0; round < data->rounds; ++round) {
+		for (i = 0; i < data->num_keys; ++i) {
+			if (table->get(table, (const char *)(data->order + i),
+				       len)) {
+				++result->found;
+			}
+		}
+	}
+	result->get_ns = bench_now_ns(NULL) - start;
+
+	ehht_free(table);
+}
+
+static int bench_report(const char *name, struct bench_data *data,
+			struct bench_result *result)
+{
+	double gets = (double)data->num_keys * data->rounds;
+
+	printf("%-8s %10.1f %10.1f\n", name,
+	       (double)result->put_ns / data->num_keys,
+	       (double)result->get_ns / gets);
+	return (result->found == data->num_keys * data->rounds) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_data data;
+	struct bench_result results[3];
+	unsigned long seed = 88172645463325252UL;
+	uint64_t tmp = 0;
+	size_t i = 0;
+	size_t j = 0;
+	int err = 0;
+
+	eembed_memset(&data, 0x00, sizeof(struct bench_data));
+	eembed_memset(results, 0x00, sizeof(results));
+	data.num_keys = 1000;
+	data.rounds = 2000;
+	if (argc > 1) {
+		data.num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		data.rounds = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		seed = strtoul(argv[3], NULL, 10);
+	}
+	if (data.num_keys == 0 || data.rounds == 0 || seed == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [rounds] [seed]\n",
+			argv[0]);
+		return 1;
+	}
+
+	data.keys = (uint64_t *)malloc(sizeof(uint64_t) * data.num_keys);
+	data.order = (uint64_t *)malloc(sizeof(uint64_t) * data.num_keys);
+	if (!data.keys || !data.order) {
+		fprintf(stderr, "could not allocate %lu keys\n",
+			(unsigned long)data.num_keys);
+		free(data.keys);
+		free(data.order);
+		return 1;
+	}
+	for (i = 0; i < data.num_keys; ++i) {
+		data.keys[i] = bench_random(&seed);
+		data.order[i] = data.keys[i];
+	}
+	for (i = data.num_keys - 1; i > 0; --i) {
+		j = bench_random(&seed) % (i + 1);
+		tmp = data.order[i];
+		data.order[i] = data.order[j];
+		data.order[j] = tmp;
+	}
+
+	bench_define(&data, &results[0]);
+	bench_u64(&data, &results[1]);
+	bench_ehht(&data, &results[2]);
+
+	printf("%lu keys, %lu rounds of gets\n", (unsigned long)data.num_keys,
+	       data.rounds);
+	printf("%-8s %10s %10s\n", "table", "put ns", "get ns");
+	err += bench_report("define", &data, &results[0]);
+	err += bench_report("u64", &data, &results[1]);
+	err += bench_report("ehht", &data, &results[2]);
+
+	free(data.keys);
+	free(data.order);
+
+	if (err) {
+		fprintf(stderr, "lookups failed\n");
+	}
+	return err ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-entry.c: word counting with get and put, or ehht_entry */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-entry [num_words] [vocabulary]
+ *
+ * Counts num_words words drawn from a skewed vocabulary, storing the
+ * count in the "void *" value:
+ *	get+put	"has_key" and "get" to read the count, "put" to store it
+ *	entry	ehht_entry, incrementing the count in place
+ * and reports the time per word.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static int bench_count(int use_entry, unsigned long num_words,
+		       const unsigned long *words, unsigned long *total)
+{
+	struct ehht *table = NULL;
+	void **slot = NULL;
+	size_t count = 0;
+	char key[40];
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long i = 0;
+	int len = 0;
+	int err = 0;
+
+	table = ehht_new();
+	if (!table) {
+		return 1;
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_words && !err; ++i) {
+		len = sprintf(key, "word%lu", words[i]);
+		if (use_entry) {
+			slot = ehht_entry(table, key, (size_t)len, NULL, &err);
+			if (slot) {
+				*slot = (void *)(((size_t)*slot) + 1);
+			}
+		} else {
+			count = 0;
+			if (table->has_key(table, key, (size_t)len)) {
+				count = (size_t)table->get(table, key,
+							   (size_t)len);
+			}
+			table->put(table, key, (size_t)len,
+				   (void *)(count + 1), &err);
+		}
+	}
+	elapsed = bench_now_ns(NULL) - start;
+
+	*total = 0;
+	for (i = 0; i < 100; ++i) {
+		len = sprintf(key, "word%lu", i);
+		*total += (size_t)table->get(table, key, (size_t)len);
+	}
+	printf("%-8s %10.1f %10lu\n", use_entry ? "entry" : "get+put",
+	       (double)elapsed / num_words, (unsigned long)table->size(table));
+
+	ehht_free(table);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_words = 4000000;
+	unsigned long vocabulary = 100000;
+	unsigned long seed = 88172645463325252UL;
+	unsigned long *words = NULL;
+	unsigned long total1 = 0;
+	unsigned long total2 = 0;
+	unsigned long r = 0;
+	unsigned long i = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		num_words = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		vocabulary = strtoul(argv[2], NULL, 10);
+	}
+	if (num_words == 0 || vocabulary == 0) {
+		fprintf(stderr, "usage: %s [num_words] [vocabulary]\n",
+			argv[0]);
+		return 1;
+	}
+
+	words = (unsigned long *)malloc(sizeof(unsigned long) * num_words);
+	if (!words) {
+		return 1;
+	}
+	/* the minimum of two draws favors the low-numbered words */
+	for (i = 0; i < num_words; ++i) {
+		words[i] = bench_random(&seed) % vocabulary;
+		r = bench_random(&seed) % vocabulary;
+		if (r < words[i]) {
+			words[i] = r;
+		}
+	}
+
+	printf("%lu words, %lu vocabulary, ns per word\n", num_words,
+	       vocabulary);
+	printf("%-8s %10s %10s\n", "count", "word", "distinct");
+	err += bench_count(0, num_words, words, &total1);
+	err += bench_count(1, num_words, words, &total2);
+	if (total1 != total2) {
+		fprintf(stderr, "counts differ: %lu != %lu\n", total1, total2);
+		err = 1;
+	}
+
+	free(words);
+	return err ? 1 : 0;
+}
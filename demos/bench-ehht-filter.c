@@ -0,0 +1,158 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-filter.c: lookups with and without ehht_counting_filter */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-filter [num_keys] [rounds]
+ *
+ * Loads num_keys keys, then times "rounds" passes of:
+ *	miss	lookups of absent keys, in a random order
+ *	mixed	lookups of which 4 in 5 are of absent keys
+ *	hit	lookups of present keys, in a random order
+ * for each combination of ehht_bucket_tags and ehht_counting_filter,
+ * and reports the false positive rate of the filter: the fraction of
+ * the absent keys which it did not reject.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static int bench_filter(const char *name, int tags, int filter,
+			unsigned long num_keys, unsigned long rounds,
+			const unsigned long *order)
+{
+	struct ehht *table = NULL;
+	struct ehht_stats stats;
+	char key[40];
+	unsigned long start = 0;
+	unsigned long hit_ns = 0;
+	unsigned long miss_ns = 0;
+	unsigned long mixed_ns = 0;
+	unsigned long found = 0;
+	unsigned long expected = 0;
+	size_t negatives = 0;
+	unsigned long i = 0;
+	unsigned long r = 0;
+	int len = 0;
+	int err = 0;
+
+	table = ehht_new();
+	if (!table) {
+		return 1;
+	}
+	if ((tags && ehht_bucket_tags(table, 1))
+	    || (filter && ehht_counting_filter(table, 1))) {
+		ehht_free(table);
+		return 1;
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "present:%lu", i);
+		table->put(table, key, (size_t)len, NULL, &err);
+	}
+
+	for (r = 0; r < rounds; ++r) {
+		ehht_stats(table, &stats);
+		negatives -= stats.filter_negatives;
+		start = bench_now_ns(NULL);
+		for (i = 0; i < num_keys; ++i) {
+			len = sprintf(key, "absent:%lu", order[i]);
+			found += table->has_key(table, key, (size_t)len);
+		}
+		miss_ns += bench_now_ns(NULL) - start;
+		ehht_stats(table, &stats);
+		negatives += stats.filter_negatives;
+
+		start = bench_now_ns(NULL);
+		for (i = 0; i < num_keys; ++i) {
+			if ((order[i] % 5) == 0) {
+				len = sprintf(key, "present:%lu", order[i]);
+			} else {
+				len = sprintf(key, "absent:%lu", order[i]);
+			}
+			found += table->has_key(table, key, (size_t)len);
+		}
+		mixed_ns += bench_now_ns(NULL) - start;
+
+		start = bench_now_ns(NULL);
+		for (i = 0; i < num_keys; ++i) {
+			len = sprintf(key, "present:%lu", order[i]);
+			found += table->has_key(table, key, (size_t)len);
+		}
+		hit_ns += bench_now_ns(NULL) - start;
+		expected += num_keys + ((num_keys + 4) / 5);
+	}
+
+	ehht_stats(table, &stats);
+	printf("%-12s %8.1f %8.1f %8.1f %10.1f", name,
+	       (double)miss_ns / (num_keys * rounds),
+	       (double)mixed_ns / (num_keys * rounds),
+	       (double)hit_ns / (num_keys * rounds),
+	       (double)stats.bytes_buckets / num_keys);
+	if (filter) {
+		printf(" %7.2f%%\n", 100.0 * (1.0 - ((double)negatives
+						     / (num_keys * rounds))));
+	} else {
+		printf(" %8s\n", "-");
+	}
+	if (found != expected) {
+		fprintf(stderr, "found %lu of %lu\n", found, expected);
+		err = 1;
+	}
+
+	ehht_free(table);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long rounds = 4;
+	unsigned long seed = 88172645463325252UL;
+	unsigned long *order = NULL;
+	unsigned long i = 0;
+	unsigned long j = 0;
+	unsigned long tmp = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		rounds = strtoul(argv[2], NULL, 10);
+	}
+	if (num_keys == 0 || rounds == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [rounds]\n", argv[0]);
+		return 1;
+	}
+
+	order = (unsigned long *)malloc(sizeof(unsigned long) * num_keys);
+	if (!order) {
+		return 1;
+	}
+	for (i = 0; i < num_keys; ++i) {
+		order[i] = i;
+	}
+	for (i = num_keys - 1; i > 0; --i) {
+		j = bench_random(&seed) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	printf("%lu keys, %lu rounds, ns per lookup\n", num_keys, rounds);
+	printf("%-12s %8s %8s %8s %10s %8s\n", "buckets", "miss", "mixed",
+	       "hit", "bytes/key", "fp rate");
+	err += bench_filter("plain", 0, 0, num_keys, rounds, order);
+	err += bench_filter("filter", 0, 1, num_keys, rounds, order);
+	err += bench_filter("tags", 1, 0, num_keys, rounds, order);
+	err += bench_filter("tags+filter", 1, 1, num_keys, rounds, order);
+
+	free(order);
+	return err ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-fixed.c: compare fixed-width key tables to byte keys */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-fixed [num_keys] [seed]
+ *
+ * Inserts num_keys random 64-bit integers, then looks each of them up
+ * in a different order, first using a "struct ehht_u64" and then a
+ * "struct ehht" with the same integers as 8 byte keys. The bytes per
+ * entry are the peak bytes allocated divided by the number of keys.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* malloc strtoul */
+
+#include "ehht.h"
+#include "ehht-fixed.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+struct bench_result {
+	unsigned long put_ns;
+	unsigned long get_ns;
+	unsigned long get_many_ns;
+	size_t bytes_peak;
+	size_t found;
+};
+
+static void bench_u64(uint64_t *keys, uint64_t *order, void **vals,
+		      size_t num_keys, struct bench_result *result)
+{
+	struct bench_tracking_context tctx;
+	struct eembed_allocator tracking;
+	struct ehht_u64 *table = NULL;
+	unsigned long start = 0;
+	size_t i = 0;
+	int err = 0;
+
+	bench_tracking_allocator_init(&tracking, &tctx,
+				      eembed_global_allocator);
+	table = ehht_u64_new(0, &tracking, NULL);
+	if (!table) {
+		return;
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys; ++i) {
+		table->put(table, keys[i], keys + i, &err);
+	}
+	result->put_ns = bench_now_ns(NULL) - start;
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys; ++i) {
+		result->found += table->get(table, order[i]) ? 1 : 0;
+	}
+	result->get_ns = bench_now_ns(NULL) - start;
+
+	start = bench_now_ns(NULL);
+	result->found += table->get_many(table, order, num_keys, vals);
+	result->get_many_ns = bench_now_ns(NULL) - start;
+
+	result->bytes_peak = tctx.bytes_peak;
+	ehht_u64_free(table);
+}
+
+static void bench_bytes(uint64_t *keys, uint64_t *order, size_t num_keys,
+			struct bench_result *result)
+{
+	struct bench_tracking_context tctx;
+	struct eembed_allocator tracking;
+	struct ehht *table = NULL;
+	unsigned long start = 0;
+	size_t len = sizeof(uint64_t);
+	size_t i = 0;
+	int err = 0;
+
+	bench_tracking_allocator_init(&tracking, &tctx,
+				      eembed_global_allocator);
+	table = ehht_new_custom(0, NULL, &tracking, NULL);
+	if (!table) {
+		return;
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys; ++i) {
+		table->put(table, (const char *)(keys + i), len, keys + i,
+			   &err);
+	}
+	result->put_ns = bench_now_ns(NULL) - start;
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys; ++i) {
+		result->found +=
+		    table->get(table, (const char *)(order + i), len) ? 1 : 0;
+	}
+	result->get_ns = bench_now_ns(NULL) - start;
+
+	result->bytes_peak = tctx.bytes_peak;
+	ehht_free(table);
+}
+
+static void bench_report(const char *name, struct bench_result *result,
+			 size_t num_keys)
+{
+	printf("%-12s %10.1f %10.1f", name,
+	       (double)result->put_ns / num_keys,
+	       (double)result->get_ns / num_keys);
+	if (result->get_many_ns) {
+		printf(" %10.1f", (double)result->get_many_ns / num_keys);
+	} else {
+		printf(" %10s", "-");
+	}
+	printf(" %10.1f\n", (double)result->bytes_peak / num_keys);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_result fixed_result;
+	struct bench_result bytes_result;
+	unsigned long num_keys = 1000000;
+	unsigned long seed = 88172645463325252UL;
+	uint64_t *keys = NULL;
+	uint64_t *order = NULL;
+	void **vals = NULL;
+	uint64_t tmp = 0;
+	size_t i = 0;
+	size_t j = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		seed = strtoul(argv[2], NULL, 10);
+	}
+	if (num_keys == 0 || seed == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	keys = (uint64_t *)malloc(sizeof(uint64_t) * num_keys);
+	order = (uint64_t *)malloc(sizeof(uint64_t) * num_keys);
+	vals = (void **)malloc(sizeof(void *) * num_keys);
+	if (!keys || !order || !vals) {
+		fprintf(stderr, "could not allocate %lu keys\n", num_keys);
+		free(keys);
+		free(order);
+		free(vals);
+		return 1;
+	}
+	for (i = 0; i < num_keys; ++i) {
+		keys[i] = bench_random(&seed);
+		order[i] = keys[i];
+	}
+	/* look up in a shuffled order, so the cache is not primed */
+	for (i = num_keys - 1; i > 0; --i) {
+		j = bench_random(&seed) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	eembed_memset(&fixed_result, 0x00, sizeof(struct bench_result));
+	eembed_memset(&bytes_result, 0x00, sizeof(struct bench_result));
+
+	bench_u64(keys, order, vals, num_keys, &fixed_result);
+	bench_bytes(keys, order, num_keys, &bytes_result);
+
+	printf("%lu keys\n", num_keys);
+	printf("%-12s %10s %10s %10s %10s\n", "table", "put ns", "get ns",
+	       "many ns", "bytes/key");
+	bench_report("ehht_u64", &fixed_result, num_keys);
+	bench_report("ehht", &bytes_result, num_keys);
+
+	free(keys);
+	free(order);
+	free(vals);
+
+	if (fixed_result.found != 2 * num_keys
+	    || bytes_result.found != num_keys) {
+		fprintf(stderr, "lookups failed (%lu, %lu)\n",
+			(unsigned long)fixed_result.found,
+			(unsigned long)bytes_result.found);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// bench-ehht-hpp.cpp: compare ehht::map to std::unordered_map
+// Copyright (C) 2020 Eric Herman <eric@freesa.org>
+// https://github.com/ericherman/libehht
+
+// Usage:
+//	bench-ehht-hpp [num_keys] [seed]
+//
+// Runs the same workloads against ehht::map and std::unordered_map:
+//	insert	try_emplace of num_keys std::string keys
+//	view	lookups by std::string_view slices of a larger buffer; the
+//		C++17 std::unordered_map must construct a std::string for each
+//	update	insert_or_assign on every key (present) and as many new keys
+//	uniq	try_emplace and erase of move-only std::unique_ptr values
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ehht.hpp"
+
+using bench_clock = std::chrono::steady_clock;
+
+static double bench_ns_per(bench_clock::time_point start, std::size_t ops)
+{
+	std::chrono::duration<double, std::nano> d = bench_clock::now() - start;
+	return d.count() / ops;
+}
+
+static unsigned long bench_random(unsigned long *state)
+{
+	unsigned long x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 2685821657736338717UL;
+}
+
+struct bench_keys {
+	std::vector<std::string> keys;
+	std::vector<std::string> more;
+	std::string buffer;
+	std::vector<std::string_view> views;
+};
+
+template <class Map, class Find>
+static void bench_run(const char *name, const bench_keys &data, Find find)
+{
+	std::size_t n = data.keys.size();
+	std::size_t found = 0;
+	bench_clock::time_point start;
+	double insert_ns, view_ns, update_ns, uniq_ns;
+	Map table;
+
+	start = bench_clock::now();
+	for (std::size_t i = 0; i < n; ++i) {
+		table.try_emplace(data.keys[i], i);
+	}
+	insert_ns = bench_ns_per(start, n);
+
+	start = bench_clock::now();
+	for (std::size_t i = 0; i < n; ++i) {
+		found += find(table, data.views[i]);
+	}
+	view_ns = bench_ns_per(start, n);
+
+	start = bench_clock::now();
+	for (std::size_t i = 0; i < n; ++i) {
+		table.insert_or_assign(data.keys[i], i + 1);
+		table.insert_or_assign(data.more[i], i);
+	}
+	update_ns = bench_ns_per(start, 2 * n);
+
+	using uniq_map = typename std::conditional<
+		std::is_same<Map, std::unordered_map<std::string,
+						     std::size_t>>::value,
+		std::unordered_map<std::string, std::unique_ptr<std::size_t>>,
+		ehht::map<std::string, std::unique_ptr<std::size_t>>>::type;
+	uniq_map uniq;
+	start = bench_clock::now();
+	for (std::size_t i = 0; i < n; ++i) {
+		uniq.try_emplace(data.keys[i], new std::size_t(i));
+		if (i >= 1000) {
+			uniq.erase(data.keys[i - 1000]);
+		}
+	}
+	uniq_ns = bench_ns_per(start, n);
+
+	std::printf("%-14s %10.1f %10.1f %10.1f %10.1f\n", name, insert_ns,
+		    view_ns, update_ns, uniq_ns);
+	if (found != n) {
+		std::fprintf(stderr, "%s: found %lu of %lu\n", name,
+			     (unsigned long)found, (unsigned long)n);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long seed = 88172645463325252UL;
+	bench_keys data;
+
+	if (argc > 1) {
+		num_keys = std::strtoul(argv[1], nullptr, 10);
+	}
+	if (argc > 2) {
+		seed = std::strtoul(argv[2], nullptr, 10);
+	}
+	if (num_keys == 0 || seed == 0) {
+		std::fprintf(stderr, "usage: %s [num_keys] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	for (unsigned long i = 0; i < num_keys; ++i) {
+		unsigned long key = bench_random(&seed);
+		unsigned long more = bench_random(&seed);
+		data.keys.push_back("key:" + std::to_string(key));
+		data.more.push_back("new:" + std::to_string(more));
+	}
+	// a "request buffer" which holds every key, in a shuffled order
+	std::vector<std::size_t> order(num_keys);
+	std::vector<std::size_t> offsets(num_keys);
+	for (std::size_t i = 0; i < num_keys; ++i) {
+		order[i] = i;
+	}
+	for (std::size_t i = num_keys - 1; i > 0; --i) {
+		std::swap(order[i], order[bench_random(&seed) % (i + 1)]);
+	}
+	for (std::size_t i = 0; i < num_keys; ++i) {
+		offsets[i] = data.buffer.size();
+		data.buffer += data.keys[order[i]];
+		data.buffer += ' ';
+	}
+	for (std::size_t i = 0; i < num_keys; ++i) {
+		data.views.emplace_back(data.buffer.data() + offsets[i],
+					data.keys[order[i]].size());
+	}
+
+	std::printf("%lu keys, ns per operation\n", num_keys);
+	std::printf("%-14s %10s %10s %10s %10s\n", "table", "insert", "view",
+		    "update", "uniq");
+
+	bench_run<ehht::map<std::string, std::size_t>>("ehht::map", data,
+		[](auto &table, std::string_view view) {
+			return table.contains(view) ? 1 : 0;
+		});
+	bench_run<std::unordered_map<std::string, std::size_t>>(
+		"unordered_map", data,
+		[](auto &table, std::string_view view) {
+			return table.count(std::string(view));
+		});
+
+	return 0;
+}
@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-hugepage.c: random lookups with and without huge pages */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-hugepage [num_keys] [huge]
+ *
+ * Loads num_keys keys, with keys pooled in 2 MiB chunks, then times
+ * lookups of them in a random order. With huge 0 the table uses
+ * eembed_global_allocator, with huge 1 the ehht_hugepage allocator, and
+ * if huge is not given, both are run, each in a forked child. Reports:
+ *	get ns		the mean time per lookup
+ *	mapped		allocations which were mapped by the adapter
+ *	madvised	of those, how many were marked for huge pages
+ *	anon huge	AnonHugePages of the process, in KiB
+ *
+ * The TLB effect itself is best seen with "make perf-hugepage", which
+ * runs this under perf stat with the dTLB-load-misses events.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+#include <string.h>		/* strncmp */
+#include <sys/wait.h>		/* waitpid */
+#include <unistd.h>		/* fork */
+
+#include "ehht.h"
+#include "ehht-hugepage.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static unsigned long bench_anon_huge_kib(void)
+{
+	FILE *smaps = NULL;
+	char line[256];
+	unsigned long kib = 0;
+
+	smaps = fopen("/proc/self/smaps_rollup", "r");
+	if (!smaps) {
+		return 0;
+	}
+	while (fgets(line, sizeof(line), smaps)) {
+		if (strncmp(line, "AnonHugePages:", 14) == 0) {
+			kib = strtoul(line + 14, NULL, 10);
+			break;
+		}
+	}
+	fclose(smaps);
+	return kib;
+}
+
+static int bench_hugepage(int huge, unsigned long num_keys)
+{
+	struct ehht_hugepage_context hctx;
+	struct eembed_allocator hugepage;
+	struct eembed_allocator *ea = NULL;
+	struct ehht *table = NULL;
+	char key[40];
+	unsigned long seed = 0x5eed;
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long found = 0;
+	unsigned long i = 0;
+	int len = 0;
+	int err = 0;
+
+	eembed_memset(&hctx, 0x00, sizeof(struct ehht_hugepage_context));
+	ea = eembed_global_allocator;
+	if (huge) {
+		ehht_hugepage_allocator_init(&hugepage, &hctx, NULL, 0,
+					     EHHT_HUGEPAGE_HUGETLB, 0);
+		ea = &hugepage;
+	}
+
+	table = ehht_new_custom(num_keys, NULL, ea, NULL);
+	if (!table) {
+		return 1;
+	}
+	if (ehht_pool_keys(table, 2 * 1024 * 1024)) {
+		ehht_free(table);
+		return 1;
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "key:%lu", i);
+		table->put(table, key, (size_t)len, table, &err);
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys; ++i) {
+		len = sprintf(key, "key:%lu", bench_random(&seed) % num_keys);
+		found += (table->get(table, key, (size_t)len) != NULL);
+	}
+	elapsed = bench_now_ns(NULL) - start;
+
+	printf("%-8s %10.1f %10lu %10lu %10lu\n", huge ? "huge" : "default",
+	       (double)elapsed / num_keys, (unsigned long)hctx.mapped,
+	       (unsigned long)hctx.madvised, bench_anon_huge_kib());
+
+	ehht_free(table);
+	return (err || found != num_keys) ? 1 : 0;
+}
+
+static int bench_forked(int huge, unsigned long num_keys)
+{
+	pid_t pid = 0;
+	int status = 0;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		exit(bench_hugepage(huge, num_keys));
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		return 1;
+	}
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 4000000;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (num_keys == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [huge]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%lu keys, random lookups\n", num_keys);
+	printf("%-8s %10s %10s %10s %10s\n", "alloc", "get ns", "mapped",
+	       "madvised", "anon huge");
+	if (argc > 2) {
+		return bench_hugepage(atoi(argv[2]), num_keys);
+	}
+	err += bench_forked(0, num_keys);
+	err += bench_forked(1, num_keys);
+
+	return err ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-keys.c: bytes per key with and without ehht_pool_keys */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-keys [num_keys] [chunk_size]
+ *
+ * Inserts num_keys short keys ("k" and a number) and reports, per key:
+ *	requested	bytes requested through the eembed_allocator
+ *	rss		growth of the resident set, which includes the
+ *			malloc headers and rounding not visible to the
+ *			allocator wrapper
+ * and the time per put. Then, for a copying snapshot with
+ * table->keys(table, 1), the time per key, the peak bytes per key
+ * requested for it, and the number of allocations it made. Each layout
+ * runs in a forked child, so that the resident set of one does not hide
+ * the other.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+#include <sys/wait.h>		/* waitpid */
+#include <unistd.h>		/* fork sysconf */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static size_t bench_rss_bytes(void)
+{
+	FILE *statm = NULL;
+	unsigned long pages = 0;
+	unsigned long resident = 0;
+
+	statm = fopen("/proc/self/statm", "r");
+	if (!statm) {
+		return 0;
+	}
+	if (fscanf(statm, "%lu %lu", &pages, &resident) != 2) {
+		resident = 0;
+	}
+	fclose(statm);
+	return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static int bench_keys(const char *name, unsigned long num_keys,
+		      size_t chunk_size)
+{
+	struct bench_tracking_context tctx;
+	struct eembed_allocator tracking;
+	struct ehht *table = NULL;
+	struct ehht_keys *keys = NULL;
+	size_t snap_allocs = 0;
+	size_t snap_peak = 0;
+	unsigned long snap_elapsed = 0;
+	char key[40];
+	size_t rss_before = 0;
+	size_t rss_after = 0;
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long i = 0;
+	int len = 0;
+	int err = 0;
+
+	bench_tracking_allocator_init(&tracking, &tctx,
+				      eembed_global_allocator);
+	table = ehht_new_custom(num_keys, NULL, &tracking, NULL);
+	if (!table) {
+		return 1;
+	}
+	if (ehht_pool_keys(table, chunk_size)) {
+		ehht_free(table);
+		return 1;
+	}
+
+	rss_before = bench_rss_bytes();
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "k%lu", i);
+		table->put(table, key, (size_t)len, NULL, &err);
+	}
+	elapsed = bench_now_ns(NULL) - start;
+	rss_after = bench_rss_bytes();
+
+	snap_allocs = tctx.allocs;
+	snap_peak = tctx.bytes_live;
+	tctx.bytes_peak = tctx.bytes_live;
+	start = bench_now_ns(NULL);
+	keys = table->keys(table, 1);
+	snap_elapsed = bench_now_ns(NULL) - start;
+	snap_allocs = tctx.allocs - snap_allocs;
+	snap_peak = tctx.bytes_peak - snap_peak;
+	if (!keys) {
+		err = 1;
+	} else {
+		table->free_keys(table, keys);
+	}
+
+	printf("%-8s %10.1f %10.1f %10.1f %10lu %10.1f %10.1f %10lu\n", name,
+	       (double)tctx.bytes_live / num_keys,
+	       (double)(rss_after - rss_before) / num_keys,
+	       (double)elapsed / num_keys,
+	       (unsigned long)(tctx.allocs - snap_allocs),
+	       (double)snap_elapsed / num_keys, (double)snap_peak / num_keys,
+	       (unsigned long)snap_allocs);
+
+	ehht_free(table);
+	return err;
+}
+
+static int bench_forked(const char *name, unsigned long num_keys,
+			size_t chunk_size)
+{
+	pid_t pid = 0;
+	int status = 0;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		exit(bench_keys(name, num_keys, chunk_size));
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		return 1;
+	}
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long chunk_size = 64 * 1024;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		chunk_size = strtoul(argv[2], NULL, 10);
+	}
+	if (num_keys == 0 || chunk_size == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [chunk_size]\n",
+			argv[0]);
+		return 1;
+	}
+
+	/* the bucket array is allocated before the measurement starts */
+	printf("%lu keys, bytes and ns per key\n", num_keys);
+	printf("%-8s %10s %10s %10s %10s %10s %10s %10s\n", "keys",
+	       "requested", "rss", "put ns", "allocs", "snap ns", "snap peak",
+	       "snap allocs");
+	err += bench_forked("malloc", num_keys, 0);
+	err += bench_forked("pooled", num_keys, chunk_size);
+
+	return err ? 1 : 0;
+}
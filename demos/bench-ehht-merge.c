@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-merge.c: combine partition tables with put or ehht_merge */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-merge [num_keys] [partitions]
+ *
+ * Spreads num_keys keys over "partitions" tables, with a quarter of the
+ * keys in two partitions, and combines them into the first:
+ *	put	for_each over each partition, "put" into the first
+ *	merge	ehht_merge of each partition into the first, relinking
+ * and reports the time per element combined.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+struct bench_put_context {
+	struct ehht *dst;
+	int err;
+};
+
+static int bench_put_each(struct ehht_key each_key, void *each_val,
+			  void *context)
+{
+	struct bench_put_context *ctx = (struct bench_put_context *)context;
+	ctx->dst->put(ctx->dst, each_key.str, each_key.len, each_val,
+		      &ctx->err);
+	return ctx->err;
+}
+
+static int bench_merge(int use_merge, unsigned long num_keys,
+		       unsigned long partitions)
+{
+	struct ehht **tables = NULL;
+	struct bench_put_context ctx;
+	char key[40];
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long elements = 0;
+	unsigned long i = 0;
+	unsigned long p = 0;
+	int len = 0;
+	int err = 0;
+
+	tables = (struct ehht **)calloc(partitions, sizeof(struct ehht *));
+	if (!tables) {
+		return 1;
+	}
+	for (p = 0; p < partitions && !err; ++p) {
+		tables[p] = ehht_new();
+		err = tables[p] ? 0 : 1;
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "key:%lu", i);
+		p = i % partitions;
+		tables[p]->put(tables[p], key, (size_t)len, NULL, &err);
+		if ((i % 4) == 0) {
+			p = (p + 1) % partitions;
+			tables[p]->put(tables[p], key, (size_t)len, NULL,
+				       &err);
+		}
+	}
+	for (p = 1; p < partitions && !err; ++p) {
+		elements += tables[p]->size(tables[p]);
+	}
+
+	start = bench_now_ns(NULL);
+	ctx.dst = tables[0];
+	ctx.err = 0;
+	for (p = 1; p < partitions && !err; ++p) {
+		if (use_merge) {
+			err = ehht_merge(tables[0], tables[p], NULL, NULL);
+		} else {
+			tables[p]->for_each(tables[p], bench_put_each, &ctx);
+			tables[p]->clear(tables[p]);
+			err = ctx.err;
+		}
+	}
+	elapsed = bench_now_ns(NULL) - start;
+
+	printf("%-8s %10.1f %10lu\n", use_merge ? "merge" : "put",
+	       (double)elapsed / elements,
+	       (unsigned long)tables[0]->size(tables[0]));
+
+	for (p = 0; p < partitions; ++p) {
+		ehht_free(tables[p]);
+	}
+	free(tables);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long partitions = 8;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		partitions = strtoul(argv[2], NULL, 10);
+	}
+	if (num_keys == 0 || partitions < 2) {
+		fprintf(stderr, "usage: %s [num_keys] [partitions]\n",
+			argv[0]);
+		return 1;
+	}
+
+	printf("%lu keys, %lu partitions, ns per element combined\n",
+	       num_keys, partitions);
+	printf("%-8s %10s %10s\n", "combine", "element", "size");
+	err += bench_merge(0, num_keys, partitions);
+	err += bench_merge(1, num_keys, partitions);
+
+	return err ? 1 : 0;
+}
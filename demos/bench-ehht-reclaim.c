@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-reclaim.c: how long freeing a large table blocks */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-reclaim [num_keys] [budget]
+ *
+ * Fills a table of num_keys keys, and frees it: with ehht_free; with
+ * ehht_free_async and then ehht_reclaim_step calls of "budget" units
+ * each, as an event loop would between events; and with
+ * ehht_free_async to a background reclaimer thread. Reports the longest
+ * time the freeing thread was blocked at once, and the time until all
+ * was freed. The table allocator is libc malloc, declared thread-safe.
+ */
+
+#include <stdio.h>		/* printf sprintf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "ehht-reclaim.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static struct ehht *bench_fill(unsigned long num_keys)
+{
+	struct ehht *table = NULL;
+	unsigned long i = 0;
+	char key[40];
+	int len = 0;
+	int err = 0;
+
+	table = ehht_new_custom(num_keys, NULL, NULL, NULL);
+	if (!table) {
+		return NULL;
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "key:%016lx", i * 0x9E3779B97F4A7C15UL);
+		table->put(table, key, (size_t)len, (void *)i, &err);
+	}
+	if (err) {
+		ehht_free(table);
+		return NULL;
+	}
+	ehht_allocator_thread_safe(table, 1);
+	return table;
+}
+
+static void bench_report(const char *name, unsigned long blocked,
+			 unsigned long total, unsigned long steps)
+{
+	printf("%-8s %14.3f %14.3f %10lu\n", name, blocked / 1000000.0,
+	       total / 1000000.0, steps);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 5000000;
+	size_t budget = 4096;
+	struct ehht_reclaimer reclaimer;
+	struct ehht_reclaim_thread *rt = NULL;
+	struct ehht *table = NULL;
+	unsigned long start = 0;
+	unsigned long step_start = 0;
+	unsigned long blocked = 0;
+	unsigned long elapsed = 0;
+	unsigned long steps = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		budget = strtoul(argv[2], NULL, 10);
+	}
+	if (num_keys == 0 || budget == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [budget]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%lu keys, steps of %lu\n", num_keys, (unsigned long)budget);
+	printf("%-8s %14s %14s %10s\n", "free", "max block ms", "total ms",
+	       "steps");
+
+	table = bench_fill(num_keys);
+	if (!table) {
+		return 1;
+	}
+	start = bench_now_ns(NULL);
+	ehht_free(table);
+	elapsed = bench_now_ns(NULL) - start;
+	bench_report("sync", elapsed, elapsed, 1);
+
+	table = bench_fill(num_keys);
+	if (!table) {
+		return 1;
+	}
+	ehht_reclaimer_init(&reclaimer, NULL, NULL);
+	start = bench_now_ns(NULL);
+	ehht_free_async(table, &reclaimer);
+	blocked = bench_now_ns(NULL) - start;
+	do {
+		step_start = bench_now_ns(NULL);
+		elapsed = ehht_reclaim_step(&reclaimer, budget);
+		step_start = bench_now_ns(NULL) - step_start;
+		if (step_start > blocked) {
+			blocked = step_start;
+		}
+		++steps;
+	} while (elapsed == budget);
+	bench_report("step", blocked, bench_now_ns(NULL) - start, steps);
+
+	table = bench_fill(num_keys);
+	if (!table) {
+		return 1;
+	}
+	rt = ehht_reclaim_thread_start(&reclaimer, budget, NULL, NULL);
+	if (!rt) {
+		ehht_free(table);
+		return 1;
+	}
+	start = bench_now_ns(NULL);
+	ehht_free_async(table, &reclaimer);
+	blocked = bench_now_ns(NULL) - start;
+	ehht_reclaim_thread_stop(rt);
+	bench_report("thread", blocked, bench_now_ns(NULL) - start, 0);
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-spill.c: deduplication with a memory budget */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-spill [num_keys] [budget] [batch]
+ *
+ * Deduplicates a stream of 2 * num_keys keys, drawn at random from
+ * num_keys distinct keys, with a table of ehht_new_spill, of 64
+ * partitions, limited to "budget" bytes. The keys are put in batches of
+ * "batch" keys with ehht_spill_put_batch. Then batch / 64 more keys are
+ * put one at a time, each of which may load a partition. Reports, for
+ * each, the keys which were new, the time per key, the spills, loads,
+ * and the bytes written to and read from the spill files.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul malloc free */
+
+#include "ehht.h"
+#include "ehht-spill.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+#define BENCH_KEY_LEN 24
+
+static void bench_key(char *buf, unsigned long n)
+{
+	sprintf(buf, "key:%016lx", n * 0x9E3779B97F4A7C15UL);
+}
+
+/* puts "stream" keys, in batches of "batch", or one at a time if 1 */
+static int bench_stream(struct ehht *table, const char *name,
+			unsigned long num_keys, unsigned long batch,
+			unsigned long stream, unsigned long *seed,
+			struct ehht_key *keys, void **vals, char *strs)
+{
+	struct ehht_spill_stats before;
+	struct ehht_spill_stats after;
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long added = 0;
+	unsigned long i = 0;
+	unsigned long j = 0;
+	int err = 0;
+
+	ehht_spill_stats(table, &before);
+	start = bench_now_ns(NULL);
+	for (i = 0; i < stream && !err; i += j) {
+		for (j = 0; j < batch && (i + j) < stream; ++j) {
+			keys[j].str = strs + (j * BENCH_KEY_LEN);
+			bench_key(strs + (j * BENCH_KEY_LEN),
+				  bench_random(seed) % num_keys);
+			keys[j].len = 20;
+			vals[j] = NULL;
+		}
+		if (batch > 1) {
+			added +=
+			    ehht_spill_put_batch(table, keys, vals, j, &err);
+		} else if (!table->has_key(table, keys[0].str, keys[0].len)) {
+			table->put(table, keys[0].str, keys[0].len, NULL, &err);
+			++added;
+		}
+	}
+	elapsed = bench_now_ns(NULL) - start;
+	ehht_spill_stats(table, &after);
+
+	printf("%-8s %10lu %10lu %10.1f %8lu %8lu %10.1f %10.1f %10lu\n",
+	       name, stream, added, (double)elapsed / stream,
+	       (unsigned long)(after.spills - before.spills),
+	       (unsigned long)(after.loads - before.loads),
+	       (double)(after.bytes_written - before.bytes_written)
+	       / (1024 * 1024),
+	       (double)(after.bytes_read - before.bytes_read) / (1024 * 1024),
+	       (unsigned long)after.bytes_peak);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long budget = 16 * 1024 * 1024;
+	unsigned long batch = 256 * 1024;
+	unsigned long seed = 0x5eed;
+	struct ehht *table = NULL;
+	struct ehht_key *keys = NULL;
+	void **vals = NULL;
+	char *strs = NULL;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		budget = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		batch = strtoul(argv[3], NULL, 10);
+	}
+	if (num_keys == 0 || budget == 0 || batch < 64) {
+		fprintf(stderr, "usage: %s [num_keys] [budget] [batch]\n",
+			argv[0]);
+		return 1;
+	}
+
+	table = ehht_new_spill(budget, 64, NULL, NULL, NULL, NULL);
+	keys = (struct ehht_key *)malloc(sizeof(struct ehht_key) * batch);
+	vals = (void **)malloc(sizeof(void *) * batch);
+	strs = (char *)malloc(BENCH_KEY_LEN * batch);
+	if (!table || !keys || !vals || !strs) {
+		err = 1;
+		goto bench_end;
+	}
+
+	printf("%lu keys, in %lu bytes\n", num_keys, budget);
+	printf("%-8s %10s %10s %10s %8s %8s %10s %10s %10s\n", "puts", "keys",
+	       "new", "ns/key", "spills", "loads", "MiB out", "MiB in",
+	       "peak");
+	err += bench_stream(table, "batched", num_keys, batch, 2 * num_keys,
+			    &seed, keys, vals, strs);
+	err += bench_stream(table, "single", num_keys, 1, batch / 64, &seed,
+			    keys, vals, strs);
+
+bench_end:
+	free(strs);
+	free(vals);
+	free(keys);
+	if (table) {
+		ehht_free(table);
+	}
+	return err ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-tags.c: lookups with and without ehht_bucket_tags */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-tags [num_keys] [rounds] [tags]
+ *
+ * Loads num_keys keys, then times "rounds" passes of:
+ *	hit	lookups of present keys, in a random order
+ *	miss	lookups of absent keys, in a random order
+ * If "tags" is given as 0 or 1, only that layout is run, which is
+ * useful for comparing the cache behavior under perf, e.g.:
+ *	perf stat -e cycles,instructions,cache-misses,LLC-load-misses \
+ *		./bench-ehht-tags 1000000 4 0
+ *	perf stat -e cycles,instructions,cache-misses,LLC-load-misses \
+ *		./bench-ehht-tags 1000000 4 1
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+static int bench_tags(int tags, unsigned long num_keys, unsigned long rounds,
+		      const unsigned long *order)
+{
+	struct ehht *table = NULL;
+	struct ehht_stats stats;
+	char key[40];
+	unsigned long start = 0;
+	unsigned long hit_ns = 0;
+	unsigned long miss_ns = 0;
+	unsigned long found = 0;
+	unsigned long i = 0;
+	unsigned long r = 0;
+	int len = 0;
+	int err = 0;
+
+	table = ehht_new();
+	if (!table) {
+		return 1;
+	}
+	if (tags && ehht_bucket_tags(table, 1)) {
+		ehht_free(table);
+		return 1;
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "present:%lu", i);
+		table->put(table, key, (size_t)len, NULL, &err);
+	}
+
+	for (r = 0; r < rounds; ++r) {
+		start = bench_now_ns(NULL);
+		for (i = 0; i < num_keys; ++i) {
+			len = sprintf(key, "present:%lu", order[i]);
+			found += table->has_key(table, key, (size_t)len);
+		}
+		hit_ns += bench_now_ns(NULL) - start;
+
+		start = bench_now_ns(NULL);
+		for (i = 0; i < num_keys; ++i) {
+			len = sprintf(key, "absent:%lu", order[i]);
+			found += table->has_key(table, key, (size_t)len);
+		}
+		miss_ns += bench_now_ns(NULL) - start;
+	}
+
+	ehht_stats(table, &stats);
+	printf("%-8s %10.1f %10.1f %10.1f\n", tags ? "tags" : "plain",
+	       (double)hit_ns / (num_keys * rounds),
+	       (double)miss_ns / (num_keys * rounds),
+	       (double)stats.bytes_buckets / num_keys);
+	if (found != num_keys * rounds) {
+		fprintf(stderr, "found %lu of %lu\n", found, num_keys * rounds);
+		err = 1;
+	}
+
+	ehht_free(table);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long rounds = 4;
+	unsigned long only = 2;
+	unsigned long seed = 88172645463325252UL;
+	unsigned long *order = NULL;
+	unsigned long i = 0;
+	unsigned long j = 0;
+	unsigned long tmp = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		rounds = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		only = strtoul(argv[3], NULL, 10);
+	}
+	if (num_keys == 0 || rounds == 0 || only > 2) {
+		fprintf(stderr, "usage: %s [num_keys] [rounds] [tags]\n",
+			argv[0]);
+		return 1;
+	}
+
+	order = (unsigned long *)malloc(sizeof(unsigned long) * num_keys);
+	if (!order) {
+		return 1;
+	}
+	for (i = 0; i < num_keys; ++i) {
+		order[i] = i;
+	}
+	for (i = num_keys - 1; i > 0; --i) {
+		j = bench_random(&seed) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	printf("%lu keys, %lu rounds, ns per lookup\n", num_keys, rounds);
+	printf("%-8s %10s %10s %10s\n", "buckets", "hit", "miss",
+	       "bytes/key");
+	if (only != 1) {
+		err += bench_tags(0, num_keys, rounds, order);
+	}
+	if (only != 0) {
+		err += bench_tags(1, num_keys, rounds, order);
+	}
+
+	free(order);
+	return err ? 1 : 0;
+}
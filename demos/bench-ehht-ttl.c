@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-ttl.c: expire keys by a for_each scan, or by ehht_expire */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-ttl [num_keys] [max_ttl] [ticks]
+ *
+ * Keeps about num_keys sessions live: each tick, num_keys / max_ttl new
+ * keys are put with a random time to live of 1 to max_ttl ticks, and
+ * the keys which expired are removed by either:
+ *	scan	a "for_each" which collects the expired keys (the expiry
+ *		time is stored as the value), then a "remove" of each
+ *	wheel	ehht_expire, with an unlimited budget
+ *	budget	ehht_expire, with a budget of twice the keys put per tick,
+ *		so that a cascade down the wheel is spread over ticks
+ * and reports the mean and the worst time per tick.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* malloc strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+struct bench_scan_context {
+	unsigned long now;
+	struct ehht_key *expired;
+	size_t len;
+};
+
+static int bench_scan_each(struct ehht_key key, void *val, void *context)
+{
+	struct bench_scan_context *ctx = (struct bench_scan_context *)context;
+
+	if ((unsigned long)val <= ctx->now) {
+		ctx->expired[ctx->len++] = key;
+	}
+	return 0;
+}
+
+static int bench_ttl(const char *name, int use_wheel, size_t budget,
+		     unsigned long num_keys, unsigned long max_ttl,
+		     unsigned long ticks)
+{
+	struct bench_scan_context ctx;
+	struct ehht *table = NULL;
+	unsigned long seed = 88172645463325252UL;
+	unsigned long per_tick = 0;
+	unsigned long ttl = 0;
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long total = 0;
+	unsigned long worst = 0;
+	unsigned long now = 0;
+	unsigned long i = 0;
+	char key[40];
+	size_t j = 0;
+	int len = 0;
+	int err = 0;
+
+	table = ehht_new_custom(num_keys, NULL, NULL, NULL);
+	ctx.expired = (struct ehht_key *)malloc(sizeof(struct ehht_key)
+						* (num_keys + 1));
+	if (!table || !ctx.expired || (use_wheel
+				       && ehht_expiry(table, 1, NULL, NULL))) {
+		ehht_free(table);
+		free(ctx.expired);
+		return 1;
+	}
+	per_tick = (num_keys / max_ttl) ? (num_keys / max_ttl) : 1;
+
+	/* the first max_ttl ticks fill the table */
+	for (now = 0; now < (max_ttl + ticks) && !err; ++now) {
+		for (i = 0; i < per_tick && !err; ++i) {
+			len = sprintf(key, "s:%lu", bench_random(&seed));
+			ttl = 1 + (bench_random(&seed) % max_ttl);
+			if (use_wheel) {
+				ehht_put_with_ttl(table, key, (size_t)len, NULL,
+						  ttl, &err);
+			} else {
+				table->put(table, key, (size_t)len,
+					   (void *)(now + ttl), &err);
+			}
+		}
+
+		start = bench_now_ns(NULL);
+		if (use_wheel) {
+			ehht_expire(table, now, budget ? budget : (size_t)-1);
+		} else {
+			ctx.now = now;
+			ctx.len = 0;
+			table->for_each(table, bench_scan_each, &ctx);
+			for (j = 0; j < ctx.len; ++j) {
+				table->remove(table, ctx.expired[j].str,
+					      ctx.expired[j].len);
+			}
+		}
+		elapsed = bench_now_ns(NULL) - start;
+		if (now >= max_ttl) {
+			total += elapsed;
+			if (elapsed > worst) {
+				worst = elapsed;
+			}
+		}
+	}
+
+	printf("%-8s %10lu %12.1f %12lu\n", name,
+	       (unsigned long)table->size(table), (double)total / ticks,
+	       worst);
+
+	free(ctx.expired);
+	ehht_free(table);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long max_ttl = 1000;
+	unsigned long ticks = 1000;
+	size_t budget = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		max_ttl = strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		ticks = strtoul(argv[3], NULL, 10);
+	}
+	if (num_keys == 0 || max_ttl == 0 || ticks == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [max_ttl] [ticks]\n",
+			argv[0]);
+		return 1;
+	}
+
+	printf("%lu keys, ttl up to %lu ticks, ns per tick over %lu ticks\n",
+	       num_keys, max_ttl, ticks);
+	printf("%-8s %10s %12s %12s\n", "expire", "live", "mean", "worst");
+	budget = 2 * ((num_keys / max_ttl) ? (num_keys / max_ttl) : 1);
+	err += bench_ttl("scan", 0, 0, num_keys, max_ttl, ticks);
+	err += bench_ttl("wheel", 1, 0, num_keys, max_ttl, ticks);
+	err += bench_ttl("budget", 1, budget, num_keys, max_ttl, ticks);
+
+	return err ? 1 : 0;
+}
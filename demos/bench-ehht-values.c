@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-values.c: allocated values compared to ehht_value_size */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-values [num_keys] [rounds]
+ *
+ * Each key has a small struct as its value:
+ *	pointer	the struct is allocated separately, "val" points to it
+ *	inline	the struct is stored in the element, via ehht_value_size
+ * and reports the time per put, per get-and-update, and the bytes and
+ * allocations per key.
+ */
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* strtoul */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+struct bench_value {
+	unsigned long count;
+	unsigned long bytes;
+};
+
+static int bench_free_value(struct ehht_key each_key, void *each_val,
+			    void *context)
+{
+	struct eembed_allocator *ea = (struct eembed_allocator *)context;
+	(void)each_key;
+	ea->free(ea, each_val);
+	return 0;
+}
+
+static int bench_values(int inline_values, unsigned long num_keys,
+			unsigned long rounds, const unsigned long *order)
+{
+	struct bench_tracking_context tctx;
+	struct eembed_allocator tracking;
+	struct ehht *table = NULL;
+	struct bench_value *value = NULL;
+	char key[40];
+	unsigned long start = 0;
+	unsigned long put_ns = 0;
+	unsigned long update_ns = 0;
+	unsigned long i = 0;
+	unsigned long r = 0;
+	int len = 0;
+	int err = 0;
+
+	bench_tracking_allocator_init(&tracking, &tctx,
+				      eembed_global_allocator);
+	table = ehht_new_custom(0, NULL, &tracking, NULL);
+	if (!table) {
+		return 1;
+	}
+	if (inline_values) {
+		ehht_value_size(table, sizeof(struct bench_value));
+	}
+
+	start = bench_now_ns(NULL);
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "k%lu", i);
+		if (inline_values) {
+			value = (struct bench_value *)
+			    ehht_put_slot(table, key, (size_t)len, &err);
+		} else {
+			value = (struct bench_value *)
+			    tracking.malloc(&tracking, sizeof(*value));
+			if (!value) {
+				err = 1;
+				break;
+			}
+			table->put(table, key, (size_t)len, value, &err);
+		}
+		if (value) {
+			value->count = 0;
+			value->bytes = 0;
+		}
+	}
+	put_ns = bench_now_ns(NULL) - start;
+
+	for (r = 0; r < rounds && !err; ++r) {
+		start = bench_now_ns(NULL);
+		for (i = 0; i < num_keys; ++i) {
+			len = sprintf(key, "k%lu", order[i]);
+			value = (struct bench_value *)
+			    table->get(table, key, (size_t)len);
+			++(value->count);
+			value->bytes += (unsigned long)len;
+		}
+		update_ns += bench_now_ns(NULL) - start;
+	}
+
+	printf("%-8s %10.1f %10.1f %10.1f %10.2f\n",
+	       inline_values ? "inline" : "pointer",
+	       (double)put_ns / num_keys,
+	       (double)update_ns / (num_keys * rounds),
+	       (double)tctx.bytes_live / num_keys,
+	       (double)tctx.allocs / num_keys);
+
+	if (!inline_values) {
+		table->for_each(table, bench_free_value, &tracking);
+	}
+	ehht_free(table);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	unsigned long rounds = 4;
+	unsigned long seed = 88172645463325252UL;
+	unsigned long *order = NULL;
+	unsigned long i = 0;
+	unsigned long j = 0;
+	unsigned long tmp = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		rounds = strtoul(argv[2], NULL, 10);
+	}
+	if (num_keys == 0 || rounds == 0) {
+		fprintf(stderr, "usage: %s [num_keys] [rounds]\n", argv[0]);
+		return 1;
+	}
+
+	order = (unsigned long *)malloc(sizeof(unsigned long) * num_keys);
+	if (!order) {
+		return 1;
+	}
+	for (i = 0; i < num_keys; ++i) {
+		order[i] = i;
+	}
+	for (i = num_keys - 1; i > 0; --i) {
+		j = bench_random(&seed) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	printf("%lu keys, %lu rounds, ns per operation\n", num_keys, rounds);
+	printf("%-8s %10s %10s %10s %10s\n", "values", "put", "update",
+	       "bytes/key", "allocs/key");
+	err += bench_values(0, num_keys, rounds, order);
+	err += bench_values(1, num_keys, rounds, order);
+
+	free(order);
+	return err ? 1 : 0;
+}
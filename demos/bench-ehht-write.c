@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-ehht-write.c: streaming a large table to a file */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	bench-ehht-write [num_keys] [path] [buf_len]
+ *
+ * Fills a table of num_keys keys, then writes it with ehht_write as
+ * JSON and as text, through a buffer of buf_len bytes, to "path"
+ * (default /dev/null), with write(2). For comparison, "raw" writes the
+ * same number of bytes of a constant buffer. Reports the MiB, MiB/s,
+ * and ns per key of each.
+ */
+
+#include <stdio.h>		/* printf sprintf */
+#include <stdlib.h>		/* malloc free strtoul */
+#include <string.h>		/* memset */
+#include <fcntl.h>		/* open */
+#include <unistd.h>		/* write close */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+struct bench_sink {
+	int fd;
+	unsigned long bytes;
+};
+
+static int bench_write(void *context, const char *bytes, size_t len)
+{
+	struct bench_sink *sink = (struct bench_sink *)context;
+	ssize_t n = 0;
+
+	while (len) {
+		n = write(sink->fd, bytes, len);
+		if (n <= 0) {
+			return 1;
+		}
+		sink->bytes += (unsigned long)n;
+		bytes += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+static void bench_report(const char *name, unsigned long bytes,
+			 unsigned long elapsed, unsigned long num_keys)
+{
+	double mib = (double)bytes / (1024 * 1024);
+
+	printf("%-8s %10.1f %10.1f %10.1f\n", name, mib,
+	       mib / ((double)elapsed / 1000000000.0),
+	       (double)elapsed / num_keys);
+}
+
+static int bench_dump(const char *name, struct ehht *table, int format,
+		      const char *path, char *buf, size_t buf_len,
+		      unsigned long num_keys, unsigned long *bytes)
+{
+	struct bench_sink sink;
+	unsigned long start = 0;
+	int err = 0;
+
+	sink.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	sink.bytes = 0;
+	if (sink.fd < 0) {
+		perror(path);
+		return 1;
+	}
+	start = bench_now_ns(NULL);
+	err = ehht_write(table, format, buf, buf_len, bench_write, &sink,
+			 NULL, NULL);
+	bench_report(name, sink.bytes, bench_now_ns(NULL) - start, num_keys);
+	close(sink.fd);
+	*bytes = sink.bytes;
+	return err;
+}
+
+static int bench_raw(const char *path, char *buf, size_t buf_len,
+		     unsigned long bytes, unsigned long num_keys)
+{
+	struct bench_sink sink;
+	unsigned long start = 0;
+	size_t len = 0;
+	int err = 0;
+
+	sink.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	sink.bytes = 0;
+	if (sink.fd < 0) {
+		perror(path);
+		return 1;
+	}
+	memset(buf, 'x', buf_len);
+	start = bench_now_ns(NULL);
+	while (sink.bytes < bytes && !err) {
+		len = buf_len;
+		if (len > bytes - sink.bytes) {
+			len = bytes - sink.bytes;
+		}
+		err = bench_write(&sink, buf, len);
+	}
+	bench_report("raw", sink.bytes, bench_now_ns(NULL) - start, num_keys);
+	close(sink.fd);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long num_keys = 1000000;
+	const char *path = "/dev/null";
+	size_t buf_len = 256 * 1024;
+	unsigned long bytes = 0;
+	unsigned long i = 0;
+	struct ehht *table = NULL;
+	char *buf = NULL;
+	char key[40];
+	int len = 0;
+	int err = 0;
+
+	if (argc > 1) {
+		num_keys = strtoul(argv[1], NULL, 10);
+	}
+	if (argc > 2) {
+		path = argv[2];
+	}
+	if (argc > 3) {
+		buf_len = strtoul(argv[3], NULL, 10);
+	}
+	if (num_keys == 0 || buf_len < EHHT_WRITE_MIN_BUF_LEN) {
+		fprintf(stderr, "usage: %s [num_keys] [path] [buf_len]\n",
+			argv[0]);
+		return 1;
+	}
+
+	buf = (char *)malloc(buf_len);
+	table = ehht_new_compact(num_keys, NULL, NULL, NULL);
+	if (!buf || !table) {
+		err = 1;
+		goto bench_end;
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		len = sprintf(key, "key:%016lx", i * 0x9E3779B97F4A7C15UL);
+		table->put(table, key, (size_t)len, (void *)i, &err);
+	}
+	if (err) {
+		goto bench_end;
+	}
+
+	printf("%lu keys to %s, %lu byte buffer\n", num_keys, path,
+	       (unsigned long)buf_len);
+	printf("%-8s %10s %10s %10s\n", "output", "MiB", "MiB/s", "ns/key");
+	err += bench_dump("json", table, EHHT_WRITE_JSON, path, buf, buf_len,
+			  num_keys, &bytes);
+	err += bench_raw(path, buf, buf_len, bytes, num_keys);
+	err += bench_dump("text", table, EHHT_WRITE_TEXT, path, buf, buf_len,
+			  num_keys, &bytes);
+
+bench_end:
+	if (table) {
+		ehht_free(table);
+	}
+	free(buf);
+	return err ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-util.c: shared helpers for the ehht benchmark programs */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include <string.h>		/* memcpy memset */
+#include <time.h>		/* clock_gettime */
+
+#include "bench-util.h"
+
+#define BENCH_ALLOC_HEADER 16
+
+static void *bench_tracking_malloc(struct eembed_allocator *ea, size_t size)
+{
+	struct bench_tracking_context *ctx = NULL;
+	unsigned char *bytes = NULL;
+
+	ctx = (struct bench_tracking_context *)ea->context;
+	bytes = (unsigned char *)ctx->real->malloc(ctx->real,
+						   BENCH_ALLOC_HEADER + size);
+	if (!bytes) {
+		return NULL;
+	}
+	memcpy(bytes, &size, sizeof(size_t));
+	++ctx->allocs;
+	ctx->bytes_live += size;
+	if (ctx->bytes_live > ctx->bytes_peak) {
+		ctx->bytes_peak = ctx->bytes_live;
+	}
+	return bytes + BENCH_ALLOC_HEADER;
+}
+
+static void bench_tracking_free(struct eembed_allocator *ea, void *ptr)
+{
+	struct bench_tracking_context *ctx = NULL;
+	unsigned char *bytes = NULL;
+	size_t size = 0;
+
+	if (!ptr) {
+		return;
+	}
+	ctx = (struct bench_tracking_context *)ea->context;
+	bytes = ((unsigned char *)ptr) - BENCH_ALLOC_HEADER;
+	memcpy(&size, bytes, sizeof(size_t));
+	++ctx->frees;
+	ctx->bytes_live -= size;
+	ctx->real->free(ctx->real, bytes);
+}
+
+static void *bench_tracking_calloc(struct eembed_allocator *ea, size_t nmemb,
+				    size_t size)
+{
+	void *ptr = NULL;
+
+	if (size && nmemb > ((size_t)-1) / size) {
+		return NULL;
+	}
+	ptr = bench_tracking_malloc(ea, nmemb * size);
+	if (ptr) {
+		memset(ptr, 0x00, nmemb * size);
+	}
+	return ptr;
+}
+
+static void *bench_tracking_realloc(struct eembed_allocator *ea, void *ptr,
+				     size_t size)
+{
+	void *new_ptr = NULL;
+	size_t old_size = 0;
+
+	if (!ptr) {
+		return bench_tracking_malloc(ea, size);
+	}
+	memcpy(&old_size, ((unsigned char *)ptr) - BENCH_ALLOC_HEADER,
+	       sizeof(size_t));
+	new_ptr = bench_tracking_malloc(ea, size);
+	if (!new_ptr) {
+		return NULL;
+	}
+	memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+	bench_tracking_free(ea, ptr);
+	return new_ptr;
+}
+
+static void *bench_tracking_reallocarray(struct eembed_allocator *ea,
+					  void *ptr, size_t nmemb, size_t size)
+{
+	if (size && nmemb > ((size_t)-1) / size) {
+		return NULL;
+	}
+	return bench_tracking_realloc(ea, ptr, nmemb * size);
+}
+
+void bench_tracking_allocator_init(struct eembed_allocator *wrap,
+				   struct bench_tracking_context *ctx,
+				   struct eembed_allocator *real)
+{
+	memset(ctx, 0x00, sizeof(struct bench_tracking_context));
+	ctx->real = real;
+
+	memset(wrap, 0x00, sizeof(struct eembed_allocator));
+	wrap->context = ctx;
+	wrap->malloc = bench_tracking_malloc;
+	wrap->calloc = bench_tracking_calloc;
+	wrap->realloc = bench_tracking_realloc;
+	wrap->reallocarray = bench_tracking_reallocarray;
+	wrap->free = bench_tracking_free;
+}
+
+unsigned long bench_now_ns(void *context)
+{
+	struct timespec ts;
+
+	(void)context;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (((unsigned long)ts.tv_sec) * 1000000000UL) + ts.tv_nsec;
+}
+
+unsigned long bench_random(unsigned long *state)
+{
+	unsigned long x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 2685821657736338717UL;
+}
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-util.h: shared helpers for the ehht benchmark programs */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stddef.h>		/* size_t */
+
+#include "eembed.h"
+
+/* tracks live and peak bytes handed out by the wrapped allocator */
+struct bench_tracking_context {
+	struct eembed_allocator *real;
+	size_t allocs;
+	size_t frees;
+	size_t bytes_live;
+	size_t bytes_peak;
+};
+
+void bench_tracking_allocator_init(struct eembed_allocator *wrap,
+				   struct bench_tracking_context *ctx,
+				   struct eembed_allocator *real);
+
+/* CLOCK_MONOTONIC in nanoseconds, usable as an ehht_clock_func */
+unsigned long bench_now_ns(void *context);
+
+/* xorshift64*, so that runs are reproducible by seed */
+unsigned long bench_random(unsigned long *state);
+
+#endif /* BENCH_UTIL_H */
@@ -0,0 +1,819 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-hashlab.c: hash function quality and throughput analyzer */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * Usage:
+ *	ehht-hashlab [corpus] [options]
+ *
+ * corpus, one of:
+ *	--text=FILE		the whitespace separated words of a file
+ *	--records=FILE		fixed length binary records of a file,
+ *				of --record-len=N bytes (default 16)
+ *	--gen=uuid		random version 4 UUID strings
+ *	--gen=url		URLs of varied hosts, paths and queries
+ *	--gen=int		sequential 8 byte little-endian integers
+ *
+ * options:
+ *	--keys=N	keys to generate (default 1000000)
+ *	--buckets=N	buckets for the distribution (default: the
+ *			smallest power of two not below the keys)
+ *	--threads=N	threads to hash with (default: online CPUs)
+ *	--repeat=N	passes over the corpus for timing (default 4)
+ *	--avalanche=N	keys sampled for avalanche (default 1000)
+ *	--seed=N
+ *
+ * Duplicate keys are dropped. For each ehht_hash_func, reports:
+ *
+ *	GB/s		corpus bytes hashed per second, by all threads
+ *	chi2/df		chi-squared of the bucket counts against a uniform
+ *			distribution, over its degrees of freedom; near 1 is
+ *			uniform, and values over the "limit" printed are
+ *			unlikely (3 sigma) from a uniform hash
+ *	max chain	the most keys in one bucket
+ *	probes		mean keys compared by a successful lookup in a
+ *			chained table, against the ideal printed
+ *	aval mean/max	avalanche bias: how far from one half the chance
+ *			that flipping an input bit (of the first 32 bytes)
+ *			flips an output bit is, as a percent of one half;
+ *			the mean and the worst over all bit pairs
+ *
+ * and the ns per hash for each range of key lengths, on one thread.
+ */
+
+#include <stdio.h>		/* fprintf fopen fread printf sprintf */
+#include <stdlib.h>		/* malloc realloc free strtoul */
+#include <string.h>		/* memcpy strlen strncmp */
+#include <math.h>		/* sqrt */
+#include <pthread.h>		/* pthread_create pthread_join */
+#include <unistd.h>		/* sysconf */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+#define HASHLAB_MAX_THREADS 256
+#define HASHLAB_AVALANCHE_BYTES 32
+#define HASHLAB_IN_BITS (HASHLAB_AVALANCHE_BYTES * 8)
+#define HASHLAB_OUT_BITS (8 * sizeof(unsigned int))
+#define HASHLAB_LEN_CLASSES 6
+
+unsigned int leveldb_hash(const char *data, size_t len);
+unsigned int djb2_hash(const char *data, size_t len);
+unsigned int ehht_kr2_hashcode(const char *str, size_t str_len);
+
+struct hashlab_func {
+	const char *name;
+	ehht_hash_func hash;
+};
+
+static struct hashlab_func hashlab_funcs[] = {
+	{ "kr2 (default)", ehht_kr2_hashcode },
+	{ "leveldb", leveldb_hash },
+	{ "djb2", djb2_hash }
+};
+
+#define HASHLAB_FUNCS (sizeof(hashlab_funcs) / sizeof(hashlab_funcs[0]))
+
+/* so that the timed hashes are not optimized away */
+static volatile unsigned int hashlab_sink;
+
+/* key lengths from 2^(n+2) up to 2^(n+3) - 1, with the first from 1 */
+static const char *hashlab_len_names[HASHLAB_LEN_CLASSES] = {
+	"1-7", "8-15", "16-31", "32-63", "64-127", "128+"
+};
+
+struct hashlab_options {
+	const char *text;
+	const char *records;
+	const char *gen;
+	unsigned long record_len;
+	unsigned long keys;
+	unsigned long buckets;
+	unsigned long threads;
+	unsigned long repeat;
+	unsigned long avalanche;
+	unsigned long seed;
+};
+
+struct hashlab_corpus {
+	const char *name;
+	char *bytes;
+	size_t bytes_len;
+	size_t bytes_size;
+	size_t *offsets;
+	size_t *lens;
+	size_t num_keys;
+	size_t keys_size;
+	size_t total_bytes;
+	size_t max_len;
+};
+
+struct hashlab_job {
+	struct hashlab_corpus *corpus;
+	ehht_hash_func hash;
+	size_t from;
+	size_t to;
+	unsigned long repeat;
+	unsigned int *hashcodes;
+
+	/* avalanche */
+	size_t sample_stride;
+	unsigned long *flips;
+	unsigned long *trials;
+	char *scratch;
+
+	pthread_t thread;
+};
+
+static int hashlab_add_key(struct hashlab_corpus *corpus, const char *key,
+			   size_t len)
+{
+	void *ptr = NULL;
+	size_t size = 0;
+
+	if (corpus->num_keys == corpus->keys_size) {
+		size = corpus->keys_size ? 2 * corpus->keys_size : 1024;
+		ptr = realloc(corpus->offsets, size * sizeof(size_t));
+		if (!ptr) {
+			return 1;
+		}
+		corpus->offsets = (size_t *)ptr;
+		ptr = realloc(corpus->lens, size * sizeof(size_t));
+		if (!ptr) {
+			return 1;
+		}
+		corpus->lens = (size_t *)ptr;
+		corpus->keys_size = size;
+	}
+	if (corpus->bytes_len + len > corpus->bytes_size) {
+		size = corpus->bytes_size ? 2 * corpus->bytes_size : 65536;
+		while (size < corpus->bytes_len + len) {
+			size *= 2;
+		}
+		ptr = realloc(corpus->bytes, size);
+		if (!ptr) {
+			return 1;
+		}
+		corpus->bytes = (char *)ptr;
+		corpus->bytes_size = size;
+	}
+	memcpy(corpus->bytes + corpus->bytes_len, key, len);
+	corpus->offsets[corpus->num_keys] = corpus->bytes_len;
+	corpus->lens[corpus->num_keys] = len;
+	corpus->bytes_len += len;
+	++(corpus->num_keys);
+	corpus->total_bytes += len;
+	if (len > corpus->max_len) {
+		corpus->max_len = len;
+	}
+	return 0;
+}
+
+static char *hashlab_read_file(const char *path, size_t *len)
+{
+	FILE *file = NULL;
+	char *buf = NULL;
+	void *ptr = NULL;
+	size_t size = 65536;
+	size_t n = 0;
+
+	*len = 0;
+	file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		return NULL;
+	}
+	buf = (char *)malloc(size);
+	while (buf && (n = fread(buf + *len, 1, size - *len, file)) > 0) {
+		*len += n;
+		if (*len == size) {
+			size *= 2;
+			ptr = realloc(buf, size);
+			if (!ptr) {
+				free(buf);
+			}
+			buf = (char *)ptr;
+		}
+	}
+	fclose(file);
+	if (!buf) {
+		fprintf(stderr, "out of memory reading %s\n", path);
+	}
+	return buf;
+}
+
+static int hashlab_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v'
+	    || c == '\f';
+}
+
+static int hashlab_load_text(struct hashlab_corpus *corpus, const char *path)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	size_t i = 0;
+	size_t start = 0;
+	int err = 0;
+
+	buf = hashlab_read_file(path, &len);
+	if (!buf) {
+		return 1;
+	}
+	while (i < len && !err) {
+		while (i < len && hashlab_is_space(buf[i])) {
+			++i;
+		}
+		start = i;
+		while (i < len && !hashlab_is_space(buf[i])) {
+			++i;
+		}
+		if (i > start) {
+			err = hashlab_add_key(corpus, buf + start, i - start);
+		}
+	}
+	free(buf);
+	return err;
+}
+
+static int hashlab_load_records(struct hashlab_corpus *corpus,
+				const char *path, size_t record_len)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	size_t i = 0;
+	int err = 0;
+
+	buf = hashlab_read_file(path, &len);
+	if (!buf) {
+		return 1;
+	}
+	for (i = 0; i + record_len <= len && !err; i += record_len) {
+		err = hashlab_add_key(corpus, buf + i, record_len);
+	}
+	free(buf);
+	return err;
+}
+
+static int hashlab_gen(struct hashlab_corpus *corpus, const char *gen,
+		       unsigned long keys, unsigned long seed)
+{
+	static const char *words[] = {
+		"api", "v2", "users", "images", "static", "search", "item",
+		"cart", "checkout", "docs", "blog", "2020", "en-us", "media"
+	};
+	const size_t num_words = sizeof(words) / sizeof(words[0]);
+	const char *hex = "0123456789abcdef";
+	unsigned long state = seed * 0x9E3779B97F4A7C15UL + 1;
+	unsigned long r = 0;
+	unsigned long i = 0;
+	unsigned long j = 0;
+	unsigned long segments = 0;
+	char key[256];
+	int len = 0;
+	int err = 0;
+
+	for (i = 0; i < keys && !err; ++i) {
+		if (strcmp(gen, "uuid") == 0) {
+			for (j = 0, len = 0; j < 32; ++j) {
+				if (j == 8 || j == 12 || j == 16 || j == 20) {
+					key[len++] = '-';
+				}
+				if (j % 16 == 0) {
+					r = bench_random(&state);
+				}
+				key[len++] = hex[(r >> (4 * (j % 16))) & 0x0F];
+			}
+			/* version 4, variant 1 */
+			key[14] = '4';
+			key[19] = hex[8 + (r & 0x03)];
+		} else if (strcmp(gen, "url") == 0) {
+			r = bench_random(&state);
+			len = sprintf(key, "https://%s%lu.example.com",
+				      (r & 1) ? "www" : "cdn", r % 1000);
+			segments = 1 + ((r >> 16) % 5);
+			for (j = 0; j < segments; ++j) {
+				r = bench_random(&state);
+				len += sprintf(key + len, "/%s",
+					       words[r % num_words]);
+			}
+			len += sprintf(key + len, "/%lu", i);
+			if ((r >> 8) & 1) {
+				len += sprintf(key + len, "?q=%lu&page=%lu",
+					       (r >> 12) % 100000,
+					       (r >> 32) % 50);
+			}
+		} else if (strcmp(gen, "int") == 0) {
+			for (j = 0; j < 8; ++j) {
+				key[j] = (char)((i >> (8 * j)) & 0xFF);
+			}
+			len = 8;
+		} else {
+			fprintf(stderr, "unknown generator: %s\n", gen);
+			return 1;
+		}
+		err = hashlab_add_key(corpus, key, (size_t)len);
+	}
+	return err;
+}
+
+/* keeps the first of each key, in place */
+static int hashlab_dedupe(struct hashlab_corpus *corpus)
+{
+	struct ehht *seen = NULL;
+	const char *key = NULL;
+	size_t i = 0;
+	size_t kept = 0;
+	int err = 0;
+
+	seen = ehht_new_custom(corpus->num_keys, NULL, NULL, NULL);
+	if (!seen || ehht_trust_keys_immutable(seen, 1)) {
+		ehht_free(seen);
+		return 1;
+	}
+	corpus->total_bytes = 0;
+	for (i = 0; i < corpus->num_keys && !err; ++i) {
+		key = corpus->bytes + corpus->offsets[i];
+		if (seen->has_key(seen, key, corpus->lens[i])) {
+			continue;
+		}
+		seen->put(seen, key, corpus->lens[i], NULL, &err);
+		corpus->offsets[kept] = corpus->offsets[i];
+		corpus->lens[kept] = corpus->lens[i];
+		corpus->total_bytes += corpus->lens[i];
+		++kept;
+	}
+	corpus->num_keys = kept;
+	ehht_free(seen);
+	return err;
+}
+
+static size_t hashlab_len_class(size_t len)
+{
+	size_t c = 0;
+
+	for (len >>= 3; len && c < HASHLAB_LEN_CLASSES - 1; len >>= 1) {
+		++c;
+	}
+	return c;
+}
+
+static void *hashlab_hash_run(void *arg)
+{
+	struct hashlab_job *job = (struct hashlab_job *)arg;
+	struct hashlab_corpus *corpus = job->corpus;
+	unsigned long r = 0;
+	size_t i = 0;
+
+	for (r = 0; r < job->repeat; ++r) {
+		for (i = job->from; i < job->to; ++i) {
+			job->hashcodes[i] =
+			    job->hash(corpus->bytes + corpus->offsets[i],
+				      corpus->lens[i]);
+		}
+	}
+	return NULL;
+}
+
+static void *hashlab_avalanche_run(void *arg)
+{
+	struct hashlab_job *job = (struct hashlab_job *)arg;
+	struct hashlab_corpus *corpus = job->corpus;
+	unsigned int h0 = 0;
+	unsigned int diff = 0;
+	size_t i = 0;
+	size_t len = 0;
+	size_t in = 0;
+	size_t in_bits = 0;
+	size_t out = 0;
+
+	for (i = job->from; i < job->to; i += job->sample_stride) {
+		len = corpus->lens[i];
+		memcpy(job->scratch, corpus->bytes + corpus->offsets[i], len);
+		h0 = job->hash(job->scratch, len);
+		in_bits = 8 * (len < HASHLAB_AVALANCHE_BYTES ? len
+			       : HASHLAB_AVALANCHE_BYTES);
+		for (in = 0; in < in_bits; ++in) {
+			job->scratch[in / 8] ^= (char)(1 << (in % 8));
+			diff = h0 ^ job->hash(job->scratch, len);
+			job->scratch[in / 8] ^= (char)(1 << (in % 8));
+			++(job->trials[in]);
+			for (out = 0; out < HASHLAB_OUT_BITS; ++out) {
+				job->flips[(in * HASHLAB_OUT_BITS) + out] +=
+				    (diff >> out) & 1;
+			}
+		}
+	}
+	return NULL;
+}
+
+/* runs the jobs, each on its own thread */
+static int hashlab_run(struct hashlab_job *jobs, size_t num_jobs,
+		       void *(*run)(void *))
+{
+	size_t i = 0;
+	int err = 0;
+
+	for (i = 0; i < num_jobs; ++i) {
+		if (pthread_create(&jobs[i].thread, NULL, run, &jobs[i])) {
+			fprintf(stderr, "could not create thread %lu\n",
+				(unsigned long)i);
+			err = 1;
+			break;
+		}
+	}
+	num_jobs = i;
+	for (i = 0; i < num_jobs; ++i) {
+		pthread_join(jobs[i].thread, NULL);
+	}
+	return err;
+}
+
+static void hashlab_split(struct hashlab_job *jobs, size_t num_jobs,
+			  struct hashlab_corpus *corpus, ehht_hash_func hash)
+{
+	size_t per_job = (corpus->num_keys + num_jobs - 1) / num_jobs;
+	size_t i = 0;
+
+	for (i = 0; i < num_jobs; ++i) {
+		jobs[i].corpus = corpus;
+		jobs[i].hash = hash;
+		jobs[i].from = i * per_job;
+		jobs[i].to = (i + 1) * per_job;
+		if (jobs[i].from > corpus->num_keys) {
+			jobs[i].from = corpus->num_keys;
+		}
+		if (jobs[i].to > corpus->num_keys) {
+			jobs[i].to = corpus->num_keys;
+		}
+	}
+}
+
+static void hashlab_distribution(unsigned int *hashcodes, size_t num_keys,
+				 size_t *counts, size_t num_buckets,
+				 double *chi2_df, size_t *max_chain,
+				 double *probes)
+{
+	double expected = (double)num_keys / num_buckets;
+	double chi2 = 0.0;
+	double d = 0.0;
+	double compares = 0.0;
+	size_t i = 0;
+
+	memset(counts, 0x00, sizeof(size_t) * num_buckets);
+	for (i = 0; i < num_keys; ++i) {
+		++counts[hashcodes[i] % num_buckets];
+	}
+	*max_chain = 0;
+	for (i = 0; i < num_buckets; ++i) {
+		d = (double)counts[i] - expected;
+		chi2 += (d * d) / expected;
+		if (counts[i] > *max_chain) {
+			*max_chain = counts[i];
+		}
+		/* finding the n-th key of a chain compares n keys */
+		compares += (double)counts[i] * (counts[i] + 1) / 2.0;
+	}
+	*chi2_df = chi2 / (double)(num_buckets - 1);
+	*probes = compares / (double)num_keys;
+}
+
+static void hashlab_avalanche(struct hashlab_job *jobs, size_t num_jobs,
+			      double *mean, double *worst)
+{
+	double bias = 0.0;
+	double sum = 0.0;
+	size_t cells = 0;
+	size_t in = 0;
+	size_t out = 0;
+	size_t j = 0;
+	unsigned long trials = 0;
+	unsigned long flips = 0;
+
+	*worst = 0.0;
+	for (in = 0; in < HASHLAB_IN_BITS; ++in) {
+		trials = 0;
+		for (j = 0; j < num_jobs; ++j) {
+			trials += jobs[j].trials[in];
+		}
+		if (!trials) {
+			continue;
+		}
+		for (out = 0; out < HASHLAB_OUT_BITS; ++out) {
+			flips = 0;
+			for (j = 0; j < num_jobs; ++j) {
+				flips += jobs[j].flips[in * HASHLAB_OUT_BITS
+						       + out];
+			}
+			bias = (double)flips / trials - 0.5;
+			bias = 200.0 * (bias < 0 ? -bias : bias);
+			sum += bias;
+			++cells;
+			if (bias > *worst) {
+				*worst = bias;
+			}
+		}
+	}
+	*mean = cells ? sum / cells : 0.0;
+}
+
+/* single threaded, so that the ns are those of one core */
+static void hashlab_by_len(struct hashlab_corpus *corpus, ehht_hash_func hash,
+			   size_t **class_keys, size_t *class_lens,
+			   unsigned long repeat)
+{
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	unsigned long r = 0;
+	size_t c = 0;
+	size_t i = 0;
+	size_t k = 0;
+
+	for (c = 0; c < HASHLAB_LEN_CLASSES; ++c) {
+		if (!class_lens[c]) {
+			printf(" %8s", "-");
+			continue;
+		}
+		start = bench_now_ns(NULL);
+		for (r = 0; r < repeat; ++r) {
+			for (i = 0; i < class_lens[c]; ++i) {
+				k = class_keys[c][i];
+				hashlab_sink ^=
+				    hash(corpus->bytes + corpus->offsets[k],
+					 corpus->lens[k]);
+			}
+		}
+		elapsed = bench_now_ns(NULL) - start;
+		printf(" %8.1f",
+		       (double)elapsed / ((double)class_lens[c] * repeat));
+	}
+	printf("\n");
+}
+
+static int hashlab_report(struct hashlab_corpus *corpus,
+			  struct hashlab_options *opts)
+{
+	struct hashlab_job *jobs = NULL;
+	unsigned int *hashcodes = NULL;
+	size_t *counts = NULL;
+	size_t *class_keys[HASHLAB_LEN_CLASSES];
+	size_t class_lens[HASHLAB_LEN_CLASSES];
+	size_t num_jobs = opts->threads;
+	size_t num_buckets = opts->buckets;
+	size_t f = 0;
+	size_t i = 0;
+	size_t c = 0;
+	size_t max_chain = 0;
+	unsigned long start = 0;
+	unsigned long elapsed = 0;
+	double chi2_df = 0.0;
+	double probes = 0.0;
+	double aval_mean = 0.0;
+	double aval_worst = 0.0;
+	int err = 0;
+
+	memset(class_keys, 0x00, sizeof(class_keys));
+	memset(class_lens, 0x00, sizeof(class_lens));
+	if (!num_buckets) {
+		for (num_buckets = 2; num_buckets < corpus->num_keys;) {
+			num_buckets *= 2;
+		}
+	}
+	if (num_jobs > corpus->num_keys) {
+		num_jobs = corpus->num_keys;
+	}
+
+	jobs = (struct hashlab_job *)calloc(num_jobs, sizeof(*jobs));
+	hashcodes = (unsigned int *)malloc(sizeof(unsigned int)
+					   * corpus->num_keys);
+	counts = (size_t *)malloc(sizeof(size_t) * num_buckets);
+	for (c = 0; c < HASHLAB_LEN_CLASSES; ++c) {
+		class_keys[c] = (size_t *)malloc(sizeof(size_t)
+						 * corpus->num_keys);
+		err = err || !class_keys[c];
+	}
+	if (!jobs || !hashcodes || !counts || err) {
+		err = 1;
+		goto hashlab_report_end;
+	}
+	for (i = 0; i < num_jobs && !err; ++i) {
+		jobs[i].flips = (unsigned long *)calloc(HASHLAB_IN_BITS
+							* HASHLAB_OUT_BITS,
+							sizeof(unsigned long));
+		jobs[i].trials = (unsigned long *)calloc(HASHLAB_IN_BITS,
+							 sizeof(unsigned long));
+		jobs[i].scratch = (char *)malloc(corpus->max_len + 1);
+		err = !jobs[i].flips || !jobs[i].trials || !jobs[i].scratch;
+	}
+	if (err) {
+		goto hashlab_report_end;
+	}
+	for (i = 0; i < corpus->num_keys; ++i) {
+		c = hashlab_len_class(corpus->lens[i]);
+		class_keys[c][class_lens[c]++] = i;
+	}
+
+	printf("corpus: %s, %lu keys, %lu bytes, mean length %.1f\n",
+	       corpus->name, (unsigned long)corpus->num_keys,
+	       (unsigned long)corpus->total_bytes,
+	       (double)corpus->total_bytes / corpus->num_keys);
+	printf("%lu buckets, chi2/df limit %.3f, ideal probes %.3f,"
+	       " %lu threads\n\n", (unsigned long)num_buckets,
+	       1.0 + 3.0 * sqrt(2.0 / (double)(num_buckets - 1)),
+	       1.0 + ((double)corpus->num_keys - 1) / (2.0 * num_buckets),
+	       (unsigned long)num_jobs);
+	printf("%-14s %8s %8s %9s %8s %6s %6s\n", "hash", "GB/s", "chi2/df",
+	       "max chain", "probes", "aval%", "max%");
+
+	for (f = 0; f < HASHLAB_FUNCS && !err; ++f) {
+		hashlab_split(jobs, num_jobs, corpus, hashlab_funcs[f].hash);
+		for (i = 0; i < num_jobs; ++i) {
+			jobs[i].repeat = opts->repeat;
+			jobs[i].hashcodes = hashcodes;
+			jobs[i].sample_stride = corpus->num_keys
+			    / (opts->avalanche ? opts->avalanche : 1);
+			if (!jobs[i].sample_stride) {
+				jobs[i].sample_stride = 1;
+			}
+			memset(jobs[i].flips, 0x00, sizeof(unsigned long)
+			       * HASHLAB_IN_BITS * HASHLAB_OUT_BITS);
+			memset(jobs[i].trials, 0x00, sizeof(unsigned long)
+			       * HASHLAB_IN_BITS);
+		}
+
+		start = bench_now_ns(NULL);
+		err = hashlab_run(jobs, num_jobs, hashlab_hash_run);
+		elapsed = bench_now_ns(NULL) - start;
+		if (!err && opts->avalanche) {
+			err = hashlab_run(jobs, num_jobs,
+					  hashlab_avalanche_run);
+		}
+		if (err) {
+			break;
+		}
+		hashlab_distribution(hashcodes, corpus->num_keys, counts,
+				     num_buckets, &chi2_df, &max_chain,
+				     &probes);
+		hashlab_avalanche(jobs, num_jobs, &aval_mean, &aval_worst);
+
+		printf("%-14s %8.2f %8.3f %9lu %8.3f %6.2f %6.2f\n",
+		       hashlab_funcs[f].name,
+		       ((double)corpus->total_bytes * opts->repeat)
+		       / (double)elapsed, chi2_df, (unsigned long)max_chain,
+		       probes, aval_mean, aval_worst);
+	}
+
+	printf("\nns/hash by key length, one thread\n%-14s", "hash");
+	for (c = 0; c < HASHLAB_LEN_CLASSES; ++c) {
+		printf(" %8s", hashlab_len_names[c]);
+	}
+	printf("\n%-14s", "keys");
+	for (c = 0; c < HASHLAB_LEN_CLASSES; ++c) {
+		printf(" %8lu", (unsigned long)class_lens[c]);
+	}
+	printf("\n");
+	for (f = 0; f < HASHLAB_FUNCS && !err; ++f) {
+		printf("%-14s", hashlab_funcs[f].name);
+		hashlab_by_len(corpus, hashlab_funcs[f].hash, class_keys,
+			       class_lens, opts->repeat);
+	}
+
+hashlab_report_end:
+	for (i = 0; jobs && i < num_jobs; ++i) {
+		free(jobs[i].flips);
+		free(jobs[i].trials);
+		free(jobs[i].scratch);
+	}
+	for (c = 0; c < HASHLAB_LEN_CLASSES; ++c) {
+		free(class_keys[c]);
+	}
+	free(counts);
+	free(hashcodes);
+	free(jobs);
+	if (err) {
+		fprintf(stderr, "out of memory, or could not create threads\n");
+	}
+	return err;
+}
+
+static int hashlab_arg(const char *arg, const char *name, const char **val)
+{
+	size_t len = strlen(name);
+
+	if (strncmp(arg, name, len) == 0 && arg[len] == '=') {
+		*val = arg + len + 1;
+		return 1;
+	}
+	return 0;
+}
+
+static int hashlab_parse_args(struct hashlab_options *opts, int argc,
+			      char *argv[])
+{
+	const char *val = NULL;
+	long cpus = 0;
+	int i = 0;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	opts->threads = cpus > 0 ? (unsigned long)cpus : 1;
+	opts->record_len = 16;
+	opts->keys = 1000000;
+	opts->repeat = 4;
+	opts->avalanche = 1000;
+
+	for (i = 1; i < argc; ++i) {
+		if (hashlab_arg(argv[i], "--text", &val)) {
+			opts->text = val;
+		} else if (hashlab_arg(argv[i], "--records", &val)) {
+			opts->records = val;
+		} else if (hashlab_arg(argv[i], "--record-len", &val)) {
+			opts->record_len = strtoul(val, NULL, 10);
+		} else if (hashlab_arg(argv[i], "--gen", &val)) {
+			opts->gen = val;
+		} else if (hashlab_arg(argv[i], "--keys", &val)) {
+			opts->keys = strtoul(val, NULL, 10);
+		} else if (hashlab_arg(argv[i], "--buckets", &val)) {
+			opts->buckets = strtoul(val, NULL, 10);
+		} else if (hashlab_arg(argv[i], "--threads", &val)) {
+			opts->threads = strtoul(val, NULL, 10);
+		} else if (hashlab_arg(argv[i], "--repeat", &val)) {
+			opts->repeat = strtoul(val, NULL, 10);
+		} else if (hashlab_arg(argv[i], "--avalanche", &val)) {
+			opts->avalanche = strtoul(val, NULL, 10);
+		} else if (hashlab_arg(argv[i], "--seed", &val)) {
+			opts->seed = strtoul(val, NULL, 10);
+		} else {
+			fprintf(stderr, "unrecognized: %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (!opts->text && !opts->records && !opts->gen) {
+		opts->gen = "uuid";
+	}
+	if ((!!opts->text + !!opts->records + !!opts->gen) != 1) {
+		return 1;
+	}
+	if (opts->threads > HASHLAB_MAX_THREADS) {
+		opts->threads = HASHLAB_MAX_THREADS;
+	}
+	if (!opts->threads || !opts->repeat || !opts->keys
+	    || !opts->record_len || opts->buckets == 1) {
+		return 1;
+	}
+	return 0;
+}
+
+static void hashlab_usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [--text=FILE | --records=FILE"
+		" [--record-len=N] | --gen=uuid|url|int [--keys=N]]\n"
+		"\t[--buckets=N] [--threads=N] [--repeat=N]"
+		" [--avalanche=N] [--seed=N]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct hashlab_options opts;
+	struct hashlab_corpus corpus;
+	char name[80];
+	int err = 0;
+
+	memset(&opts, 0x00, sizeof(opts));
+	memset(&corpus, 0x00, sizeof(corpus));
+
+	if (hashlab_parse_args(&opts, argc, argv)) {
+		hashlab_usage(argv[0]);
+		return 2;
+	}
+
+	if (opts.text) {
+		corpus.name = opts.text;
+		err = hashlab_load_text(&corpus, opts.text);
+	} else if (opts.records) {
+		sprintf(name, "%lu byte records", opts.record_len);
+		corpus.name = name;
+		err = hashlab_load_records(&corpus, opts.records,
+					   opts.record_len);
+	} else {
+		corpus.name = opts.gen;
+		err = hashlab_gen(&corpus, opts.gen, opts.keys, opts.seed);
+	}
+	if (!err) {
+		err = hashlab_dedupe(&corpus);
+	}
+	if (!err && corpus.num_keys < 2) {
+		fprintf(stderr, "too few keys: %lu\n",
+			(unsigned long)corpus.num_keys);
+		err = 1;
+	}
+	if (!err) {
+		err = hashlab_report(&corpus, &opts);
+	}
+
+	free(corpus.bytes);
+	free(corpus.offsets);
+	free(corpus.lens);
+	return err ? 1 : 0;
+}
@@ -0,0 +1,691 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-replay.c: workload trace generator and replay driver for ehht */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/*
+ * A trace is plain text, one operation per line:
+ *
+ *	<op> <key>
+ *
+ * where <op> is one of:
+ *	p	put (the value stored is the line number)
+ *	g	get
+ *	h	has_key
+ *	r	remove
+ *
+ * Keys may not contain whitespace. Blank lines and lines starting with
+ * '#' are ignored.
+ *
+ * Usage:
+ *	ehht-replay --trace=FILE
+ *	ehht-replay --gen=zipf|hotspot|churn [options] [--write=FILE]
+ *
+ * With --cache=N the table is limited to N entries with
+ * ehht_cache_limit, and a get which misses is followed by a put of the
+ * key, as a read-through cache would; the hit rate is reported.
+ *
+ * The whole trace is loaded into memory before the timed replay, so
+ * only the table operations are measured. Each operation is timed
+ * individually with CLOCK_MONOTONIC, which adds a roughly constant
+ * overhead per sample.
+ */
+
+#include <stdio.h>		/* fprintf fopen printf */
+#include <stdlib.h>		/* malloc strtoul strtod */
+#include <string.h>		/* strlen strncmp memcpy */
+#include <math.h>		/* pow */
+
+#include "ehht.h"
+#include "eembed.h"
+#include "bench-util.h"
+
+#define REPLAY_MAX_KEY_LEN 80
+#define REPLAY_HIST_LEN 64
+
+enum replay_op_type {
+	replay_op_put = 0,
+	replay_op_get,
+	replay_op_has_key,
+	replay_op_remove,
+	replay_op_types_len
+};
+
+static const char replay_op_chars[] = { 'p', 'g', 'h', 'r' };
+
+static const char *replay_op_names[] = { "put", "get", "has_key", "remove" };
+
+struct replay_op {
+	size_t key_offset;
+	unsigned char key_len;
+	unsigned char type;
+};
+
+struct replay_trace {
+	struct replay_op *ops;
+	size_t ops_len;
+	size_t ops_size;
+	char *key_bytes;
+	size_t key_bytes_len;
+	size_t key_bytes_size;
+};
+
+struct replay_options {
+	const char *trace;
+	const char *gen;
+	const char *write;
+	unsigned long keys;
+	unsigned long ops;
+	double theta;
+	double read_ratio;
+	double hot_fraction;
+	double hot_ops;
+	unsigned long shift_every;
+	unsigned long burst;
+	unsigned long window;
+	unsigned long seed;
+	unsigned long sample_every;
+	unsigned long buckets;
+	unsigned long cache;
+};
+
+struct replay_histogram {
+	unsigned long count;
+	unsigned long total_ns;
+	unsigned long buckets[REPLAY_HIST_LEN];
+};
+
+/*****************************************************************************/
+/* traces */
+/*****************************************************************************/
+static int replay_trace_append(struct replay_trace *trace,
+			       enum replay_op_type type, const char *key,
+			       size_t key_len)
+{
+	struct replay_op *op = NULL;
+	void *grown = NULL;
+
+	if (key_len >= REPLAY_MAX_KEY_LEN) {
+		fprintf(stderr, "key too long (%lu)\n", (unsigned long)key_len);
+		return 1;
+	}
+	if (trace->ops_len == trace->ops_size) {
+		trace->ops_size = trace->ops_size ? trace->ops_size * 2 : 4096;
+		grown = realloc(trace->ops,
+				trace->ops_size * sizeof(struct replay_op));
+		if (!grown) {
+			return 1;
+		}
+		trace->ops = (struct replay_op *)grown;
+	}
+	if (trace->key_bytes_len + key_len > trace->key_bytes_size) {
+		trace->key_bytes_size =
+		    trace->key_bytes_size ? trace->key_bytes_size * 2 : 65536;
+		grown = realloc(trace->key_bytes, trace->key_bytes_size);
+		if (!grown) {
+			return 1;
+		}
+		trace->key_bytes = (char *)grown;
+	}
+
+	op = &trace->ops[trace->ops_len++];
+	op->type = (unsigned char)type;
+	op->key_len = (unsigned char)key_len;
+	op->key_offset = trace->key_bytes_len;
+	memcpy(trace->key_bytes + trace->key_bytes_len, key, key_len);
+	trace->key_bytes_len += key_len;
+
+	return 0;
+}
+
+static int replay_trace_append_id(struct replay_trace *trace,
+				  enum replay_op_type type, unsigned long id)
+{
+	char key[REPLAY_MAX_KEY_LEN];
+	int len = 0;
+
+	len = sprintf(key, "k%lu", id);
+	return replay_trace_append(trace, type, key, (size_t)len);
+}
+
+static void replay_trace_free(struct replay_trace *trace)
+{
+	free(trace->ops);
+	free(trace->key_bytes);
+	memset(trace, 0x00, sizeof(struct replay_trace));
+}
+
+static int replay_trace_read(struct replay_trace *trace, const char *path)
+{
+	FILE *file = NULL;
+	char line[REPLAY_MAX_KEY_LEN + 16];
+	char key[REPLAY_MAX_KEY_LEN];
+	char op_char = '\0';
+	unsigned long line_num = 0;
+	size_t i = 0;
+	int err = 0;
+
+	file = fopen(path, "r");
+	if (!file) {
+		perror(path);
+		return 1;
+	}
+	while (!err && fgets(line, sizeof(line), file)) {
+		++line_num;
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\0') {
+			continue;
+		}
+		if (sscanf(line, "%c %79s", &op_char, key) != 2) {
+			fprintf(stderr, "%s:%lu: bad line\n", path, line_num);
+			err = 1;
+			break;
+		}
+		for (i = 0; i < replay_op_types_len; ++i) {
+			if (replay_op_chars[i] == op_char) {
+				break;
+			}
+		}
+		if (i == replay_op_types_len) {
+			fprintf(stderr, "%s:%lu: unknown op '%c'\n", path,
+				line_num, op_char);
+			err = 1;
+			break;
+		}
+		err = replay_trace_append(trace, (enum replay_op_type)i, key,
+					  strlen(key));
+	}
+	fclose(file);
+	return err;
+}
+
+static int replay_trace_write(struct replay_trace *trace, const char *path)
+{
+	FILE *file = NULL;
+	struct replay_op *op = NULL;
+	size_t i = 0;
+
+	file = fopen(path, "w");
+	if (!file) {
+		perror(path);
+		return 1;
+	}
+	for (i = 0; i < trace->ops_len; ++i) {
+		op = &trace->ops[i];
+		fprintf(file, "%c %.*s\n", replay_op_chars[op->type],
+			(int)op->key_len, trace->key_bytes + op->key_offset);
+	}
+	return fclose(file) ? 1 : 0;
+}
+
+/*****************************************************************************/
+/* generators */
+/*****************************************************************************/
+static unsigned long replay_random_state = 88172645463325252UL;
+
+static unsigned long replay_random(void)
+{
+	return bench_random(&replay_random_state);
+}
+
+static double replay_random_unit(void)
+{
+	return (replay_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static enum replay_op_type replay_read_or_put(double read_ratio)
+{
+	if (replay_random_unit() < read_ratio) {
+		return replay_op_get;
+	}
+	return replay_op_put;
+}
+
+/* cumulative distribution of Zipf(theta) over [0, n), sampled by
+   binary search; rank 0 is the most popular key */
+static double *replay_zipf_cdf(unsigned long n, double theta)
+{
+	double *cdf = NULL;
+	double sum = 0.0;
+	unsigned long i = 0;
+
+	cdf = (double *)malloc(sizeof(double) * n);
+	if (!cdf) {
+		return NULL;
+	}
+	for (i = 0; i < n; ++i) {
+		sum += 1.0 / pow((double)(i + 1), theta);
+		cdf[i] = sum;
+	}
+	for (i = 0; i < n; ++i) {
+		cdf[i] /= sum;
+	}
+	return cdf;
+}
+
+static unsigned long replay_zipf_next(const double *cdf, unsigned long n)
+{
+	double u = replay_random_unit();
+	unsigned long lo = 0;
+	unsigned long hi = n - 1;
+	unsigned long mid = 0;
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) / 2);
+		if (cdf[mid] < u) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static int replay_load_keys(struct replay_trace *trace, unsigned long keys)
+{
+	unsigned long i = 0;
+	int err = 0;
+
+	for (i = 0; i < keys && !err; ++i) {
+		err = replay_trace_append_id(trace, replay_op_put, i);
+	}
+	return err;
+}
+
+/* skewed reads: a load phase, then Zipf(theta) chosen gets and puts,
+   scattered over the key space so popularity is not hash-order */
+static int replay_gen_zipf(struct replay_trace *trace,
+			   struct replay_options *opts)
+{
+	double *cdf = NULL;
+	unsigned long i = 0;
+	unsigned long rank = 0;
+	int err = 0;
+
+	cdf = replay_zipf_cdf(opts->keys, opts->theta);
+	if (!cdf) {
+		return 1;
+	}
+	err = replay_load_keys(trace, opts->keys);
+	for (i = 0; i < opts->ops && !err; ++i) {
+		rank = replay_zipf_next(cdf, opts->keys);
+		err = replay_trace_append_id(trace,
+					     replay_read_or_put
+					     (opts->read_ratio),
+					     (rank * 2654435761UL) %
+					     opts->keys);
+	}
+	free(cdf);
+	return err;
+}
+
+/* a hot window of hot_fraction of the keys receives hot_ops of the
+   operations, and the window moves every shift_every operations */
+static int replay_gen_hotspot(struct replay_trace *trace,
+			      struct replay_options *opts)
+{
+	unsigned long i = 0;
+	unsigned long id = 0;
+	unsigned long hot_start = 0;
+	unsigned long hot_len = 0;
+	int err = 0;
+
+	hot_len = (unsigned long)(opts->keys * opts->hot_fraction);
+	if (hot_len == 0) {
+		hot_len = 1;
+	}
+	err = replay_load_keys(trace, opts->keys);
+	for (i = 0; i < opts->ops && !err; ++i) {
+		if (opts->shift_every && i && (i % opts->shift_every) == 0) {
+			hot_start = (hot_start + hot_len) % opts->keys;
+		}
+		if (replay_random_unit() < opts->hot_ops) {
+			id = (hot_start + (replay_random() % hot_len))
+			    % opts->keys;
+		} else {
+			id = replay_random() % opts->keys;
+		}
+		err = replay_trace_append_id(trace,
+					     replay_read_or_put
+					     (opts->read_ratio), id);
+	}
+	return err;
+}
+
+/* bursts of inserts of new keys, gets against the live window, and
+   TTL-like removal of the oldest keys once the window is exceeded */
+static int replay_gen_churn(struct replay_trace *trace,
+			    struct replay_options *opts)
+{
+	unsigned long i = 0;
+	unsigned long j = 0;
+	unsigned long oldest = 0;
+	unsigned long next_id = 0;
+	unsigned long live = 0;
+	int err = 0;
+
+	while (i < opts->ops && !err) {
+		for (j = 0; j < opts->burst && i < opts->ops && !err;
+		     ++j, ++i) {
+			err = replay_trace_append_id(trace, replay_op_put,
+						     next_id++);
+		}
+		while ((next_id - oldest) > opts->window && !err
+		       && i < opts->ops) {
+			err = replay_trace_append_id(trace, replay_op_remove,
+						     oldest++);
+			++i;
+		}
+		live = next_id - oldest;
+		for (j = 0; j < opts->burst && i < opts->ops && !err;
+		     ++j, ++i) {
+			err = replay_trace_append_id(trace, replay_op_get,
+						     oldest +
+						     (replay_random() % live));
+		}
+	}
+	return err;
+}
+
+/*****************************************************************************/
+/* replay */
+/*****************************************************************************/
+static void replay_histogram_add(struct replay_histogram *hist,
+				 unsigned long ns)
+{
+	size_t bucket = 0;
+
+	while ((ns >> bucket) > 1 && bucket < (REPLAY_HIST_LEN - 1)) {
+		++bucket;
+	}
+	++hist->buckets[bucket];
+	++hist->count;
+	hist->total_ns += ns;
+}
+
+/* the upper bound of the bucket holding the requested percentile */
+static unsigned long replay_histogram_percentile(struct replay_histogram *hist,
+						 double pct)
+{
+	unsigned long target = 0;
+	unsigned long seen = 0;
+	size_t i = 0;
+
+	target = (unsigned long)(hist->count * pct);
+	for (i = 0; i < REPLAY_HIST_LEN; ++i) {
+		seen += hist->buckets[i];
+		if (seen > target) {
+			return 2UL << i;
+		}
+	}
+	return 2UL << (REPLAY_HIST_LEN - 1);
+}
+
+static void replay_histogram_print(const char *name,
+				   struct replay_histogram *hist)
+{
+	size_t i = 0;
+
+	if (!hist->count) {
+		return;
+	}
+	printf("%s: %lu ops, mean %lu ns, p50 < %lu ns, p90 < %lu ns,"
+	       " p99 < %lu ns, p99.9 < %lu ns\n", name, hist->count,
+	       hist->total_ns / hist->count,
+	       replay_histogram_percentile(hist, 0.50),
+	       replay_histogram_percentile(hist, 0.90),
+	       replay_histogram_percentile(hist, 0.99),
+	       replay_histogram_percentile(hist, 0.999));
+	for (i = 0; i < REPLAY_HIST_LEN; ++i) {
+		if (hist->buckets[i]) {
+			printf("\t[%lu, %lu) ns: %lu\n",
+			       i ? (1UL << i) : 0UL, 2UL << i,
+			       hist->buckets[i]);
+		}
+	}
+}
+
+static int replay_run(struct replay_trace *trace, struct replay_options *opts)
+{
+	struct replay_histogram hists[replay_op_types_len];
+	struct bench_tracking_context tctx;
+	struct eembed_allocator tracking;
+	struct ehht *table = NULL;
+	struct replay_op *op = NULL;
+	const char *key = NULL;
+	struct ehht_stats stats;
+	unsigned long start = 0;
+	unsigned long begin = 0;
+	unsigned long elapsed = 0;
+	unsigned long hits = 0;
+	size_t i = 0;
+	int found = 0;
+	int err = 0;
+
+	memset(hists, 0x00, sizeof(hists));
+	bench_tracking_allocator_init(&tracking, &tctx,
+				      eembed_global_allocator);
+
+	table = ehht_new_custom(opts->buckets, NULL, &tracking, NULL);
+	if (!table) {
+		fprintf(stderr, "ehht_new_custom returned NULL\n");
+		return 1;
+	}
+	if (opts->cache
+	    && ehht_cache_limit(table, opts->cache, 0, NULL, NULL)) {
+		ehht_free(table);
+		return 1;
+	}
+
+	if (opts->sample_every) {
+		printf("# ops, bytes_live, bytes_peak, size, buckets\n");
+	}
+	begin = bench_now_ns(NULL);
+	for (i = 0; i < trace->ops_len && !err; ++i) {
+		op = &trace->ops[i];
+		key = trace->key_bytes + op->key_offset;
+		start = bench_now_ns(NULL);
+		switch (op->type) {
+		case replay_op_put:
+			table->put(table, key, op->key_len, (void *)(i + 1),
+				   &err);
+			break;
+		case replay_op_get:
+			ehht_lookup(table, key, op->key_len, &found);
+			if (found) {
+				++hits;
+			} else if (opts->cache) {
+				table->put(table, key, op->key_len,
+					   (void *)(i + 1), &err);
+			}
+			break;
+		case replay_op_has_key:
+			table->has_key(table, key, op->key_len);
+			break;
+		case replay_op_remove:
+			table->remove(table, key, op->key_len);
+			break;
+		}
+		replay_histogram_add(&hists[op->type],
+				     bench_now_ns(NULL) - start);
+
+		if (opts->sample_every && ((i + 1) % opts->sample_every) == 0) {
+			printf("%lu, %lu, %lu, %lu, %lu\n",
+			       (unsigned long)(i + 1),
+			       (unsigned long)tctx.bytes_live,
+			       (unsigned long)tctx.bytes_peak,
+			       (unsigned long)table->size(table),
+			       (unsigned long)ehht_buckets_size(table));
+		}
+	}
+	elapsed = bench_now_ns(NULL) - begin;
+	if (err) {
+		fprintf(stderr, "put failed at op %lu\n", (unsigned long)i);
+	}
+
+	printf("ops: %lu in %lu ns (%.0f ops/s, including timer overhead)\n",
+	       (unsigned long)i, elapsed,
+	       elapsed ? (i * 1000000000.0) / elapsed : 0.0);
+	printf("final size: %lu, buckets: %lu\n",
+	       (unsigned long)table->size(table),
+	       (unsigned long)ehht_buckets_size(table));
+	printf("allocator: %lu allocs, %lu frees, %lu bytes live,"
+	       " %lu bytes peak\n", (unsigned long)tctx.allocs,
+	       (unsigned long)tctx.frees, (unsigned long)tctx.bytes_live,
+	       (unsigned long)tctx.bytes_peak);
+	if (hists[replay_op_get].count) {
+		ehht_stats(table, &stats);
+		printf("gets: %lu hits of %lu (%.2f%%), %lu evictions\n",
+		       hits, hists[replay_op_get].count,
+		       (100.0 * hits) / hists[replay_op_get].count,
+		       (unsigned long)stats.evictions);
+	}
+	for (i = 0; i < replay_op_types_len; ++i) {
+		replay_histogram_print(replay_op_names[i], &hists[i]);
+	}
+
+	ehht_free(table);
+	return err;
+}
+
+/*****************************************************************************/
+/* command line */
+/*****************************************************************************/
+static int replay_arg(const char *arg, const char *name, const char **val)
+{
+	size_t len = strlen(name);
+
+	if (strncmp(arg, name, len) == 0 && arg[len] == '=') {
+		*val = arg + len + 1;
+		return 1;
+	}
+	return 0;
+}
+
+static void replay_usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s --trace=FILE [options]\n", prog);
+	fprintf(stderr, "   or: %s --gen=zipf|hotspot|churn [options]\n", prog);
+	fprintf(stderr, "options (defaults in parens):\n");
+	fprintf(stderr, "\t--write=FILE    write generated trace, no replay\n");
+	fprintf(stderr, "\t--keys=N        key space size (100000)\n");
+	fprintf(stderr, "\t--ops=N         operations after load (1000000)\n");
+	fprintf(stderr, "\t--theta=F       zipf skew (0.99)\n");
+	fprintf(stderr, "\t--read=F        ratio of gets to puts (0.95)\n");
+	fprintf(stderr, "\t--hot=F         hotspot key fraction (0.01)\n");
+	fprintf(stderr, "\t--hot-ops=F     hotspot op fraction (0.9)\n");
+	fprintf(stderr,
+		"\t--shift=N       hotspot moves every N ops (100000)\n");
+	fprintf(stderr, "\t--burst=N       churn burst length (1000)\n");
+	fprintf(stderr, "\t--window=N      churn live key window (50000)\n");
+	fprintf(stderr, "\t--seed=N        generator seed\n");
+	fprintf(stderr, "\t--sample=N      print bytes every N ops (0: off)\n");
+	fprintf(stderr,
+		"\t--buckets=N     initial buckets (library default)\n");
+	fprintf(stderr,
+		"\t--cache=N       limit to N entries, fill on miss (0)\n");
+}
+
+static int replay_parse_args(struct replay_options *opts, int argc,
+			     char *argv[])
+{
+	const char *val = NULL;
+	int i = 0;
+
+	opts->keys = 100000;
+	opts->ops = 1000000;
+	opts->theta = 0.99;
+	opts->read_ratio = 0.95;
+	opts->hot_fraction = 0.01;
+	opts->hot_ops = 0.9;
+	opts->shift_every = 100000;
+	opts->burst = 1000;
+	opts->window = 50000;
+
+	for (i = 1; i < argc; ++i) {
+		if (replay_arg(argv[i], "--trace", &val)) {
+			opts->trace = val;
+		} else if (replay_arg(argv[i], "--gen", &val)) {
+			opts->gen = val;
+		} else if (replay_arg(argv[i], "--write", &val)) {
+			opts->write = val;
+		} else if (replay_arg(argv[i], "--keys", &val)) {
+			opts->keys = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--ops", &val)) {
+			opts->ops = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--theta", &val)) {
+			opts->theta = strtod(val, NULL);
+		} else if (replay_arg(argv[i], "--read", &val)) {
+			opts->read_ratio = strtod(val, NULL);
+		} else if (replay_arg(argv[i], "--hot", &val)) {
+			opts->hot_fraction = strtod(val, NULL);
+		} else if (replay_arg(argv[i], "--hot-ops", &val)) {
+			opts->hot_ops = strtod(val, NULL);
+		} else if (replay_arg(argv[i], "--shift", &val)) {
+			opts->shift_every = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--burst", &val)) {
+			opts->burst = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--window", &val)) {
+			opts->window = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--seed", &val)) {
+			opts->seed = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--sample", &val)) {
+			opts->sample_every = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--buckets", &val)) {
+			opts->buckets = strtoul(val, NULL, 10);
+		} else if (replay_arg(argv[i], "--cache", &val)) {
+			opts->cache = strtoul(val, NULL, 10);
+		} else {
+			fprintf(stderr, "unrecognized: %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if ((!opts->trace) == (!opts->gen)) {
+		return 1;
+	}
+	if (!opts->keys || !opts->burst || !opts->window) {
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct replay_options opts;
+	struct replay_trace trace;
+	int err = 0;
+
+	memset(&opts, 0x00, sizeof(opts));
+	memset(&trace, 0x00, sizeof(trace));
+
+	if (replay_parse_args(&opts, argc, argv)) {
+		replay_usage(argv[0]);
+		return 2;
+	}
+	if (opts.seed) {
+		replay_random_state ^= opts.seed * 0x9E3779B97F4A7C15UL;
+	}
+
+	if (opts.trace) {
+		err = replay_trace_read(&trace, opts.trace);
+	} else if (strcmp(opts.gen, "zipf") == 0) {
+		err = replay_gen_zipf(&trace, &opts);
+	} else if (strcmp(opts.gen, "hotspot") == 0) {
+		err = replay_gen_hotspot(&trace, &opts);
+	} else if (strcmp(opts.gen, "churn") == 0) {
+		err = replay_gen_churn(&trace, &opts);
+	} else {
+		replay_usage(argv[0]);
+		return 2;
+	}
+
+	if (!err) {
+		if (opts.write) {
+			err = replay_trace_write(&trace, opts.write);
+		} else {
+			err = replay_run(&trace, &opts);
+		}
+	}
+
+	replay_trace_free(&trace);
+	return err ? 1 : 0;
+}
@@ -0,0 +1,512 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-compact.c: an insertion ordered hashtable behind "struct ehht" */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "ehht-fixed.h"		/* ehht_mix32 uint32_t */
+#include "ehht-each.h"
+#include "ehht-error.h"
+#include "eembed.h"
+
+/* the index is at most two thirds full of entries and removed marks */
+#define EHHT_COMPACT_MIN_INDEX 8
+
+/* a slot of the index holds 0 if empty, the all-ones value of its width
+   if its entry was removed, otherwise the entry's position plus one */
+#define EHHT_COMPACT_EMPTY 0
+
+/* the key_len of a removed entry */
+#define EHHT_COMPACT_REMOVED ((unsigned int)-1)
+
+/* ehht.c */
+unsigned int ehht_kr2_hashcode(const char *data, size_t len);
+
+/* 24 bytes on LP64; the key is at key_offset in the key bytes, with a
+   NUL terminator which is not counted in key_len */
+struct ehht_compact_entry {
+	size_t key_offset;
+	unsigned int key_len;
+	unsigned int hashcode;
+	void *val;
+};
+
+struct ehht_compact_table {
+	/* first, as in struct ehht_each_table */
+	struct eembed_allocator *ea;
+	struct eembed_log *log;
+	/* a power of two slots, each of index_width bytes */
+	unsigned char *index;
+	size_t index_size;
+	size_t index_width;
+	size_t index_removed_mark;
+
+	/* in insertion order, including removed entries until a resize */
+	struct ehht_compact_entry *entries;
+	size_t entries_len;
+	size_t entries_cap;
+
+	char *key_bytes;
+	size_t key_bytes_len;
+	size_t key_bytes_cap;
+	/* of the entries not removed */
+	size_t key_bytes_live;
+
+	size_t size;
+	ehht_hash_func hash_func;
+};
+
+static void ehht_compact_destroy(struct ehht *ht);
+
+static struct ehht_compact_table *ehht_compact_get_table(struct ehht *ht)
+{
+	eembed_assert(ht);
+	eembed_assert(ht->destroy == ehht_compact_destroy);
+	eembed_assert(ht->data);
+	return (struct ehht_compact_table *)ht->data;
+}
+
+static size_t ehht_compact_usable(size_t index_size)
+{
+	return (index_size * 2) / 3;
+}
+
+static size_t ehht_compact_slot_get(struct ehht_compact_table *table,
+				    size_t slot)
+{
+	switch (table->index_width) {
+	case 1:
+		return ((uint8_t *)table->index)[slot];
+	case 2:
+		return ((uint16_t *)table->index)[slot];
+	default:
+		return ((uint32_t *)table->index)[slot];
+	}
+}
+
+static void ehht_compact_slot_set(struct ehht_compact_table *table,
+				  size_t slot, size_t val)
+{
+	switch (table->index_width) {
+	case 1:
+		((uint8_t *)table->index)[slot] = (uint8_t)val;
+		break;
+	case 2:
+		((uint16_t *)table->index)[slot] = (uint16_t)val;
+		break;
+	default:
+		((uint32_t *)table->index)[slot] = (uint32_t)val;
+		break;
+	}
+}
+
+/* Returns the slot which holds the key, or if absent, the slot where it
+   should be inserted: the first removed mark on its probe sequence, or
+   else the empty slot which ends it; *found is set accordingly. There
+   is always an empty slot, as at most two thirds are used. */
+static size_t ehht_compact_find(struct ehht_compact_table *table,
+				const char *key, size_t key_len,
+				unsigned int hashcode, int *found)
+{
+	struct ehht_compact_entry *entry = NULL;
+	size_t mask = table->index_size - 1;
+	size_t slot = 0;
+	size_t insert = table->index_size;
+	size_t ix = 0;
+
+	*found = 0;
+	for (slot = ehht_mix32(hashcode) & mask;; slot = (slot + 1) & mask) {
+		ix = ehht_compact_slot_get(table, slot);
+		if (ix == EHHT_COMPACT_EMPTY) {
+			return (insert < table->index_size) ? insert : slot;
+		}
+		if (ix == table->index_removed_mark) {
+			if (insert == table->index_size) {
+				insert = slot;
+			}
+			continue;
+		}
+		entry = table->entries + (ix - 1);
+		if (entry->hashcode == hashcode
+		    && entry->key_len == (unsigned int)key_len
+		    && eembed_memcmp(table->key_bytes + entry->key_offset, key,
+				     key_len) == 0) {
+			*found = 1;
+			return slot;
+		}
+	}
+}
+
+/* the slot of a key known to be absent, for rebuilding the index */
+static size_t ehht_compact_free_slot(struct ehht_compact_table *table,
+				     unsigned int hashcode)
+{
+	size_t mask = table->index_size - 1;
+	size_t slot = 0;
+
+	slot = ehht_mix32(hashcode) & mask;
+	while (ehht_compact_slot_get(table, slot) != EHHT_COMPACT_EMPTY) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+/* Rebuilds the table with an index for at least "needed" entries,
+   dropping removed entries and their key bytes, which keeps the
+   insertion order. Returns non-zero on error, leaving the table as it
+   was. */
+static int ehht_compact_resize(struct ehht_compact_table *table,
+			       size_t needed)
+{
+	struct eembed_allocator *ea = table->ea;
+	struct ehht_compact_table next;
+	struct ehht_compact_entry *from = NULL;
+	struct ehht_compact_entry *to = NULL;
+	size_t size = 0;
+	size_t i = 0;
+
+	eembed_memset(&next, 0x00, sizeof(struct ehht_compact_table));
+	next.index_size = EHHT_COMPACT_MIN_INDEX;
+	while (ehht_compact_usable(next.index_size) < needed) {
+		next.index_size *= 2;
+	}
+	if (next.index_size <= 0x100) {
+		next.index_width = 1;
+		next.index_removed_mark = 0xFF;
+	} else if (next.index_size <= 0x10000) {
+		next.index_width = 2;
+		next.index_removed_mark = 0xFFFF;
+	} else if ((next.index_size >> 16) <= 0x10000) {
+		next.index_width = 4;
+		next.index_removed_mark = 0xFFFFFFFFUL;
+	} else {
+		Ehht_error(table->log, 301, "too many entries");
+		return 1;
+	}
+	next.entries_cap = ehht_compact_usable(next.index_size);
+	next.key_bytes_cap = (2 * table->key_bytes_live) + 64;
+
+	size = next.index_size * next.index_width;
+	next.index = (unsigned char *)ea->malloc(ea, size);
+	if (!next.index) {
+		Ehht_error_malloc(table->log, 302, size, "index");
+		return 1;
+	}
+	eembed_memset(next.index, 0x00, size);
+
+	size = sizeof(struct ehht_compact_entry) * next.entries_cap;
+	next.entries = (struct ehht_compact_entry *)ea->malloc(ea, size);
+	if (!next.entries) {
+		Ehht_error_malloc(table->log, 303, size, "entries");
+		ea->free(ea, next.index);
+		return 1;
+	}
+
+	size = next.key_bytes_cap;
+	next.key_bytes = (char *)ea->malloc(ea, size);
+	if (!next.key_bytes) {
+		Ehht_error_malloc(table->log, 304, size, "key bytes");
+		ea->free(ea, next.entries);
+		ea->free(ea, next.index);
+		return 1;
+	}
+
+	for (i = 0; i < table->entries_len; ++i) {
+		from = table->entries + i;
+		if (from->key_len == EHHT_COMPACT_REMOVED) {
+			continue;
+		}
+		to = next.entries + next.entries_len;
+		*to = *from;
+		to->key_offset = next.key_bytes_len;
+		eembed_memcpy(next.key_bytes + next.key_bytes_len,
+			      table->key_bytes + from->key_offset,
+			      from->key_len + 1);
+		next.key_bytes_len += from->key_len + 1;
+		ehht_compact_slot_set(&next,
+				      ehht_compact_free_slot(&next,
+							     to->hashcode),
+				      ++(next.entries_len));
+	}
+
+	ea->free(ea, table->key_bytes);
+	ea->free(ea, table->entries);
+	ea->free(ea, table->index);
+
+	table->index = next.index;
+	table->index_size = next.index_size;
+	table->index_width = next.index_width;
+	table->index_removed_mark = next.index_removed_mark;
+	table->entries = next.entries;
+	table->entries_len = next.entries_len;
+	table->entries_cap = next.entries_cap;
+	table->key_bytes = next.key_bytes;
+	table->key_bytes_len = next.key_bytes_len;
+	table->key_bytes_cap = next.key_bytes_cap;
+	return 0;
+}
+
+/* appends the key and its NUL to the key bytes, growing them if needed;
+   the old bytes are freed only after the copy, in case the key is in
+   them. Returns the offset, or (size_t)-1 on error. */
+static size_t ehht_compact_append_key(struct ehht_compact_table *table,
+				      const char *key, size_t key_len)
+{
+	struct eembed_allocator *ea = table->ea;
+	char *old_bytes = NULL;
+	char *new_bytes = NULL;
+	size_t new_cap = 0;
+	size_t offset = 0;
+
+	if ((table->key_bytes_len + key_len + 1) > table->key_bytes_cap) {
+		new_cap = 2 * table->key_bytes_cap;
+		while (new_cap < (table->key_bytes_len + key_len + 1)) {
+			new_cap *= 2;
+		}
+		new_bytes = (char *)ea->malloc(ea, new_cap);
+		if (!new_bytes) {
+			Ehht_error_malloc(table->log, 305, new_cap,
+					  "key bytes");
+			return (size_t)-1;
+		}
+		eembed_memcpy(new_bytes, table->key_bytes,
+			      table->key_bytes_len);
+		old_bytes = table->key_bytes;
+		table->key_bytes = new_bytes;
+		table->key_bytes_cap = new_cap;
+	}
+	offset = table->key_bytes_len;
+	eembed_memcpy(table->key_bytes + offset, key, key_len);
+	table->key_bytes[offset + key_len] = '\0';
+	table->key_bytes_len += key_len + 1;
+	ea->free(ea, old_bytes);
+	return offset;
+}
+
+static void *ehht_compact_get(struct ehht *ht, const char *key,
+			      size_t key_len)
+{
+	struct ehht_compact_table *table = NULL;
+	size_t slot = 0;
+	int found = 0;
+
+	table = ehht_compact_get_table(ht);
+	slot = ehht_compact_find(table, key, key_len,
+				 table->hash_func(key, key_len), &found);
+	if (!found) {
+		return NULL;
+	}
+	return table->entries[ehht_compact_slot_get(table, slot) - 1].val;
+}
+
+static int ehht_compact_has_key(struct ehht *ht, const char *key,
+				size_t key_len)
+{
+	struct ehht_compact_table *table = NULL;
+	int found = 0;
+
+	table = ehht_compact_get_table(ht);
+	ehht_compact_find(table, key, key_len, table->hash_func(key, key_len),
+			  &found);
+	return found;
+}
+
+static void *ehht_compact_put(struct ehht *ht, const char *key,
+			      size_t key_len, void *val, int *err)
+{
+	struct ehht_compact_table *table = NULL;
+	struct ehht_compact_entry *entry = NULL;
+	unsigned int hashcode = 0;
+	size_t offset = 0;
+	size_t slot = 0;
+	void *old_val = NULL;
+	int found = 0;
+
+	table = ehht_compact_get_table(ht);
+	hashcode = table->hash_func(key, key_len);
+	slot = ehht_compact_find(table, key, key_len, hashcode, &found);
+	if (found) {
+		entry =
+		    table->entries + (ehht_compact_slot_get(table, slot) - 1);
+		old_val = entry->val;
+		entry->val = val;
+		return old_val;
+	}
+	if (key_len >= EHHT_COMPACT_REMOVED) {
+		Ehht_error(table->log, 306, "key too long");
+		if (err) {
+			*err = 1;
+		}
+		return NULL;
+	}
+
+	/* full, perhaps of removed entries: compact, and grow if half of
+	   the room would be used by the live entries */
+	if (table->entries_len == table->entries_cap) {
+		if (ehht_compact_resize(table, 2 * (table->size + 1))) {
+			if (err) {
+				*err = 1;
+			}
+			return NULL;
+		}
+		slot = ehht_compact_find(table, key, key_len, hashcode,
+					 &found);
+	}
+
+	offset = ehht_compact_append_key(table, key, key_len);
+	if (offset == (size_t)-1) {
+		if (err) {
+			*err = 1;
+		}
+		return NULL;
+	}
+	entry = table->entries + table->entries_len;
+	entry->key_offset = offset;
+	entry->key_len = (unsigned int)key_len;
+	entry->hashcode = hashcode;
+	entry->val = val;
+	ehht_compact_slot_set(table, slot, ++(table->entries_len));
+	table->key_bytes_live += key_len + 1;
+	++(table->size);
+	return NULL;
+}
+
+static void *ehht_compact_remove(struct ehht *ht, const char *key,
+				 size_t key_len)
+{
+	struct ehht_compact_table *table = NULL;
+	struct ehht_compact_entry *entry = NULL;
+	size_t slot = 0;
+	void *old_val = NULL;
+	int found = 0;
+
+	table = ehht_compact_get_table(ht);
+	slot = ehht_compact_find(table, key, key_len,
+				 table->hash_func(key, key_len), &found);
+	if (!found) {
+		return NULL;
+	}
+	entry = table->entries + (ehht_compact_slot_get(table, slot) - 1);
+	old_val = entry->val;
+	table->key_bytes_live -= entry->key_len + 1;
+	entry->key_len = EHHT_COMPACT_REMOVED;
+	entry->val = NULL;
+	ehht_compact_slot_set(table, slot, table->index_removed_mark);
+	--(table->size);
+	return old_val;
+}
+
+static size_t ehht_compact_size(struct ehht *ht)
+{
+	return ehht_compact_get_table(ht)->size;
+}
+
+static void ehht_compact_clear(struct ehht *ht)
+{
+	struct ehht_compact_table *table = NULL;
+
+	table = ehht_compact_get_table(ht);
+	eembed_memset(table->index, 0x00,
+		      table->index_size * table->index_width);
+	table->entries_len = 0;
+	table->key_bytes_len = 0;
+	table->key_bytes_live = 0;
+	table->size = 0;
+}
+
+static int ehht_compact_for_each(struct ehht *ht, ehht_iterator_func func,
+				 void *context)
+{
+	struct ehht_compact_table *table = NULL;
+	struct ehht_compact_entry *entry = NULL;
+	struct ehht_key key;
+	size_t i = 0;
+	int end = 0;
+
+	table = ehht_compact_get_table(ht);
+	for (i = 0; i < table->entries_len && !end; ++i) {
+		entry = table->entries + i;
+		if (entry->key_len == EHHT_COMPACT_REMOVED) {
+			continue;
+		}
+		key.str = table->key_bytes + entry->key_offset;
+		key.len = entry->key_len;
+		key.hashcode = entry->hashcode;
+		end = (*func) (key, entry->val, context);
+	}
+	return end;
+}
+
+static void ehht_compact_destroy(struct ehht *ht)
+{
+	struct ehht_compact_table *table = NULL;
+	struct eembed_allocator *ea = NULL;
+
+	table = ehht_compact_get_table(ht);
+	ea = table->ea;
+
+	ea->free(ea, table->key_bytes);
+	ea->free(ea, table->entries);
+	ea->free(ea, table->index);
+	ea->free(ea, table);
+	ea->free(ea, ht);
+}
+
+struct ehht *ehht_new_compact(size_t capacity, ehht_hash_func hash_func,
+			      struct eembed_allocator *ea,
+			      struct eembed_log *log)
+{
+	struct ehht *ht = NULL;
+	struct ehht_compact_table *table = NULL;
+	size_t size = 0;
+
+	if (hash_func == NULL) {
+		hash_func = ehht_kr2_hashcode;
+	}
+	if (ea == NULL) {
+		ea = eembed_global_allocator;
+	}
+	if (log == NULL) {
+		log = eembed_err_log;
+	}
+
+	size = sizeof(struct ehht);
+	ht = (struct ehht *)ea->malloc(ea, size);
+	if (ht == NULL) {
+		Ehht_error_malloc(log, 310, size, "struct ehht");
+		return NULL;
+	}
+	eembed_memset(ht, 0x00, size);
+
+	ht->get = ehht_compact_get;
+	ht->put = ehht_compact_put;
+	ht->remove = ehht_compact_remove;
+	ht->size = ehht_compact_size;
+	ht->clear = ehht_compact_clear;
+	ht->for_each = ehht_compact_for_each;
+	ht->has_key = ehht_compact_has_key;
+	ht->keys = ehht_each_keys;
+	ht->free_keys = ehht_each_free_keys;
+	ht->to_string = ehht_each_to_string;
+	ht->destroy = ehht_compact_destroy;
+
+	size = sizeof(struct ehht_compact_table);
+	table = (struct ehht_compact_table *)ea->malloc(ea, size);
+	if (table == NULL) {
+		Ehht_error_malloc(log, 311, size, "compact table");
+		ea->free(ea, ht);
+		return NULL;
+	}
+	eembed_memset(table, 0x00, size);
+	table->hash_func = hash_func;
+	table->ea = ea;
+	table->log = log;
+	ht->data = table;
+
+	if (ehht_compact_resize(table, capacity)) {
+		ea->free(ea, table);
+		ea->free(ea, ht);
+		return NULL;
+	}
+	return ht;
+}
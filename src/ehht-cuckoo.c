@@ -0,0 +1,663 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-cuckoo.c: a bucketized cuckoo hashtable behind "struct ehht" */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "ehht-fixed.h"		/* ehht_mix32 */
+#include "ehht-each.h"
+#include "ehht-error.h"
+#include "eembed.h"
+
+/* four slots per bucket, the hashcodes and lengths are beside the
+   entry pointers, so that a bucket is one 64 byte cache line on LP64 */
+#define EHHT_CUCKOO_SLOTS 4
+#define EHHT_CUCKOO_ALIGN 64
+
+#ifndef EHHT_CUCKOO_STASH_LEN
+#define EHHT_CUCKOO_STASH_LEN 4
+#endif
+
+/* the breadth first search for a free slot visits at most this many
+   buckets, which reaches every path of up to 3 moves */
+#ifndef EHHT_CUCKOO_BFS_MAX
+#define EHHT_CUCKOO_BFS_MAX 128
+#endif
+
+/* ehht.c */
+unsigned int ehht_kr2_hashcode(const char *data, size_t len);
+
+/* the key bytes follow the entry */
+struct ehht_cuckoo_entry {
+	struct ehht_key key;
+	void *val;
+};
+
+struct ehht_cuckoo_bucket {
+	unsigned int hashcode[EHHT_CUCKOO_SLOTS];
+	unsigned int len[EHHT_CUCKOO_SLOTS];
+	struct ehht_cuckoo_entry *entry[EHHT_CUCKOO_SLOTS];
+};
+
+struct ehht_cuckoo_bfs_node {
+	size_t bucket;
+	int parent;
+	int parent_slot;
+};
+
+struct ehht_cuckoo_table {
+	/* first, as in struct ehht_each_table */
+	struct eembed_allocator *ea;
+	struct eembed_log *log;
+	/* a power of two */
+	size_t num_buckets;
+	struct ehht_cuckoo_bucket *buckets;
+	/* the allocation, of which buckets is the aligned part */
+	void *buckets_mem;
+	struct ehht_cuckoo_entry *stash[EHHT_CUCKOO_STASH_LEN];
+	size_t stash_len;
+	/* entries which no table size would place, e.g.: many keys of
+	   one hashcode */
+	struct ehht_cuckoo_entry **overflow;
+	size_t overflow_len;
+	size_t overflow_size;
+	size_t size;
+	ehht_hash_func hash_func;
+};
+
+static struct ehht_cuckoo_table *ehht_cuckoo_get_table(struct ehht *ht)
+{
+	eembed_assert(ht);
+	eembed_assert(ht->data);
+	return (struct ehht_cuckoo_table *)ht->data;
+}
+
+static size_t ehht_cuckoo_bucket1(struct ehht_cuckoo_table *table,
+				  unsigned int hashcode)
+{
+	return (size_t)ehht_mix32(hashcode) & (table->num_buckets - 1);
+}
+
+static size_t ehht_cuckoo_bucket2(struct ehht_cuckoo_table *table,
+				  unsigned int hashcode)
+{
+	size_t mask = table->num_buckets - 1;
+	size_t b1 = (size_t)ehht_mix32(hashcode) & mask;
+	size_t b2 = (size_t)ehht_mix32(hashcode ^ 0x9E3779B9UL) & mask;
+
+	return (b2 == b1) ? (b1 ^ 1) : b2;
+}
+
+/* the bucket, other than "bucket", which may hold this hashcode */
+static size_t ehht_cuckoo_alt(struct ehht_cuckoo_table *table,
+			      unsigned int hashcode, size_t bucket)
+{
+	size_t b1 = ehht_cuckoo_bucket1(table, hashcode);
+	return (bucket == b1) ? ehht_cuckoo_bucket2(table, hashcode) : b1;
+}
+
+static int ehht_cuckoo_free_slot(struct ehht_cuckoo_bucket *bucket)
+{
+	int i = 0;
+
+	for (i = 0; i < EHHT_CUCKOO_SLOTS; ++i) {
+		if (bucket->entry[i] == NULL) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void ehht_cuckoo_set(struct ehht_cuckoo_bucket *bucket, int slot,
+			    struct ehht_cuckoo_entry *entry)
+{
+	bucket->entry[slot] = entry;
+	bucket->hashcode[slot] = entry ? entry->key.hashcode : 0;
+	bucket->len[slot] = entry ? (unsigned int)entry->key.len : 0;
+}
+
+static int ehht_cuckoo_matches(struct ehht_cuckoo_bucket *bucket, int slot,
+			       const char *key, size_t key_len,
+			       unsigned int hashcode)
+{
+	struct ehht_cuckoo_entry *entry = bucket->entry[slot];
+
+	return entry && bucket->hashcode[slot] == hashcode
+	    && bucket->len[slot] == (unsigned int)key_len
+	    && entry->key.len == key_len
+	    && eembed_memcmp(entry->key.str, key, key_len) == 0;
+}
+
+/* returns the pointer which holds the entry for the key, or NULL */
+static struct ehht_cuckoo_entry **ehht_cuckoo_find(struct ehht_cuckoo_table
+						   *table, const char *key,
+						   size_t key_len,
+						   unsigned int hashcode)
+{
+	struct ehht_cuckoo_bucket *bucket = NULL;
+	struct ehht_cuckoo_entry *entry = NULL;
+	size_t i = 0;
+	int slot = 0;
+
+	bucket = table->buckets + ehht_cuckoo_bucket1(table, hashcode);
+	for (slot = 0; slot < EHHT_CUCKOO_SLOTS; ++slot) {
+		if (ehht_cuckoo_matches(bucket, slot, key, key_len, hashcode)) {
+			return &(bucket->entry[slot]);
+		}
+	}
+	bucket = table->buckets + ehht_cuckoo_bucket2(table, hashcode);
+	for (slot = 0; slot < EHHT_CUCKOO_SLOTS; ++slot) {
+		if (ehht_cuckoo_matches(bucket, slot, key, key_len, hashcode)) {
+			return &(bucket->entry[slot]);
+		}
+	}
+	for (i = 0; i < table->stash_len; ++i) {
+		entry = table->stash[i];
+		if (entry->key.hashcode == hashcode && entry->key.len == key_len
+		    && eembed_memcmp(entry->key.str, key, key_len) == 0) {
+			return &(table->stash[i]);
+		}
+	}
+	for (i = 0; i < table->overflow_len; ++i) {
+		entry = table->overflow[i];
+		if (entry->key.hashcode == hashcode && entry->key.len == key_len
+		    && eembed_memcmp(entry->key.str, key, key_len) == 0) {
+			return &(table->overflow[i]);
+		}
+	}
+	return NULL;
+}
+
+static int ehht_cuckoo_bfs_seen(struct ehht_cuckoo_bfs_node *nodes,
+				size_t len, size_t bucket)
+{
+	size_t i = 0;
+
+	for (i = 0; i < len; ++i) {
+		if (nodes[i].bucket == bucket) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* places the entry in one of its buckets, moving others along the
+   shortest path to a free slot; returns non-zero if none was found */
+static int ehht_cuckoo_place(struct ehht_cuckoo_table *table,
+			     struct ehht_cuckoo_entry *entry)
+{
+	struct ehht_cuckoo_bfs_node nodes[EHHT_CUCKOO_BFS_MAX];
+	struct ehht_cuckoo_bucket *bucket = NULL;
+	struct ehht_cuckoo_bucket *to = NULL;
+	size_t len = 0;
+	size_t head = 0;
+	size_t alt = 0;
+	int cur = 0;
+	int slot = 0;
+	int free_slot = 0;
+
+	nodes[0].bucket = ehht_cuckoo_bucket1(table, entry->key.hashcode);
+	nodes[0].parent = -1;
+	nodes[0].parent_slot = -1;
+	nodes[1].bucket = ehht_cuckoo_bucket2(table, entry->key.hashcode);
+	nodes[1].parent = -1;
+	nodes[1].parent_slot = -1;
+	len = 2;
+
+	for (head = 0; head < 2; ++head) {
+		bucket = table->buckets + nodes[head].bucket;
+		free_slot = ehht_cuckoo_free_slot(bucket);
+		if (free_slot >= 0) {
+			ehht_cuckoo_set(bucket, free_slot, entry);
+			return 0;
+		}
+	}
+
+	for (head = 0; head < len; ++head) {
+		bucket = table->buckets + nodes[head].bucket;
+		for (slot = 0; slot < EHHT_CUCKOO_SLOTS; ++slot) {
+			alt = ehht_cuckoo_alt(table, bucket->hashcode[slot],
+					      nodes[head].bucket);
+			to = table->buckets + alt;
+			free_slot = ehht_cuckoo_free_slot(to);
+			if (free_slot < 0) {
+				if (len < EHHT_CUCKOO_BFS_MAX
+				    && !ehht_cuckoo_bfs_seen(nodes, len, alt)) {
+					nodes[len].bucket = alt;
+					nodes[len].parent = (int)head;
+					nodes[len].parent_slot = slot;
+					++len;
+				}
+				continue;
+			}
+			/* move each entry of the path one step, from the
+			   free end back to the root */
+			cur = (int)head;
+			while (cur >= 0) {
+				bucket = table->buckets + nodes[cur].bucket;
+				ehht_cuckoo_set(to, free_slot,
+						bucket->entry[slot]);
+				to = bucket;
+				free_slot = slot;
+				slot = nodes[cur].parent_slot;
+				cur = nodes[cur].parent;
+			}
+			ehht_cuckoo_set(to, free_slot, entry);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int ehht_cuckoo_place_or_stash(struct ehht_cuckoo_table *table,
+				      struct ehht_cuckoo_entry *entry)
+{
+	if (ehht_cuckoo_place(table, entry) == 0) {
+		return 0;
+	}
+	if (table->stash_len < EHHT_CUCKOO_STASH_LEN) {
+		table->stash[table->stash_len++] = entry;
+		return 0;
+	}
+	return 1;
+}
+
+static int ehht_cuckoo_overflow_add(struct ehht_cuckoo_table *table,
+				    struct ehht_cuckoo_entry *entry)
+{
+	struct ehht_cuckoo_entry **overflow = NULL;
+	struct eembed_allocator *ea = table->ea;
+	size_t overflow_size = 0;
+	size_t size = 0;
+	size_t i = 0;
+
+	if (table->overflow_len == table->overflow_size) {
+		overflow_size = table->overflow_size ? 2 * table->overflow_size
+		    : EHHT_CUCKOO_STASH_LEN;
+		size = sizeof(struct ehht_cuckoo_entry *) * overflow_size;
+		overflow = (struct ehht_cuckoo_entry **)ea->malloc(ea, size);
+		if (!overflow) {
+			Ehht_error_malloc(table->log, 208, size,
+					  "cuckoo overflow");
+			return 1;
+		}
+		for (i = 0; i < table->overflow_len; ++i) {
+			overflow[i] = table->overflow[i];
+		}
+		ea->free(ea, table->overflow);
+		table->overflow = overflow;
+		table->overflow_size = overflow_size;
+	}
+	table->overflow[table->overflow_len++] = entry;
+	return 0;
+}
+
+/* returns non-zero, and leaves the table unchanged, on failure */
+static int ehht_cuckoo_rehash(struct ehht_cuckoo_table *table,
+			      size_t num_buckets)
+{
+	struct ehht_cuckoo_entry *old_stash[EHHT_CUCKOO_STASH_LEN];
+	struct ehht_cuckoo_bucket *old_buckets = NULL;
+	struct ehht_cuckoo_entry *entry = NULL;
+	struct eembed_allocator *ea = table->ea;
+	void *old_mem = NULL;
+	void *mem = NULL;
+	size_t old_num_buckets = 0;
+	size_t old_stash_len = 0;
+	size_t size = 0;
+	size_t addr = 0;
+	size_t i = 0;
+	int slot = 0;
+
+	size = (sizeof(struct ehht_cuckoo_bucket) * num_buckets)
+	    + EHHT_CUCKOO_ALIGN - 1;
+	mem = ea->malloc(ea, size);
+	if (!mem) {
+		Ehht_error_malloc(table->log, 201, size, "cuckoo buckets");
+		return 1;
+	}
+	eembed_memset(mem, 0x00, size);
+
+	old_buckets = table->buckets;
+	old_mem = table->buckets_mem;
+	old_num_buckets = table->num_buckets;
+	old_stash_len = table->stash_len;
+	for (i = 0; i < old_stash_len; ++i) {
+		old_stash[i] = table->stash[i];
+	}
+
+	addr = ((size_t)mem) + EHHT_CUCKOO_ALIGN - 1;
+	addr -= addr % EHHT_CUCKOO_ALIGN;
+	table->buckets_mem = mem;
+	table->buckets = (struct ehht_cuckoo_bucket *)addr;
+	table->num_buckets = num_buckets;
+	table->stash_len = 0;
+
+	for (i = 0; i < old_num_buckets; ++i) {
+		for (slot = 0; slot < EHHT_CUCKOO_SLOTS; ++slot) {
+			entry = old_buckets[i].entry[slot];
+			if (entry && ehht_cuckoo_place_or_stash(table, entry)) {
+				goto ehht_cuckoo_rehash_fail;
+			}
+		}
+	}
+	for (i = 0; i < old_stash_len; ++i) {
+		if (ehht_cuckoo_place_or_stash(table, old_stash[i])) {
+			goto ehht_cuckoo_rehash_fail;
+		}
+	}
+	ea->free(ea, old_mem);
+	return 0;
+
+ehht_cuckoo_rehash_fail:
+	table->buckets = old_buckets;
+	table->buckets_mem = old_mem;
+	table->num_buckets = old_num_buckets;
+	table->stash_len = old_stash_len;
+	for (i = 0; i < old_stash_len; ++i) {
+		table->stash[i] = old_stash[i];
+	}
+	ea->free(ea, mem);
+	return 1;
+}
+
+/* after a remove, a stashed entry may fit in its buckets again */
+static void ehht_cuckoo_unstash(struct ehht_cuckoo_table *table)
+{
+	size_t i = 0;
+
+	while (i < table->stash_len) {
+		if (ehht_cuckoo_place(table, table->stash[i]) == 0) {
+			table->stash[i] = table->stash[--(table->stash_len)];
+		} else {
+			++i;
+		}
+	}
+}
+
+static void *ehht_cuckoo_get(struct ehht *ht, const char *key, size_t key_len)
+{
+	struct ehht_cuckoo_table *table = NULL;
+	struct ehht_cuckoo_entry **found = NULL;
+	unsigned int hashcode = 0;
+
+	table = ehht_cuckoo_get_table(ht);
+	hashcode = table->hash_func(key, key_len);
+	found = ehht_cuckoo_find(table, key, key_len, hashcode);
+	return found ? (*found)->val : NULL;
+}
+
+static int ehht_cuckoo_has_key(struct ehht *ht, const char *key,
+			       size_t key_len)
+{
+	struct ehht_cuckoo_table *table = NULL;
+	unsigned int hashcode = 0;
+
+	table = ehht_cuckoo_get_table(ht);
+	hashcode = table->hash_func(key, key_len);
+	return ehht_cuckoo_find(table, key, key_len, hashcode) ? 1 : 0;
+}
+
+static void *ehht_cuckoo_put(struct ehht *ht, const char *key, size_t key_len,
+			     void *val, int *err)
+{
+	struct ehht_cuckoo_table *table = NULL;
+	struct ehht_cuckoo_entry **found = NULL;
+	struct ehht_cuckoo_entry *entry = NULL;
+	struct eembed_allocator *ea = NULL;
+	unsigned int hashcode = 0;
+	void *old_val = NULL;
+	char *key_copy = NULL;
+	size_t size = 0;
+	size_t num_buckets = 0;
+	size_t grown = 0;
+
+	table = ehht_cuckoo_get_table(ht);
+	ea = table->ea;
+	num_buckets = table->num_buckets;
+	hashcode = table->hash_func(key, key_len);
+	found = ehht_cuckoo_find(table, key, key_len, hashcode);
+	if (found) {
+		old_val = (*found)->val;
+		(*found)->val = val;
+		return old_val;
+	}
+
+	size = sizeof(struct ehht_cuckoo_entry) + key_len + 1;
+	entry = (struct ehht_cuckoo_entry *)ea->malloc(ea, size);
+	if (!entry) {
+		Ehht_error_malloc(table->log, 202, size, "cuckoo entry");
+		if (err) {
+			*err = 1;
+		}
+		return NULL;
+	}
+	key_copy = ((char *)entry) + sizeof(struct ehht_cuckoo_entry);
+	eembed_memcpy(key_copy, key, key_len);
+	key_copy[key_len] = '\0';
+	entry->key.str = key_copy;
+	entry->key.len = key_len;
+	entry->key.hashcode = hashcode;
+	entry->val = val;
+
+	/* a full table doubles, up to twice; below half full, there is no
+	   room only because many keys share buckets, e.g.: have one
+	   hashcode, and those will never fit, however large the table */
+	grown = table->num_buckets;
+	while (ehht_cuckoo_place_or_stash(table, entry)) {
+		grown *= 2;
+		if ((2 * table->size) < (table->num_buckets * EHHT_CUCKOO_SLOTS)
+		    || grown > (4 * num_buckets)
+		    || ehht_cuckoo_rehash(table, grown)) {
+			if (ehht_cuckoo_overflow_add(table, entry)) {
+				ea->free(ea, entry);
+				if (err) {
+					*err = 1;
+				}
+				return NULL;
+			}
+			break;
+		}
+	}
+	++(table->size);
+	return NULL;
+}
+
+static void *ehht_cuckoo_remove(struct ehht *ht, const char *key,
+				size_t key_len)
+{
+	struct ehht_cuckoo_table *table = NULL;
+	struct ehht_cuckoo_entry **found = NULL;
+	struct ehht_cuckoo_entry *entry = NULL;
+	struct ehht_cuckoo_bucket *bucket = NULL;
+	unsigned int hashcode = 0;
+	void *old_val = NULL;
+	size_t i = 0;
+	int slot = 0;
+
+	table = ehht_cuckoo_get_table(ht);
+	hashcode = table->hash_func(key, key_len);
+	found = ehht_cuckoo_find(table, key, key_len, hashcode);
+	if (!found) {
+		return NULL;
+	}
+	entry = *found;
+	old_val = entry->val;
+
+	if (found >= table->stash && found < table->stash + table->stash_len) {
+		i = (size_t)(found - table->stash);
+		table->stash[i] = table->stash[--(table->stash_len)];
+	} else if (table->overflow_len && found >= table->overflow
+		   && found < table->overflow + table->overflow_len) {
+		i = (size_t)(found - table->overflow);
+		table->overflow[i] = table->overflow[--(table->overflow_len)];
+	} else {
+		bucket = table->buckets
+		    + ehht_cuckoo_bucket1(table, hashcode);
+		for (slot = 0; slot < EHHT_CUCKOO_SLOTS; ++slot) {
+			if (bucket->entry[slot] == entry) {
+				break;
+			}
+		}
+		if (slot == EHHT_CUCKOO_SLOTS) {
+			bucket = table->buckets
+			    + ehht_cuckoo_bucket2(table, hashcode);
+			for (slot = 0; slot < EHHT_CUCKOO_SLOTS; ++slot) {
+				if (bucket->entry[slot] == entry) {
+					break;
+				}
+			}
+		}
+		eembed_assert(slot < EHHT_CUCKOO_SLOTS);
+		ehht_cuckoo_set(bucket, slot, NULL);
+		if (table->stash_len) {
+			ehht_cuckoo_unstash(table);
+		}
+	}
+	--(table->size);
+	table->ea->free(table->ea, entry);
+	return old_val;
+}
+
+static size_t ehht_cuckoo_size(struct ehht *ht)
+{
+	return ehht_cuckoo_get_table(ht)->size;
+}
+
+static void ehht_cuckoo_clear(struct ehht *ht)
+{
+	struct ehht_cuckoo_table *table = NULL;
+	struct ehht_cuckoo_bucket *bucket = NULL;
+	struct eembed_allocator *ea = NULL;
+	size_t i = 0;
+	int slot = 0;
+
+	table = ehht_cuckoo_get_table(ht);
+	ea = table->ea;
+	for (i = 0; i < table->num_buckets; ++i) {
+		bucket = table->buckets + i;
+		for (slot = 0; slot < EHHT_CUCKOO_SLOTS; ++slot) {
+			if (bucket->entry[slot]) {
+				ea->free(ea, bucket->entry[slot]);
+				ehht_cuckoo_set(bucket, slot, NULL);
+			}
+		}
+	}
+	for (i = 0; i < table->stash_len; ++i) {
+		ea->free(ea, table->stash[i]);
+	}
+	table->stash_len = 0;
+	for (i = 0; i < table->overflow_len; ++i) {
+		ea->free(ea, table->overflow[i]);
+	}
+	table->overflow_len = 0;
+	table->size = 0;
+}
+
+static int ehht_cuckoo_for_each(struct ehht *ht, ehht_iterator_func func,
+				void *context)
+{
+	struct ehht_cuckoo_table *table = NULL;
+	struct ehht_cuckoo_entry *entry = NULL;
+	size_t i = 0;
+	int slot = 0;
+	int end = 0;
+
+	table = ehht_cuckoo_get_table(ht);
+	for (i = 0; i < table->num_buckets && !end; ++i) {
+		for (slot = 0; slot < EHHT_CUCKOO_SLOTS && !end; ++slot) {
+			entry = table->buckets[i].entry[slot];
+			if (entry) {
+				end = (*func) (entry->key, entry->val, context);
+			}
+		}
+	}
+	for (i = 0; i < table->stash_len && !end; ++i) {
+		entry = table->stash[i];
+		end = (*func) (entry->key, entry->val, context);
+	}
+	for (i = 0; i < table->overflow_len && !end; ++i) {
+		entry = table->overflow[i];
+		end = (*func) (entry->key, entry->val, context);
+	}
+	return end;
+}
+
+static void ehht_cuckoo_destroy(struct ehht *ht)
+{
+	struct ehht_cuckoo_table *table = NULL;
+	struct eembed_allocator *ea = NULL;
+
+	table = ehht_cuckoo_get_table(ht);
+	ea = table->ea;
+
+	ehht_cuckoo_clear(ht);
+
+	ea->free(ea, table->overflow);
+	ea->free(ea, table->buckets_mem);
+	ea->free(ea, table);
+	ea->free(ea, ht);
+}
+
+struct ehht *ehht_new_cuckoo(size_t capacity, ehht_hash_func hash_func,
+			     struct eembed_allocator *ea,
+			     struct eembed_log *log)
+{
+	struct ehht *ht = NULL;
+	struct ehht_cuckoo_table *table = NULL;
+	size_t num_buckets = 2;
+	size_t size = 0;
+
+	while ((num_buckets * EHHT_CUCKOO_SLOTS) < capacity) {
+		num_buckets *= 2;
+	}
+	if (hash_func == NULL) {
+		hash_func = ehht_kr2_hashcode;
+	}
+	if (ea == NULL) {
+		ea = eembed_global_allocator;
+	}
+	if (log == NULL) {
+		log = eembed_err_log;
+	}
+
+	size = sizeof(struct ehht);
+	ht = (struct ehht *)ea->malloc(ea, size);
+	if (ht == NULL) {
+		Ehht_error_malloc(log, 206, size, "struct ehht");
+		return NULL;
+	}
+	eembed_memset(ht, 0x00, size);
+
+	ht->get = ehht_cuckoo_get;
+	ht->put = ehht_cuckoo_put;
+	ht->remove = ehht_cuckoo_remove;
+	ht->size = ehht_cuckoo_size;
+	ht->clear = ehht_cuckoo_clear;
+	ht->for_each = ehht_cuckoo_for_each;
+	ht->has_key = ehht_cuckoo_has_key;
+	ht->keys = ehht_each_keys;
+	ht->free_keys = ehht_each_free_keys;
+	ht->to_string = ehht_each_to_string;
+	ht->destroy = ehht_cuckoo_destroy;
+
+	size = sizeof(struct ehht_cuckoo_table);
+	table = (struct ehht_cuckoo_table *)ea->malloc(ea, size);
+	if (table == NULL) {
+		Ehht_error_malloc(log, 207, size, "cuckoo table");
+		ea->free(ea, ht);
+		return NULL;
+	}
+	eembed_memset(table, 0x00, size);
+	table->hash_func = hash_func;
+	table->ea = ea;
+	table->log = log;
+	ht->data = table;
+
+	if (ehht_cuckoo_rehash(table, num_buckets)) {
+		ea->free(ea, table);
+		ea->free(ea, ht);
+		return NULL;
+	}
+	return ht;
+}
@@ -0,0 +1,312 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-define.h: macro-generated type-specialized hashtables */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef EHHT_DEFINE_H
+#define EHHT_DEFINE_H
+
+/* EHHT_DEFINE(name, key_t, val_t, hash_fn, eq_fn) emits a "struct name"
+   and "static __inline__" functions prefixed with "name_", specialized
+   to the key and value types. Because there are no function pointers,
+   the compiler can inline the table functions, the hash_fn, and the
+   eq_fn into the caller.
+
+	hash_fn(key)	a function or macro returning an unsigned integer
+	eq_fn(a, b)	a function or macro, non-zero if the keys are equal
+
+   Keys and values are stored by value in the element: if key_t is a
+   pointer, the pointed-to key must outlive its entry, as with
+   ehht_trust_keys_immutable. Otherwise the behavior matches
+   "struct ehht": chained buckets which resize when a put collides above
+   the load factor, and are not thread-safe.
+
+   For example:
+
+	EHHT_DEFINE(id_map, uint64_t, struct user *, ehht_mix64, Id_eq)
+
+	struct id_map users;
+	struct user *old = NULL;
+	struct user **found = NULL;
+	int err = 0;
+
+	id_map_init(&users, 0, NULL, NULL);
+	id_map_put(&users, user->id, user, &old, &err);
+	found = id_map_get(&users, user->id);
+	id_map_destroy(&users);
+*/
+
+#include "eembed.h"
+
+#ifndef EHHT_DEFINE_DEFAULT_BUCKETS
+#define EHHT_DEFINE_DEFAULT_BUCKETS 64
+#endif
+
+#ifndef EHHT_DEFINE_DEFAULT_RESIZE_LOADFACTOR
+#define EHHT_DEFINE_DEFAULT_RESIZE_LOADFACTOR (2.0/3.0)
+#endif
+
+static __inline__ void ehht_define_error_malloc(struct eembed_log *log,
+						const char *file,
+						unsigned long line,
+						size_t bytes, const char *thing)
+{
+	if (log) {
+		log->append_s(log, file);
+		log->append_s(log, ":");
+		log->append_ul(log, line);
+		log->append_s(log, " Ehht Error: could not allocate ");
+		log->append_ul(log, bytes);
+		log->append_s(log, " bytes (");
+		log->append_s(log, thing);
+		log->append_s(log, ")");
+		log->append_eol(log);
+	}
+}
+
+/* may be defined before including this file, to report the failures
+   some other way */
+#ifndef Ehht_define_error_malloc
+#define Ehht_define_error_malloc(log, bytes, thing) \
+	ehht_define_error_malloc(log, __FILE__, __LINE__, bytes, thing)
+#endif
+
+#define EHHT_DEFINE(name, key_t, val_t, hash_fn, eq_fn) \
+ \
+struct name ## _element { \
+	key_t key; \
+	val_t val; \
+	struct name ## _element *next; \
+}; \
+ \
+struct name { \
+	size_t num_buckets; \
+	struct name ## _element **buckets; \
+	size_t size; \
+	struct eembed_allocator *ea; \
+	struct eembed_log *log; \
+	double collision_load_factor; \
+}; \
+ \
+static __inline__ size_t name ## _bucket_for_key(key_t key, \
+						  size_t num_buckets) \
+{ \
+	return (size_t)((hash_fn(key)) % num_buckets); \
+} \
+ \
+/* returns non-zero if the buckets could not be allocated */ \
+static __inline__ int name ## _init(struct name *table, size_t num_buckets, \
+				    struct eembed_allocator *ea, \
+				    struct eembed_log *log) \
+{ \
+	size_t size = 0; \
+ \
+	eembed_memset(table, 0x00, sizeof(struct name)); \
+	table->ea = ea ? ea : eembed_global_allocator; \
+	table->log = log ? log : eembed_err_log; \
+	table->collision_load_factor = EHHT_DEFINE_DEFAULT_RESIZE_LOADFACTOR; \
+	table->num_buckets = \
+	    num_buckets ? num_buckets : EHHT_DEFINE_DEFAULT_BUCKETS; \
+ \
+	size = sizeof(struct name ## _element *) * table->num_buckets; \
+	table->buckets = (struct name ## _element **) \
+	    table->ea->malloc(table->ea, size); \
+	if (table->buckets == NULL) { \
+		Ehht_define_error_malloc(table->log, size, "buckets"); \
+		table->num_buckets = 0; \
+		return 1; \
+	} \
+	eembed_memset(table->buckets, 0x00, size); \
+	return 0; \
+} \
+ \
+/* a load factor of 0.0 disables auto-resize */ \
+static __inline__ void name ## _auto_resize_load_factor(struct name *table, \
+							  double factor) \
+{ \
+	table->collision_load_factor = factor; \
+} \
+ \
+/* returns a pointer to the stored value, or NULL */ \
+static __inline__ val_t *name ## _get(struct name *table, key_t key) \
+{ \
+	struct name ## _element *element = NULL; \
+	size_t bucket_num = 0; \
+ \
+	bucket_num = name ## _bucket_for_key(key, table->num_buckets); \
+	for (element = table->buckets[bucket_num]; element != NULL; \
+	     element = element->next) { \
+		if (eq_fn(element->key, key)) { \
+			return &(element->val); \
+		} \
+	} \
+	return NULL; \
+} \
+ \
+static __inline__ int name ## _has_key(struct name *table, key_t key) \
+{ \
+	return name ## _get(table, key) ? 1 : 0; \
+} \
+ \
+/* returns the new number of buckets, or the old if allocation fails */ \
+static __inline__ size_t name ## _resize(struct name *table, \
+					 size_t num_buckets) \
+{ \
+	struct name ## _element **new_buckets = NULL; \
+	struct name ## _element *element = NULL; \
+	size_t new_bucket_num = 0; \
+	size_t size = 0; \
+	size_t i = 0; \
+ \
+	size = sizeof(struct name ## _element *) * num_buckets; \
+	new_buckets = (struct name ## _element **) \
+	    table->ea->malloc(table->ea, size); \
+	if (new_buckets == NULL) { \
+		Ehht_define_error_malloc(table->log, size, "buckets"); \
+		return table->num_buckets; \
+	} \
+	eembed_memset(new_buckets, 0x00, size); \
+ \
+	for (i = 0; i < table->num_buckets; ++i) { \
+		while ((element = table->buckets[i]) != NULL) { \
+			table->buckets[i] = element->next; \
+			new_bucket_num = \
+			    name ## _bucket_for_key(element->key, \
+						    num_buckets); \
+			element->next = new_buckets[new_bucket_num]; \
+			new_buckets[new_bucket_num] = element; \
+		} \
+	} \
+	table->ea->free(table->ea, table->buckets); \
+	table->buckets = new_buckets; \
+	table->num_buckets = num_buckets; \
+	return num_buckets; \
+} \
+ \
+/* returns 1 if the key was present, and the previous value is written \
+ * to *old_val if old_val is not NULL; if memory allocation fails, and \
+ * the *err in not NULL, *err will be populated with a non-zero value */ \
+static __inline__ int name ## _put(struct name *table, key_t key, \
+				   val_t val, val_t *old_val, int *err) \
+{ \
+	struct name ## _element *element = NULL; \
+	size_t bucket_num = 0; \
+	size_t size = 0; \
+ \
+	bucket_num = name ## _bucket_for_key(key, table->num_buckets); \
+	for (element = table->buckets[bucket_num]; element != NULL; \
+	     element = element->next) { \
+		if (eq_fn(element->key, key)) { \
+			if (old_val) { \
+				*old_val = element->val; \
+			} \
+			element->val = val; \
+			return 1; \
+		} \
+	} \
+ \
+	if (table->buckets[bucket_num] != NULL \
+	    && table->collision_load_factor > 0.0 \
+	    && table->size >= \
+	    (table->num_buckets * table->collision_load_factor)) { \
+		name ## _resize(table, table->num_buckets * 2); \
+		bucket_num = name ## _bucket_for_key(key, table->num_buckets); \
+	} \
+ \
+	size = sizeof(struct name ## _element); \
+	element = (struct name ## _element *) \
+	    table->ea->malloc(table->ea, size); \
+	if (element == NULL) { \
+		Ehht_define_error_malloc(table->log, size, "element"); \
+		if (err) { \
+			*err = 1; \
+		} \
+		return 0; \
+	} \
+	element->key = key; \
+	element->val = val; \
+	element->next = table->buckets[bucket_num]; \
+	table->buckets[bucket_num] = element; \
+	++(table->size); \
+	return 0; \
+} \
+ \
+/* returns 1 if the key was present, and the previous value is written \
+ * to *old_val if old_val is not NULL */ \
+static __inline__ int name ## _remove(struct name *table, key_t key, \
+				      val_t *old_val) \
+{ \
+	struct name ## _element *element = NULL; \
+	struct name ## _element **ptr_to_element = NULL; \
+	size_t bucket_num = 0; \
+ \
+	bucket_num = name ## _bucket_for_key(key, table->num_buckets); \
+	ptr_to_element = &(table->buckets[bucket_num]); \
+	while ((element = *ptr_to_element) != NULL) { \
+		if (eq_fn(element->key, key)) { \
+			*ptr_to_element = element->next; \
+			if (old_val) { \
+				*old_val = element->val; \
+			} \
+			table->ea->free(table->ea, element); \
+			--(table->size); \
+			return 1; \
+		} \
+		ptr_to_element = &(element->next); \
+	} \
+	return 0; \
+} \
+ \
+static __inline__ size_t name ## _size(struct name *table) \
+{ \
+	return table->size; \
+} \
+ \
+static __inline__ void name ## _clear(struct name *table) \
+{ \
+	struct name ## _element *element = NULL; \
+	size_t i = 0; \
+ \
+	for (i = 0; i < table->num_buckets; ++i) { \
+		while ((element = table->buckets[i]) != NULL) { \
+			table->buckets[i] = element->next; \
+			table->ea->free(table->ea, element); \
+		} \
+	} \
+	table->size = 0; \
+} \
+ \
+/* if func returns non-zero, iteration stops and that value is returned */ \
+static __inline__ int name ## _for_each(struct name *table, \
+					int (*func)(key_t each_key, \
+						    val_t *each_val, \
+						    void *context), \
+					void *context) \
+{ \
+	struct name ## _element *element = NULL; \
+	size_t i = 0; \
+	int end = 0; \
+ \
+	for (i = 0; i < table->num_buckets && !end; ++i) { \
+		for (element = table->buckets[i]; element != NULL && !end; \
+		     element = element->next) { \
+			end = (*func) (element->key, &(element->val), \
+				       context); \
+		} \
+	} \
+	return end; \
+} \
+ \
+static __inline__ void name ## _destroy(struct name *table) \
+{ \
+	if (table->buckets) { \
+		name ## _clear(table); \
+		table->ea->free(table->ea, table->buckets); \
+		table->buckets = NULL; \
+	} \
+	table->num_buckets = 0; \
+} \
+ \
+struct name ## _semicolon_swallower
+
+#endif /* EHHT_DEFINE_H */
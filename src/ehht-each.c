@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-each.c: "struct ehht" methods built on for_each */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "ehht-each.h"
+#include "ehht-error.h"
+#include "eembed.h"
+
+static struct ehht_each_table *ehht_each_get_table(struct ehht *ht)
+{
+	eembed_assert(ht);
+	eembed_assert(ht->data);
+	return (struct ehht_each_table *)ht->data;
+}
+
+/* The keys are a single allocation: the struct ehht_keys, the array of
+   struct ehht_key, and, if the keys are copied, the bytes of each key
+   and its NUL, packed. As both structs hold pointers, the array needs
+   no padding after the struct ehht_keys. */
+struct ehht_each_keys_context {
+	struct ehht_keys *keys;
+	size_t capacity;
+	char *bytes;
+	size_t bytes_len;
+};
+
+static int ehht_each_sum_key_bytes(struct ehht_key key, void *each_val,
+				   void *context)
+{
+	(void)each_val;
+	*((size_t *)context) += key.len + 1;
+	return 0;
+}
+
+static int ehht_each_fill_keys(struct ehht_key key, void *each_val,
+			       void *context)
+{
+	struct ehht_each_keys_context *fe_ctx = NULL;
+	struct ehht_key *out = NULL;
+
+	(void)each_val;
+	fe_ctx = (struct ehht_each_keys_context *)context;
+
+	eembed_assert(fe_ctx->keys->len < fe_ctx->capacity);
+	if (fe_ctx->keys->len >= fe_ctx->capacity) {
+		return 1;
+	}
+	out = fe_ctx->keys->keys + fe_ctx->keys->len;
+	*out = key;
+	if (fe_ctx->bytes) {
+		eembed_assert(key.len < fe_ctx->bytes_len);
+		if (key.len >= fe_ctx->bytes_len) {
+			return 1;
+		}
+		eembed_memcpy(fe_ctx->bytes, key.str, key.len);
+		fe_ctx->bytes[key.len] = '\0';
+		out->str = fe_ctx->bytes;
+		fe_ctx->bytes += key.len + 1;
+		fe_ctx->bytes_len -= key.len + 1;
+	}
+	++(fe_ctx->keys->len);
+
+	return 0;
+}
+
+void ehht_each_free_keys(struct ehht *ht, struct ehht_keys *keys)
+{
+	struct ehht_each_table *table = NULL;
+	struct eembed_allocator *ea = NULL;
+
+	table = ehht_each_get_table(ht);
+	ea = table->ea;
+	ea->free(ea, keys);
+}
+
+struct ehht_keys *ehht_each_keys(struct ehht *ht, int copy_keys)
+{
+	struct ehht_each_table *table = NULL;
+	struct eembed_allocator *ea = NULL;
+	struct ehht_each_keys_context fe_ctx = { NULL, 0, NULL, 0 };
+	size_t len = 0;
+	size_t size = 0;
+
+	table = ehht_each_get_table(ht);
+	ea = table->ea;
+
+	len = ht->size(ht);
+	if (copy_keys) {
+		ht->for_each(ht, ehht_each_sum_key_bytes, &fe_ctx.bytes_len);
+	}
+	size = sizeof(struct ehht_keys) + (sizeof(struct ehht_key) * len)
+	    + fe_ctx.bytes_len;
+	fe_ctx.keys = (struct ehht_keys *)ea->malloc(ea, size);
+	if (!fe_ctx.keys) {
+		Ehht_error_malloc(table->log, 601, size, "struct ehht_keys");
+		return NULL;
+	}
+	fe_ctx.keys->keys = NULL;
+	fe_ctx.keys->len = 0;
+	fe_ctx.keys->keys_copied = copy_keys;
+	if (len == 0) {
+		return fe_ctx.keys;
+	}
+
+	fe_ctx.keys->keys = (struct ehht_key *)(fe_ctx.keys + 1);
+	fe_ctx.capacity = len;
+	if (copy_keys) {
+		fe_ctx.bytes = (char *)(fe_ctx.keys->keys + len);
+	}
+	if (ht->for_each(ht, ehht_each_fill_keys, &fe_ctx)) {
+		ea->free(ea, fe_ctx.keys);
+		Ehht_error(table->log, 602, "ehht_keys failed");
+		return NULL;
+	}
+
+	return fe_ctx.keys;
+}
+
+static int ehht_each_to_string_each(struct ehht_key key, void *each_val,
+				    void *context)
+{
+	struct eembed_log *slog = (struct eembed_log *)context;
+
+	slog->append_s(slog, "'");
+	slog->append_s(slog, key.len ? key.str : "");
+	slog->append_s(slog, "' => ");
+	slog->append_vp(slog, each_val);
+	slog->append_s(slog, ", ");
+
+	return 0;
+}
+
+size_t ehht_each_to_string(struct ehht *ht, char *buf, size_t buf_len)
+{
+	struct eembed_str_buf str_buf = { NULL, 0 };
+	struct eembed_log log =
+	    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	struct eembed_log *slog = NULL;
+
+	slog = eembed_char_buf_log_init(&log, &str_buf, buf, buf_len);
+	if (!slog) {
+		return 0;
+	}
+
+	slog->append_s(slog, "{ ");
+	ht->for_each(ht, ehht_each_to_string_each, slog);
+	slog->append_s(slog, "}");
+
+	return eembed_strnlen(buf, buf_len);
+}
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-each.h: "struct ehht" methods built on for_each */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef EHHT_EACH_H
+#define EHHT_EACH_H
+
+/* not installed, for the source files of libehht only */
+
+#include "ehht.h"
+
+/* The "data" of a table which uses these methods must begin with the
+   members of this struct, in this order; the keys are allocated from,
+   and errors logged to, these. */
+struct ehht_each_table {
+	struct eembed_allocator *ea;
+	struct eembed_log *log;
+};
+
+struct ehht_keys *ehht_each_keys(struct ehht *table, int copy_keys);
+
+void ehht_each_free_keys(struct ehht *table, struct ehht_keys *keys);
+
+size_t ehht_each_to_string(struct ehht *table, char *buf, size_t buf_len);
+
+#endif /* EHHT_EACH_H */
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-error.h: error logging and tracepoints shared inside libehht */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef EHHT_ERROR_H
+#define EHHT_ERROR_H
+
+/* not installed, for the source files of libehht only */
+
+/*
+ * Each source file has its own range of error numbers:
+ *	ehht.c		1 - 99
+ *	ehht-fixed.c	100 - 199
+ *	ehht-cuckoo.c	200 - 299
+ *	ehht-compact.c	300 - 399
+ *	ehht-spill.c	400 - 499
+ *	ehht-reclaim.c	500 - 599
+ *	ehht-each.c	600 - 699
+ */
+
+/* configure defines EHHT_USDT; other builds get the probes if the
+   compiler can tell that sys/sdt.h is there */
+#ifndef EHHT_USDT
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define EHHT_USDT 1
+#endif
+#endif
+#endif
+#ifndef EHHT_USDT
+#define EHHT_USDT 0
+#endif
+
+/* static tracepoints for bpftrace, systemtap, perf: "usdt:*:ehht:*" */
+#if EHHT_USDT
+#include <sys/sdt.h>
+#define Ehht_probe3(name, a, b, c) DTRACE_PROBE3(ehht, name, a, b, c)
+#define Ehht_probe4(name, a, b, c, d) DTRACE_PROBE4(ehht, name, a, b, c, d)
+#else
+#define Ehht_probe3(name, a, b, c) do { } while (0)
+#define Ehht_probe4(name, a, b, c, d) do { } while (0)
+#endif
+
+#define Ehht_error_malloc(log, err_num, bytes, thing) \
+	do { Ehht_probe3(malloc__fail, err_num, bytes, thing); \
+	if (log) { \
+		log->append_s(log, __FILE__); \
+		log->append_s(log, ":"); \
+		log->append_ul(log, __LINE__); \
+		log->append_s(log, " Ehht Error "); \
+		log->append_l(log, err_num); \
+		log->append_s(log, ": could not allocate "); \
+		log->append_ul(log, bytes); \
+		log->append_s(log, " bytes ("); \
+		log->append_s(log, thing); \
+		log->append_s(log, ")"); \
+		log->append_eol(log); \
+	} } while (0)
+
+#define Ehht_error(log, err_num, msg) \
+	do { if (log) { \
+		log->append_s(log, __FILE__); \
+		log->append_s(log, ":"); \
+		log->append_ul(log, __LINE__); \
+		log->append_s(log, " Error "); \
+		log->append_l(log, err_num); \
+		log->append_s(log, ": "); \
+		log->append_s(log, msg); \
+		log->append_eol(log); \
+	} } while (0)
+
+#endif /* EHHT_ERROR_H */
@@ -0,0 +1,201 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-fixed-template.h: fixed-width key hashtable implementation */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+/* This file is included by ehht-fixed.c once per key type, with these
+   defined:
+	Ehht_fixed(name)	prefixes name, e.g.: ehht_u64_ ## name
+	Ehht_fixed_t		the public struct name, e.g.: ehht_u64
+	Ehht_fixed_key_t	the key type, e.g.: uint64_t
+	Ehht_fixed_keys_t	the get_many keys type, e.g.: const uint64_t *
+	Ehht_fixed_hash(key)	returns a well mixed uint64_t
+	Ehht_fixed_eq(a, b)	non-zero if the keys are equal
+
+   The table is an EHHT_DEFINE table, "struct Ehht_fixed(map)", and
+   these are the function pointer wrappers of its functions.
+*/
+
+Ehht_fixed_define(Ehht_fixed(map), Ehht_fixed_key_t, void *, Ehht_fixed_hash,
+		  Ehht_fixed_eq);
+
+static struct Ehht_fixed(map) *Ehht_fixed(get_map) (struct Ehht_fixed_t *ht)
+{
+	eembed_assert(ht);
+	eembed_assert(ht->data);
+	return (struct Ehht_fixed(map) *)ht->data;
+}
+
+static void *Ehht_fixed(get) (struct Ehht_fixed_t *ht, Ehht_fixed_key_t key)
+{
+	void **val = NULL;
+
+	val = Ehht_fixed(map_get) (Ehht_fixed(get_map) (ht), key);
+	return (val == NULL) ? NULL : *val;
+}
+
+static int Ehht_fixed(has_key) (struct Ehht_fixed_t *ht, Ehht_fixed_key_t key)
+{
+	return Ehht_fixed(map_has_key) (Ehht_fixed(get_map) (ht), key);
+}
+
+static void *Ehht_fixed(put) (struct Ehht_fixed_t *ht, Ehht_fixed_key_t key,
+			      void *val, int *err)
+{
+	void *old_val = NULL;
+
+	Ehht_fixed(map_put) (Ehht_fixed(get_map) (ht), key, val, &old_val,
+			     err);
+	return old_val;
+}
+
+static void *Ehht_fixed(remove) (struct Ehht_fixed_t *ht, Ehht_fixed_key_t key)
+{
+	void *old_val = NULL;
+
+	Ehht_fixed(map_remove) (Ehht_fixed(get_map) (ht), key, &old_val);
+	return old_val;
+}
+
+static size_t Ehht_fixed(size) (struct Ehht_fixed_t *ht)
+{
+	return Ehht_fixed(map_size) (Ehht_fixed(get_map) (ht));
+}
+
+static void Ehht_fixed(clear) (struct Ehht_fixed_t *ht)
+{
+	Ehht_fixed(map_clear) (Ehht_fixed(get_map) (ht));
+}
+
+struct Ehht_fixed(for_each_context) {
+	int (*func)(Ehht_fixed_key_t each_key, void *each_val, void *context);
+	void *context;
+};
+
+static int Ehht_fixed(for_each_val) (Ehht_fixed_key_t each_key,
+				     void **each_val, void *context)
+{
+	struct Ehht_fixed(for_each_context) *ctx = NULL;
+
+	ctx = (struct Ehht_fixed(for_each_context) *)context;
+	return (*ctx->func) (each_key, *each_val, ctx->context);
+}
+
+static int Ehht_fixed(for_each) (struct Ehht_fixed_t *ht,
+				 int (*func)(Ehht_fixed_key_t each_key,
+					     void *each_val, void *context),
+				 void *context)
+{
+	struct Ehht_fixed(for_each_context) ctx;
+
+	ctx.func = func;
+	ctx.context = context;
+	return Ehht_fixed(map_for_each) (Ehht_fixed(get_map) (ht),
+					 Ehht_fixed(for_each_val), &ctx);
+}
+
+static size_t Ehht_fixed(get_many) (struct Ehht_fixed_t *ht,
+				    Ehht_fixed_keys_t keys, size_t keys_len,
+				    void **vals)
+{
+	struct Ehht_fixed(map) *table = NULL;
+	struct Ehht_fixed(map_element) *heads[EHHT_FIXED_GET_MANY_BATCH];
+	struct Ehht_fixed(map_element) *element = NULL;
+	size_t batch = 0;
+	size_t found = 0;
+	size_t i = 0;
+	size_t j = 0;
+
+	table = Ehht_fixed(get_map) (ht);
+	for (i = 0; i < keys_len; i += batch) {
+		batch = keys_len - i;
+		if (batch > EHHT_FIXED_GET_MANY_BATCH) {
+			batch = EHHT_FIXED_GET_MANY_BATCH;
+		}
+		/* first load the bucket heads, and start fetching the
+		   elements, then walk the chains */
+		for (j = 0; j < batch; ++j) {
+			heads[j] = table->buckets[Ehht_fixed(map_bucket_for_key)
+						  (keys[i + j],
+						   table->num_buckets)];
+			Ehht_fixed_prefetch(heads[j]);
+		}
+		for (j = 0; j < batch; ++j) {
+			vals[i + j] = NULL;
+			for (element = heads[j]; element != NULL;
+			     element = element->next) {
+				if (Ehht_fixed_eq(element->key, keys[i + j])) {
+					vals[i + j] = element->val;
+					++found;
+					break;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+struct Ehht_fixed_t *Ehht_fixed(new) (size_t num_buckets,
+				      struct eembed_allocator *ea,
+				      struct eembed_log *log)
+{
+	struct Ehht_fixed_t *ht = NULL;
+	struct Ehht_fixed(map) *table = NULL;
+	size_t size = 0;
+
+	if (ea == NULL) {
+		ea = eembed_global_allocator;
+	}
+	if (log == NULL) {
+		log = eembed_err_log;
+	}
+
+	size = sizeof(struct Ehht_fixed_t);
+	ht = (struct Ehht_fixed_t *)ea->malloc(ea, size);
+	if (ht == NULL) {
+		Ehht_error_malloc(log, 103, size, "struct");
+		return NULL;
+	}
+	eembed_memset(ht, 0x00, size);
+
+	ht->get = Ehht_fixed(get);
+	ht->put = Ehht_fixed(put);
+	ht->remove = Ehht_fixed(remove);
+	ht->has_key = Ehht_fixed(has_key);
+	ht->size = Ehht_fixed(size);
+	ht->clear = Ehht_fixed(clear);
+	ht->for_each = Ehht_fixed(for_each);
+	ht->get_many = Ehht_fixed(get_many);
+
+	size = sizeof(struct Ehht_fixed(map));
+	table = (struct Ehht_fixed(map) *)ea->malloc(ea, size);
+	if (table == NULL) {
+		Ehht_error_malloc(log, 104, size, "table");
+		ea->free(ea, ht);
+		return NULL;
+	}
+	if (Ehht_fixed(map_init) (table, num_buckets, ea, log)) {
+		ea->free(ea, table);
+		ea->free(ea, ht);
+		return NULL;
+	}
+	ht->data = table;
+
+	return ht;
+}
+
+void Ehht_fixed(free) (struct Ehht_fixed_t *ht)
+{
+	struct Ehht_fixed(map) *table = NULL;
+	struct eembed_allocator *ea = NULL;
+
+	if (ht == NULL) {
+		return;
+	}
+	table = Ehht_fixed(get_map) (ht);
+	ea = table->ea;
+
+	Ehht_fixed(map_destroy) (table);
+	ea->free(ea, table);
+	ea->free(ea, ht);
+}
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-fixed.c: simple OO hashtables with fixed-width keys */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht-fixed.h"
+#include "ehht-error.h"
+#include "eembed.h"
+
+#ifndef EHHT_FIXED_DEFAULT_BUCKETS
+#define EHHT_FIXED_DEFAULT_BUCKETS 64
+#endif
+
+#ifndef EHHT_FIXED_DEFAULT_RESIZE_LOADFACTOR
+#define EHHT_FIXED_DEFAULT_RESIZE_LOADFACTOR (2.0/3.0)
+#endif
+
+/* the tables are EHHT_DEFINE tables, with the libehht error logging */
+#define EHHT_DEFINE_DEFAULT_BUCKETS EHHT_FIXED_DEFAULT_BUCKETS
+#define EHHT_DEFINE_DEFAULT_RESIZE_LOADFACTOR \
+	EHHT_FIXED_DEFAULT_RESIZE_LOADFACTOR
+#define Ehht_define_error_malloc(log, bytes, thing) \
+	Ehht_error_malloc(log, 101, bytes, thing)
+#include "ehht-define.h"
+
+/* expands the arguments before EHHT_DEFINE pastes the name */
+#define Ehht_fixed_define(name, key_t, val_t, hash_fn, eq_fn) \
+	EHHT_DEFINE(name, key_t, val_t, hash_fn, eq_fn)
+
+#ifndef EHHT_FIXED_GET_MANY_BATCH
+#define EHHT_FIXED_GET_MANY_BATCH 16
+#endif
+
+#ifdef __GNUC__
+#define Ehht_fixed_prefetch(ptr) __builtin_prefetch(ptr)
+#else
+#define Ehht_fixed_prefetch(ptr) ((void)(ptr))
+#endif
+
+#define Ehht_fixed_paste(prefix, name) prefix ## name
+#define Ehht_fixed_xpaste(prefix, name) Ehht_fixed_paste(prefix, name)
+
+/* MurmurHash3 finalizers, https://github.com/aappleby/smhasher */
+uint32_t ehht_mix32(uint32_t key)
+{
+	key ^= key >> 16;
+	key *= 0x85ebca6bUL;
+	key ^= key >> 13;
+	key *= 0xc2b2ae35UL;
+	key ^= key >> 16;
+	return key;
+}
+
+uint64_t ehht_mix64(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+struct ehht_u128_key ehht_u128_key_from_bytes(const unsigned char bytes[16])
+{
+	struct ehht_u128_key key = { 0, 0 };
+	size_t i = 0;
+
+	for (i = 0; i < 8; ++i) {
+		key.hi = (key.hi << 8) | bytes[i];
+		key.lo = (key.lo << 8) | bytes[8 + i];
+	}
+	return key;
+}
+
+#define Ehht_fixed(name) Ehht_fixed_xpaste(ehht_u32_, name)
+#define Ehht_fixed_t ehht_u32
+#define Ehht_fixed_key_t uint32_t
+#define Ehht_fixed_keys_t const uint32_t *
+#define Ehht_fixed_hash(key) ((uint64_t)ehht_mix32(key))
+#define Ehht_fixed_eq(a, b) ((a) == (b))
+#include "ehht-fixed-template.h"
+#undef Ehht_fixed
+#undef Ehht_fixed_t
+#undef Ehht_fixed_key_t
+#undef Ehht_fixed_keys_t
+#undef Ehht_fixed_hash
+#undef Ehht_fixed_eq
+
+#define Ehht_fixed(name) Ehht_fixed_xpaste(ehht_u64_, name)
+#define Ehht_fixed_t ehht_u64
+#define Ehht_fixed_key_t uint64_t
+#define Ehht_fixed_keys_t const uint64_t *
+#define Ehht_fixed_hash(key) ehht_mix64(key)
+#define Ehht_fixed_eq(a, b) ((a) == (b))
+#include "ehht-fixed-template.h"
+#undef Ehht_fixed
+#undef Ehht_fixed_t
+#undef Ehht_fixed_key_t
+#undef Ehht_fixed_keys_t
+#undef Ehht_fixed_hash
+#undef Ehht_fixed_eq
+
+#define Ehht_fixed(name) Ehht_fixed_xpaste(ehht_u128_, name)
+#define Ehht_fixed_t ehht_u128
+#define Ehht_fixed_key_t struct ehht_u128_key
+#define Ehht_fixed_keys_t const struct ehht_u128_key *
+#define Ehht_fixed_hash(key) ehht_mix64((key).hi ^ ehht_mix64((key).lo))
+#define Ehht_fixed_eq(a, b) (((a).hi == (b).hi) && ((a).lo == (b).lo))
+#include "ehht-fixed-template.h"
+#undef Ehht_fixed
+#undef Ehht_fixed_t
+#undef Ehht_fixed_key_t
+#undef Ehht_fixed_keys_t
+#undef Ehht_fixed_hash
+#undef Ehht_fixed_eq
+
+#define Ehht_fixed(name) Ehht_fixed_xpaste(ehht_ptr_, name)
+#define Ehht_fixed_t ehht_ptr
+#define Ehht_fixed_key_t const void *
+#define Ehht_fixed_keys_t const void *const *
+#define Ehht_fixed_hash(key) ehht_mix64((uint64_t)(size_t)(key))
+#define Ehht_fixed_eq(a, b) ((a) == (b))
+#include "ehht-fixed-template.h"
+#undef Ehht_fixed
+#undef Ehht_fixed_t
+#undef Ehht_fixed_key_t
+#undef Ehht_fixed_keys_t
+#undef Ehht_fixed_hash
+#undef Ehht_fixed_eq
@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-fixed.h: simple OO hashtables with fixed-width keys */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef EHHT_FIXED_H
+#define EHHT_FIXED_H
+
+/* Hashtables for integer, 128-bit, and pointer keys. The key is stored
+   inline in the element rather than copied to the heap, is hashed with
+   an integer mixer rather than a byte-at-a-time hash_func, and is
+   compared with "==" rather than memcmp. Otherwise the behavior
+   matches "struct ehht": the tables are chained, resize when a put
+   collides above the load factor, and are not thread-safe. */
+
+#ifdef __cplusplus
+#define Ehht_fixed_begin_C_functions extern "C" {
+#define Ehht_fixed_end_C_functions }
+#else
+#define Ehht_fixed_begin_C_functions
+#define Ehht_fixed_end_C_functions
+#endif
+
+Ehht_fixed_begin_C_functions
+#undef Ehht_fixed_begin_C_functions
+#include <stddef.h>		/* size_t */
+#include <stdint.h>		/* uint32_t uint64_t */
+    struct eembed_log;		/* emmbed.h */
+struct eembed_allocator;	/* emmbed.h */
+
+struct ehht_u128_key {
+	uint64_t hi;
+	uint64_t lo;
+};
+
+/*****************************************************************************/
+/* uint32_t keys */
+/*****************************************************************************/
+struct ehht_u32 {
+	/* private */
+	void *data;
+
+	/* public methods */
+	void *(*get)(struct ehht_u32 *table, uint32_t key);
+
+	/* returns the previous value or NULL
+	 * if memory allocation fails, and the *err in not NULL, *err will
+	 * be populated with a non-zero value */
+	void *(*put)(struct ehht_u32 *table, uint32_t key, void *val, int *err);
+
+	/* returns the previous value or NULL */
+	void *(*remove)(struct ehht_u32 *table, uint32_t key);
+
+	int (*has_key)(struct ehht_u32 *table, uint32_t key);
+
+	size_t (*size)(struct ehht_u32 *table);
+
+	void (*clear)(struct ehht_u32 *table);
+
+	int (*for_each)(struct ehht_u32 *table,
+			int (*func)(uint32_t each_key, void *each_val,
+				    void *context), void *context);
+
+	/* looks up all of the keys before walking any chains, so that the
+	 * bucket loads overlap; vals[i] is set to the value for keys[i] or
+	 * NULL, returns the number of keys found */
+	size_t (*get_many)(struct ehht_u32 *table, const uint32_t *keys,
+			   size_t keys_len, void **vals);
+};
+
+/* if num_buckets is 0, a default is chosen */
+/* if ea is NULL, eembed_global_alloctor will be used */
+/* if log is NULL, eembed_err_log will be used */
+struct ehht_u32 *ehht_u32_new(size_t num_buckets,
+			      struct eembed_allocator *ea,
+			      struct eembed_log *log);
+
+void ehht_u32_free(struct ehht_u32 *table);
+
+/*****************************************************************************/
+/* uint64_t keys */
+/*****************************************************************************/
+struct ehht_u64 {
+	/* private */
+	void *data;
+
+	/* public methods, as ehht_u32 */
+	void *(*get)(struct ehht_u64 *table, uint64_t key);
+	void *(*put)(struct ehht_u64 *table, uint64_t key, void *val, int *err);
+	void *(*remove)(struct ehht_u64 *table, uint64_t key);
+	int (*has_key)(struct ehht_u64 *table, uint64_t key);
+	size_t (*size)(struct ehht_u64 *table);
+	void (*clear)(struct ehht_u64 *table);
+	int (*for_each)(struct ehht_u64 *table,
+			int (*func)(uint64_t each_key, void *each_val,
+				    void *context), void *context);
+	size_t (*get_many)(struct ehht_u64 *table, const uint64_t *keys,
+			   size_t keys_len, void **vals);
+};
+
+struct ehht_u64 *ehht_u64_new(size_t num_buckets,
+			      struct eembed_allocator *ea,
+			      struct eembed_log *log);
+
+void ehht_u64_free(struct ehht_u64 *table);
+
+/*****************************************************************************/
+/* 128-bit keys, e.g.: UUIDs */
+/*****************************************************************************/
+struct ehht_u128 {
+	/* private */
+	void *data;
+
+	/* public methods, as ehht_u32 */
+	void *(*get)(struct ehht_u128 *table, struct ehht_u128_key key);
+	void *(*put)(struct ehht_u128 *table, struct ehht_u128_key key,
+		     void *val, int *err);
+	void *(*remove)(struct ehht_u128 *table, struct ehht_u128_key key);
+	int (*has_key)(struct ehht_u128 *table, struct ehht_u128_key key);
+	size_t (*size)(struct ehht_u128 *table);
+	void (*clear)(struct ehht_u128 *table);
+	int (*for_each)(struct ehht_u128 *table,
+			int (*func)(struct ehht_u128_key each_key,
+				    void *each_val, void *context),
+			void *context);
+	size_t (*get_many)(struct ehht_u128 *table,
+			   const struct ehht_u128_key *keys, size_t keys_len,
+			   void **vals);
+};
+
+struct ehht_u128 *ehht_u128_new(size_t num_buckets,
+				struct eembed_allocator *ea,
+				struct eembed_log *log);
+
+void ehht_u128_free(struct ehht_u128 *table);
+
+/* a UUID or other 16 bytes as a key, in network (big-endian) order */
+struct ehht_u128_key ehht_u128_key_from_bytes(const unsigned char bytes[16]);
+
+/*****************************************************************************/
+/* pointer identity keys */
+/*****************************************************************************/
+struct ehht_ptr {
+	/* private */
+	void *data;
+
+	/* public methods, as ehht_u32 */
+	void *(*get)(struct ehht_ptr *table, const void *key);
+	void *(*put)(struct ehht_ptr *table, const void *key, void *val,
+		     int *err);
+	void *(*remove)(struct ehht_ptr *table, const void *key);
+	int (*has_key)(struct ehht_ptr *table, const void *key);
+	size_t (*size)(struct ehht_ptr *table);
+	void (*clear)(struct ehht_ptr *table);
+	int (*for_each)(struct ehht_ptr *table,
+			int (*func)(const void *each_key, void *each_val,
+				    void *context), void *context);
+	size_t (*get_many)(struct ehht_ptr *table, const void *const *keys,
+			   size_t keys_len, void **vals);
+};
+
+struct ehht_ptr *ehht_ptr_new(size_t num_buckets,
+			      struct eembed_allocator *ea,
+			      struct eembed_log *log);
+
+void ehht_ptr_free(struct ehht_ptr *table);
+
+/*****************************************************************************/
+/* the integer mixers used for hashing, exposed for testing */
+/*****************************************************************************/
+uint32_t ehht_mix32(uint32_t key);
+uint64_t ehht_mix64(uint64_t key);
+
+Ehht_fixed_end_C_functions
+#undef Ehht_fixed_end_C_functions
+#endif /* EHHT_FIXED_H */
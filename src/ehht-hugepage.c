@@ -0,0 +1,269 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-hugepage.c: an eembed_allocator for huge pages and NUMA placement */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sys/mman.h>		/* mmap munmap madvise */
+#include <sys/syscall.h>	/* SYS_mbind */
+#include <unistd.h>		/* syscall */
+
+#include "ehht-hugepage.h"
+#include "eembed.h"
+
+#define EHHT_HUGEPAGE_SIZE (2UL * 1024 * 1024)
+#define EHHT_HUGEPAGE_DEFAULT_THRESHOLD (1UL * 1024 * 1024)
+
+/* the mapping record is the first cache line of each mapping */
+#define EHHT_HUGEPAGE_HEADER 64
+
+/* from numaif.h, which is in libnuma-dev rather than libc */
+#define EHHT_MPOL_BIND 2
+#define EHHT_MPOL_INTERLEAVE 3
+
+struct ehht_hugepage_mapping {
+	struct ehht_hugepage_mapping *next;
+	size_t len;
+};
+
+static size_t ehht_hugepage_round_up(size_t size, size_t to)
+{
+	return ((size + to - 1) / to) * to;
+}
+
+static void ehht_hugepage_place(struct ehht_hugepage_context *ctx,
+				void *addr, size_t len)
+{
+	int mode = 0;
+
+	if (!ctx->nodemask) {
+		return;
+	}
+	if (ctx->flags & EHHT_HUGEPAGE_INTERLEAVE) {
+		mode = EHHT_MPOL_INTERLEAVE;
+	} else if (ctx->flags & EHHT_HUGEPAGE_BIND) {
+		mode = EHHT_MPOL_BIND;
+	} else {
+		return;
+	}
+#ifdef SYS_mbind
+	if (syscall(SYS_mbind, addr, len, mode, &(ctx->nodemask),
+		    8 * sizeof(unsigned long) + 1, 0) == 0) {
+		return;
+	}
+#else
+	(void)addr;
+	(void)len;
+	(void)mode;
+#endif
+	/* the pages are still usable, only not placed */
+	++(ctx->mbind_failures);
+}
+
+/* returns MAP_FAILED if no mapping could be made */
+static void *ehht_hugepage_map(struct ehht_hugepage_context *ctx,
+			       size_t size, size_t *len)
+{
+	unsigned char *addr = NULL;
+	size_t head = 0;
+	size_t tail = 0;
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#ifdef MAP_HUGETLB
+	if ((ctx->flags & EHHT_HUGEPAGE_HUGETLB)
+	    && size >= EHHT_HUGEPAGE_SIZE) {
+		*len = ehht_hugepage_round_up(size, EHHT_HUGEPAGE_SIZE);
+		addr = (unsigned char *)mmap(NULL, *len, prot,
+					     flags | MAP_HUGETLB, -1, 0);
+		if ((void *)addr != MAP_FAILED) {
+			++(ctx->hugetlb);
+			return addr;
+		}
+	}
+#endif
+
+	*len = ehht_hugepage_round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+	if (*len < EHHT_HUGEPAGE_SIZE) {
+		return mmap(NULL, *len, prot, flags, -1, 0);
+	}
+
+	/* over-map, then trim to a huge page boundary, so that the kernel
+	   can back every aligned 2 MiB with one huge page */
+	*len = ehht_hugepage_round_up(size, EHHT_HUGEPAGE_SIZE);
+	addr = (unsigned char *)mmap(NULL, *len + EHHT_HUGEPAGE_SIZE, prot,
+				     flags, -1, 0);
+	if ((void *)addr == MAP_FAILED) {
+		return MAP_FAILED;
+	}
+	head = EHHT_HUGEPAGE_SIZE - (((size_t)addr) % EHHT_HUGEPAGE_SIZE);
+	if (head == EHHT_HUGEPAGE_SIZE) {
+		head = 0;
+	}
+	tail = EHHT_HUGEPAGE_SIZE - head;
+	if (head) {
+		munmap(addr, head);
+	}
+	if (tail) {
+		munmap(addr + head + *len, tail);
+	}
+	addr += head;
+#ifdef MADV_HUGEPAGE
+	if (madvise(addr, *len, MADV_HUGEPAGE) == 0) {
+		++(ctx->madvised);
+	}
+#endif
+	return addr;
+}
+
+static void *ehht_hugepage_malloc(struct eembed_allocator *ea, size_t size)
+{
+	struct ehht_hugepage_context *ctx = NULL;
+	struct ehht_hugepage_mapping *mapping = NULL;
+	void *addr = NULL;
+	size_t len = 0;
+
+	ctx = (struct ehht_hugepage_context *)ea->context;
+	if (size < ctx->threshold) {
+		return ctx->small->malloc(ctx->small, size);
+	}
+
+	addr = ehht_hugepage_map(ctx, EHHT_HUGEPAGE_HEADER + size, &len);
+	if (addr == MAP_FAILED) {
+		++(ctx->fallbacks);
+		return ctx->small->malloc(ctx->small, size);
+	}
+	/* before the first touch, which is when the pages are placed */
+	ehht_hugepage_place(ctx, addr, len);
+
+	mapping = (struct ehht_hugepage_mapping *)addr;
+	mapping->len = len;
+	mapping->next = ctx->mappings;
+	ctx->mappings = mapping;
+	++(ctx->mapped);
+	ctx->bytes_mapped += len;
+	return ((unsigned char *)addr) + EHHT_HUGEPAGE_HEADER;
+}
+
+/* a table makes few large allocations, so a list is searched */
+static struct ehht_hugepage_mapping **ehht_hugepage_find(struct
+							 ehht_hugepage_context
+							 *ctx, void *ptr)
+{
+	struct ehht_hugepage_mapping **pos = NULL;
+	unsigned char *data = NULL;
+
+	for (pos = &(ctx->mappings); *pos; pos = &((*pos)->next)) {
+		data = ((unsigned char *)(*pos)) + EHHT_HUGEPAGE_HEADER;
+		if ((void *)data == ptr) {
+			return pos;
+		}
+	}
+	return NULL;
+}
+
+static void ehht_hugepage_free(struct eembed_allocator *ea, void *ptr)
+{
+	struct ehht_hugepage_context *ctx = NULL;
+	struct ehht_hugepage_mapping **pos = NULL;
+	struct ehht_hugepage_mapping *mapping = NULL;
+
+	if (!ptr) {
+		return;
+	}
+	ctx = (struct ehht_hugepage_context *)ea->context;
+	pos = ehht_hugepage_find(ctx, ptr);
+	if (!pos) {
+		ctx->small->free(ctx->small, ptr);
+		return;
+	}
+	mapping = *pos;
+	*pos = mapping->next;
+	ctx->bytes_mapped -= mapping->len;
+	munmap(mapping, mapping->len);
+}
+
+static void *ehht_hugepage_calloc(struct eembed_allocator *ea, size_t nmemb,
+				  size_t size)
+{
+	struct ehht_hugepage_context *ctx = NULL;
+	void *ptr = NULL;
+
+	ctx = (struct ehht_hugepage_context *)ea->context;
+	if (size && nmemb > ((size_t)-1) / size) {
+		return NULL;
+	}
+	if ((nmemb * size) < ctx->threshold) {
+		return ctx->small->calloc(ctx->small, nmemb, size);
+	}
+	/* fresh mappings are zeroed, but a fallback may not be */
+	ptr = ehht_hugepage_malloc(ea, nmemb * size);
+	if (ptr) {
+		eembed_memset(ptr, 0x00, nmemb * size);
+	}
+	return ptr;
+}
+
+/* a small allocation stays with the small allocator, as its size is not
+   known here */
+static void *ehht_hugepage_realloc(struct eembed_allocator *ea, void *ptr,
+				   size_t size)
+{
+	struct ehht_hugepage_context *ctx = NULL;
+	struct ehht_hugepage_mapping **pos = NULL;
+	size_t old_size = 0;
+	void *new_ptr = NULL;
+
+	ctx = (struct ehht_hugepage_context *)ea->context;
+	if (!ptr) {
+		return ehht_hugepage_malloc(ea, size);
+	}
+	pos = ehht_hugepage_find(ctx, ptr);
+	if (!pos) {
+		return ctx->small->realloc(ctx->small, ptr, size);
+	}
+	old_size = (*pos)->len - EHHT_HUGEPAGE_HEADER;
+	if (size <= old_size && size >= ctx->threshold) {
+		return ptr;
+	}
+	new_ptr = ehht_hugepage_malloc(ea, size);
+	if (!new_ptr) {
+		return NULL;
+	}
+	eembed_memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+	ehht_hugepage_free(ea, ptr);
+	return new_ptr;
+}
+
+static void *ehht_hugepage_reallocarray(struct eembed_allocator *ea,
+					void *ptr, size_t nmemb, size_t size)
+{
+	if (size && nmemb > ((size_t)-1) / size) {
+		return NULL;
+	}
+	return ehht_hugepage_realloc(ea, ptr, nmemb * size);
+}
+
+void ehht_hugepage_allocator_init(struct eembed_allocator *ea,
+				  struct ehht_hugepage_context *ctx,
+				  struct eembed_allocator *small,
+				  size_t threshold, int flags,
+				  unsigned long nodemask)
+{
+	eembed_memset(ctx, 0x00, sizeof(struct ehht_hugepage_context));
+	ctx->small = small ? small : eembed_global_allocator;
+	ctx->threshold = threshold ? threshold
+	    : EHHT_HUGEPAGE_DEFAULT_THRESHOLD;
+	ctx->flags = flags;
+	ctx->nodemask = nodemask;
+
+	ea->context = ctx;
+	ea->malloc = ehht_hugepage_malloc;
+	ea->calloc = ehht_hugepage_calloc;
+	ea->realloc = ehht_hugepage_realloc;
+	ea->reallocarray = ehht_hugepage_reallocarray;
+	ea->free = ehht_hugepage_free;
+}
@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-hugepage.h: an eembed_allocator for huge pages and NUMA placement */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef EHHT_HUGEPAGE_H
+#define EHHT_HUGEPAGE_H
+
+/* An eembed_allocator which maps requests of at least "threshold" bytes,
+   such as bucket arrays, filters, and key pool chunks, directly with
+   mmap, backed by huge pages where the system allows, and optionally
+   placed on chosen NUMA nodes. Smaller requests, such as elements, go
+   to the wrapped allocator. Only built on systems with sys/mman.h.
+
+   Huge pages are tried in order:
+	1. MAP_HUGETLB, if EHHT_HUGEPAGE_HUGETLB is set and the mapping is
+	   at least one huge page; needs pages reserved by the system, e.g.
+	   "echo 512 > /proc/sys/vm/nr_hugepages"
+	2. a 2 MiB aligned mapping with madvise(MADV_HUGEPAGE), for
+	   transparent huge pages in "madvise" or "always" mode
+	3. if mmap fails, the wrapped allocator
+   The counters in the context report which path each request took.
+
+   The context is not thread-safe; like a table, it must be guarded by
+   the caller if shared between threads. */
+
+#ifdef __cplusplus
+#define Ehht_hugepage_begin_C_functions extern "C" {
+#define Ehht_hugepage_end_C_functions }
+#else
+#define Ehht_hugepage_begin_C_functions
+#define Ehht_hugepage_end_C_functions
+#endif
+
+Ehht_hugepage_begin_C_functions
+#undef Ehht_hugepage_begin_C_functions
+#include <stddef.h>		/* size_t */
+    struct eembed_allocator;	/* emmbed.h */
+
+/* flags */
+#define EHHT_HUGEPAGE_HUGETLB 0x01
+/* with a nodemask: place pages round-robin over the nodes, for tables
+   read by threads on every node */
+#define EHHT_HUGEPAGE_INTERLEAVE 0x02
+/* with a nodemask: only place pages on those nodes, for tables read by
+   threads pinned to them */
+#define EHHT_HUGEPAGE_BIND 0x04
+
+struct ehht_hugepage_mapping;
+
+struct ehht_hugepage_context {
+	struct eembed_allocator *small;
+	size_t threshold;
+	int flags;
+	/* bit n is NUMA node n; 0 for the default placement */
+	unsigned long nodemask;
+	struct ehht_hugepage_mapping *mappings;
+
+	/* counters */
+	size_t mapped;
+	size_t hugetlb;
+	size_t madvised;
+	size_t fallbacks;
+	size_t mbind_failures;
+	size_t bytes_mapped;
+};
+
+/* if small is NULL, eembed_global_allocator is used;
+   if threshold is 0, 1 MiB is used */
+void ehht_hugepage_allocator_init(struct eembed_allocator *ea,
+				  struct ehht_hugepage_context *ctx,
+				  struct eembed_allocator *small,
+				  size_t threshold, int flags,
+				  unsigned long nodemask);
+
+Ehht_hugepage_end_C_functions
+#undef Ehht_hugepage_end_C_functions
+#endif /* EHHT_HUGEPAGE_H */
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-reclaim.c: a background thread which frees detached tables */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include <pthread.h>		/* pthread_create pthread_mutex_lock ... */
+
+#include "ehht-reclaim.h"
+#include "ehht-error.h"
+#include "eembed.h"
+
+#define EHHT_RECLAIM_DEFAULT_BUDGET 4096
+
+struct ehht_reclaim_thread {
+	struct ehht_reclaimer *reclaimer;
+	size_t budget;
+	struct eembed_allocator *ea;
+	pthread_t thread;
+	/* guards the queue of the reclaimer, and the flags */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int queued;
+	int stopping;
+};
+
+static void ehht_reclaim_thread_sync(void *context, int op)
+{
+	struct ehht_reclaim_thread *rt = (struct ehht_reclaim_thread *)context;
+
+	switch (op) {
+	case EHHT_RECLAIM_LOCK:
+		pthread_mutex_lock(&rt->mutex);
+		break;
+	case EHHT_RECLAIM_UNLOCK:
+		pthread_mutex_unlock(&rt->mutex);
+		break;
+	case EHHT_RECLAIM_QUEUED:
+		rt->queued = 1;
+		pthread_cond_signal(&rt->cond);
+		break;
+	}
+}
+
+static void *ehht_reclaim_thread_run(void *arg)
+{
+	struct ehht_reclaim_thread *rt = (struct ehht_reclaim_thread *)arg;
+
+	pthread_mutex_lock(&rt->mutex);
+	while (rt->queued || !rt->stopping) {
+		if (!rt->queued) {
+			pthread_cond_wait(&rt->cond, &rt->mutex);
+			continue;
+		}
+		rt->queued = 0;
+		pthread_mutex_unlock(&rt->mutex);
+		/* ehht_reclaim_step takes the lock through the sync func */
+		while (ehht_reclaim_step(rt->reclaimer, rt->budget) ==
+		       rt->budget) ;
+		pthread_mutex_lock(&rt->mutex);
+	}
+	pthread_mutex_unlock(&rt->mutex);
+	return NULL;
+}
+
+struct ehht_reclaim_thread *ehht_reclaim_thread_start(struct ehht_reclaimer
+						      *reclaimer,
+						      size_t budget,
+						      struct eembed_allocator
+						      *ea,
+						      struct eembed_log *log)
+{
+	struct ehht_reclaim_thread *rt = NULL;
+
+	if (!ea) {
+		ea = eembed_global_allocator;
+	}
+	if (!log) {
+		log = eembed_err_log;
+	}
+	if (reclaimer->head || reclaimer->sync) {
+		Ehht_error(log, 501, "reclaimer not empty, or shared");
+		return NULL;
+	}
+
+	rt = (struct ehht_reclaim_thread *)ea->malloc(ea, sizeof(*rt));
+	if (!rt) {
+		Ehht_error(log, 502, "could not allocate thread state");
+		return NULL;
+	}
+	rt->reclaimer = reclaimer;
+	rt->budget = budget ? budget : EHHT_RECLAIM_DEFAULT_BUDGET;
+	rt->ea = ea;
+	rt->queued = 0;
+	rt->stopping = 0;
+	if (pthread_mutex_init(&rt->mutex, NULL)) {
+		Ehht_error(log, 503, "could not create mutex");
+		goto ehht_reclaim_thread_start_free;
+	}
+	if (pthread_cond_init(&rt->cond, NULL)) {
+		Ehht_error(log, 504, "could not create condition");
+		goto ehht_reclaim_thread_start_mutex;
+	}
+
+	reclaimer->sync = ehht_reclaim_thread_sync;
+	reclaimer->sync_context = rt;
+	if (pthread_create(&rt->thread, NULL, ehht_reclaim_thread_run, rt)) {
+		Ehht_error(log, 505, "could not create thread");
+		reclaimer->sync = NULL;
+		reclaimer->sync_context = NULL;
+		goto ehht_reclaim_thread_start_cond;
+	}
+	return rt;
+
+ehht_reclaim_thread_start_cond:
+	pthread_cond_destroy(&rt->cond);
+ehht_reclaim_thread_start_mutex:
+	pthread_mutex_destroy(&rt->mutex);
+ehht_reclaim_thread_start_free:
+	ea->free(ea, rt);
+	return NULL;
+}
+
+void ehht_reclaim_thread_stop(struct ehht_reclaim_thread *rt)
+{
+	struct eembed_allocator *ea = NULL;
+
+	if (!rt) {
+		return;
+	}
+	pthread_mutex_lock(&rt->mutex);
+	rt->stopping = 1;
+	pthread_cond_signal(&rt->cond);
+	pthread_mutex_unlock(&rt->mutex);
+	pthread_join(rt->thread, NULL);
+
+	rt->reclaimer->sync = NULL;
+	rt->reclaimer->sync_context = NULL;
+	pthread_cond_destroy(&rt->cond);
+	pthread_mutex_destroy(&rt->mutex);
+	ea = rt->ea;
+	ea->free(ea, rt);
+}
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-reclaim.h: a background thread which frees detached tables */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef EHHT_RECLAIM_H
+#define EHHT_RECLAIM_H
+
+/* Frees the tables queued on a reclaimer by ehht_free_async on a POSIX
+   thread, so that the thread which frees a very large table is only
+   blocked for the constant time of detaching it. The thread sets the
+   sync function of the reclaimer, after which ehht_free_async frees
+   tables whose allocator is not declared thread-safe at once, with
+   ehht_free, rather than let the thread call that allocator.
+
+   ehht_reclaim_step may still be called on the reclaimer from other
+   threads, e.g.: to help.
+
+   Only built on systems with pthreads. */
+
+#ifdef __cplusplus
+#define Ehht_reclaim_begin_C_functions extern "C" {
+#define Ehht_reclaim_end_C_functions }
+#else
+#define Ehht_reclaim_begin_C_functions
+#define Ehht_reclaim_end_C_functions
+#endif
+
+Ehht_reclaim_begin_C_functions
+#undef Ehht_reclaim_begin_C_functions
+#include <stddef.h>		/* size_t */
+#include "ehht.h"
+
+struct ehht_reclaim_thread;
+
+/* The reclaimer must be empty, and not in use by another thread.
+   The thread frees in steps of "budget" units of work, releasing the
+   queue lock between them; if budget is 0, 4096 is used.
+   If ea is NULL, eembed_global_allocator is used for the thread state;
+   if log is NULL, eembed_err_log is used.
+   Returns NULL on error. */
+struct ehht_reclaim_thread *ehht_reclaim_thread_start(struct ehht_reclaimer
+						      *reclaimer,
+						      size_t budget,
+						      struct eembed_allocator
+						      *ea,
+						      struct eembed_log *log);
+
+/* Returns once every table queued has been freed and the thread has
+   exited; the reclaimer is then without a sync function. Other threads
+   must have stopped using the reclaimer. */
+void ehht_reclaim_thread_stop(struct ehht_reclaim_thread *thread);
+
+Ehht_reclaim_end_C_functions
+#undef Ehht_reclaim_end_C_functions
+#endif /* EHHT_RECLAIM_H */
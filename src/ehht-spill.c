@@ -0,0 +1,980 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-spill.c: a memory-budgeted hashtable which spills to disk */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>		/* errno EINTR */
+#include <stdlib.h>		/* getenv mkstemp */
+#include <unistd.h>		/* read write lseek ftruncate close unlink */
+
+#include "ehht-spill.h"
+#include "ehht-fixed.h"		/* ehht_mix32 */
+#include "ehht-each.h"
+#include "ehht-error.h"
+#include "eembed.h"
+
+#ifndef EHHT_SPILL_PARTITIONS
+#define EHHT_SPILL_PARTITIONS 16
+#endif
+#define EHHT_SPILL_PARTITIONS_MAX 256
+
+/* the buckets of a new, empty, partition; it grows as usual */
+#define EHHT_SPILL_MIN_BUCKETS 8
+
+/* each budgeted allocation is preceded by its size, which keeps the
+   alignment of the wrapped allocator */
+#define EHHT_SPILL_HEADER 16
+
+/* each of the two I/O buffers is a sixteenth of the budget, within: */
+#define EHHT_SPILL_IO_MIN 256
+#define EHHT_SPILL_IO_MAX (64 * 1024)
+
+#define EHHT_SPILL_PATH_LEN 256
+#define EHHT_SPILL_FILE_TEMPLATE "/ehht-spill-XXXXXX"
+
+/* ehht.c */
+unsigned int ehht_kr2_hashcode(const char *data, size_t len);
+
+/* A spilled partition is a sequence of records of:
+	size_t		key length
+	unsigned int	hashcode
+	void *		value
+	char[]		key, without the NUL
+   in the byte order and sizes of this process. */
+struct ehht_spill_partition {
+	/* NULL if the partition is empty or spilled */
+	struct ehht *table;
+	/* the number of records in the file, if spilled */
+	size_t spilled;
+	unsigned long last_used;
+	int fd;
+	/* the table was changed since it was read from the file */
+	int dirty;
+};
+
+struct ehht_spill_io {
+	unsigned char *buf;
+	size_t len;
+	size_t pos;
+	int fd;
+	int err;
+};
+
+struct ehht_spill_table {
+	/* first, as in struct ehht_each_table */
+	struct eembed_allocator *ea;
+	struct eembed_log *log;
+	/* the budgeted allocator, used by the partitions */
+	struct eembed_allocator budgeted;
+	/* the partitions fail allocations as a matter of course, which is
+	   handled by spilling, so they log here rather than to "log" */
+	struct eembed_log quiet_log;
+	struct eembed_str_buf quiet_str_buf;
+	char quiet_buf[80];
+	ehht_hash_func hash_func;
+	size_t budget;
+	size_t used;
+	size_t peak;
+	size_t num_partitions;
+	unsigned int partition_bits;
+	struct ehht_spill_partition *parts;
+	unsigned long clock;
+	size_t io_size;
+	struct ehht_spill_io in;
+	struct ehht_spill_io out;
+	char *scratch;
+	size_t scratch_size;
+	size_t spills;
+	size_t loads;
+	size_t bytes_written;
+	size_t bytes_read;
+	char dir[EHHT_SPILL_PATH_LEN];
+};
+
+/* the keys are always copied, as the keys of a spilled partition are
+   valid only during the for_each which streams them, and allocated
+   outside of the budget, as there may be more of them than fit in it */
+static struct ehht_keys *ehht_spill_keys(struct ehht *ht, int copy_keys)
+{
+	(void)copy_keys;
+	return ehht_each_keys(ht, 1);
+}
+
+static void ehht_spill_destroy(struct ehht *ht);
+
+static struct ehht_spill_table *ehht_spill_get_table(struct ehht *ht)
+{
+	eembed_assert(ht);
+	eembed_assert(ht->destroy == ehht_spill_destroy);
+	eembed_assert(ht->data);
+	return (struct ehht_spill_table *)ht->data;
+}
+
+/*****************************************************************************/
+/* the budgeted allocator */
+/*****************************************************************************/
+static void *ehht_spill_malloc(struct eembed_allocator *ea, size_t size)
+{
+	struct ehht_spill_table *table = NULL;
+	unsigned char *mem = NULL;
+	size_t total = 0;
+
+	table = (struct ehht_spill_table *)ea->context;
+	total = EHHT_SPILL_HEADER + size;
+	if (total < size || total > (table->budget - table->used)) {
+		return NULL;
+	}
+	mem = (unsigned char *)table->ea->malloc(table->ea, total);
+	if (!mem) {
+		return NULL;
+	}
+	eembed_memcpy(mem, &size, sizeof(size_t));
+	table->used += total;
+	if (table->used > table->peak) {
+		table->peak = table->used;
+	}
+	return mem + EHHT_SPILL_HEADER;
+}
+
+static void ehht_spill_free(struct eembed_allocator *ea, void *ptr)
+{
+	struct ehht_spill_table *table = NULL;
+	unsigned char *mem = NULL;
+	size_t size = 0;
+
+	if (!ptr) {
+		return;
+	}
+	table = (struct ehht_spill_table *)ea->context;
+	mem = ((unsigned char *)ptr) - EHHT_SPILL_HEADER;
+	eembed_memcpy(&size, mem, sizeof(size_t));
+	table->used -= (EHHT_SPILL_HEADER + size);
+	table->ea->free(table->ea, mem);
+}
+
+static void *ehht_spill_calloc(struct eembed_allocator *ea, size_t nmemb,
+			       size_t size)
+{
+	void *ptr = NULL;
+
+	if (size && nmemb > ((size_t)-1) / size) {
+		return NULL;
+	}
+	ptr = ehht_spill_malloc(ea, nmemb * size);
+	if (ptr) {
+		eembed_memset(ptr, 0x00, nmemb * size);
+	}
+	return ptr;
+}
+
+static void *ehht_spill_realloc(struct eembed_allocator *ea, void *ptr,
+				size_t size)
+{
+	void *new_ptr = NULL;
+	size_t old_size = 0;
+
+	if (!ptr) {
+		return ehht_spill_malloc(ea, size);
+	}
+	eembed_memcpy(&old_size, ((unsigned char *)ptr) - EHHT_SPILL_HEADER,
+		      sizeof(size_t));
+	new_ptr = ehht_spill_malloc(ea, size);
+	if (!new_ptr) {
+		return NULL;
+	}
+	eembed_memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+	ehht_spill_free(ea, ptr);
+	return new_ptr;
+}
+
+static void *ehht_spill_reallocarray(struct eembed_allocator *ea, void *ptr,
+				     size_t nmemb, size_t size)
+{
+	if (size && nmemb > ((size_t)-1) / size) {
+		return NULL;
+	}
+	return ehht_spill_realloc(ea, ptr, nmemb * size);
+}
+
+/*****************************************************************************/
+/* files */
+/*****************************************************************************/
+static int ehht_spill_open(struct ehht_spill_table *table,
+			   struct ehht_spill_partition *part)
+{
+	char path[EHHT_SPILL_PATH_LEN];
+
+	eembed_strcpy(path, table->dir);
+	eembed_strcpy(path + eembed_strlen(path), EHHT_SPILL_FILE_TEMPLATE);
+	part->fd = mkstemp(path);
+	if (part->fd < 0) {
+		Ehht_error(table->log, 406, "could not create a spill file");
+		return 1;
+	}
+	/* the file is gone with the descriptor, even after a crash */
+	unlink(path);
+	return 0;
+}
+
+static int ehht_spill_flush(struct ehht_spill_table *table)
+{
+	struct ehht_spill_io *io = &(table->out);
+	size_t done = 0;
+	ssize_t n = 0;
+
+	while (done < io->len && !io->err) {
+		n = write(io->fd, io->buf + done, io->len - done);
+		if (n < 0) {
+			io->err = (errno != EINTR);
+		} else {
+			done += (size_t)n;
+		}
+	}
+	table->bytes_written += done;
+	io->len = 0;
+	return io->err;
+}
+
+static void ehht_spill_write(struct ehht_spill_table *table, const void *data,
+			     size_t len)
+{
+	struct ehht_spill_io *io = &(table->out);
+	const unsigned char *from = (const unsigned char *)data;
+	size_t chunk = 0;
+
+	while (len && !io->err) {
+		chunk = table->io_size - io->len;
+		if (chunk > len) {
+			chunk = len;
+		}
+		eembed_memcpy(io->buf + io->len, from, chunk);
+		io->len += chunk;
+		from += chunk;
+		len -= chunk;
+		if (io->len == table->io_size) {
+			ehht_spill_flush(table);
+		}
+	}
+}
+
+static int ehht_spill_read(struct ehht_spill_table *table, void *data,
+			   size_t len)
+{
+	struct ehht_spill_io *io = &(table->in);
+	unsigned char *to = (unsigned char *)data;
+	size_t chunk = 0;
+	ssize_t n = 0;
+
+	while (len && !io->err) {
+		if (io->pos == io->len) {
+			n = read(io->fd, io->buf, table->io_size);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				io->err = 1;
+				break;
+			}
+			io->len = (size_t)n;
+			io->pos = 0;
+			table->bytes_read += (size_t)n;
+		}
+		chunk = io->len - io->pos;
+		if (chunk > len) {
+			chunk = len;
+		}
+		eembed_memcpy(to, io->buf + io->pos, chunk);
+		io->pos += chunk;
+		to += chunk;
+		len -= chunk;
+	}
+	return io->err;
+}
+
+static int ehht_spill_rewind(struct ehht_spill_table *table,
+			     struct ehht_spill_partition *part)
+{
+	table->in.fd = part->fd;
+	table->in.len = 0;
+	table->in.pos = 0;
+	table->in.err = (lseek(part->fd, 0, SEEK_SET) != 0);
+	return table->in.err;
+}
+
+static int ehht_spill_write_each(struct ehht_key key, void *each_val,
+				 void *context)
+{
+	struct ehht_spill_table *table = (struct ehht_spill_table *)context;
+
+	ehht_spill_write(table, &key.len, sizeof(size_t));
+	ehht_spill_write(table, &key.hashcode, sizeof(unsigned int));
+	ehht_spill_write(table, &each_val, sizeof(void *));
+	ehht_spill_write(table, key.str, key.len);
+	return table->out.err;
+}
+
+/*****************************************************************************/
+/* partitions */
+/*****************************************************************************/
+static size_t ehht_spill_partition_of(struct ehht_spill_table *table,
+				      unsigned int hashcode)
+{
+	if (table->partition_bits == 0) {
+		return 0;
+	}
+	return (size_t)(ehht_mix32(hashcode) >> (32 - table->partition_bits));
+}
+
+/* writes the partition to its file and frees its table; a partition
+   which was only read since it was loaded is freed without writing */
+static int ehht_spill_out(struct ehht_spill_table *table, size_t p)
+{
+	struct ehht_spill_partition *part = table->parts + p;
+
+	if (!part->dirty) {
+		part->spilled = part->table->size(part->table);
+		ehht_free(part->table);
+		part->table = NULL;
+		++(table->spills);
+		return 0;
+	}
+	if (part->fd < 0 && ehht_spill_open(table, part)) {
+		return 1;
+	}
+	table->out.fd = part->fd;
+	table->out.len = 0;
+	table->out.err = (lseek(part->fd, 0, SEEK_SET) != 0)
+	    || ftruncate(part->fd, 0);
+	if (!table->out.err) {
+		part->table->for_each(part->table, ehht_spill_write_each,
+				      table);
+	}
+	if (ehht_spill_flush(table)) {
+		Ehht_error(table->log, 407, "could not write a spill file");
+		return 1;
+	}
+	part->spilled = part->table->size(part->table);
+	ehht_free(part->table);
+	part->table = NULL;
+	++(table->spills);
+	return 0;
+}
+
+/* spills the least recently used partition in memory, other than "keep",
+   returns non-zero if there is none, or it could not be written */
+static int ehht_spill_make_room(struct ehht_spill_table *table, size_t keep)
+{
+	size_t victim = table->num_partitions;
+	size_t i = 0;
+
+	for (i = 0; i < table->num_partitions; ++i) {
+		if (i == keep || table->parts[i].table == NULL) {
+			continue;
+		}
+		if (victim == table->num_partitions
+		    || table->parts[i].last_used <
+		    table->parts[victim].last_used) {
+			victim = i;
+		}
+	}
+	if (victim == table->num_partitions) {
+		return 1;
+	}
+	return ehht_spill_out(table, victim);
+}
+
+static int ehht_spill_scratch(struct ehht_spill_table *table, size_t size,
+			      size_t keep)
+{
+	struct eembed_allocator *ea = &(table->budgeted);
+
+	if (size <= table->scratch_size) {
+		return 0;
+	}
+	ea->free(ea, table->scratch);
+	table->scratch_size = 0;
+	for (;;) {
+		table->scratch = (char *)ea->malloc(ea, size);
+		if (table->scratch) {
+			table->scratch_size = size;
+			return 0;
+		}
+		if (ehht_spill_make_room(table, keep)) {
+			return 1;
+		}
+	}
+}
+
+static void ehht_spill_scratch_release(struct ehht_spill_table *table)
+{
+	struct eembed_allocator *ea = &(table->budgeted);
+
+	ea->free(ea, table->scratch);
+	table->scratch = NULL;
+	table->scratch_size = 0;
+}
+
+static struct ehht *ehht_spill_new_partition(struct ehht_spill_table *table,
+					     size_t p, size_t num_keys)
+{
+	struct ehht *partition = NULL;
+	size_t num_buckets = EHHT_SPILL_MIN_BUCKETS;
+
+	while (num_buckets < (num_keys + (num_keys / 2))) {
+		num_buckets *= 2;
+	}
+	for (;;) {
+		partition = ehht_new_custom(num_buckets, table->hash_func,
+					    &(table->budgeted),
+					    &(table->quiet_log));
+		if (partition || ehht_spill_make_room(table, p)) {
+			return partition;
+		}
+	}
+}
+
+static void *ehht_spill_put_into(struct ehht_spill_table *table, size_t p,
+				 struct ehht *partition, const char *key,
+				 size_t key_len, void *val, int *err)
+{
+	void *old_val = NULL;
+	int put_err = 0;
+
+	table->parts[p].dirty = 1;
+	for (;;) {
+		put_err = 0;
+		old_val = partition->put(partition, key, key_len, val,
+					 &put_err);
+		if (!put_err) {
+			return old_val;
+		}
+		if (ehht_spill_make_room(table, p)) {
+			*err = 1;
+			return NULL;
+		}
+	}
+}
+
+/* reads the partition back from its file */
+static int ehht_spill_in(struct ehht_spill_table *table, size_t p)
+{
+	struct ehht_spill_partition *part = table->parts + p;
+	struct ehht *partition = NULL;
+	size_t key_len = 0;
+	unsigned int hashcode = 0;
+	void *val = NULL;
+	size_t i = 0;
+	int err = 0;
+
+	partition = ehht_spill_new_partition(table, p, part->spilled);
+	if (!partition) {
+		return 1;
+	}
+	err = ehht_spill_rewind(table, part);
+	for (i = 0; i < part->spilled && !err; ++i) {
+		err = ehht_spill_read(table, &key_len, sizeof(size_t))
+		    || ehht_spill_read(table, &hashcode, sizeof(unsigned int))
+		    || ehht_spill_read(table, &val, sizeof(void *))
+		    || ehht_spill_scratch(table, key_len + 1, p)
+		    || ehht_spill_read(table, table->scratch, key_len);
+		if (!err) {
+			table->scratch[key_len] = '\0';
+			ehht_spill_put_into(table, p, partition, table->scratch,
+					    key_len, val, &err);
+		}
+	}
+	ehht_spill_scratch_release(table);
+	if (err) {
+		ehht_free(partition);
+		return 1;
+	}
+	part->table = partition;
+	part->spilled = 0;
+	part->dirty = 0;
+	++(table->loads);
+	return 0;
+}
+
+/* returns the table of partition p, loading it if spilled, or creating
+   it if empty and "create" is set; returns NULL if empty, or on error,
+   which sets *err */
+static struct ehht *ehht_spill_partition(struct ehht_spill_table *table,
+					 size_t p, int create, int *err)
+{
+	struct ehht_spill_partition *part = table->parts + p;
+
+	part->last_used = ++(table->clock);
+	if (part->table) {
+		return part->table;
+	}
+	if (part->spilled) {
+		if (ehht_spill_in(table, p)) {
+			Ehht_error(table->log, 408,
+				   "could not load a partition");
+			*err = 1;
+		}
+		return part->table;
+	}
+	if (create) {
+		part->table = ehht_spill_new_partition(table, p, 0);
+		if (!part->table) {
+			Ehht_error(table->log, 409,
+				   "budget too small for a partition");
+			*err = 1;
+		}
+	}
+	return part->table;
+}
+
+/* calls func for each record of a spilled partition, without loading */
+static int ehht_spill_stream(struct ehht_spill_table *table, size_t p,
+			     ehht_iterator_func func, void *context)
+{
+	struct ehht_spill_partition *part = table->parts + p;
+	struct ehht_key key;
+	void *val = NULL;
+	size_t i = 0;
+	int end = 0;
+	int err = 0;
+
+	err = ehht_spill_rewind(table, part);
+	for (i = 0; i < part->spilled && !err && !end; ++i) {
+		err = ehht_spill_read(table, &key.len, sizeof(size_t))
+		    || ehht_spill_read(table, &key.hashcode,
+				       sizeof(unsigned int))
+		    || ehht_spill_read(table, &val, sizeof(void *))
+		    || ehht_spill_scratch(table, key.len + 1,
+					  table->num_partitions)
+		    || ehht_spill_read(table, table->scratch, key.len);
+		if (!err) {
+			table->scratch[key.len] = '\0';
+			key.str = table->scratch;
+			end = (*func) (key, val, context);
+		}
+	}
+	ehht_spill_scratch_release(table);
+	if (err) {
+		Ehht_error(table->log, 410, "could not read a spill file");
+	}
+	return end;
+}
+
+/*****************************************************************************/
+/* struct ehht methods */
+/*****************************************************************************/
+static void *ehht_spill_get(struct ehht *ht, const char *key, size_t key_len)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht *partition = NULL;
+	size_t p = 0;
+	int err = 0;
+
+	table = ehht_spill_get_table(ht);
+	p = ehht_spill_partition_of(table, table->hash_func(key, key_len));
+	partition = ehht_spill_partition(table, p, 0, &err);
+	return partition ? partition->get(partition, key, key_len) : NULL;
+}
+
+static int ehht_spill_has_key(struct ehht *ht, const char *key,
+			      size_t key_len)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht *partition = NULL;
+	size_t p = 0;
+	int err = 0;
+
+	table = ehht_spill_get_table(ht);
+	p = ehht_spill_partition_of(table, table->hash_func(key, key_len));
+	partition = ehht_spill_partition(table, p, 0, &err);
+	return partition ? partition->has_key(partition, key, key_len) : 0;
+}
+
+static void *ehht_spill_put(struct ehht *ht, const char *key, size_t key_len,
+			    void *val, int *err)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht *partition = NULL;
+	void *old_val = NULL;
+	size_t p = 0;
+	int put_err = 0;
+
+	table = ehht_spill_get_table(ht);
+	p = ehht_spill_partition_of(table, table->hash_func(key, key_len));
+	partition = ehht_spill_partition(table, p, 1, &put_err);
+	if (partition) {
+		old_val = ehht_spill_put_into(table, p, partition, key,
+					      key_len, val, &put_err);
+		if (put_err) {
+			Ehht_error(table->log, 409,
+				   "budget too small for a partition");
+		}
+	}
+	if (put_err && err) {
+		*err = put_err;
+	}
+	return old_val;
+}
+
+static void *ehht_spill_remove(struct ehht *ht, const char *key,
+			       size_t key_len)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht *partition = NULL;
+	void *old_val = NULL;
+	size_t size = 0;
+	size_t p = 0;
+	int err = 0;
+
+	table = ehht_spill_get_table(ht);
+	p = ehht_spill_partition_of(table, table->hash_func(key, key_len));
+	partition = ehht_spill_partition(table, p, 0, &err);
+	if (!partition) {
+		return NULL;
+	}
+	size = partition->size(partition);
+	old_val = partition->remove(partition, key, key_len);
+	if (partition->size(partition) != size) {
+		table->parts[p].dirty = 1;
+	}
+	return old_val;
+}
+
+static size_t ehht_spill_size(struct ehht *ht)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht_spill_partition *part = NULL;
+	size_t size = 0;
+	size_t i = 0;
+
+	table = ehht_spill_get_table(ht);
+	for (i = 0; i < table->num_partitions; ++i) {
+		part = table->parts + i;
+		size += part->table ? part->table->size(part->table)
+		    : part->spilled;
+	}
+	return size;
+}
+
+static void ehht_spill_clear(struct ehht *ht)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht_spill_partition *part = NULL;
+	size_t i = 0;
+
+	table = ehht_spill_get_table(ht);
+	for (i = 0; i < table->num_partitions; ++i) {
+		part = table->parts + i;
+		if (part->table) {
+			ehht_free(part->table);
+			part->table = NULL;
+		}
+		/* the next spill rewrites the file from the start */
+		part->spilled = 0;
+	}
+}
+
+static int ehht_spill_for_each(struct ehht *ht, ehht_iterator_func func,
+			       void *context)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht_spill_partition *part = NULL;
+	size_t i = 0;
+	int end = 0;
+
+	table = ehht_spill_get_table(ht);
+	for (i = 0; i < table->num_partitions && !end; ++i) {
+		part = table->parts + i;
+		if (part->table) {
+			end = part->table->for_each(part->table, func, context);
+		} else if (part->spilled) {
+			end = ehht_spill_stream(table, i, func, context);
+		}
+	}
+	return end;
+}
+
+static void ehht_spill_destroy(struct ehht *ht)
+{
+	struct ehht_spill_table *table = NULL;
+	struct eembed_allocator *budgeted = NULL;
+	struct eembed_allocator *ea = NULL;
+	size_t i = 0;
+
+	table = (struct ehht_spill_table *)ht->data;
+	budgeted = &(table->budgeted);
+	ea = table->ea;
+
+	if (table->parts) {
+		ehht_spill_clear(ht);
+		for (i = 0; i < table->num_partitions; ++i) {
+			if (table->parts[i].fd >= 0) {
+				close(table->parts[i].fd);
+			}
+		}
+	}
+	budgeted->free(budgeted, table->parts);
+	budgeted->free(budgeted, table->in.buf);
+	budgeted->free(budgeted, table->out.buf);
+
+	ea->free(ea, table);
+	ea->free(ea, ht);
+}
+
+/*****************************************************************************/
+/* batches */
+/*****************************************************************************/
+static size_t ehht_spill_batch(struct ehht *ht, struct ehht_key *keys,
+			       void **vals, size_t n, int put, int *err)
+{
+	struct ehht_spill_table *table = NULL;
+	struct ehht *partition = NULL;
+	size_t order[EHHT_SPILL_PARTITIONS_MAX];
+	size_t count = 0;
+	size_t before = 0;
+	size_t p = 0;
+	size_t i = 0;
+	size_t j = 0;
+	int found = 0;
+	int batch_err = 0;
+	int part_err = 0;
+
+	table = ehht_spill_get_table(ht);
+	for (i = 0; i < n; ++i) {
+		keys[i].hashcode = table->hash_func(keys[i].str, keys[i].len);
+	}
+
+	/* the partitions in memory first, so that the loads of the
+	   spilled partitions spill those which are finished with */
+	for (p = 0; p < table->num_partitions; ++p) {
+		if (table->parts[p].spilled == 0) {
+			order[j++] = p;
+		}
+	}
+	for (p = 0; p < table->num_partitions; ++p) {
+		if (table->parts[p].spilled != 0) {
+			order[j++] = p;
+		}
+	}
+
+	for (j = 0; j < table->num_partitions; ++j) {
+		p = order[j];
+		partition = NULL;
+		part_err = 0;
+		for (i = 0; i < n && !part_err; ++i) {
+			if (ehht_spill_partition_of(table, keys[i].hashcode)
+			    != p) {
+				continue;
+			}
+			if (!partition) {
+				partition = ehht_spill_partition(table, p, put,
+								 &part_err);
+			}
+			if (!partition) {
+				if (!put) {
+					vals[i] = NULL;
+				}
+				continue;
+			}
+			if (put) {
+				before = partition->size(partition);
+				ehht_spill_put_into(table, p, partition,
+						    keys[i].str, keys[i].len,
+						    vals[i], &part_err);
+				count += partition->size(partition) - before;
+			} else {
+				vals[i] = ehht_lookup(partition, keys[i].str,
+						      keys[i].len, &found);
+				count += found ? 1 : 0;
+			}
+		}
+		if (part_err) {
+			if (put) {
+				Ehht_error(table->log, 409,
+					   "budget too small for a"
+					   " partition");
+			}
+			batch_err = 1;
+			/* the rest of the partition's keys are not found */
+			for (; i < n && !put; ++i) {
+				if (ehht_spill_partition_of
+				    (table, keys[i].hashcode) == p) {
+					vals[i] = NULL;
+				}
+			}
+		}
+	}
+	if (batch_err && err) {
+		*err = batch_err;
+	}
+	return count;
+}
+
+size_t ehht_spill_get_batch(struct ehht *ht, struct ehht_key *keys,
+			    void **vals, size_t n, int *err)
+{
+	return ehht_spill_batch(ht, keys, vals, n, 0, err);
+}
+
+size_t ehht_spill_put_batch(struct ehht *ht, struct ehht_key *keys,
+			    void **vals, size_t n, int *err)
+{
+	return ehht_spill_batch(ht, keys, vals, n, 1, err);
+}
+
+void ehht_spill_stats(struct ehht *ht, struct ehht_spill_stats *out)
+{
+	struct ehht_spill_table *table = NULL;
+	size_t i = 0;
+
+	table = ehht_spill_get_table(ht);
+	eembed_memset(out, 0x00, sizeof(struct ehht_spill_stats));
+	out->budget = table->budget;
+	out->bytes_used = table->used;
+	out->bytes_peak = table->peak;
+	out->partitions = table->num_partitions;
+	for (i = 0; i < table->num_partitions; ++i) {
+		if (table->parts[i].spilled) {
+			++(out->partitions_spilled);
+		}
+	}
+	out->spills = table->spills;
+	out->loads = table->loads;
+	out->bytes_written = table->bytes_written;
+	out->bytes_read = table->bytes_read;
+}
+
+/*****************************************************************************/
+/* constructor */
+/*****************************************************************************/
+struct ehht *ehht_new_spill(size_t budget, size_t partitions, const char *dir,
+			   ehht_hash_func hash_func,
+			   struct eembed_allocator *ea,
+			   struct eembed_log *log)
+{
+	struct ehht *ht = NULL;
+	struct ehht_spill_table *table = NULL;
+	struct eembed_allocator *budgeted = NULL;
+	size_t num_partitions = 1;
+	unsigned int partition_bits = 0;
+	size_t size = 0;
+	size_t i = 0;
+
+	if (hash_func == NULL) {
+		hash_func = ehht_kr2_hashcode;
+	}
+	if (ea == NULL) {
+		ea = eembed_global_allocator;
+	}
+	if (log == NULL) {
+		log = eembed_err_log;
+	}
+	if (partitions == 0) {
+		partitions = EHHT_SPILL_PARTITIONS;
+	}
+	if (partitions > EHHT_SPILL_PARTITIONS_MAX) {
+		Ehht_error(log, 401, "too many partitions");
+		return NULL;
+	}
+	while (num_partitions < partitions) {
+		num_partitions *= 2;
+		++partition_bits;
+	}
+	if (dir == NULL) {
+		dir = getenv("TMPDIR");
+	}
+	if (dir == NULL || dir[0] == '\0') {
+		dir = "/tmp";
+	}
+	if (eembed_strlen(dir) + sizeof(EHHT_SPILL_FILE_TEMPLATE) >
+	    EHHT_SPILL_PATH_LEN) {
+		Ehht_error(log, 402, "spill directory name too long");
+		return NULL;
+	}
+
+	size = sizeof(struct ehht);
+	ht = (struct ehht *)ea->malloc(ea, size);
+	if (ht == NULL) {
+		Ehht_error_malloc(log, 403, size, "struct ehht");
+		return NULL;
+	}
+	eembed_memset(ht, 0x00, size);
+
+	ht->get = ehht_spill_get;
+	ht->put = ehht_spill_put;
+	ht->remove = ehht_spill_remove;
+	ht->size = ehht_spill_size;
+	ht->clear = ehht_spill_clear;
+	ht->for_each = ehht_spill_for_each;
+	ht->has_key = ehht_spill_has_key;
+	ht->keys = ehht_spill_keys;
+	ht->free_keys = ehht_each_free_keys;
+	ht->to_string = ehht_each_to_string;
+	ht->destroy = ehht_spill_destroy;
+
+	size = sizeof(struct ehht_spill_table);
+	table = (struct ehht_spill_table *)ea->malloc(ea, size);
+	if (table == NULL) {
+		Ehht_error_malloc(log, 404, size, "spill table");
+		ea->free(ea, ht);
+		return NULL;
+	}
+	eembed_memset(table, 0x00, size);
+	ht->data = table;
+
+	table->ea = ea;
+	table->log = log;
+	eembed_char_buf_log_init(&(table->quiet_log), &(table->quiet_str_buf),
+				 table->quiet_buf, sizeof(table->quiet_buf));
+	table->hash_func = hash_func;
+	table->num_partitions = num_partitions;
+	table->partition_bits = partition_bits;
+	eembed_strcpy(table->dir, dir);
+
+	budgeted = &(table->budgeted);
+	budgeted->context = table;
+	budgeted->malloc = ehht_spill_malloc;
+	budgeted->calloc = ehht_spill_calloc;
+	budgeted->realloc = ehht_spill_realloc;
+	budgeted->reallocarray = ehht_spill_reallocarray;
+	budgeted->free = ehht_spill_free;
+
+	/* the structs are part of the budget */
+	table->budget = budget;
+	table->used = sizeof(struct ehht) + sizeof(struct ehht_spill_table);
+	if (table->used > budget) {
+		table->used = budget;
+	}
+	table->peak = table->used;
+
+	table->io_size = budget / 16;
+	if (table->io_size < EHHT_SPILL_IO_MIN) {
+		table->io_size = EHHT_SPILL_IO_MIN;
+	} else if (table->io_size > EHHT_SPILL_IO_MAX) {
+		table->io_size = EHHT_SPILL_IO_MAX;
+	}
+
+	size = sizeof(struct ehht_spill_partition) * num_partitions;
+	table->parts = (struct ehht_spill_partition *)
+	    budgeted->malloc(budgeted, size);
+	if (table->parts) {
+		eembed_memset(table->parts, 0x00, size);
+		for (i = 0; i < num_partitions; ++i) {
+			table->parts[i].fd = -1;
+		}
+	}
+	table->in.buf = (unsigned char *)
+	    budgeted->malloc(budgeted, table->io_size);
+	table->out.buf = (unsigned char *)
+	    budgeted->malloc(budgeted, table->io_size);
+	if (!table->parts || !table->in.buf || !table->out.buf) {
+		Ehht_error(log, 405, "budget too small");
+		ehht_spill_destroy(ht);
+		return NULL;
+	}
+
+	return ht;
+}
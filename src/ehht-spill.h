@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-spill.h: a memory-budgeted hashtable which spills to disk */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#ifndef EHHT_SPILL_H
+#define EHHT_SPILL_H
+
+/* A "struct ehht" for more keys than fit in memory, in the manner of a
+   Grace hash join: the keys are split by hashcode into partitions, each
+   a chained table. Every allocation of the table, its partitions and
+   its I/O buffers is counted against a byte budget, and an allocation
+   which would exceed it is refused. When that happens, the least
+   recently used other partition is written sequentially to its own
+   unlinked temporary file and freed, and the allocation is retried.
+   A spilled partition is read back whole when a key in it is next
+   accessed, spilling others as needed to make room; if it is not
+   changed before it is spilled again, it is not rewritten.
+
+   The values are written as their pointer bits, so they should be
+   NULL, small integers, or pointers which the caller keeps alive.
+   "for_each" and "to_string" read spilled partitions from their files
+   without loading them. "keys" always copies, and allocates the copy
+   from the allocator outside of the budget. A put fails, setting
+   *err, only if one partition does not fit in the budget by itself.
+
+   Only built on systems with mkstemp. */
+
+#ifdef __cplusplus
+#define Ehht_spill_begin_C_functions extern "C" {
+#define Ehht_spill_end_C_functions }
+#else
+#define Ehht_spill_begin_C_functions
+#define Ehht_spill_end_C_functions
+#endif
+
+Ehht_spill_begin_C_functions
+#undef Ehht_spill_begin_C_functions
+#include "ehht.h"
+/* "budget" is in bytes, and must at least cover the fixed overhead:
+   about 1 KiB, 48 bytes per partition, and two I/O buffers, each a
+   sixteenth of the budget, at least 256 bytes and at most 64 KiB.
+   "partitions" is rounded up to a power of two, at most 256;
+   if 0, 16 are used.
+   if dir is NULL, $TMPDIR or else "/tmp" is used;
+   if hash_func is NULL, a hashing function will be provided;
+   if ea is NULL, eembed_global_allocator will be used;
+   if log is NULL, eembed_err_log will be used.
+   Returns NULL on error. */
+struct ehht *ehht_new_spill(size_t budget, size_t partitions, const char *dir,
+			   ehht_hash_func hash_func,
+			   struct eembed_allocator *ea,
+			   struct eembed_log *log);
+
+/* Looks up n keys, visiting the partitions in memory first, then
+   loading each spilled partition which has keys in the batch once.
+   Sets vals[i] to the value of keys[i], or NULL, and the hashcode of
+   each key. Returns the number of keys found; if a partition could not
+   be loaded, its keys are not found and *err is set, if not NULL. */
+size_t ehht_spill_get_batch(struct ehht *table, struct ehht_key *keys,
+			    void **vals, size_t n, int *err);
+
+/* Puts keys[i] => vals[i] for n keys, grouped by partition as with
+   ehht_spill_get_batch. Returns the number of keys which were not
+   already present; on error, sets *err, if not NULL, and the keys of
+   the failing partition may be only partly added. */
+size_t ehht_spill_put_batch(struct ehht *table, struct ehht_key *keys,
+			    void **vals, size_t n, int *err);
+
+struct ehht_spill_stats {
+	size_t budget;
+	size_t bytes_used;
+	size_t bytes_peak;
+	size_t partitions;
+	size_t partitions_spilled;
+	size_t spills;
+	size_t loads;
+	size_t bytes_written;
+	size_t bytes_read;
+};
+
+void ehht_spill_stats(struct ehht *table, struct ehht_spill_stats *out);
+
+Ehht_spill_end_C_functions
+#undef Ehht_spill_end_C_functions
+#endif /* EHHT_SPILL_H */
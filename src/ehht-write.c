@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* ehht-write.c: streaming text and JSON output of any "struct ehht" */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "eembed.h"
+
+struct ehht_writer {
+	char *buf;
+	size_t buf_len;
+	size_t used;
+	ehht_write_func write;
+	void *write_context;
+	ehht_format_value_func format_value;
+	void *format_context;
+	int format;
+	size_t count;
+	int err;
+};
+
+static void ehht_writer_flush(struct ehht_writer *w)
+{
+	if (w->used && !w->err) {
+		w->err = w->write(w->write_context, w->buf, w->used);
+	}
+	w->used = 0;
+}
+
+static void ehht_writer_bytes(struct ehht_writer *w, const char *bytes,
+			      size_t len)
+{
+	size_t n = 0;
+
+	while (len && !w->err) {
+		if (w->used == w->buf_len) {
+			ehht_writer_flush(w);
+		}
+		n = w->buf_len - w->used;
+		if (n > len) {
+			n = len;
+		}
+		eembed_memcpy(w->buf + w->used, bytes, n);
+		w->used += n;
+		bytes += n;
+		len -= n;
+	}
+}
+
+static void ehht_writer_s(struct ehht_writer *w, const char *s)
+{
+	ehht_writer_bytes(w, s, eembed_strlen(s));
+}
+
+/* writes the escape of c, which is at most 6 bytes, returns its length */
+static size_t ehht_escape(int format, unsigned char c, char *out)
+{
+	const char *hex = "0123456789abcdef";
+	size_t len = 0;
+
+	out[len++] = '\\';
+	switch (c) {
+	case '\\':
+	case '"':
+		out[len++] = (char)c;
+		break;
+	case '\t':
+		out[len++] = 't';
+		break;
+	case '\n':
+		out[len++] = 'n';
+		break;
+	case '\r':
+		out[len++] = 'r';
+		break;
+	default:
+		if (format == EHHT_WRITE_JSON) {
+			out[len++] = 'u';
+			out[len++] = '0';
+			out[len++] = '0';
+		} else {
+			out[len++] = 'x';
+		}
+		out[len++] = hex[c >> 4];
+		out[len++] = hex[c & 0x0F];
+		break;
+	}
+	return len;
+}
+
+/* text escapes DEL, as it does the other control characters */
+#define Ehht_needs_escape(c, quote) \
+	((c) < 0x20 || (c) == '\\' || (c) == (quote))
+
+/* copies runs of bytes which need no escape in one piece */
+static void ehht_writer_escaped(struct ehht_writer *w, const char *str,
+				size_t len)
+{
+	unsigned char quote = (w->format == EHHT_WRITE_JSON) ? '"' : 0x7F;
+	char esc[6];
+	size_t start = 0;
+	size_t i = 0;
+
+	for (i = 0; i < len; ++i) {
+		if (!Ehht_needs_escape((unsigned char)str[i], quote)) {
+			continue;
+		}
+		ehht_writer_bytes(w, str + start, i - start);
+		ehht_writer_bytes(w, esc, ehht_escape(w->format,
+						      (unsigned char)str[i],
+						      esc));
+		start = i + 1;
+	}
+	ehht_writer_bytes(w, str + start, len - start);
+}
+
+/* the value is formatted directly into the buffer, which is flushed
+   first if the value does not fit in what is left of it */
+static void ehht_writer_value(struct ehht_writer *w, void *val)
+{
+	size_t len = 0;
+
+	if (w->err) {
+		return;
+	}
+	len = w->format_value(val, w->buf + w->used, w->buf_len - w->used,
+			      w->format_context);
+	if (len > (w->buf_len - w->used)) {
+		ehht_writer_flush(w);
+		if (w->err) {
+			return;
+		}
+		len = w->format_value(val, w->buf, w->buf_len,
+				      w->format_context);
+		if (len > w->buf_len) {
+			w->err = -1;
+			return;
+		}
+	}
+	w->used += len;
+}
+
+/* writes directly to the buffer, which must have room for 6 bytes for
+   each byte of the key */
+static void ehht_writer_escaped_fast(struct ehht_writer *w, const char *str,
+				     size_t len)
+{
+	unsigned char quote = (w->format == EHHT_WRITE_JSON) ? '"' : 0x7F;
+	char *out = w->buf + w->used;
+	unsigned char c = 0;
+	size_t i = 0;
+
+	for (i = 0; i < len; ++i) {
+		c = (unsigned char)str[i];
+		if (Ehht_needs_escape(c, quote)) {
+			out += ehht_escape(w->format, c, out);
+		} else {
+			*out++ = (char)c;
+		}
+	}
+	w->used = (size_t)(out - w->buf);
+}
+
+static int ehht_write_each(struct ehht_key key, void *each_val,
+			   void *context)
+{
+	struct ehht_writer *w = (struct ehht_writer *)context;
+	size_t room = 0;
+
+	/* usually the whole key fits without checks, even if escaped;
+	   otherwise the buffer is filled to the end before it is flushed */
+	room = (6 * key.len) + 8;
+	if (room > (w->buf_len - w->used) || w->err) {
+		if (w->format == EHHT_WRITE_JSON) {
+			ehht_writer_s(w, w->count ? ",\n\"" : "\"");
+			ehht_writer_escaped(w, key.str, key.len);
+			ehht_writer_bytes(w, "\": ", 3);
+		} else {
+			ehht_writer_escaped(w, key.str, key.len);
+			ehht_writer_bytes(w, "\t", 1);
+		}
+	} else if (w->format == EHHT_WRITE_JSON) {
+		if (w->count) {
+			w->buf[w->used++] = ',';
+			w->buf[w->used++] = '\n';
+		}
+		w->buf[w->used++] = '"';
+		ehht_writer_escaped_fast(w, key.str, key.len);
+		w->buf[w->used++] = '"';
+		w->buf[w->used++] = ':';
+		w->buf[w->used++] = ' ';
+	} else {
+		ehht_writer_escaped_fast(w, key.str, key.len);
+		w->buf[w->used++] = '\t';
+	}
+	ehht_writer_value(w, each_val);
+	if (w->format == EHHT_WRITE_TEXT) {
+		ehht_writer_bytes(w, "\n", 1);
+	}
+	++(w->count);
+	return w->err;
+}
+
+/* the pointer, in hex, as ehht_to_string */
+static size_t ehht_format_value_text(void *val, char *buf, size_t buf_len,
+				     void *context)
+{
+	const char *hex = "0123456789abcdef";
+	size_t bits = (size_t)val;
+	size_t len = 2 + (2 * sizeof(size_t));
+	size_t i = 0;
+
+	(void)context;
+	if (len > buf_len) {
+		return len;
+	}
+	buf[0] = '0';
+	buf[1] = 'x';
+	for (i = 2; i < len; ++i) {
+		buf[i] = hex[(bits >> (4 * (len - 1 - i))) & 0x0F];
+	}
+	return len;
+}
+
+/* null, or the unsigned integer of the pointer bits */
+static size_t ehht_format_value_json(void *val, char *buf, size_t buf_len,
+				     void *context)
+{
+	char digits[3 * sizeof(size_t)];
+	size_t bits = (size_t)val;
+	size_t len = 0;
+
+	(void)context;
+	if (val == NULL) {
+		if (buf_len >= 4) {
+			eembed_memcpy(buf, "null", 4);
+		}
+		return 4;
+	}
+	/* from the end, as this is called for every value */
+	do {
+		digits[sizeof(digits) - (++len)] = (char)('0' + (bits % 10));
+		bits /= 10;
+	} while (bits);
+	if (len <= buf_len) {
+		eembed_memcpy(buf, digits + sizeof(digits) - len, len);
+	}
+	return len;
+}
+
+int ehht_write(struct ehht *table, int format, char *buf, size_t buf_len,
+	       ehht_write_func write, void *write_context,
+	       ehht_format_value_func format_value, void *format_context)
+{
+	struct ehht_writer w;
+
+	if (!table || !buf || buf_len < EHHT_WRITE_MIN_BUF_LEN || !write
+	    || (format != EHHT_WRITE_TEXT && format != EHHT_WRITE_JSON)) {
+		return -1;
+	}
+
+	eembed_memset(&w, 0x00, sizeof(struct ehht_writer));
+	w.buf = buf;
+	w.buf_len = buf_len;
+	w.write = write;
+	w.write_context = write_context;
+	w.format = format;
+	w.format_value = format_value;
+	w.format_context = format_context;
+	if (!w.format_value) {
+		w.format_value = (format == EHHT_WRITE_JSON)
+		    ? ehht_format_value_json : ehht_format_value_text;
+	}
+
+	if (format == EHHT_WRITE_JSON) {
+		ehht_writer_bytes(&w, "{\n", 2);
+	}
+	table->for_each(table, ehht_write_each, &w);
+	if (format == EHHT_WRITE_JSON) {
+		ehht_writer_s(&w, w.count ? "\n}\n" : "}\n");
+	}
+	ehht_writer_flush(&w);
+	return w.err;
+}
@@ -4,6 +4,8 @@
 /* https://github.com/ericherman/libehht */
 
 #include "ehht.h"
+#include "ehht-each.h"
+#include "ehht-error.h"
 #include "eembed.h"
 
 #ifndef EHHT_DEFAULT_BUCKETS
@@ -16,48 +18,174 @@
 #define EHHT_DEFAULT_RESIZE_LOADFACTOR (2.0/3.0)
 #endif
 
-#define Ehht_error_malloc(log, err_num, bytes, thing) \
-	do { if (log) { \
-		log->append_s(log, __FILE__); \
-		log->append_s(log, ":"); \
-		log->append_ul(log, __LINE__); \
-		log->append_s(log, " Ehht Error "); \
-		log->append_l(log, err_num); \
-		log->append_s(log, ": could not allocate "); \
-		log->append_ul(log, bytes); \
-		log->append_s(log, " bytes ("); \
-		log->append_s(log, thing); \
-		log->append_s(log, ")"); \
-		log->append_eol(log); \
-	} } while (0)
-
-#define Ehht_error(log, err_num, msg) \
-	do { if (log) { \
-		log->append_s(log, __FILE__); \
-		log->append_s(log, ":"); \
-		log->append_ul(log, __LINE__); \
-		log->append_s(log, " Error "); \
-		log->append_l(log, err_num); \
-		log->append_s(log, ": "); \
-		log->append_s(log, msg); \
-		log->append_eol(log); \
-	} } while (0)
+#ifndef EHHT_INSTRUMENT
+#define EHHT_INSTRUMENT 0
+#endif
+
+#if EHHT_INSTRUMENT
+#define Ehht_instr_now(table) ehht_now(table)
+#define Ehht_instr_count(table, counter) ++((table)->op_stats.counter)
+#define Ehht_instr_add(table, counter, amount) \
+	((table)->op_stats.counter += (amount))
+#define Ehht_instr_record(table, hist, val) \
+	ehht_op_histogram_add(&((table)->op_stats.hist), (val))
+#else
+#define Ehht_instr_now(table) 0
+#define Ehht_instr_count(table, counter) do { } while (0)
+#define Ehht_instr_add(table, counter, amount) ((void)(amount))
+#define Ehht_instr_record(table, hist, val) ((void)(val))
+#endif
+
+#ifndef EHHT_DEFAULT_LONG_CHAIN_PROBE
+#define EHHT_DEFAULT_LONG_CHAIN_PROBE 8
+#endif
+
+/* pooled keys are rounded up to a multiple of EHHT_KEY_POOL_ALIGN bytes,
+   and each rounded size has a free list; longer keys are malloc'd */
+#ifndef EHHT_KEY_POOL_ALIGN
+#define EHHT_KEY_POOL_ALIGN 8
+#endif
+
+#ifndef EHHT_KEY_POOL_CLASSES
+#define EHHT_KEY_POOL_CLASSES 32
+#endif
+
+/* inline values follow the element, at an offset rounded up to this;
+   define larger for values which need a stricter alignment */
+#ifndef EHHT_VALUE_ALIGN
+#define EHHT_VALUE_ALIGN 8
+#endif
+
+/* in expiry mode, elements are linked into a hierarchical timing wheel
+   of EHHT_WHEEL_LEVELS levels of EHHT_WHEEL_SLOTS slots; a slot at
+   level k spans EHHT_WHEEL_SLOTS^k ticks */
+#define EHHT_WHEEL_BITS 5
+#define EHHT_WHEEL_SLOTS (1UL << EHHT_WHEEL_BITS)
+#define EHHT_WHEEL_MASK (EHHT_WHEEL_SLOTS - 1)
+#define EHHT_WHEEL_LEVELS 6
+#define EHHT_TICK_NEVER ((unsigned long)-1)
+
+/* with bucket tags, the first EHHT_BUCKET_TAGS_LEN elements of each chain
+   have a one byte tag derived from the hashcode */
+#define EHHT_BUCKET_TAGS_LEN 7
+#define EHHT_BUCKET_TAGS_OVERFLOW 255
+
+/* the counting filter is an array of 64 byte blocks of 128 four bit
+   counters; a hashcode sets EHHT_FILTER_HASHES counters of one block,
+   so a check touches one cache line. A counter which reaches
+   EHHT_FILTER_COUNTER_MAX stays there until the filter is rebuilt. */
+#define EHHT_FILTER_BLOCK_BYTES 64
+#define EHHT_FILTER_BLOCK_COUNTERS (2 * EHHT_FILTER_BLOCK_BYTES)
+#define EHHT_FILTER_HASHES 4
+#define EHHT_FILTER_COUNTER_MAX 15
+#ifndef EHHT_FILTER_COUNTERS_PER_BUCKET
+#define EHHT_FILTER_COUNTERS_PER_BUCKET 8
+#endif
+
+#ifdef __GNUC__
+#define Ehht_prefetch(ptr) __builtin_prefetch(ptr)
+#else
+#define Ehht_prefetch(ptr) ((void)(ptr))
+#endif
+
+/* as struct ehht_key, with the CLOCK reference bit of cache mode where
+   struct ehht_key has padding on LP64 */
+struct ehht_element_key {
+	const char *str;
+	size_t len;
+	unsigned hashcode;
+	unsigned char referenced;
+};
 
 struct ehht_element {
-	struct ehht_key key;
+	struct ehht_element_key key;
 	void *val;
 	struct ehht_element *next;
 };
 
+/* the key bytes, or in arena mode the elements and their keys, follow
+   the header */
+struct ehht_key_chunk {
+	struct ehht_key_chunk *next;
+	size_t size;
+	size_t used;
+};
+
+/* eight bytes per bucket, so that a miss can often be decided without
+   touching the chain; len saturates at EHHT_BUCKET_TAGS_OVERFLOW */
+struct ehht_bucket_tags {
+	unsigned char len;
+	unsigned char tag[EHHT_BUCKET_TAGS_LEN];
+};
+
+/* in expiry mode, follows each element */
+struct ehht_ttl {
+	/* 0 if the element does not expire */
+	unsigned long expires;
+	struct ehht_element *wheel_next;
+	struct ehht_element **wheel_prev;
+	unsigned int wheel_slot;
+};
+
+struct ehht_wheel {
+	unsigned long tick_len;
+	/* ticks before this one have been expired */
+	unsigned long tick;
+	/* the latest "now" passed to ehht_expire */
+	unsigned long now;
+	ehht_evict_func expired;
+	void *context;
+	size_t expirations;
+	unsigned long occupied[EHHT_WHEEL_LEVELS];
+	struct ehht_element *slots[EHHT_WHEEL_LEVELS][EHHT_WHEEL_SLOTS];
+};
+
+/* a removed pooled key, the slot is at least EHHT_KEY_POOL_ALIGN bytes */
+struct ehht_key_free {
+	struct ehht_key_free *next;
+};
+
 struct ehht_table {
+	/* first, as in struct ehht_each_table */
+	struct eembed_allocator *ea;
+	struct eembed_log *log;
 	size_t num_buckets;
 	struct ehht_element **buckets;
+	struct ehht_bucket_tags *tags;
+	unsigned char *filter;
+	size_t filter_blocks;
+	size_t filter_negatives;
 	size_t size;
 	ehht_hash_func hash_func;
-	struct eembed_allocator *ea;
-	struct eembed_log *log;
 	double collision_load_factor;
 	int trust_keys_immutable;
+	size_t resizes;
+	unsigned long last_resize_time;
+	ehht_clock_func now;
+	void *now_context;
+	size_t long_chain_probe;
+	size_t key_pool_chunk_size;
+	struct ehht_key_chunk *key_chunks;
+	struct ehht_key_free *key_free[EHHT_KEY_POOL_CLASSES];
+	size_t arena_chunk_size;
+	struct ehht_key_chunk *arena_chunks;
+	size_t value_size;
+	size_t bytes_used;
+	size_t cache_max_entries;
+	size_t cache_max_bytes;
+	ehht_evict_func evict;
+	void *evict_context;
+	size_t cache_hand;
+	size_t evictions;
+	struct ehht_wheel *wheel;
+	int allocator_thread_safe;
+	/* once detached by ehht_free_async */
+	struct ehht_table *reclaim_next;
+	size_t reclaim_bucket;
+	struct ehht_element *reclaim_elements;
+#if EHHT_INSTRUMENT
+	struct ehht_op_stats op_stats;
+#endif
 };
 
 static void ehht_set_table(struct ehht *ht, struct ehht_table *table)
@@ -70,6 +198,7 @@ static struct ehht_table *ehht_get_table(struct ehht *ht)
 {
 	eembed_assert(ht);
 	eembed_assert(ht->data);
+	eembed_assert(ht->destroy == NULL);
 	return (struct ehht_table *)ht->data;
 }
 
@@ -81,13 +210,355 @@ static void ehht_free_const_str(struct eembed_allocator *ea, const char *str)
 	ea->free(ea, ptr);
 }
 
+static struct ehht_key_free *ehht_key_free_slot(const char *str)
+{
+	return (struct ehht_key_free *)str;
+}
+
 #pragma GCC diagnostic pop
 
+static unsigned long ehht_now(struct ehht_table *table)
+{
+	return table->now ? table->now(table->now_context) : 0;
+}
+
+unsigned long ehht_op_histogram_bucket_min(size_t bucket)
+{
+	size_t msb = 0;
+
+	if (bucket < 4) {
+		return (unsigned long)bucket;
+	}
+	msb = (bucket / 4) + 1;
+	return (4UL | (bucket % 4)) << (msb - 2);
+}
+
+#if EHHT_INSTRUMENT
+static size_t ehht_op_histogram_bucket(unsigned long val)
+{
+	size_t msb = 0;
+	size_t bucket = 0;
+
+	if (val < 4) {
+		return (size_t)val;
+	}
+	for (msb = 2; (val >> (msb + 1)) != 0; ++msb) ;
+	bucket = ((msb - 1) * 4) + ((val >> (msb - 2)) & 0x03);
+	if (bucket >= EHHT_OP_HISTOGRAM_LEN) {
+		bucket = EHHT_OP_HISTOGRAM_LEN - 1;
+	}
+	return bucket;
+}
+
+static void ehht_op_histogram_add(struct ehht_op_histogram *hist,
+				  unsigned long val)
+{
+	++(hist->buckets[ehht_op_histogram_bucket(val)]);
+	++(hist->count);
+	hist->total += val;
+	if (val > hist->max) {
+		hist->max = val;
+	}
+}
+#endif
+
+static unsigned int ehht_hash(struct ehht_table *table, const char *key,
+			      size_t key_len)
+{
+	unsigned long start = 0;
+	unsigned int hashcode = 0;
+
+	start = Ehht_instr_now(table);
+	hashcode = table->hash_func(key, key_len);
+	Ehht_instr_count(table, hashes);
+	Ehht_instr_add(table, hash_time, Ehht_instr_now(table) - start);
+
+	return hashcode;
+}
+
+static size_t ehht_key_pool_class(size_t bytes)
+{
+	return (bytes + EHHT_KEY_POOL_ALIGN - 1) / EHHT_KEY_POOL_ALIGN;
+}
+
+static int ehht_key_pooled(struct ehht_table *table, size_t bytes)
+{
+	return table->key_pool_chunk_size
+	    && ehht_key_pool_class(bytes) <= EHHT_KEY_POOL_CLASSES;
+}
+
+static char *ehht_key_pool_alloc(struct ehht_table *table, size_t bytes)
+{
+	struct eembed_allocator *ea = table->ea;
+	struct ehht_key_chunk *chunk = NULL;
+	struct ehht_key_free *slot = NULL;
+	size_t class_num = 0;
+	size_t slot_size = 0;
+	size_t size = 0;
+	char *key = NULL;
+
+	class_num = ehht_key_pool_class(bytes);
+	slot = table->key_free[class_num - 1];
+	if (slot) {
+		table->key_free[class_num - 1] = slot->next;
+		return (char *)slot;
+	}
+
+	slot_size = class_num * EHHT_KEY_POOL_ALIGN;
+	chunk = table->key_chunks;
+	if (chunk == NULL || (chunk->size - chunk->used) < slot_size) {
+		size =
+		    sizeof(struct ehht_key_chunk) + table->key_pool_chunk_size;
+		chunk = (struct ehht_key_chunk *)ea->malloc(ea, size);
+		if (chunk == NULL) {
+			Ehht_error_malloc(table->log, 13, size, "key chunk");
+			return NULL;
+		}
+		chunk->size = table->key_pool_chunk_size;
+		chunk->used = 0;
+		chunk->next = table->key_chunks;
+		table->key_chunks = chunk;
+	}
+	key = ((char *)(chunk + 1)) + chunk->used;
+	chunk->used += slot_size;
+	return key;
+}
+
+static void ehht_key_pool_free(struct ehht_table *table, const char *key,
+			       size_t bytes)
+{
+	struct ehht_key_free *slot = NULL;
+	size_t class_num = 0;
+
+	class_num = ehht_key_pool_class(bytes);
+	slot = ehht_key_free_slot(key);
+	slot->next = table->key_free[class_num - 1];
+	table->key_free[class_num - 1] = slot;
+}
+
+/* only safe once no element refers to a pooled key */
+static void ehht_key_pool_release(struct ehht_table *table)
+{
+	struct ehht_key_chunk *chunk = NULL;
+
+	while ((chunk = table->key_chunks) != NULL) {
+		table->key_chunks = chunk->next;
+		table->ea->free(table->ea, chunk);
+	}
+	eembed_memset(table->key_free, 0x00, sizeof(table->key_free));
+}
+
+/* arena allocations, and the data of each chunk, are aligned as inline
+   values are */
+#define Ehht_arena_round(bytes) \
+	((((bytes) + EHHT_VALUE_ALIGN - 1) / EHHT_VALUE_ALIGN) \
+	 * EHHT_VALUE_ALIGN)
+
+static void *ehht_arena_alloc(struct ehht_table *table, size_t bytes)
+{
+	struct eembed_allocator *ea = table->ea;
+	struct ehht_key_chunk *chunk = NULL;
+	size_t data_size = 0;
+	size_t size = 0;
+	unsigned char *ptr = NULL;
+
+	bytes = Ehht_arena_round(bytes);
+	chunk = table->arena_chunks;
+	if (chunk == NULL || (chunk->size - chunk->used) < bytes) {
+		data_size = table->arena_chunk_size;
+		if (bytes > data_size) {
+			data_size = bytes;
+		}
+		size = Ehht_arena_round(sizeof(struct ehht_key_chunk))
+		    + data_size;
+		chunk = (struct ehht_key_chunk *)ea->malloc(ea, size);
+		if (chunk == NULL) {
+			Ehht_error_malloc(table->log, 30, size, "arena chunk");
+			return NULL;
+		}
+		chunk->size = data_size;
+		chunk->used = 0;
+		if (data_size > table->arena_chunk_size
+		    && table->arena_chunks) {
+			/* behind the current chunk, which still has room */
+			chunk->next = table->arena_chunks->next;
+			table->arena_chunks->next = chunk;
+		} else {
+			chunk->next = table->arena_chunks;
+			table->arena_chunks = chunk;
+		}
+	}
+	ptr = ((unsigned char *)chunk)
+	    + Ehht_arena_round(sizeof(struct ehht_key_chunk)) + chunk->used;
+	chunk->used += bytes;
+	return ptr;
+}
+
+/* only safe once no element is in a chunk; the current chunk may be
+   kept, emptied, for the next elements */
+static void ehht_arena_release(struct ehht_table *table, int keep_current)
+{
+	struct ehht_key_chunk *chunk = NULL;
+	struct ehht_key_chunk *kept = NULL;
+
+	if (keep_current && table->arena_chunks) {
+		kept = table->arena_chunks;
+		table->arena_chunks = kept->next;
+		kept->next = NULL;
+		kept->used = 0;
+	}
+	while ((chunk = table->arena_chunks) != NULL) {
+		table->arena_chunks = chunk->next;
+		table->ea->free(table->ea, chunk);
+	}
+	table->arena_chunks = kept;
+}
+
+static size_t ehht_value_offset(struct ehht_table *table)
+{
+	size_t size = sizeof(struct ehht_element);
+	if (table->wheel) {
+		size += sizeof(struct ehht_ttl);
+	}
+	return ((size + EHHT_VALUE_ALIGN - 1) / EHHT_VALUE_ALIGN)
+	    * EHHT_VALUE_ALIGN;
+}
+
+static size_t ehht_element_size(struct ehht_table *table)
+{
+	if (table->value_size) {
+		return ehht_value_offset(table) + table->value_size;
+	}
+	if (table->wheel) {
+		return sizeof(struct ehht_element) + sizeof(struct ehht_ttl);
+	}
+	return sizeof(struct ehht_element);
+}
+
+static struct ehht_ttl *ehht_ttl(struct ehht_element *element)
+{
+	unsigned char *bytes = (unsigned char *)element;
+	return (struct ehht_ttl *)(bytes + sizeof(struct ehht_element));
+}
+
+static void ehht_wheel_link(struct ehht_wheel *wheel,
+			    struct ehht_element *element)
+{
+	struct ehht_ttl *ttl = NULL;
+	struct ehht_element **slot = NULL;
+	unsigned long tick = 0;
+	unsigned long delta = 0;
+	size_t level = 0;
+	size_t idx = 0;
+
+	ttl = ehht_ttl(element);
+	tick = ttl->expires / wheel->tick_len;
+	if (tick < wheel->tick) {
+		tick = wheel->tick;
+	}
+	delta = tick - wheel->tick;
+	while (level < (EHHT_WHEEL_LEVELS - 1)
+	       && (delta >> (EHHT_WHEEL_BITS * (level + 1))) != 0) {
+		++level;
+	}
+	if ((delta >> (EHHT_WHEEL_BITS * (level + 1))) != 0) {
+		/* beyond the wheel, it will be re-linked when reached */
+		tick = wheel->tick
+		    + ((1UL << (EHHT_WHEEL_BITS * EHHT_WHEEL_LEVELS)) - 1);
+	}
+	idx = (tick >> (EHHT_WHEEL_BITS * level)) & EHHT_WHEEL_MASK;
+
+	slot = &(wheel->slots[level][idx]);
+	ttl->wheel_next = *slot;
+	if (*slot) {
+		ehht_ttl(*slot)->wheel_prev = &(ttl->wheel_next);
+	}
+	ttl->wheel_prev = slot;
+	ttl->wheel_slot = (unsigned int)((level * EHHT_WHEEL_SLOTS) + idx);
+	*slot = element;
+	wheel->occupied[level] |= (1UL << idx);
+}
+
+static void ehht_wheel_unlink(struct ehht_wheel *wheel,
+			      struct ehht_element *element)
+{
+	struct ehht_ttl *ttl = NULL;
+	size_t level = 0;
+	size_t idx = 0;
+
+	ttl = ehht_ttl(element);
+	if (!ttl->wheel_prev) {
+		return;
+	}
+	*(ttl->wheel_prev) = ttl->wheel_next;
+	if (ttl->wheel_next) {
+		ehht_ttl(ttl->wheel_next)->wheel_prev = ttl->wheel_prev;
+	}
+	level = ttl->wheel_slot / EHHT_WHEEL_SLOTS;
+	idx = ttl->wheel_slot % EHHT_WHEEL_SLOTS;
+	if (!wheel->slots[level][idx]) {
+		wheel->occupied[level] &= ~(1UL << idx);
+	}
+	ttl->wheel_next = NULL;
+	ttl->wheel_prev = NULL;
+}
+
+static void ehht_ttl_set(struct ehht_table *table,
+			 struct ehht_element *element, unsigned long expires)
+{
+	ehht_wheel_unlink(table->wheel, element);
+	ehht_ttl(element)->expires = expires;
+	if (expires) {
+		ehht_wheel_link(table->wheel, element);
+	}
+}
+
+/* the clock, if set, otherwise the latest "now" given to ehht_expire */
+static unsigned long ehht_expiry_now(struct ehht_table *table)
+{
+	return table->now ? ehht_now(table) : table->wheel->now;
+}
+
+static int ehht_expired(struct ehht_table *table,
+			struct ehht_element *element)
+{
+	unsigned long expires = 0;
+
+	if (!table->wheel) {
+		return 0;
+	}
+	expires = ehht_ttl(element)->expires;
+	return (expires && expires <= ehht_expiry_now(table)) ? 1 : 0;
+}
+
+/* what an element costs, as counted against ehht_cache_limit bytes */
+static size_t ehht_element_bytes(struct ehht_table *table, size_t key_len)
+{
+	size_t bytes = ehht_element_size(table);
+	if (!table->trust_keys_immutable) {
+		bytes += key_len + 1;
+	}
+	return bytes;
+}
+
 static void ehht_free_element(struct ehht_table *table,
 			      struct ehht_element *element)
 {
 	struct eembed_allocator *ea = table->ea;
-	if (!table->trust_keys_immutable) {
+	table->bytes_used -= ehht_element_bytes(table, element->key.len);
+	if (table->wheel) {
+		ehht_wheel_unlink(table->wheel, element);
+	}
+	if (table->arena_chunk_size) {
+		/* the arena is freed as a whole by clear and ehht_free */
+		return;
+	}
+	if (table->trust_keys_immutable) {
+		/* not ours to free */
+	} else if (ehht_key_pooled(table, element->key.len + 1)) {
+		ehht_key_pool_free(table, element->key.str,
+				   element->key.len + 1);
+	} else {
 		ehht_free_const_str(ea, element->key.str);
 	}
 	ea->free(ea, element);
@@ -100,14 +571,40 @@ static void ehht_clear(struct ehht *ht)
 
 	table = ehht_get_table(ht);
 
-	for (i = 0; i < table->num_buckets; ++i) {
-		struct ehht_element *element = NULL;
-		while ((element = table->buckets[i]) != NULL) {
-			table->buckets[i] = element->next;
-			ehht_free_element(table, element);
+	if (table->arena_chunk_size) {
+		/* no element needs to be visited */
+		eembed_memset(table->buckets, 0x00,
+			      sizeof(struct ehht_element *) *
+			      table->num_buckets);
+		if (table->wheel) {
+			eembed_memset(table->wheel->slots, 0x00,
+				      sizeof(table->wheel->slots));
+			eembed_memset(table->wheel->occupied, 0x00,
+				      sizeof(table->wheel->occupied));
+		}
+		ehht_arena_release(table, 1);
+		table->bytes_used = 0;
+	} else {
+		for (i = 0; i < table->num_buckets; ++i) {
+			struct ehht_element *element = NULL;
+			while ((element = table->buckets[i]) != NULL) {
+				table->buckets[i] = element->next;
+				ehht_free_element(table, element);
+			}
 		}
 	}
 	table->size = 0;
+	if (table->tags) {
+		eembed_memset(table->tags, 0x00,
+			      sizeof(struct ehht_bucket_tags) *
+			      table->num_buckets);
+	}
+	if (table->filter) {
+		eembed_memset(table->filter, 0x00,
+			      EHHT_FILTER_BLOCK_BYTES * table->filter_blocks);
+	}
+	table->cache_hand = 0;
+	ehht_key_pool_release(table);
 }
 
 static size_t ehht_bucket_for_hashcode(unsigned int hashcode,
@@ -116,13 +613,168 @@ static size_t ehht_bucket_for_hashcode(unsigned int hashcode,
 	return (size_t)(hashcode % num_buckets);
 }
 
+/* the bucket is chosen by the low bits, so the tag uses the high bits
+   of a multiplicative hash of the hashcode */
+static unsigned char ehht_tag_for_hashcode(unsigned int hashcode)
+{
+	unsigned long mixed = (hashcode * 2654435761UL) & 0xFFFFFFFFUL;
+	return (unsigned char)(mixed >> 24);
+}
+
+static void ehht_tags_push(struct ehht_bucket_tags *tags,
+			   unsigned int hashcode)
+{
+	size_t i = 0;
+
+	for (i = EHHT_BUCKET_TAGS_LEN - 1; i > 0; --i) {
+		tags->tag[i] = tags->tag[i - 1];
+	}
+	tags->tag[0] = ehht_tag_for_hashcode(hashcode);
+	if (tags->len < EHHT_BUCKET_TAGS_OVERFLOW) {
+		++(tags->len);
+	}
+}
+
+static void ehht_tags_rebuild(struct ehht_bucket_tags *tags,
+			      struct ehht_element *head)
+{
+	struct ehht_element *element = NULL;
+	size_t len = 0;
+
+	eembed_memset(tags, 0x00, sizeof(struct ehht_bucket_tags));
+	for (element = head; element != NULL; element = element->next) {
+		if (len < EHHT_BUCKET_TAGS_LEN) {
+			tags->tag[len] =
+			    ehht_tag_for_hashcode(element->key.hashcode);
+		}
+		if (len < EHHT_BUCKET_TAGS_OVERFLOW) {
+			++len;
+		}
+	}
+	tags->len = (unsigned char)len;
+}
+
+static size_t ehht_filter_blocks_for(size_t num_buckets)
+{
+	size_t counters = num_buckets * EHHT_FILTER_COUNTERS_PER_BUCKET;
+	return (counters + EHHT_FILTER_BLOCK_COUNTERS -
+		1) / EHHT_FILTER_BLOCK_COUNTERS;
+}
+
+/* op: 1 to increment, -1 to decrement, 0 to test; returns 0 only if the
+   test found a zero counter */
+static int ehht_filter_update(unsigned char *filter, size_t filter_blocks,
+			      unsigned int hashcode, int op)
+{
+	unsigned long mixed = 0;
+	unsigned char *block = NULL;
+	unsigned char *byte = NULL;
+	unsigned int counter = 0;
+	unsigned int shift = 0;
+	size_t pos = 0;
+	size_t i = 0;
+
+	/* the bucket is hashcode % num_buckets, so mix before choosing */
+	mixed = (hashcode * 2654435761UL) & 0xFFFFFFFFUL;
+	block = filter + (EHHT_FILTER_BLOCK_BYTES
+			  * ((mixed ^ (mixed >> 16)) % filter_blocks));
+	mixed = ((hashcode ^ (hashcode >> 15)) * 2246822519UL) & 0xFFFFFFFFUL;
+	for (i = 0; i < EHHT_FILTER_HASHES; ++i) {
+		pos = (mixed >> (7 * i)) % EHHT_FILTER_BLOCK_COUNTERS;
+		byte = block + (pos / 2);
+		shift = (pos & 1) ? 4 : 0;
+		counter = ((*byte) >> shift) & 0x0F;
+		if (op == 0) {
+			if (counter == 0) {
+				return 0;
+			}
+		} else if (counter == EHHT_FILTER_COUNTER_MAX) {
+			continue;
+		} else if (op > 0) {
+			*byte = (unsigned char)(*byte + (1U << shift));
+		} else if (counter) {
+			*byte = (unsigned char)(*byte - (1U << shift));
+		}
+	}
+	return 1;
+}
+
+static int ehht_filter_may_contain(struct ehht_table *table,
+				   unsigned int hashcode)
+{
+	return ehht_filter_update(table->filter, table->filter_blocks,
+				  hashcode, 0);
+}
+
+static void ehht_filter_rebuild(struct ehht_table *table)
+{
+	struct ehht_element *element = NULL;
+	size_t i = 0;
+
+	if (!table->filter) {
+		return;
+	}
+	eembed_memset(table->filter, 0x00,
+		      EHHT_FILTER_BLOCK_BYTES * table->filter_blocks);
+	for (i = 0; i < table->num_buckets; ++i) {
+		for (element = table->buckets[i]; element != NULL;
+		     element = element->next) {
+			ehht_filter_update(table->filter, table->filter_blocks,
+					   element->key.hashcode, 1);
+		}
+	}
+}
+
+/* all additions to a chain go through here, to keep the tags and the
+   filter in sync */
+static void ehht_bucket_link(struct ehht_table *table, size_t bucket_num,
+			     struct ehht_element *element)
+{
+	element->next = table->buckets[bucket_num];
+	table->buckets[bucket_num] = element;
+	if (table->tags) {
+		ehht_tags_push(&(table->tags[bucket_num]),
+			       element->key.hashcode);
+	}
+	if (table->filter) {
+		ehht_filter_update(table->filter, table->filter_blocks,
+				   element->key.hashcode, 1);
+	}
+}
+
+/* all removals from a chain go through here, to keep the tags and the
+   filter in sync */
+static void ehht_bucket_unlink(struct ehht_table *table, size_t bucket_num,
+			       struct ehht_element *element)
+{
+	struct ehht_element **ptr_to_element = NULL;
+
+	/* find what points to this element */
+	ptr_to_element = &(table->buckets[bucket_num]);
+	while (*ptr_to_element != element) {
+		ptr_to_element = &((*ptr_to_element)->next);
+	}
+	/* make that point to the next element */
+	*ptr_to_element = element->next;
+	element->next = NULL;
+
+	if (table->tags) {
+		ehht_tags_rebuild(&(table->tags[bucket_num]),
+				  table->buckets[bucket_num]);
+	}
+	if (table->filter) {
+		ehht_filter_update(table->filter, table->filter_blocks,
+				   element->key.hashcode, -1);
+	}
+}
+
 size_t ehht_bucket_for_key(struct ehht *ht, const char *key, size_t key_len)
 {
 	struct ehht_table *table = NULL;
 	unsigned int hashcode = 0;
 
 	table = ehht_get_table(ht);
-	hashcode = table->hash_func(key, key_len);
+	hashcode = ehht_hash(table, key, key_len);
 
 	return ehht_bucket_for_hashcode(hashcode, table->num_buckets);
 }
@@ -136,13 +788,30 @@ static struct ehht_element *ehht_alloc_element(struct ehht_table *table,
 	char *key_copy = NULL;
 	struct ehht_element *element = NULL;
 	size_t size = 0;
+	unsigned long start = 0;
+
+	start = Ehht_instr_now(table);
+	Ehht_instr_count(table, allocs);
 
-	size = sizeof(struct ehht_element);
+	size = ehht_element_size(table);
 	ea = table->ea;
-	element = (struct ehht_element *)ea->malloc(ea, size);
-	if (element == NULL) {
-		Ehht_error_malloc(table->log, 1, size, "struct ehht_element");
-		return NULL;
+	if (table->arena_chunk_size) {
+		/* the key copy follows the element */
+		element = (struct ehht_element *)
+		    ehht_arena_alloc(table, Ehht_arena_round(size)
+				     + (table->trust_keys_immutable ? 0
+					: key_len + 1));
+		if (element == NULL) {
+			return NULL;
+		}
+		key_copy = ((char *)element) + Ehht_arena_round(size);
+	} else {
+		element = (struct ehht_element *)ea->malloc(ea, size);
+		if (element == NULL) {
+			Ehht_error_malloc(table->log, 1, size,
+					  "struct ehht_element");
+			return NULL;
+		}
 	}
 	eembed_memset(element, 0x00, size);
 
@@ -152,10 +821,20 @@ static struct ehht_element *ehht_alloc_element(struct ehht_table *table,
 		size = key_len + 1;
 		eembed_assert(size > 0);
 		ea = table->ea;
-		key_copy = (char *)ea->malloc(ea, size);
+		if (table->arena_chunk_size) {
+			/* already allocated */
+		} else if (ehht_key_pooled(table, size)) {
+			/* logs its own failure, once, with the chunk size */
+			key_copy = ehht_key_pool_alloc(table, size);
+		} else {
+			key_copy = (char *)ea->malloc(ea, size);
+			if (!key_copy) {
+				Ehht_error_malloc(table->log, 2, size,
+						  "key copy");
+			}
+		}
 		if (!key_copy) {
-			Ehht_error_malloc(table->log, 2, size, "key copy");
-			ehht_free_element(table, element);
+			ea->free(ea, element);
 			return NULL;
 		}
 		eembed_memset(key_copy, 0x00, size);
@@ -167,11 +846,20 @@ static struct ehht_element *ehht_alloc_element(struct ehht_table *table,
 
 	element->key.len = key_len;
 	element->key.hashcode = hashcode;
-	element->val = val;
+	if (table->value_size) {
+		/* the value lives as long as the element, resize relinks
+		   elements without moving them */
+		element->val =
+		    ((unsigned char *)element) + ehht_value_offset(table);
+	} else {
+		element->val = val;
+	}
 	element->next = NULL;
 
 	++(table->size);
+	table->bytes_used += ehht_element_bytes(table, key_len);
 
+	Ehht_instr_add(table, alloc_time, Ehht_instr_now(table) - start);
 	return element;
 }
 
@@ -191,60 +879,188 @@ unsigned int ehht_kr2_hashcode(const char *data, size_t len)
 	return hash;
 }
 
-static struct ehht_element *ehht_get_element(struct ehht_table *table,
-					     const char *key, size_t key_len)
+/* returns 0 only if no element of the chain can have this hashcode */
+static int ehht_tags_may_contain(struct ehht_bucket_tags *tags,
+				 unsigned int hashcode)
 {
-	struct ehht_element *element = NULL;
-	unsigned int hashcode = 0;
-	size_t bucket_num = 0;
+	unsigned char tag = 0;
+	size_t i = 0;
+
+	if (tags->len > EHHT_BUCKET_TAGS_LEN) {
+		return 1;
+	}
+	tag = ehht_tag_for_hashcode(hashcode);
+	for (i = 0; i < tags->len; ++i) {
+		if (tags->tag[i] == tag) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static struct ehht_key ehht_key_of(struct ehht_element *element)
+{
+	struct ehht_key key;
+
+	key.str = element->key.str;
+	key.len = element->key.len;
+	key.hashcode = element->key.hashcode;
+	return key;
+}
+
+/* frees an expired element which is no longer in a bucket */
+static void ehht_reap_unlinked(struct ehht_table *table,
+			       struct ehht_element *element)
+{
+	struct ehht_wheel *wheel = table->wheel;
+
+	++(wheel->expirations);
+	if (wheel->expired) {
+		(*wheel->expired) (ehht_key_of(element), element->val,
+				    wheel->context);
+	}
+	ehht_free_element(table, element);
+}
+
+static void ehht_reap(struct ehht_table *table, struct ehht_element *element)
+{
+	size_t bucket_num = 0;
+
+	bucket_num = ehht_bucket_for_hashcode(element->key.hashcode,
+					      table->num_buckets);
+	ehht_bucket_unlink(table, bucket_num, element);
+	--(table->size);
+	ehht_reap_unlinked(table, element);
+}
+
+static struct ehht_element *ehht_get_element_hashed(struct ehht_table *table,
+						    const char *key,
+						    size_t key_len,
+						    unsigned int hashcode)
+{
+	struct ehht_element *element = NULL;
+	size_t bucket_num = 0;
+	unsigned long visited = 0;
+
+	if (table->filter && !ehht_filter_may_contain(table, hashcode)) {
+		++(table->filter_negatives);
+		Ehht_instr_record(table, nodes_visited, visited);
+		return NULL;
+	}
 
-	hashcode = table->hash_func(key, key_len);
 	bucket_num = ehht_bucket_for_hashcode(hashcode, table->num_buckets);
 
+	if (table->tags && !ehht_tags_may_contain(&(table->tags[bucket_num]),
+						   hashcode)) {
+		Ehht_instr_record(table, nodes_visited, visited);
+		return NULL;
+	}
+
 	element = table->buckets[bucket_num];
 	while (element != NULL) {
-		if (element->key.len == key_len) {
-			if (eembed_memcmp(key, element->key.str, key_len) == 0) {
-				return element;
+		++visited;
+		if (element->key.len == key_len
+		    && (!table->tags || element->key.hashcode == hashcode)) {
+			if (eembed_memcmp(key, element->key.str, key_len)
+			    == 0) {
+				break;
 			}
 		}
 		element = element->next;
 	}
-	return NULL;
+	Ehht_instr_record(table, nodes_visited, visited);
+#if EHHT_USDT
+	if (table->long_chain_probe && visited > table->long_chain_probe) {
+		Ehht_probe4(long__chain, table, visited, key, key_len);
+	}
+#endif
+	if (element && ehht_expired(table, element)) {
+		ehht_reap(table, element);
+		element = NULL;
+	}
+	return element;
+}
+
+static struct ehht_element *ehht_get_element(struct ehht_table *table,
+					     const char *key, size_t key_len)
+{
+	unsigned int hashcode = ehht_hash(table, key, key_len);
+	return ehht_get_element_hashed(table, key, key_len, hashcode);
 }
 
 static void *ehht_get(struct ehht *ht, const char *key, size_t key_len)
 {
-	struct ehht_table *table = NULL;
-	struct ehht_element *element = NULL;
+	return ehht_lookup(ht, key, key_len, NULL);
+}
 
-	table = ehht_get_table(ht);
+static int ehht_cache_mode(struct ehht_table *table)
+{
+	return (table->cache_max_entries || table->cache_max_bytes) ? 1 : 0;
+}
 
-	element = ehht_get_element(table, key, key_len);
-	return (element == NULL) ? NULL : element->val;
+static int ehht_cache_over_limit(struct ehht_table *table)
+{
+	if (table->cache_max_entries
+	    && table->size > table->cache_max_entries) {
+		return 1;
+	}
+	if (table->cache_max_bytes
+	    && table->bytes_used > table->cache_max_bytes) {
+		return 1;
+	}
+	return 0;
 }
 
-static void *ehht_put(struct ehht *ht, const char *key, size_t key_len,
-		      void *val, int *err)
+/* CLOCK, with the hand sweeping bucket by bucket: in each bucket, it
+   clears the reference bits of the elements which have one, and evicts
+   the first element without one; "keep" is never evicted */
+static void ehht_cache_evict(struct ehht_table *table,
+			     struct ehht_element *keep)
 {
-	struct ehht_table *table = NULL;
+	struct ehht_element *victim = NULL;
 	struct ehht_element *element = NULL;
-	void *old_val = NULL;
-	unsigned int hashcode = 0;
+	size_t steps = 0;
+	size_t hand = 0;
+
+	while (ehht_cache_over_limit(table)) {
+		victim = NULL;
+		for (steps = 0; steps <= (2 * table->num_buckets) && !victim;
+		     ++steps) {
+			hand = table->cache_hand;
+			table->cache_hand = (hand + 1) % table->num_buckets;
+			for (element = table->buckets[hand]; element != NULL;
+			     element = element->next) {
+				if (element != keep
+				    && !element->key.referenced) {
+					victim = element;
+					break;
+				}
+				element->key.referenced = 0;
+			}
+		}
+		if (!victim) {
+			return;
+		}
+		ehht_bucket_unlink(table, hand, victim);
+		--(table->size);
+		++(table->evictions);
+		Ehht_probe3(evict, table, victim->key.str, victim->key.len);
+		if (table->evict) {
+			(*table->evict) (ehht_key_of(victim), victim->val,
+					 table->evict_context);
+		}
+		ehht_free_element(table, victim);
+	}
+}
+
+/* before adding an element with this hashcode */
+static void ehht_grow_on_collision(struct ehht *ht, unsigned int hashcode)
+{
+	struct ehht_table *table = NULL;
 	unsigned int collision = 0;
 	size_t bucket_num = 0;
 
 	table = ehht_get_table(ht);
-
-	element = ehht_get_element(table, key, key_len);
-	old_val = (element == NULL) ? NULL : element->val;
-
-	if (element != NULL) {
-		element->val = val;
-		return old_val;
-	}
-
-	hashcode = table->hash_func(key, key_len);
 	bucket_num = ehht_bucket_for_hashcode(hashcode, table->num_buckets);
 	collision = (table->buckets[bucket_num] == NULL) ? 0 : 1;
 	if (collision && table->collision_load_factor > 0.0) {
@@ -253,8 +1069,40 @@ static void *ehht_put(struct ehht *ht, const char *key, size_t key_len,
 			ehht_buckets_resize(ht, 0);
 		}
 	}
+}
 
-	element = ehht_alloc_element(table, key, key_len, hashcode, val);
+/* finds the element for the key, or adds a new one
+   sets *inserted if the element is new, its val is NULL or zeroed */
+static struct ehht_element *ehht_put_element(struct ehht *ht,
+					     const char *key, size_t key_len,
+					     int *inserted, int *err)
+{
+	struct ehht_table *table = NULL;
+	struct ehht_element *element = NULL;
+	unsigned int hashcode = 0;
+	size_t bucket_num = 0;
+	unsigned long start = 0;
+
+	table = ehht_get_table(ht);
+	start = Ehht_instr_now(table);
+	Ehht_instr_count(table, puts);
+	*inserted = 0;
+
+	hashcode = ehht_hash(table, key, key_len);
+	element = ehht_get_element_hashed(table, key, key_len, hashcode);
+	if (element != NULL) {
+		if (ehht_cache_mode(table)) {
+			element->key.referenced = 1;
+		}
+		Ehht_instr_count(table, put_updates);
+		Ehht_instr_record(table, put_latency,
+				  Ehht_instr_now(table) - start);
+		return element;
+	}
+
+	ehht_grow_on_collision(ht, hashcode);
+
+	element = ehht_alloc_element(table, key, key_len, hashcode, NULL);
 	if (!element) {
 		if (err) {
 			*err = 1;
@@ -264,319 +1112,1164 @@ static void *ehht_put(struct ehht *ht, const char *key, size_t key_len,
 	}
 
 	bucket_num = ehht_bucket_for_hashcode(hashcode, table->num_buckets);
-	element->next = table->buckets[bucket_num];
-	table->buckets[bucket_num] = element;
+	ehht_bucket_link(table, bucket_num, element);
+	*inserted = 1;
+	if (ehht_cache_mode(table)) {
+		/* as with SIEVE, a new key is not yet referenced, so that
+		   one-time keys are evicted before those read again */
+		ehht_cache_evict(table, element);
+	}
 
-	return NULL;
+	Ehht_instr_record(table, put_latency, Ehht_instr_now(table) - start);
+	return element;
+}
+
+/* returns what "put" returns */
+static void *ehht_set_val(struct ehht_table *table,
+			  struct ehht_element *element, void *val)
+{
+	void *old_val = NULL;
+
+	if (table->value_size) {
+		if (val) {
+			eembed_memcpy(element->val, val, table->value_size);
+		} else {
+			eembed_memset(element->val, 0x00, table->value_size);
+		}
+		return element->val;
+	}
+
+	old_val = element->val;
+	element->val = val;
+	return old_val;
+}
+
+static void *ehht_put(struct ehht *ht, const char *key, size_t key_len,
+		      void *val, int *err)
+{
+	struct ehht_table *table = NULL;
+	struct ehht_element *element = NULL;
+	int inserted = 0;
+
+	table = ehht_get_table(ht);
+	element = ehht_put_element(ht, key, key_len, &inserted, err);
+	if (element == NULL) {
+		return NULL;
+	}
+	return ehht_set_val(table, element, val);
+}
+
+void *ehht_put_with_ttl(struct ehht *ht, const char *key, size_t key_len,
+			void *val, unsigned long ttl, int *err)
+{
+	struct ehht_table *table = NULL;
+	struct ehht_element *element = NULL;
+	void *old_val = NULL;
+	unsigned long expires = 0;
+	int inserted = 0;
+
+	table = ehht_get_table(ht);
+	if (!table->wheel) {
+		Ehht_error(table->log, 27,
+			   "ehht_put_with_ttl needs ehht_expiry");
+		if (err) {
+			*err = 1;
+		}
+		return NULL;
+	}
+	element = ehht_put_element(ht, key, key_len, &inserted, err);
+	if (element == NULL) {
+		return NULL;
+	}
+	old_val = ehht_set_val(table, element, val);
+	if (ttl) {
+		expires = ehht_expiry_now(table) + ttl;
+	}
+	ehht_ttl_set(table, element, expires);
+	return old_val;
+}
+
+void *ehht_put_slot(struct ehht *ht, const char *key, size_t key_len,
+		    int *err)
+{
+	struct ehht_table *table = NULL;
+	struct ehht_element *element = NULL;
+	int inserted = 0;
+
+	table = ehht_get_table(ht);
+	element = ehht_put_element(ht, key, key_len, &inserted, err);
+	if (element == NULL) {
+		return NULL;
+	}
+	return table->value_size ? element->val : (void *)&(element->val);
+}
+
+void **ehht_entry(struct ehht *ht, const char *key, size_t key_len,
+		  int *inserted, int *err)
+{
+	struct ehht_element *element = NULL;
+	int ignored = 0;
+
+	if (!inserted) {
+		inserted = &ignored;
+	}
+	element = ehht_put_element(ht, key, key_len, inserted, err);
+	return (element == NULL) ? NULL : &(element->val);
+}
+
+void *ehht_lookup(struct ehht *ht, const char *key, size_t key_len,
+		  int *found)
+{
+	struct ehht_table *table = NULL;
+	struct ehht_element *element = NULL;
+	unsigned long start = 0;
+
+	table = ehht_get_table(ht);
+	start = Ehht_instr_now(table);
+
+	element = ehht_get_element(table, key, key_len);
+
+	Ehht_instr_count(table, gets);
+	if (element == NULL) {
+		Ehht_instr_count(table, get_misses);
+	} else {
+		Ehht_instr_count(table, get_hits);
+	}
+	Ehht_instr_record(table, get_latency, Ehht_instr_now(table) - start);
+
+	if (element && ehht_cache_mode(table)) {
+		element->key.referenced = 1;
+	}
+	if (found) {
+		*found = (element == NULL) ? 0 : 1;
+	}
+	return (element == NULL) ? NULL : element->val;
 }
 
 static void *ehht_remove(struct ehht *ht, const char *key, size_t key_len)
 {
 	struct ehht_table *table = NULL;
 	struct ehht_element *element = NULL;
-	struct ehht_element **ptr_to_element = NULL;
 	void *old_val = 0;
-	unsigned int hashcode = 0;
 	size_t bucket_num = 0;
+	unsigned long start = 0;
 
 	table = ehht_get_table(ht);
+	start = Ehht_instr_now(table);
+	Ehht_instr_count(table, removes);
 
 	element = ehht_get_element(table, key, key_len);
 	if (element == NULL) {
+		Ehht_instr_record(table, remove_latency,
+				  Ehht_instr_now(table) - start);
 		return NULL;
 	}
+	Ehht_instr_count(table, remove_hits);
 
-	old_val = element->val;
+	/* an inline value is freed with the element */
+	old_val = table->value_size ? NULL : element->val;
 
-	hashcode = table->hash_func(key, key_len);
-	bucket_num = ehht_bucket_for_hashcode(hashcode, table->num_buckets);
-
-	/* find what points to this element */
-	ptr_to_element = &(table->buckets[bucket_num]);
-	while (*ptr_to_element != element) {
-		ptr_to_element = &((*ptr_to_element)->next);
-	}
-	/* make that point to the next element */
-	*ptr_to_element = element->next;
+	bucket_num = ehht_bucket_for_hashcode(element->key.hashcode,
+					      table->num_buckets);
+	ehht_bucket_unlink(table, bucket_num, element);
 
 	--(table->size);
 	ehht_free_element(table, element);
 
-	return old_val;
+	Ehht_instr_record(table, remove_latency, Ehht_instr_now(table) - start);
+	return old_val;
+}
+
+static int ehht_for_each(struct ehht *ht,
+			 int (*func)(struct ehht_key each_key,
+				     void *each_val, void *context),
+			 void *context)
+{
+	struct ehht_table *table = NULL;
+	size_t i = 0;
+	size_t end = 0;
+	struct ehht_element *element = NULL;
+
+	table = ehht_get_table(ht);
+
+	end = 0;
+	for (i = 0; i < table->num_buckets && !end; ++i) {
+		if (table->tags && table->tags[i].len == 0) {
+			continue;
+		}
+		if ((i + 1) < table->num_buckets) {
+			Ehht_prefetch(table->buckets[i + 1]);
+		}
+		for (element = table->buckets[i]; element != NULL;
+		     element = element->next) {
+			end = (*func) (ehht_key_of(element), element->val,
+				       context);
+		}
+	}
+
+	return end;
+}
+
+static size_t ehht_size(struct ehht *ht)
+{
+	struct ehht_table *table = NULL;
+	size_t size = 0;
+
+	table = ehht_get_table(ht);
+	size = table->size;
+
+	return size;
+}
+
+size_t ehht_buckets_resize(struct ehht *ht, size_t num_buckets)
+{
+	size_t i = 0;
+	size_t old_num_buckets = 0;
+	size_t new_bucket_num = 0;
+	size_t size = 0;
+	struct ehht_table *table = NULL;
+	struct ehht_element **new_buckets = NULL;
+	struct ehht_element **old_buckets = NULL;
+	struct ehht_bucket_tags *new_tags = NULL;
+	unsigned char *new_filter = NULL;
+	size_t new_filter_blocks = 0;
+	struct eembed_allocator *ea = NULL;
+	unsigned long start = 0;
+
+	table = ehht_get_table(ht);
+	ea = table->ea;
+	start = ehht_now(table);
+
+	if (num_buckets == 0) {
+		num_buckets = table->num_buckets * 2;
+	}
+	eembed_assert(num_buckets > 1);
+	Ehht_probe3(resize__start, table, table->num_buckets, num_buckets);
+	size = sizeof(struct ehht_element *) * num_buckets;
+	eembed_assert(size > 0);
+	new_buckets = (struct ehht_element **)ea->malloc(ea, size);
+	if (new_buckets == NULL) {
+		Ehht_error_malloc(table->log, 4, size, "buckets");
+		Ehht_probe4(resize__end, table, table->num_buckets,
+			    table->num_buckets, ehht_now(table) - start);
+		return table->num_buckets;
+	}
+	eembed_assert(size > 0);
+	eembed_memset(new_buckets, 0x00, size);
+
+	if (table->tags) {
+		size = sizeof(struct ehht_bucket_tags) * num_buckets;
+		new_tags = (struct ehht_bucket_tags *)ea->malloc(ea, size);
+		if (new_tags == NULL) {
+			Ehht_error_malloc(table->log, 15, size, "bucket tags");
+			ea->free(ea, new_buckets);
+			Ehht_probe4(resize__end, table, table->num_buckets,
+				    table->num_buckets,
+				    ehht_now(table) - start);
+			return table->num_buckets;
+		}
+		eembed_memset(new_tags, 0x00, size);
+	}
+
+	/* the filter is rebuilt as the elements are relinked */
+	if (table->filter) {
+		new_filter_blocks = ehht_filter_blocks_for(num_buckets);
+		size = EHHT_FILTER_BLOCK_BYTES * new_filter_blocks;
+		new_filter = (unsigned char *)ea->malloc(ea, size);
+		if (new_filter == NULL) {
+			Ehht_error_malloc(table->log, 29, size, "filter");
+			ea->free(ea, new_tags);
+			ea->free(ea, new_buckets);
+			Ehht_probe4(resize__end, table, table->num_buckets,
+				    table->num_buckets,
+				    ehht_now(table) - start);
+			return table->num_buckets;
+		}
+		eembed_memset(new_filter, 0x00, size);
+	}
+
+	if (table->cache_hand >= num_buckets) {
+		table->cache_hand = 0;
+	}
+	if (new_tags) {
+		ea->free(ea, table->tags);
+		table->tags = new_tags;
+	}
+	if (new_filter) {
+		ea->free(ea, table->filter);
+		table->filter = new_filter;
+		table->filter_blocks = new_filter_blocks;
+	}
+
+	old_num_buckets = table->num_buckets;
+	old_buckets = table->buckets;
+	table->buckets = new_buckets;
+	table->num_buckets = num_buckets;
+	for (i = 0; i < old_num_buckets; ++i) {
+		struct ehht_element *element = NULL;
+		while ((element = old_buckets[i]) != NULL) {
+			old_buckets[i] = element->next;
+			new_bucket_num =
+			    ehht_bucket_for_hashcode(element->key.hashcode,
+						     num_buckets);
+			ehht_bucket_link(table, new_bucket_num, element);
+		}
+	}
+	++(table->resizes);
+	table->last_resize_time = ehht_now(table);
+	Ehht_instr_count(table, resizes);
+	Ehht_instr_add(table, resize_time, table->last_resize_time - start);
+	Ehht_probe4(resize__end, table, old_num_buckets, num_buckets,
+		    table->last_resize_time - start);
+
+	ea->free(ea, old_buckets);
+	return num_buckets;
+}
+
+size_t ehht_buckets_size(struct ehht *ht)
+{
+	struct ehht_table *table = NULL;
+
+	table = ehht_get_table(ht);
+	return table->num_buckets;
+}
+
+static int ehht_has_key(struct ehht *ht, const char *key, size_t key_len)
+{
+	struct ehht_table *table = NULL;
+	struct ehht_element *element = NULL;
+
+	table = ehht_get_table(ht);
+	Ehht_instr_count(table, has_keys);
+
+	element = ehht_get_element(table, key, key_len);
+	return (element == NULL) ? 0 : 1;
+}
+
+void ehht_buckets_auto_resize_load_factor(struct ehht *ht, double factor)
+{
+	struct ehht_table *table = NULL;
+
+	table = ehht_get_table(ht);
+	table->collision_load_factor = factor;
+}
+
+int ehht_trust_keys_immutable(struct ehht *ht, int val)
+{
+	struct ehht_table *table = NULL;
+	int new_val = val ? 1 : 0;
+
+	table = ehht_get_table(ht);
+	if (table->size && new_val != table->trust_keys_immutable) {
+		Ehht_error(table->log, 12,
+			   "invalid attempt to change key immutablity");
+		return 1;
+	}
+	table->trust_keys_immutable = new_val;
+	return 0;
+}
+
+int ehht_pool_keys(struct ehht *ht, size_t chunk_size)
+{
+	struct ehht_table *table = NULL;
+	size_t min_chunk = EHHT_KEY_POOL_CLASSES * EHHT_KEY_POOL_ALIGN;
+
+	table = ehht_get_table(ht);
+	if (table->size) {
+		Ehht_error(table->log, 14,
+			   "invalid attempt to change key pooling");
+		return 1;
+	}
+	ehht_key_pool_release(table);
+	if (chunk_size && chunk_size < min_chunk) {
+		chunk_size = min_chunk;
+	}
+	table->key_pool_chunk_size = chunk_size;
+	return 0;
+}
+
+int ehht_arena(struct ehht *ht, size_t chunk_size)
+{
+	struct ehht_table *table = NULL;
+	size_t min_chunk = 4 * sizeof(struct ehht_element);
+
+	table = ehht_get_table(ht);
+	if (table->size) {
+		Ehht_error(table->log, 31,
+			   "invalid attempt to change arena mode");
+		return 1;
+	}
+	if (chunk_size && ehht_cache_mode(table)) {
+		/* evicting would not release memory */
+		Ehht_error(table->log, 32, "arena mode with a cache limit");
+		return 1;
+	}
+	ehht_arena_release(table, 0);
+	if (chunk_size && chunk_size < min_chunk) {
+		chunk_size = min_chunk;
+	}
+	table->arena_chunk_size = chunk_size;
+	return 0;
+}
+
+/* the hashcode stored in an element of one table is valid in the other */
+static unsigned int ehht_hash_for(struct ehht_table *table,
+				  struct ehht_table *from,
+				  struct ehht_element *element)
+{
+	if (table->hash_func == from->hash_func) {
+		return element->key.hashcode;
+	}
+	return ehht_hash(table, element->key.str, element->key.len);
+}
+
+/* an element of "from" may be relinked into "to", as "to" would free it
+   exactly as "from" would have */
+static int ehht_can_relink(struct ehht_table *to, struct ehht_table *from)
+{
+	if (to->ea != from->ea || to->value_size != from->value_size
+	    || to->trust_keys_immutable != from->trust_keys_immutable
+	    || to->wheel || from->wheel || to->arena_chunk_size
+	    || from->arena_chunk_size) {
+		return 0;
+	}
+	if (to->trust_keys_immutable) {
+		return 1;
+	}
+	return (!to->key_pool_chunk_size && !from->key_pool_chunk_size);
+}
+
+/* grow once, rather than on collisions while merging */
+static void ehht_reserve(struct ehht *ht, size_t size)
+{
+	struct ehht_table *table = NULL;
+	size_t needed = 0;
+
+	table = ehht_get_table(ht);
+	if (table->collision_load_factor <= 0.0) {
+		return;
+	}
+	needed = (size_t)(size / table->collision_load_factor) + 1;
+	if (needed > table->num_buckets) {
+		ehht_buckets_resize(ht, needed);
+	}
+}
+
+static void ehht_tags_rebuild_all(struct ehht_table *table)
+{
+	size_t i = 0;
+
+	if (!table->tags) {
+		return;
+	}
+	for (i = 0; i < table->num_buckets; ++i) {
+		ehht_tags_rebuild(&(table->tags[i]), table->buckets[i]);
+	}
+}
+
+/* gives the copy the expiry of the original, if "dst" has expiry mode */
+static void ehht_ttl_copy(struct ehht_table *dst, struct ehht_table *src,
+			  struct ehht_element *copy,
+			  struct ehht_element *element)
+{
+	if (dst->wheel && src->wheel && ehht_ttl(element)->expires) {
+		ehht_ttl_set(dst, copy, ehht_ttl(element)->expires);
+	}
+}
+
+static int ehht_merge_element(struct ehht_table *dst, struct ehht_table *src,
+			      struct ehht_element *element, int relink,
+			      ehht_merge_func conflict, void *context)
+{
+	struct ehht_element *existing = NULL;
+	struct ehht_element *copy = NULL;
+	unsigned int hashcode = 0;
+	size_t bucket_num = 0;
+
+	if (ehht_expired(src, element)) {
+		ehht_reap_unlinked(src, element);
+		return 0;
+	}
+
+	hashcode = ehht_hash_for(dst, src, element);
+	existing = ehht_get_element_hashed(dst, element->key.str,
+					   element->key.len, hashcode);
+	if (existing) {
+		if (conflict && dst->value_size) {
+			(*conflict) (ehht_key_of(existing), existing->val,
+				     element->val, context);
+		} else if (conflict) {
+			existing->val = (*conflict) (ehht_key_of(existing),
+						     existing->val,
+						     element->val, context);
+		} else if (dst->value_size) {
+			eembed_memcpy(existing->val, element->val,
+				      dst->value_size);
+		} else {
+			existing->val = element->val;
+		}
+		ehht_free_element(src, element);
+		return 0;
+	}
+
+	bucket_num = ehht_bucket_for_hashcode(hashcode, dst->num_buckets);
+	if (relink) {
+		element->key.hashcode = hashcode;
+		ehht_bucket_link(dst, bucket_num, element);
+		++(dst->size);
+		src->bytes_used -= ehht_element_bytes(src, element->key.len);
+		dst->bytes_used += ehht_element_bytes(dst, element->key.len);
+		if (ehht_cache_mode(dst)) {
+			ehht_cache_evict(dst, element);
+		}
+		return 0;
+	}
+
+	copy = ehht_alloc_element(dst, element->key.str, element->key.len,
+				  hashcode, element->val);
+	if (!copy) {
+		return 1;
+	}
+	if (dst->value_size) {
+		eembed_memcpy(copy->val, element->val, dst->value_size);
+	}
+	ehht_ttl_copy(dst, src, copy, element);
+	ehht_bucket_link(dst, bucket_num, copy);
+	ehht_free_element(src, element);
+	if (ehht_cache_mode(dst)) {
+		ehht_cache_evict(dst, copy);
+	}
+	return 0;
+}
+
+int ehht_merge(struct ehht *dst_ht, struct ehht *src_ht,
+	       ehht_merge_func conflict, void *context)
+{
+	struct ehht_table *dst = NULL;
+	struct ehht_table *src = NULL;
+	struct ehht_element *element = NULL;
+	size_t i = 0;
+	int relink = 0;
+	int err = 0;
+
+	dst = ehht_get_table(dst_ht);
+	src = ehht_get_table(src_ht);
+	if (dst == src) {
+		return 0;
+	}
+	if (dst->value_size != src->value_size) {
+		Ehht_error(dst->log, 18, "ehht_merge value sizes differ");
+		return 1;
+	}
+	relink = ehht_can_relink(dst, src);
+	ehht_reserve(dst_ht, dst->size + src->size);
+
+	for (i = 0; i < src->num_buckets && !err; ++i) {
+		while ((element = src->buckets[i]) != NULL) {
+			src->buckets[i] = element->next;
+			element->next = NULL;
+			--(src->size);
+			err = ehht_merge_element(dst, src, element, relink,
+						 conflict, context);
+			if (err) {
+				/* put it back, the rest remain in src */
+				element->next = src->buckets[i];
+				src->buckets[i] = element;
+				++(src->size);
+				Ehht_error(dst->log, 19, "ehht_merge failed");
+				break;
+			}
+		}
+	}
+	ehht_tags_rebuild_all(src);
+	ehht_filter_rebuild(src);
+	if (!src->size) {
+		ehht_key_pool_release(src);
+	}
+	return err;
+}
+
+/* removes the elements of "table" for which the presence of the key in
+   "other" is not "keep" */
+static size_t ehht_retain(struct ehht_table *table, struct ehht_table *other,
+			  int keep, ehht_iterator_func removed, void *context)
+{
+	struct ehht_element **ptr_to_element = NULL;
+	struct ehht_element *element = NULL;
+	unsigned int hashcode = 0;
+	size_t count = 0;
+	size_t i = 0;
+	int present = 0;
+
+	if (table == other) {
+		if (keep) {
+			return 0;
+		}
+		/* every key is present in itself */
+		other = NULL;
+	}
+
+	for (i = 0; i < table->num_buckets; ++i) {
+		ptr_to_element = &(table->buckets[i]);
+		while ((element = *ptr_to_element) != NULL) {
+			present = 1;
+			if (other) {
+				hashcode = ehht_hash_for(other, table, element);
+				present = ehht_get_element_hashed(other,
+								  element->key.
+								  str,
+								  element->key.
+								  len,
+								  hashcode)
+				    ? 1 : 0;
+			}
+			if (present == keep) {
+				ptr_to_element = &(element->next);
+				continue;
+			}
+			*ptr_to_element = element->next;
+			--(table->size);
+			++count;
+			if (removed) {
+				(*removed) (ehht_key_of(element), element->val,
+					    context);
+			}
+			ehht_free_element(table, element);
+		}
+	}
+	if (count) {
+		ehht_tags_rebuild_all(table);
+		ehht_filter_rebuild(table);
+	}
+	return count;
+}
+
+size_t ehht_intersect(struct ehht *ht, struct ehht *other,
+		      ehht_iterator_func removed, void *context)
+{
+	return ehht_retain(ehht_get_table(ht), ehht_get_table(other), 1,
+			   removed, context);
+}
+
+size_t ehht_subtract(struct ehht *ht, struct ehht *other,
+		     ehht_iterator_func removed, void *context)
+{
+	return ehht_retain(ehht_get_table(ht), ehht_get_table(other), 0,
+			   removed, context);
+}
+
+struct ehht *ehht_clone(struct ehht *ht)
+{
+	struct ehht_table *src = NULL;
+	struct ehht_table *table = NULL;
+	struct ehht_element *element = NULL;
+	struct ehht_element *copy = NULL;
+	struct ehht *clone = NULL;
+	size_t num_buckets = 0;
+	size_t needed = 0;
+	size_t bucket_num = 0;
+	size_t i = 0;
+
+	src = ehht_get_table(ht);
+	num_buckets = src->num_buckets;
+	if (src->collision_load_factor > 0.0) {
+		needed = (size_t)(src->size / src->collision_load_factor) + 1;
+		if (needed > num_buckets) {
+			num_buckets = needed;
+		}
+	}
+
+	clone = ehht_new_custom(num_buckets, src->hash_func, src->ea, src->log);
+	if (!clone) {
+		return NULL;
+	}
+	table = ehht_get_table(clone);
+	table->collision_load_factor = src->collision_load_factor;
+	table->trust_keys_immutable = src->trust_keys_immutable;
+	table->key_pool_chunk_size = src->key_pool_chunk_size;
+	table->arena_chunk_size = src->arena_chunk_size;
+	table->value_size = src->value_size;
+	table->now = src->now;
+	table->now_context = src->now_context;
+	table->allocator_thread_safe = src->allocator_thread_safe;
+	table->long_chain_probe = src->long_chain_probe;
+	if (src->tags && ehht_bucket_tags(clone, 1)) {
+		goto ehht_clone_fail;
+	}
+	if (src->filter && ehht_counting_filter(clone, 1)) {
+		goto ehht_clone_fail;
+	}
+
+	for (i = 0; i < src->num_buckets; ++i) {
+		for (element = src->buckets[i]; element != NULL;
+		     element = element->next) {
+			if (ehht_expired(src, element)) {
+				continue;
+			}
+			copy = ehht_alloc_element(table, element->key.str,
+						  element->key.len,
+						  element->key.hashcode,
+						  element->val);
+			if (!copy) {
+				goto ehht_clone_fail;
+			}
+			if (table->value_size) {
+				eembed_memcpy(copy->val, element->val,
+					      table->value_size);
+			}
+			bucket_num =
+			    ehht_bucket_for_hashcode(copy->key.hashcode,
+						     table->num_buckets);
+			ehht_bucket_link(table, bucket_num, copy);
+		}
+	}
+	return clone;
+
+ehht_clone_fail:
+	Ehht_error(src->log, 20, "ehht_clone failed");
+	ehht_free(clone);
+	return NULL;
+}
+
+int ehht_move(struct ehht *dst_ht, struct ehht *src_ht, const char *key,
+	      size_t key_len)
+{
+	struct ehht_table *dst = NULL;
+	struct ehht_table *src = NULL;
+	struct ehht_element *element = NULL;
+	struct ehht_element *copy = NULL;
+	unsigned int hashcode = 0;
+	size_t src_bucket = 0;
+	size_t bucket_num = 0;
+
+	dst = ehht_get_table(dst_ht);
+	src = ehht_get_table(src_ht);
+	if (dst->value_size != src->value_size) {
+		Ehht_error(dst->log, 21, "ehht_move value sizes differ");
+		return 1;
+	}
+	element = ehht_get_element(src, key, key_len);
+	if (!element) {
+		return 1;
+	}
+	if (dst == src) {
+		return 0;
+	}
+	hashcode = ehht_hash_for(dst, src, element);
+	if (ehht_get_element_hashed(dst, key, key_len, hashcode)) {
+		return 1;
+	}
+
+	ehht_grow_on_collision(dst_ht, hashcode);
+	bucket_num = ehht_bucket_for_hashcode(hashcode, dst->num_buckets);
+	src_bucket = ehht_bucket_for_hashcode(element->key.hashcode,
+					      src->num_buckets);
+
+	if (ehht_can_relink(dst, src)) {
+		ehht_bucket_unlink(src, src_bucket, element);
+		--(src->size);
+		element->key.hashcode = hashcode;
+		ehht_bucket_link(dst, bucket_num, element);
+		++(dst->size);
+		src->bytes_used -= ehht_element_bytes(src, element->key.len);
+		dst->bytes_used += ehht_element_bytes(dst, element->key.len);
+		if (ehht_cache_mode(dst)) {
+			ehht_cache_evict(dst, element);
+		}
+		return 0;
+	}
+
+	copy = ehht_alloc_element(dst, element->key.str, element->key.len,
+				  hashcode, element->val);
+	if (!copy) {
+		Ehht_error(dst->log, 22, "ehht_move failed");
+		return 1;
+	}
+	if (dst->value_size) {
+		eembed_memcpy(copy->val, element->val, dst->value_size);
+	}
+	ehht_ttl_copy(dst, src, copy, element);
+	ehht_bucket_link(dst, bucket_num, copy);
+	ehht_bucket_unlink(src, src_bucket, element);
+	--(src->size);
+	ehht_free_element(src, element);
+	if (ehht_cache_mode(dst)) {
+		ehht_cache_evict(dst, copy);
+	}
+	return 0;
+}
+
+void ehht_swap(struct ehht *a, struct ehht *b)
+{
+	struct ehht tmp;
+
+	/* the methods differ only if one is not a chained table */
+	tmp = *a;
+	*a = *b;
+	*b = tmp;
 }
 
-static int ehht_for_each(struct ehht *ht,
-			 int (*func)(struct ehht_key each_key,
-				     void *each_val, void *context),
-			 void *context)
+int ehht_cache_limit(struct ehht *ht, size_t max_entries, size_t max_bytes,
+		     ehht_evict_func evict, void *context)
 {
 	struct ehht_table *table = NULL;
-	size_t i = 0;
-	size_t end = 0;
-	struct ehht_element *element = NULL;
 
 	table = ehht_get_table(ht);
-
-	end = 0;
-	for (i = 0; i < table->num_buckets && !end; ++i) {
-		for (element = table->buckets[i]; element != NULL;
-		     element = element->next) {
-			end = (*func) (element->key, element->val, context);
-		}
+	if ((max_entries || max_bytes) && table->arena_chunk_size) {
+		/* evicting would not release memory */
+		Ehht_error(table->log, 23, "cache limit in arena mode");
+		return 1;
 	}
-
-	return end;
+	table->cache_max_entries = max_entries;
+	table->cache_max_bytes = max_bytes;
+	table->evict = evict;
+	table->evict_context = context;
+	ehht_cache_evict(table, NULL);
+	return 0;
 }
 
-static size_t ehht_size(struct ehht *ht)
+int ehht_expiry(struct ehht *ht, unsigned long tick_len,
+		ehht_evict_func expired, void *context)
 {
 	struct ehht_table *table = NULL;
+	struct eembed_allocator *ea = NULL;
 	size_t size = 0;
 
 	table = ehht_get_table(ht);
-	size = table->size;
-
-	return size;
+	ea = table->ea;
+	if (table->size && (!tick_len != !table->wheel
+			    || (table->wheel
+				&& tick_len != table->wheel->tick_len))) {
+		Ehht_error(table->log, 26,
+			   "invalid attempt to change expiry mode");
+		return 1;
+	}
+	if (!tick_len) {
+		ea->free(ea, table->wheel);
+		table->wheel = NULL;
+		return 0;
+	}
+	if (!table->wheel) {
+		size = sizeof(struct ehht_wheel);
+		table->wheel = (struct ehht_wheel *)ea->malloc(ea, size);
+		if (!table->wheel) {
+			Ehht_error_malloc(table->log, 25, size, "timing wheel");
+			return 1;
+		}
+		eembed_memset(table->wheel, 0x00, size);
+		table->wheel->now = ehht_now(table);
+		table->wheel->tick = table->wheel->now / tick_len;
+	}
+	table->wheel->tick_len = tick_len;
+	table->wheel->expired = expired;
+	table->wheel->context = context;
+	return 0;
 }
 
-static int ehht_to_string_each(struct ehht_key key, void *each_val,
-			       void *context)
+/* moves the elements of the slot at the start of the current tick down
+   the wheel; returns non-zero if the budget ran out first */
+static int ehht_wheel_cascade(struct ehht_wheel *wheel, size_t *work,
+			      size_t budget)
 {
-	struct eembed_log *slog = (struct eembed_log *)context;
-
-	slog->append_s(slog, "'");
-	slog->append_s(slog, key.len ? key.str : "");
-	slog->append_s(slog, "' => ");
-	slog->append_vp(slog, each_val);
-	slog->append_s(slog, ", ");
-
+	struct ehht_element *element = NULL;
+	size_t level = 0;
+	size_t idx = 0;
+
+	for (level = 1; level < EHHT_WHEEL_LEVELS; ++level) {
+		idx = (wheel->tick >> (EHHT_WHEEL_BITS * level))
+		    & EHHT_WHEEL_MASK;
+		while ((element = wheel->slots[level][idx]) != NULL) {
+			if (*work >= budget) {
+				return 1;
+			}
+			ehht_wheel_unlink(wheel, element);
+			ehht_wheel_link(wheel, element);
+			++(*work);
+		}
+		if (idx != 0) {
+			break;
+		}
+	}
 	return 0;
 }
 
-static size_t ehht_to_string(struct ehht *ht, char *buf, size_t buf_len)
+/* the first tick after the current one which may have work: the start
+   of the next occupied slot, or of the next rotation of a level which
+   holds elements for that rotation; EHHT_TICK_NEVER if the wheel is empty */
+static unsigned long ehht_wheel_next_tick(struct ehht_wheel *wheel)
 {
-	struct eembed_str_buf str_buf = { NULL, 0 };
-	struct eembed_log log =
-	    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
-	struct eembed_log *slog = NULL;
-
-	slog = eembed_char_buf_log_init(&log, &str_buf, buf, buf_len);
-	if (!slog) {
-		return 0;
+	unsigned long slot = 0;
+	unsigned long later = 0;
+	unsigned long next = 0;
+	size_t shift = 0;
+	size_t level = 0;
+	size_t idx = 0;
+	size_t j = 0;
+
+	for (level = 0; level < EHHT_WHEEL_LEVELS; ++level) {
+		if (!wheel->occupied[level]) {
+			continue;
+		}
+		shift = EHHT_WHEEL_BITS * level;
+		slot = wheel->tick >> shift;
+		idx = slot & EHHT_WHEEL_MASK;
+		later = wheel->occupied[level] & ~((2UL << idx) - 1);
+		if (later) {
+			for (j = idx + 1; !(later & (1UL << j)); ++j) ;
+			next = (slot - idx + j) << shift;
+		} else {
+			next = (slot - idx + EHHT_WHEEL_SLOTS) << shift;
+		}
+		return (next > wheel->tick) ? next : EHHT_TICK_NEVER;
 	}
-
-	slog->append_s(slog, "{ ");
-	ehht_for_each(ht, ehht_to_string_each, slog);
-	slog->append_s(slog, "}");
-
-	return eembed_strnlen(buf, buf_len);
+	return EHHT_TICK_NEVER;
 }
 
-size_t ehht_buckets_resize(struct ehht *ht, size_t num_buckets)
+size_t ehht_expire(struct ehht *ht, unsigned long now, size_t budget)
 {
-	size_t i = 0;
-	size_t old_num_buckets = 0;
-	size_t new_bucket_num = 0;
-	size_t size = 0;
 	struct ehht_table *table = NULL;
-	struct ehht_element **new_buckets = NULL;
-	struct ehht_element **old_buckets = NULL;
-	struct eembed_allocator *ea = NULL;
+	struct ehht_wheel *wheel = NULL;
+	struct ehht_element *element = NULL;
+	struct ehht_element *next_element = NULL;
+	unsigned long target = 0;
+	unsigned long next = 0;
+	size_t work = 0;
+	size_t idx = 0;
 
 	table = ehht_get_table(ht);
-	ea = table->ea;
-
-	if (num_buckets == 0) {
-		num_buckets = table->num_buckets * 2;
+	wheel = table->wheel;
+	if (!wheel) {
+		return 0;
 	}
-	eembed_assert(num_buckets > 1);
-	size = sizeof(struct ehht_element *) * num_buckets;
-	eembed_assert(size > 0);
-	new_buckets = (struct ehht_element **)ea->malloc(ea, size);
-	if (new_buckets == NULL) {
-		Ehht_error_malloc(table->log, 4, size, "buckets");
-		return table->num_buckets;
+	if (now > wheel->now) {
+		wheel->now = now;
 	}
-	eembed_assert(size > 0);
-	eembed_memset(new_buckets, 0x00, size);
 
-	old_num_buckets = table->num_buckets;
-	old_buckets = table->buckets;
-	for (i = 0; i < old_num_buckets; ++i) {
-		struct ehht_element *element = NULL;
-		while ((element = old_buckets[i]) != NULL) {
-			old_buckets[i] = element->next;
-			new_bucket_num =
-			    ehht_bucket_for_hashcode(element->key.hashcode,
-						     num_buckets);
-			element->next = new_buckets[new_bucket_num];
-			new_buckets[new_bucket_num] = element;
+	/* the ticks before the one holding "now" are over */
+	target = now / wheel->tick_len;
+	while (wheel->tick < target && work < budget) {
+		idx = wheel->tick & EHHT_WHEEL_MASK;
+		if (idx == 0 && ehht_wheel_cascade(wheel, &work, budget)) {
+			break;
+		}
+		while ((element = wheel->slots[0][idx]) != NULL
+		       && work < budget) {
+			ehht_reap(table, element);
+			++work;
+		}
+		if (element != NULL || work >= budget) {
+			break;
 		}
+		next = ehht_wheel_next_tick(wheel);
+		wheel->tick = (next < target) ? next : target;
+		++work;
+	}
+	if (wheel->tick != target || work >= budget) {
+		return work;
 	}
-	table->buckets = new_buckets;
-	table->num_buckets = num_buckets;
 
-	ea->free(ea, old_buckets);
-	return num_buckets;
+	/* the tick holding "now" is only partly over; elements which have
+	   not yet expired are passed over, and not counted as work */
+	idx = wheel->tick & EHHT_WHEEL_MASK;
+	if (idx == 0 && ehht_wheel_cascade(wheel, &work, budget)) {
+		return work;
+	}
+	element = wheel->slots[0][idx];
+	while (element != NULL && work < budget) {
+		next_element = ehht_ttl(element)->wheel_next;
+		if (ehht_ttl(element)->expires <= now) {
+			ehht_reap(table, element);
+			++work;
+		}
+		element = next_element;
+	}
+	return work;
 }
 
-size_t ehht_buckets_size(struct ehht *ht)
+int ehht_value_size(struct ehht *ht, size_t value_size)
 {
 	struct ehht_table *table = NULL;
 
 	table = ehht_get_table(ht);
-	return table->num_buckets;
+	if (table->size && value_size != table->value_size) {
+		Ehht_error(table->log, 17,
+			   "invalid attempt to change value size");
+		return 1;
+	}
+	table->value_size = value_size;
+	return 0;
 }
 
-struct ehht_keys_foreach_context {
-	struct ehht *ehht;
-	struct ehht_keys *keys;
-	size_t pos;
-};
-
-static int ehht_fill_keys_each(struct ehht_key key, void *each_val,
-			       void *context)
+int ehht_bucket_tags(struct ehht *ht, int enable)
 {
-	struct ehht_keys_foreach_context *fe_ctx = NULL;
-	struct ehht *ehht = NULL;
+	struct ehht_table *table = NULL;
 	struct eembed_allocator *ea = NULL;
+	size_t size = 0;
+	size_t i = 0;
 
-	fe_ctx = (struct ehht_keys_foreach_context *)context;
-	ehht = fe_ctx->ehht;
-
-	eembed_assert(each_val == ehht->get(ehht, key.str, key.len));
-	(void)each_val;
+	table = ehht_get_table(ht);
+	ea = table->ea;
+	if (!enable) {
+		ea->free(ea, table->tags);
+		table->tags = NULL;
+		return 0;
+	}
+	if (table->tags) {
+		return 0;
+	}
 
-	eembed_assert(fe_ctx->pos < fe_ctx->keys->len);
-	if (fe_ctx->pos >= fe_ctx->keys->len) {
+	size = sizeof(struct ehht_bucket_tags) * table->num_buckets;
+	table->tags = (struct ehht_bucket_tags *)ea->malloc(ea, size);
+	if (table->tags == NULL) {
+		Ehht_error_malloc(table->log, 16, size, "bucket tags");
 		return 1;
 	}
-
-	if (fe_ctx->keys->keys_copied) {
-		struct ehht_table *table = NULL;
-		size_t size = 0;
-		char *key_copy = NULL;
-
-		table = ehht_get_table(ehht);
-
-		size = sizeof(char *) * (key.len + 1);
-		eembed_assert(size > 0);
-		ea = table->ea;
-		key_copy = (char *)ea->malloc(ea, size);
-		if (!key_copy) {
-			Ehht_error_malloc(table->log, 5, size, "key copy");
-			return 1;
-		}
-		eembed_memset(key_copy, 0x00, size);
-
-		eembed_memcpy(key_copy, key.str, key.len + 1);
-		fe_ctx->keys->keys[fe_ctx->pos].str = key_copy;
-		fe_ctx->keys->keys[fe_ctx->pos].len = key.len;
-		fe_ctx->keys->keys[fe_ctx->pos].hashcode = key.hashcode;
-	} else {
-		fe_ctx->keys->keys[fe_ctx->pos] = key;
+	for (i = 0; i < table->num_buckets; ++i) {
+		ehht_tags_rebuild(&(table->tags[i]), table->buckets[i]);
 	}
-
-	++fe_ctx->pos;
-
 	return 0;
 }
 
-static int ehht_has_key(struct ehht *ht, const char *key, size_t key_len)
+int ehht_counting_filter(struct ehht *ht, int enable)
 {
 	struct ehht_table *table = NULL;
-	struct ehht_element *element = NULL;
+	struct eembed_allocator *ea = NULL;
+	size_t size = 0;
 
 	table = ehht_get_table(ht);
+	ea = table->ea;
+	if (!enable) {
+		ea->free(ea, table->filter);
+		table->filter = NULL;
+		table->filter_blocks = 0;
+		return 0;
+	}
+	if (table->filter) {
+		return 0;
+	}
 
-	element = ehht_get_element(table, key, key_len);
-	return (element == NULL) ? 0 : 1;
+	table->filter_blocks = ehht_filter_blocks_for(table->num_buckets);
+	size = EHHT_FILTER_BLOCK_BYTES * table->filter_blocks;
+	table->filter = (unsigned char *)ea->malloc(ea, size);
+	if (table->filter == NULL) {
+		Ehht_error_malloc(table->log, 28, size, "filter");
+		table->filter_blocks = 0;
+		return 1;
+	}
+	ehht_filter_rebuild(table);
+	return 0;
 }
 
-static void ehht_free_keys(struct ehht *ht, struct ehht_keys *keys)
+void ehht_set_clock(struct ehht *ht, ehht_clock_func now, void *context)
 {
 	struct ehht_table *table = NULL;
-	struct eembed_allocator *ea = NULL;
 
 	table = ehht_get_table(ht);
-	ea = table->ea;
-
-	if (keys->keys_copied) {
-		size_t i;
-		for (i = 0; i < keys->len; ++i) {
-			ehht_free_const_str(ea, keys->keys[i].str);
-		}
-	}
-	if (keys->keys) {
-		ea->free(ea, keys->keys);
-	}
-	ea->free(ea, keys);
+	table->now = now;
+	table->now_context = context;
 }
 
-static struct ehht_keys *ehht_keys (struct ehht *ht, int copy_keys) {
+void ehht_stats(struct ehht *ht, struct ehht_stats *out)
+{
 	struct ehht_table *table = NULL;
-	struct eembed_allocator *ea = NULL;
-	struct ehht_keys_foreach_context fe_ctx = { NULL, NULL, 0 };
-	size_t size = 0;
+	struct ehht_element *element = NULL;
+	struct ehht_key_chunk *chunk = NULL;
+	size_t i = 0;
+	size_t chain_length = 0;
 
 	table = ehht_get_table(ht);
-	ea = table->ea;
-
-	fe_ctx.ehht = ht;
-
-	size = sizeof(struct ehht_keys);
-	fe_ctx.keys = (struct ehht_keys *)ea->malloc(ea, size);
-	if (!fe_ctx.keys) {
-		Ehht_error_malloc(table->log, 6, size, "struct ehht_keys");
-		return NULL;
+	eembed_memset(out, 0x00, sizeof(struct ehht_stats));
+
+	out->size = table->size;
+	out->num_buckets = table->num_buckets;
+	out->load_factor = ((double)table->size) / table->num_buckets;
+	out->resizes = table->resizes;
+	out->last_resize_time = table->last_resize_time;
+	out->evictions = table->evictions;
+	out->expirations = table->wheel ? table->wheel->expirations : 0;
+	out->bytes_buckets = sizeof(struct ehht_element *) * table->num_buckets;
+	if (table->tags) {
+		out->bytes_buckets +=
+		    sizeof(struct ehht_bucket_tags) * table->num_buckets;
 	}
-	eembed_memset(fe_ctx.keys, 0x00, size);
-	fe_ctx.pos = 0;
-	fe_ctx.keys->len = ht->size(ht);
-	fe_ctx.keys->keys_copied = copy_keys;
+	out->filter_negatives = table->filter_negatives;
+	out->bytes_buckets += EHHT_FILTER_BLOCK_BYTES * table->filter_blocks;
 
-	size = sizeof(struct ehht_key) * fe_ctx.keys->len;
-	if (size == 0) {
-		fe_ctx.keys->keys = NULL;
-	} else {
-		fe_ctx.keys->keys = (struct ehht_key *)ea->malloc(ea, size);
-		if (!fe_ctx.keys->keys) {
-			Ehht_error_malloc(table->log, 7, size, "key list");
-			ea->free(ea, fe_ctx.keys);
-			return NULL;
+	for (i = 0; i < table->num_buckets; ++i) {
+		chain_length = 0;
+		for (element = table->buckets[i]; element != NULL;
+		     element = element->next) {
+			++chain_length;
+			if (table->arena_chunk_size) {
+				continue;
+			}
+			out->bytes_elements += ehht_element_size(table);
+			if (!table->trust_keys_immutable
+			    && !ehht_key_pooled(table, element->key.len + 1)) {
+				out->bytes_keys += element->key.len + 1;
+			}
 		}
-		eembed_memset(fe_ctx.keys->keys, 0x00, size);
-		if (ehht_for_each(ht, ehht_fill_keys_each, &fe_ctx)) {
-			ehht_free_keys(ht, fe_ctx.keys);
-			Ehht_error(table->log, 8, "ehht_keys failed");
-			return NULL;
+		if (chain_length == 0) {
+			++(out->empty_buckets);
 		}
+		if (chain_length > out->max_chain_length) {
+			out->max_chain_length = chain_length;
+		}
+		if (chain_length >= EHHT_STATS_CHAIN_LENGTHS_LEN) {
+			chain_length = EHHT_STATS_CHAIN_LENGTHS_LEN - 1;
+		}
+		++(out->chain_lengths[chain_length]);
+	}
+	for (chunk = table->key_chunks; chunk != NULL; chunk = chunk->next) {
+		out->bytes_keys += sizeof(struct ehht_key_chunk) + chunk->size;
+	}
+	/* in arena mode, the elements and keys are the chunks */
+	for (chunk = table->arena_chunks; chunk != NULL; chunk = chunk->next) {
+		out->bytes_elements +=
+		    Ehht_arena_round(sizeof(struct ehht_key_chunk))
+		    + chunk->size;
 	}
 
-	return fe_ctx.keys;
+	out->bytes_total = sizeof(struct ehht) + sizeof(struct ehht_table)
+	    + out->bytes_buckets + out->bytes_elements + out->bytes_keys;
+	if (table->wheel) {
+		out->bytes_total += sizeof(struct ehht_wheel);
+	}
 }
 
-void ehht_buckets_auto_resize_load_factor(struct ehht *ht, double factor)
+void ehht_long_chain_probe(struct ehht *ht, size_t chain_length)
 {
 	struct ehht_table *table = NULL;
 
 	table = ehht_get_table(ht);
-	table->collision_load_factor = factor;
+	table->long_chain_probe = chain_length;
 }
 
-int ehht_trust_keys_immutable(struct ehht *ht, int val)
+int ehht_op_stats(struct ehht *ht, struct ehht_op_stats *out)
 {
 	struct ehht_table *table = NULL;
-	int new_val = val ? 1 : 0;
 
 	table = ehht_get_table(ht);
-	if (table->size && new_val != table->trust_keys_immutable) {
-		Ehht_error(table->log, 12,
-			   "invalid attempt to change key immutablity");
-		return 1;
-	}
-	table->trust_keys_immutable = new_val;
+#if EHHT_INSTRUMENT
+	eembed_memcpy(out, &table->op_stats, sizeof(struct ehht_op_stats));
 	return 0;
+#else
+	eembed_memset(out, 0x00, sizeof(struct ehht_op_stats));
+	(void)table;
+	return 1;
+#endif
+}
+
+void ehht_op_stats_reset(struct ehht *ht)
+{
+	struct ehht_table *table = NULL;
+
+	table = ehht_get_table(ht);
+#if EHHT_INSTRUMENT
+	eembed_memset(&table->op_stats, 0x00, sizeof(struct ehht_op_stats));
+#else
+	(void)table;
+#endif
 }
 
 struct ehht *ehht_new(void)
@@ -625,9 +2318,9 @@ struct ehht *ehht_new_custom(size_t num_buckets, ehht_hash_func hash_func,
 	ht->clear = ehht_clear;
 	ht->for_each = ehht_for_each;
 	ht->has_key = ehht_has_key;
-	ht->keys = ehht_keys;
-	ht->free_keys = ehht_free_keys;
-	ht->to_string = ehht_to_string;
+	ht->keys = ehht_each_keys;
+	ht->free_keys = ehht_each_free_keys;
+	ht->to_string = ehht_each_to_string;
 
 	size = sizeof(struct ehht_table);
 	table = (struct ehht_table *)ea->malloc(ea, size);
@@ -657,10 +2350,187 @@ struct ehht *ehht_new_custom(size_t num_buckets, ehht_hash_func hash_func,
 
 	table->collision_load_factor = EHHT_DEFAULT_RESIZE_LOADFACTOR;
 	table->trust_keys_immutable = 0;
+	table->long_chain_probe = EHHT_DEFAULT_LONG_CHAIN_PROBE;
 
 	return ht;
 }
 
+/* the elements must be unlinked */
+static void ehht_free_arrays(struct ehht_table *table)
+{
+	struct eembed_allocator *ea = table->ea;
+
+	ea->free(ea, table->filter);
+	table->filter = NULL;
+	ea->free(ea, table->tags);
+	table->tags = NULL;
+	ea->free(ea, table->buckets);
+	table->buckets = NULL;
+}
+
+/* frees all but the elements */
+static void ehht_free_table(struct ehht_table *table)
+{
+	struct eembed_allocator *ea = table->ea;
+
+	ehht_arena_release(table, 0);
+	ehht_key_pool_release(table);
+
+	ehht_free_arrays(table);
+	ea->free(ea, table->wheel);
+	ea->free(ea, table);
+}
+
+void ehht_reclaimer_init(struct ehht_reclaimer *reclaimer,
+			 ehht_reclaim_sync_func sync, void *context)
+{
+	reclaimer->head = NULL;
+	reclaimer->tail = NULL;
+	reclaimer->sync = sync;
+	reclaimer->sync_context = context;
+}
+
+void ehht_allocator_thread_safe(struct ehht *ht, int thread_safe)
+{
+	struct ehht_table *table = NULL;
+
+	if (ht->destroy) {
+		/* always freed by the caller's thread */
+		return;
+	}
+	table = ehht_get_table(ht);
+	table->allocator_thread_safe = thread_safe ? 1 : 0;
+}
+
+static void ehht_reclaim_sync(struct ehht_reclaimer *reclaimer, int op)
+{
+	if (reclaimer->sync) {
+		reclaimer->sync(reclaimer->sync_context, op);
+	}
+}
+
+int ehht_free_async(struct ehht *ht, struct ehht_reclaimer *reclaimer)
+{
+	struct ehht_table *table = NULL;
+	struct eembed_allocator *ea = NULL;
+
+	if (ht == NULL) {
+		return 1;
+	}
+	if (ht->destroy) {
+		ht->destroy(ht);
+		return 1;
+	}
+	table = ehht_get_table(ht);
+	if (reclaimer->sync && !table->allocator_thread_safe) {
+		ehht_free(ht);
+		return 1;
+	}
+	ea = table->ea;
+	ea->free(ea, ht);
+
+	/* in arena mode, the elements are freed with the chunks */
+	table->reclaim_bucket =
+	    table->arena_chunk_size ? table->num_buckets : 0;
+	table->reclaim_next = NULL;
+	table->reclaim_elements = NULL;
+
+	ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_LOCK);
+	if (reclaimer->tail) {
+		reclaimer->tail->reclaim_next = table;
+	} else {
+		reclaimer->head = table;
+	}
+	reclaimer->tail = table;
+	ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_QUEUED);
+	ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_UNLOCK);
+	return 0;
+}
+
+/* returns non-zero once the table is freed */
+static int ehht_reclaim_table(struct ehht_table *table, size_t budget,
+			      size_t *work)
+{
+	struct ehht_element *element = NULL;
+	struct ehht_key_chunk *chunk = NULL;
+
+	/* The elements are moved to one list, and the arrays are freed
+	   before any element is: with some allocators (e.g.: glibc),
+	   freeing a large block after many small ones first coalesces
+	   all of the small ones, and would take as long as the rest. */
+	while (*work < budget && table->reclaim_bucket < table->num_buckets) {
+		element = table->buckets[table->reclaim_bucket];
+		if (element) {
+			table->buckets[table->reclaim_bucket] = element->next;
+			element->next = table->reclaim_elements;
+			table->reclaim_elements = element;
+		} else {
+			++(table->reclaim_bucket);
+		}
+		++(*work);
+	}
+	if (*work < budget && table->buckets) {
+		ehht_free_arrays(table);
+		++(*work);
+	}
+	while (*work < budget && (element = table->reclaim_elements) != NULL) {
+		table->reclaim_elements = element->next;
+		ehht_free_element(table, element);
+		++(*work);
+	}
+	while (*work < budget && (chunk = table->arena_chunks) != NULL) {
+		table->arena_chunks = chunk->next;
+		table->ea->free(table->ea, chunk);
+		++(*work);
+	}
+	while (*work < budget && (chunk = table->key_chunks) != NULL) {
+		table->key_chunks = chunk->next;
+		table->ea->free(table->ea, chunk);
+		++(*work);
+	}
+	if (*work >= budget) {
+		return 0;
+	}
+	ehht_free_table(table);
+	++(*work);
+	return 1;
+}
+
+size_t ehht_reclaim_step(struct ehht_reclaimer *reclaimer, size_t budget)
+{
+	struct ehht_table *table = NULL;
+	size_t work = 0;
+
+	while (work < budget) {
+		/* a table taken from the queue is ours alone */
+		ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_LOCK);
+		table = reclaimer->head;
+		if (table) {
+			reclaimer->head = table->reclaim_next;
+			if (reclaimer->head == NULL) {
+				reclaimer->tail = NULL;
+			}
+		}
+		ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_UNLOCK);
+		if (table == NULL) {
+			break;
+		}
+
+		if (!ehht_reclaim_table(table, budget, &work)) {
+			/* out of budget, it goes back to the front */
+			ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_LOCK);
+			table->reclaim_next = reclaimer->head;
+			reclaimer->head = table;
+			if (reclaimer->tail == NULL) {
+				reclaimer->tail = table;
+			}
+			ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_QUEUED);
+			ehht_reclaim_sync(reclaimer, EHHT_RECLAIM_UNLOCK);
+		}
+	}
+	return work;
+}
+
 void ehht_free(struct ehht *ht)
 {
 	struct ehht_table *table = NULL;
@@ -669,13 +2539,15 @@ void ehht_free(struct ehht *ht)
 	if (ht == NULL) {
 		return;
 	}
+	if (ht->destroy) {
+		ht->destroy(ht);
+		return;
+	}
 
 	table = ehht_get_table(ht);
 	ea = table->ea;
 
 	ht->clear(ht);
-
-	ea->free(ea, table->buckets);
-	ea->free(ea, table);
+	ehht_free_table(table);
 	ea->free(ea, ht);
 }
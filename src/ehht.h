@@ -75,8 +75,13 @@ struct ehht {
 	void (*free_keys)(struct ehht *table, struct ehht_keys *keys);
 
 	/* returns the number of characters written to "buf"
-	   (excluding the null byte terminator) */
+	   (excluding the null byte terminator); output which does not
+	   fit is silently truncated, see ehht_write for complete output */
 	size_t (*to_string)(struct ehht *table, char *buf, size_t buf_len);
+
+	/* private, last so the methods above keep their offsets */
+	/* frees the table, if it is not the chained table of ehht_new */
+	void (*destroy)(struct ehht *table);
 };
 
 /*****************************************************************************/
@@ -96,10 +101,89 @@ struct ehht *ehht_new_custom(size_t num_buckets,
 			     struct eembed_allocator *ea,
 			     struct eembed_log *log);
 
+/* A bucketized cuckoo hashtable: each key may be in one of two buckets
+   of 4 slots, and each bucket fills one 64 byte cache line, so a lookup
+   reads at most two cache lines of the table (and a small stash, only
+   if it is in use) before comparing the key. A put which finds both
+   buckets full moves keys to their other bucket, by a breadth first
+   search for the shortest path to a free slot; if none is found, the
+   key goes to the stash, and if the stash is full, the table doubles.
+   Keys which would not fit however large the table, as when many keys
+   share a hashcode, go to an overflow list which a lookup scans if it
+   is in use, so a put fails only if memory runs out. The table is
+   sized for "capacity" keys, and works well to over 95%
+   load. Only the "struct ehht" methods, ehht_free, and ehht_swap apply
+   to these tables; keys are always copied. */
+struct ehht *ehht_new_cuckoo(size_t capacity, ehht_hash_func hash_func,
+			     struct eembed_allocator *ea,
+			     struct eembed_log *log);
+
+/* An insertion ordered hashtable: the entries are appended to one dense
+   array, and their keys to one buffer; a separate open addressed index
+   of 8, 16 or 32 bit entry positions, the narrowest which fits, maps a
+   hashcode to its entry. An entry is 24 bytes, plus its key, and the
+   index 1 to 4 bytes per slot, all in five allocations rather than two
+   per key; "for_each" streams the entries in the order in which they
+   were first put. Removed entries leave a hole which is
+   compacted away when the table next grows. Only the "struct ehht"
+   methods, ehht_free, and ehht_swap apply to these tables; keys are
+   always copied, and the key pointers given to "for_each" or from
+   "keys(table, 0)" are valid until the next put. */
+struct ehht *ehht_new_compact(size_t capacity, ehht_hash_func hash_func,
+			      struct eembed_allocator *ea,
+			      struct eembed_log *log);
+
 /* destructor */
 void ehht_free(struct ehht *table);
 /*****************************************************************************/
 
+/*****************************************************************************/
+/* deferred destruction */
+/*****************************************************************************/
+#define EHHT_RECLAIM_LOCK 1
+#define EHHT_RECLAIM_UNLOCK 2
+/* while locked, after a table is added to the queue */
+#define EHHT_RECLAIM_QUEUED 3
+
+/* lets the queue of a reclaimer be shared with other threads */
+typedef void (*ehht_reclaim_sync_func)(void *context, int op);
+
+struct ehht_table;
+
+/* a queue of tables to be freed, owned by the caller */
+struct ehht_reclaimer {
+	struct ehht_table *head;
+	struct ehht_table *tail;
+	ehht_reclaim_sync_func sync;
+	void *sync_context;
+};
+
+/* if sync is NULL, the reclaimer must only be used by one thread */
+void ehht_reclaimer_init(struct ehht_reclaimer *reclaimer,
+			 ehht_reclaim_sync_func sync, void *context);
+
+/* Declares that the allocator of the table may be called from threads
+   other than the one using the table, e.g.: to free it in the
+   background. eembed allocators make no such promise, so the default
+   is 0. */
+void ehht_allocator_thread_safe(struct ehht *table, int thread_safe);
+
+/* As ehht_free, but in constant time: the table is detached and queued
+   on the reclaimer, and its elements, key copies and arrays are freed
+   later by ehht_reclaim_step. The table may not be used after this
+   call. Tables of other engines, which are a few allocations, are
+   freed now, as are tables whose allocator is not declared thread-safe
+   if the reclaimer has a sync function.
+   Returns 0 if the table was queued, or non-zero if it was freed. */
+int ehht_free_async(struct ehht *table, struct ehht_reclaimer *reclaimer);
+
+/* Frees the queued tables, oldest first, doing at most "budget" units
+   of work: an element or chunk freed, a bucket passed, or the arrays of
+   a table freed. Returns the units of work done; less than "budget"
+   means no table remained in the queue. */
+size_t ehht_reclaim_step(struct ehht_reclaimer *reclaimer, size_t budget);
+/*****************************************************************************/
+
 /*****************************************************************************/
 /* implementation-exposing "friend" functions are provided for testing and
  * other very special uses, but are not truly part of a hashtable API */
@@ -116,6 +200,337 @@ size_t ehht_bucket_for_key(struct ehht *table, const char *key, size_t key_len);
 int ehht_trust_keys_immutable(struct ehht *ht, int val);
 /*****************************************************************************/
 
+/*****************************************************************************/
+/* key storage */
+/*****************************************************************************/
+/* Rather than a malloc per key, copy keys into chunks of chunk_size
+   bytes. Space is rounded up to 8 bytes per key, and the space of a
+   removed key is reused by the next key of the same rounded size. Keys
+   over 255 bytes are still allocated individually. Chunks are only
+   returned to the allocator by clear and ehht_free. Keys remain NUL
+   terminated. If chunk_size is 0, pooling is disabled. Has no effect
+   if ehht_trust_keys_immutable is set.
+   To change this value, the table must be empty.
+   Returns non-zero on error. */
+int ehht_pool_keys(struct ehht *table, size_t chunk_size);
+
+/* For short lived tables: elements and their key copies are allocated
+   together from chunks of chunk_size bytes, by bumping an offset. A
+   removed element is unlinked, but its space is only reclaimed by
+   clear, which resets the bucket array in one pass and frees all but
+   the current chunk (kept for reuse) without visiting any element, and
+   by ehht_free. Elements larger than chunk_size get a chunk of their
+   own. Supersedes ehht_pool_keys. Elements are copied, not relinked,
+   by ehht_merge and ehht_move with an arena table. If chunk_size is 0,
+   arena mode is disabled. As removing an element frees no memory, a
+   table may not have both arena mode and ehht_cache_limit.
+   To change this value, the table must be empty.
+   Returns non-zero on error. */
+int ehht_arena(struct ehht *table, size_t chunk_size);
+
+/* Keeps 8 bytes per bucket beside the bucket array: the chain length and
+   a one byte tag of the hashcode of each of the first 7 elements. A
+   lookup of a missing key is then usually rejected without reading the
+   chain, and only elements with a matching hashcode have their key
+   compared. May be changed at any time.
+   Returns non-zero if the tags could not be allocated. */
+int ehht_bucket_tags(struct ehht *table, int enable);
+
+/* Keeps a counting Bloom filter of the hashcodes, of about 4 bytes per
+   bucket, updated by put and remove and rebuilt when the bucket array
+   is resized. A lookup of a missing key is then usually rejected after
+   reading one cache line of the filter, without touching the bucket
+   array or the chain. The number of lookups rejected is reported as
+   "filter_negatives" by ehht_stats. May be changed at any time.
+   Returns non-zero if the filter could not be allocated. */
+int ehht_counting_filter(struct ehht *table, int enable);
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* cache mode */
+/*****************************************************************************/
+/* called with an element removed to stay within the cache limits, the
+   key is only valid for the duration of the call */
+typedef void (*ehht_evict_func)(struct ehht_key key, void *val,
+				void *context);
+
+/* Bounds the table to max_entries elements and (or) max_bytes bytes of
+   elements and key copies; 0 means no limit, and if both are 0 cache
+   mode is disabled. When "put", ehht_put_slot, ehht_entry, ehht_merge
+   or ehht_move adds a key beyond a limit, elements are evicted with
+   CLOCK: a reference bit per element is set by each "get", ehht_lookup
+   or update, and a hand sweeps the buckets, clearing set bits and
+   evicting the first element found without one. The added key is never
+   evicted by its own addition. Each evicted value is passed to
+   evict(key, val, context) if not NULL, e.g.: to free it. Cache mode is
+   not copied by ehht_clone.
+   Returns non-zero on error, e.g.: if the table is in arena mode. */
+int ehht_cache_limit(struct ehht *table, size_t max_entries, size_t max_bytes,
+		     ehht_evict_func evict, void *context);
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* expiry mode */
+/*****************************************************************************/
+/* Links each element with a time to live into a hierarchical timing
+   wheel with a slot per tick_len time units at the lowest level, so
+   that ehht_expire does work in proportion to what expires rather than
+   to the size of the table. The current time is from the ehht_set_clock
+   clock if set, otherwise the latest "now" given to ehht_expire. A
+   lookup treats an expired element as missing and reaps it, but "size"
+   and "for_each" count it until it is reaped.
+   Each expired value is passed to expired(key, val, context) if not
+   NULL, e.g.: to free it. If tick_len is 0, expiry mode is disabled.
+   Expiry mode is not copied by ehht_clone, which skips expired keys.
+   ehht_merge and ehht_move skip expired keys, and keep when a key
+   expires only if dst also has expiry mode; otherwise, it no longer
+   expires. To change this value, the table must be empty.
+   Returns non-zero on error. */
+int ehht_expiry(struct ehht *table, unsigned long tick_len,
+		ehht_evict_func expired, void *context);
+
+/* As "put", and the key will expire ttl time units from now; if ttl is
+   0, the key does not expire. A plain "put" does not change when an
+   existing key expires. Requires ehht_expiry. */
+void *ehht_put_with_ttl(struct ehht *table, const char *key, size_t key_len,
+			void *val, unsigned long ttl, int *err);
+
+/* Removes the elements which expired by "now", doing at most "budget"
+   units of work: an element expired or moved down the wheel, or a step
+   to the next tick which may have work. Elements in the tick holding
+   "now" which expire later in it are passed over without counting as
+   work. If the budget runs out, the next call continues where this one
+   stopped. Returns the units of work done; less than "budget" means
+   every element which expired by "now" has been removed. */
+size_t ehht_expire(struct ehht *table, unsigned long now, size_t budget);
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* value storage */
+/*****************************************************************************/
+/* Rather than storing the "val" pointer, store value_size bytes inside
+   each element. Then:
+   "put" copies value_size bytes from "val" (or zeroes, if NULL) and
+   returns the address of the value in the table, or NULL on error;
+   "get" and "for_each" pass the address of the value in the table;
+   "remove" returns NULL, as the value is freed with the element.
+   The address of a value is stable until the key is removed, resizing
+   does not move it. If value_size is 0, the "val" pointer is stored.
+   To change this value, the table must be empty.
+   Returns non-zero on error. */
+int ehht_value_size(struct ehht *table, size_t value_size);
+
+/* Finds or adds the key, and returns the address of its value storage
+   for initialization or update in place, or NULL on error. For a newly
+   added key, the value is zeroed. If ehht_value_size is set, this is
+   the address of the value in the table, otherwise this is the address
+   of the "void *" value pointer. */
+void *ehht_put_slot(struct ehht *table, const char *key, size_t key_len,
+		    int *err);
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* single probe access */
+/*****************************************************************************/
+/* Finds the key, adding it with a NULL value if absent, and returns the
+   address of its "val" for update in place, hashing the key and walking
+   the chain only once, e.g.:
+	void **slot = ehht_entry(table, word, word_len, NULL, &err);
+	*slot = (void *)(((size_t)*slot) + 1);
+   If inserted is not NULL, *inserted is set to 1 if the key was added.
+   Returns NULL if memory allocation fails, and sets *err if not NULL.
+   The address is valid until the key is removed. If ehht_value_size is
+   set, *slot is the address of the value, and must not be changed. */
+void **ehht_entry(struct ehht *table, const char *key, size_t key_len,
+		  int *inserted, int *err);
+
+/* Like "get", but also sets *found (if not NULL) to whether the key is
+   present, which distinguishes a missing key from a NULL value. */
+void *ehht_lookup(struct ehht *table, const char *key, size_t key_len,
+		  int *found);
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* bulk operations */
+/*****************************************************************************/
+/* returns the value to keep for a key present in both tables */
+typedef void *(*ehht_merge_func)(struct ehht_key key, void *dst_val,
+				 void *src_val, void *context);
+
+/* Moves every element of src into dst, leaving src empty. For a key in
+   both, the value becomes conflict(key, dst_val, src_val, context), or
+   src_val if conflict is NULL. With ehht_value_size, the values are
+   addresses, conflict should update dst_val in place and its return is
+   ignored. The stored hashcodes are reused if the tables share a hash
+   function. If the tables also share an allocator and key ownership
+   (trusted keys, or neither pooling keys) elements are relinked, not
+   copied; otherwise, if a copy fails, the remaining elements stay in
+   src. If dst is in cache mode, each element added may evict others,
+   including ones merged before it, as with "put". Returns non-zero on
+   error. */
+int ehht_merge(struct ehht *dst, struct ehht *src, ehht_merge_func conflict,
+	       void *context);
+
+/* Removes from table the keys not present in other, calling
+   removed(key, val, context) (if not NULL) for each before it is
+   freed, e.g.: to free the value. Returns the number of keys removed. */
+size_t ehht_intersect(struct ehht *table, struct ehht *other,
+		      ehht_iterator_func removed, void *context);
+
+/* Removes from table the keys present in other, calling removed(key,
+   val, context) (if not NULL) for each before it is freed.
+   Returns the number of keys removed. */
+size_t ehht_subtract(struct ehht *table, struct ehht *other,
+		     ehht_iterator_func removed, void *context);
+
+/* Returns a new table with the same settings and a copy of each
+   element, with buckets for the final size and the stored hashcodes
+   reused, or NULL on error. Values are copied as pointers, or as bytes
+   if ehht_value_size is set. The clone is not in cache mode, so holds
+   every element. */
+struct ehht *ehht_clone(struct ehht *table);
+
+/* Moves the element for key from src to dst, relinking it if the tables
+   share an allocator and key ownership (as with ehht_merge), otherwise
+   copying it. If dst is in cache mode, the moved element may evict
+   others, as with "put". Returns 0 if moved, non-zero if the key is not
+   in src, is already in dst, or on error. */
+int ehht_move(struct ehht *dst, struct ehht *src, const char *key,
+	      size_t key_len);
+
+/* exchanges the contents and settings of the two tables, in constant
+   time, without touching the elements */
+void ehht_swap(struct ehht *a, struct ehht *b);
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* streaming output */
+/*****************************************************************************/
+/* called with each full buffer, and the rest at the end;
+   returns non-zero to stop */
+typedef int (*ehht_write_func)(void *context, const char *bytes, size_t len);
+
+/* Writes the text of "val" to buf, without a NUL, and returns its
+   length. If the length is more than buf_len, nothing need be written:
+   it is called again with an empty buffer of the full length. */
+typedef size_t (*ehht_format_value_func)(void *val, char *buf,
+					 size_t buf_len, void *context);
+
+/* one line per key: the key, a tab, the value */
+#define EHHT_WRITE_TEXT 0
+/* an object of one member per key and line */
+#define EHHT_WRITE_JSON 1
+
+#define EHHT_WRITE_MIN_BUF_LEN 64
+
+/* Writes every key and value of any "struct ehht", in for_each order,
+   through buf, calling write(write_context, buf, len) each time the
+   buffer fills, and once at the end; nothing is allocated, so a
+   buffer of 64 KiB or more writes at about the speed of the sink.
+   Keys are escaped: in JSON as strings, in text with backslash escapes
+   for backslash and control characters; other bytes pass through as
+   they are, so JSON is only valid if the keys are UTF-8.
+   Values are formatted by format_value(val, buf, len, format_context),
+   which must produce JSON for EHHT_WRITE_JSON; if NULL, text has the
+   pointer in hex, and JSON has null or the pointer bits as an integer.
+   Returns 0 on success, or non-zero if the arguments are invalid, a
+   formatted value does not fit in buf, or write returns non-zero, in
+   which case output stops. */
+int ehht_write(struct ehht *table, int format, char *buf, size_t buf_len,
+	       ehht_write_func write, void *write_context,
+	       ehht_format_value_func format_value, void *format_context);
+/*****************************************************************************/
+
+/*****************************************************************************/
+/* introspection */
+/*****************************************************************************/
+/* returns the current time in caller-chosen units, e.g.: nanoseconds */
+typedef unsigned long (*ehht_clock_func)(void *context);
+
+/* if no clock is set, times are reported as zero */
+void ehht_set_clock(struct ehht *table, ehht_clock_func now, void *context);
+
+#define EHHT_STATS_CHAIN_LENGTHS_LEN 16
+
+struct ehht_stats {
+	size_t size;
+	size_t num_buckets;
+	size_t empty_buckets;
+	double load_factor;
+	/* chain_lengths[i] counts buckets with a chain of length i,
+	   the last element also counts all longer chains */
+	size_t chain_lengths[EHHT_STATS_CHAIN_LENGTHS_LEN];
+	size_t max_chain_length;
+	size_t resizes;
+	unsigned long last_resize_time;
+	size_t evictions;
+	size_t expirations;
+	size_t filter_negatives;
+	size_t bytes_elements;
+	size_t bytes_keys;
+	size_t bytes_buckets;
+	/* all of the above, plus the table structs */
+	size_t bytes_total;
+};
+
+/* walks the bucket array once, does not allocate */
+void ehht_stats(struct ehht *table, struct ehht_stats *out);
+
+/* Per-operation counters are only collected if the library is built
+   with "./configure --enable-instrumentation", otherwise the calls
+   below compile away inside the library and ehht_op_stats returns
+   non-zero. Latencies are measured with the ehht_set_clock function. */
+
+/* values 0-3 have a bucket each, after which every power of two is
+   split into 4 linear sub-buckets; the last bucket is open-ended */
+#define EHHT_OP_HISTOGRAM_LEN 128
+
+struct ehht_op_histogram {
+	unsigned long count;
+	unsigned long total;
+	unsigned long max;
+	unsigned long buckets[EHHT_OP_HISTOGRAM_LEN];
+};
+
+struct ehht_op_stats {
+	unsigned long gets;
+	unsigned long get_hits;
+	unsigned long get_misses;
+	unsigned long has_keys;
+	unsigned long puts;
+	unsigned long put_updates;
+	unsigned long removes;
+	unsigned long remove_hits;
+
+	unsigned long hashes;
+	unsigned long hash_time;
+	unsigned long allocs;
+	unsigned long alloc_time;
+	unsigned long resizes;
+	unsigned long resize_time;
+
+	/* chain nodes visited per key lookup */
+	struct ehht_op_histogram nodes_visited;
+
+	struct ehht_op_histogram get_latency;
+	struct ehht_op_histogram put_latency;
+	struct ehht_op_histogram remove_latency;
+};
+
+/* copies the counters, returns non-zero if built without instrumentation */
+int ehht_op_stats(struct ehht *table, struct ehht_op_stats *out);
+
+void ehht_op_stats_reset(struct ehht *table);
+
+/* returns the smallest value counted in the histogram bucket */
+unsigned long ehht_op_histogram_bucket_min(size_t bucket);
+
+/* If built with the static tracepoints (when sys/sdt.h is found) the
+   "ehht:long__chain" tracepoint fires for lookups which visit more than
+   this many chain elements. Zero disables the probe. Default is 8. */
+void ehht_long_chain_probe(struct ehht *table, size_t chain_length);
+/*****************************************************************************/
+
 Ehht_end_C_functions
 #undef Ehht_end_C_functions
 #endif /* EHHT_H */
@@ -0,0 +1,714 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// ehht.hpp: a simple hashtable, as a header-only C++17 template
+// Copyright (C) 2020 Eric Herman <eric@freesa.org>
+// https://github.com/ericherman/libehht
+
+#ifndef EHHT_HPP
+#define EHHT_HPP
+
+// ehht::map<K, V, Hash, Eq, Alloc> has the structure of "struct ehht":
+// chained buckets, each element keeps its hashcode, and a put resizes
+// only when it collides while above the load factor. Unlike the C
+// interface, keys and values are typed and owned by the map, so there
+// is no "(char *, len)" glue and values need not be "void *".
+//
+// When both Hash and Eq declare "is_transparent" (the default for
+// std::string keys), find, contains, at, erase, and try_emplace accept
+// anything the hasher accepts, e.g.: a std::string_view, without
+// constructing a temporary key.
+//
+// try_emplace and insert_or_assign hash the key once and walk the chain
+// once. Values only need to be move-constructible.
+//
+// ehht::eembed_resource adapts a "struct eembed_allocator" to a
+// std::pmr::memory_resource, for use with ehht::pmr::map.
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "eembed.h"
+
+namespace ehht {
+
+// std::hash, but transparent for strings
+template <class K> struct hash : std::hash<K> {
+};
+
+template <class C, class T, class A>
+struct hash<std::basic_string<C, T, A>> {
+	using is_transparent = void;
+
+	std::size_t operator()(std::basic_string_view<C, T> s) const noexcept
+	{
+		return std::hash<std::basic_string_view<C, T>>{}(s);
+	}
+};
+
+template <class T, class = void>
+struct is_transparent : std::false_type {
+};
+
+template <class T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>>
+: std::true_type {
+};
+
+template <class K, class V, class Hash = ehht::hash<K>,
+	  class Eq = std::equal_to<>,
+	  class Alloc = std::allocator<std::pair<const K, V>>>
+class map {
+      public:
+	using key_type = K;
+	using mapped_type = V;
+	using value_type = std::pair<const K, V>;
+	using size_type = std::size_t;
+	using hasher = Hash;
+	using key_equal = Eq;
+	using allocator_type = Alloc;
+
+      private:
+	struct node {
+		node *next;
+		std::size_t hashcode;
+		value_type kv;
+
+		template <class... Args>
+		node(std::size_t h, Args &&... args)
+		: next(nullptr), hashcode(h), kv(std::forward<Args>(args)...)
+		{
+		}
+	};
+
+	using alloc_traits = std::allocator_traits<Alloc>;
+	using node_alloc = typename alloc_traits::template rebind_alloc<node>;
+	using node_traits = std::allocator_traits<node_alloc>;
+	using bucket_alloc =
+	    typename alloc_traits::template rebind_alloc<node *>;
+	using bucket_vector = std::vector<node *, bucket_alloc>;
+
+	template <class Q>
+	using is_lookup_key = std::integral_constant<bool,
+		std::is_convertible<const Q &, const K &>::value
+		|| (is_transparent<Hash>::value
+		    && is_transparent<Eq>::value)>;
+
+      public:
+	template <bool Const> class basic_iterator {
+		friend class map;
+		template <bool> friend class basic_iterator;
+		using bucket_ptr =
+		    typename std::conditional<Const, node * const *,
+					      node **>::type;
+
+		bucket_ptr bucket;
+		bucket_ptr end;
+		node *n;
+
+		basic_iterator(bucket_ptr b, bucket_ptr e, node *at)
+		: bucket(b), end(e), n(at)
+		{
+			if (!n) {
+				advance_bucket();
+			}
+		}
+
+		void advance_bucket()
+		{
+			while (bucket != end && !n) {
+				++bucket;
+				n = (bucket != end) ? *bucket : nullptr;
+			}
+		}
+
+	      public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::pair<const K, V>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = typename std::conditional<Const,
+			const value_type *, value_type *>::type;
+		using reference = typename std::conditional<Const,
+			const value_type &, value_type &>::type;
+
+		basic_iterator() : bucket(nullptr), end(nullptr), n(nullptr)
+		{
+		}
+
+		// iterator converts to const_iterator
+		template <bool C = Const, class = std::enable_if_t<C>>
+		basic_iterator(const basic_iterator<false> &other)
+		: bucket(other.bucket), end(other.end), n(other.n)
+		{
+		}
+
+		reference operator*() const
+		{
+			return n->kv;
+		}
+
+		pointer operator->() const
+		{
+			return &(n->kv);
+		}
+
+		basic_iterator &operator++()
+		{
+			n = n->next;
+			advance_bucket();
+			return *this;
+		}
+
+		basic_iterator operator++(int)
+		{
+			basic_iterator prev = *this;
+			++(*this);
+			return prev;
+		}
+
+		friend bool operator==(const basic_iterator &a,
+				       const basic_iterator &b)
+		{
+			return a.n == b.n;
+		}
+
+		friend bool operator!=(const basic_iterator &a,
+				       const basic_iterator &b)
+		{
+			return a.n != b.n;
+		}
+	};
+
+	using iterator = basic_iterator<false>;
+	using const_iterator = basic_iterator<true>;
+
+	// if num_buckets is 0, a default is chosen
+	explicit map(size_type num_buckets = 0, const Hash &hash = Hash(),
+		     const Eq &eq = Eq(), const Alloc &alloc = Alloc())
+	: buckets_(num_buckets ? num_buckets : default_buckets,
+		   nullptr, bucket_alloc(alloc)),
+	  size_(0),
+	  collision_load_factor_(default_load_factor),
+	  hash_(hash),
+	  eq_(eq),
+	  alloc_(alloc)
+	{
+	}
+
+	explicit map(const Alloc &alloc)
+	: map(0, Hash(), Eq(), alloc)
+	{
+	}
+
+	map(const map &other)
+	: map(other.bucket_count(), other.hash_, other.eq_,
+	      node_traits::select_on_container_copy_construction(other.alloc_))
+	{
+		collision_load_factor_ = other.collision_load_factor_;
+		for (const value_type &kv : other) {
+			try_emplace(kv.first, kv.second);
+		}
+	}
+
+	map(map &&other) noexcept
+	: buckets_(std::move(other.buckets_)),
+	  size_(other.size_),
+	  collision_load_factor_(other.collision_load_factor_),
+	  hash_(std::move(other.hash_)),
+	  eq_(std::move(other.eq_)),
+	  alloc_(std::move(other.alloc_))
+	{
+		other.size_ = 0;
+		other.buckets_.clear();
+	}
+
+	// keeps this map's allocator
+	map &operator=(const map &other)
+	{
+		if (this != &other) {
+			clear();
+			hash_ = other.hash_;
+			eq_ = other.eq_;
+			collision_load_factor_ = other.collision_load_factor_;
+			for (const value_type &kv : other) {
+				try_emplace(kv.first, kv.second);
+			}
+		}
+		return *this;
+	}
+
+	map &operator=(map &&other)
+	{
+		if (this == &other) {
+			return *this;
+		}
+		clear();
+		if (alloc_ == other.alloc_) {
+			swap(other);
+			return *this;
+		}
+		// different memory resources, the nodes can not be adopted
+		for (value_type &kv : other) {
+			try_emplace(kv.first, std::move(kv.second));
+		}
+		other.clear();
+		return *this;
+	}
+
+	~map()
+	{
+		clear();
+	}
+
+	// as with std containers, unless the allocator propagates on swap,
+	// the allocators must compare equal
+	void swap(map &other) noexcept
+	{
+		using std::swap;
+		buckets_.swap(other.buckets_);
+		swap(size_, other.size_);
+		swap(collision_load_factor_, other.collision_load_factor_);
+		swap(hash_, other.hash_);
+		swap(eq_, other.eq_);
+		if constexpr (node_traits::propagate_on_container_swap::value) {
+			swap(alloc_, other.alloc_);
+		}
+	}
+
+	allocator_type get_allocator() const
+	{
+		return allocator_type(alloc_);
+	}
+
+	size_type size() const noexcept
+	{
+		return size_;
+	}
+
+	bool empty() const noexcept
+	{
+		return size_ == 0;
+	}
+
+	size_type bucket_count() const noexcept
+	{
+		return buckets_.size();
+	}
+
+	// a load factor of 0.0 disables auto-resize
+	void max_load_factor(double factor) noexcept
+	{
+		collision_load_factor_ = factor;
+	}
+
+	double max_load_factor() const noexcept
+	{
+		return collision_load_factor_;
+	}
+
+	iterator begin() noexcept
+	{
+		return make_iterator(0, first_node());
+	}
+
+	iterator end() noexcept
+	{
+		return make_iterator(bucket_count(), nullptr);
+	}
+
+	const_iterator begin() const noexcept
+	{
+		return make_const_iterator(0, first_node());
+	}
+
+	const_iterator end() const noexcept
+	{
+		return make_const_iterator(bucket_count(), nullptr);
+	}
+
+	const_iterator cbegin() const noexcept
+	{
+		return begin();
+	}
+
+	const_iterator cend() const noexcept
+	{
+		return end();
+	}
+
+	template <class Q, class = std::enable_if_t<is_lookup_key<Q>::value>>
+	iterator find(const Q &key)
+	{
+		std::size_t h = hash_(key);
+		node *n = find_node(key, h);
+		return n ? make_iterator(bucket_for(h), n) : end();
+	}
+
+	template <class Q, class = std::enable_if_t<is_lookup_key<Q>::value>>
+	const_iterator find(const Q &key) const
+	{
+		std::size_t h = hash_(key);
+		node *n = find_node(key, h);
+		return n ? make_const_iterator(bucket_for(h), n) : end();
+	}
+
+	template <class Q, class = std::enable_if_t<is_lookup_key<Q>::value>>
+	bool contains(const Q &key) const
+	{
+		return find_node(key, hash_(key)) != nullptr;
+	}
+
+	template <class Q, class = std::enable_if_t<is_lookup_key<Q>::value>>
+	size_type count(const Q &key) const
+	{
+		return contains(key) ? 1 : 0;
+	}
+
+	template <class Q, class = std::enable_if_t<is_lookup_key<Q>::value>>
+	V &at(const Q &key)
+	{
+		node *n = find_node(key, hash_(key));
+		if (!n) {
+			throw std::out_of_range("ehht::map::at");
+		}
+		return n->kv.second;
+	}
+
+	template <class Q, class = std::enable_if_t<is_lookup_key<Q>::value>>
+	const V &at(const Q &key) const
+	{
+		node *n = find_node(key, hash_(key));
+		if (!n) {
+			throw std::out_of_range("ehht::map::at");
+		}
+		return n->kv.second;
+	}
+
+	V &operator[](const K &key)
+	{
+		return try_emplace(key).first->second;
+	}
+
+	V &operator[](K &&key)
+	{
+		return try_emplace(std::move(key)).first->second;
+	}
+
+	// if the key is present, nothing is moved from args
+	template <class... Args>
+	std::pair<iterator, bool> try_emplace(const K &key, Args &&... args)
+	{
+		return emplace_unique(key, std::forward<Args>(args)...);
+	}
+
+	template <class... Args>
+	std::pair<iterator, bool> try_emplace(K &&key, Args &&... args)
+	{
+		return emplace_unique(std::move(key),
+				      std::forward<Args>(args)...);
+	}
+
+	// a K is constructed from the lookup key only if it is inserted
+	template <class Q, class... Args,
+		  class = std::enable_if_t<!std::is_convertible<Q &&,
+						const K &>::value
+					   && is_lookup_key<Q>::value>>
+	std::pair<iterator, bool> try_emplace(Q &&key, Args &&... args)
+	{
+		return emplace_unique(std::forward<Q>(key),
+				      std::forward<Args>(args)...);
+	}
+
+	template <class M>
+	std::pair<iterator, bool> insert_or_assign(const K &key, M &&val)
+	{
+		return assign_unique(key, std::forward<M>(val));
+	}
+
+	template <class M>
+	std::pair<iterator, bool> insert_or_assign(K &&key, M &&val)
+	{
+		return assign_unique(std::move(key), std::forward<M>(val));
+	}
+
+	template <class Q, class = std::enable_if_t<is_lookup_key<Q>::value>>
+	size_type erase(const Q &key)
+	{
+		std::size_t h = hash_(key);
+		node **ptr_to_node = nullptr;
+		node *n = nullptr;
+
+		if (buckets_.empty()) {
+			return 0;
+		}
+		ptr_to_node = &buckets_[bucket_for(h)];
+		while ((n = *ptr_to_node) != nullptr) {
+			if (n->hashcode == h && eq_(n->kv.first, key)) {
+				*ptr_to_node = n->next;
+				destroy_node(n);
+				--size_;
+				return 1;
+			}
+			ptr_to_node = &(n->next);
+		}
+		return 0;
+	}
+
+	void clear() noexcept
+	{
+		node *n = nullptr;
+
+		for (node *&head : buckets_) {
+			while ((n = head) != nullptr) {
+				head = n->next;
+				destroy_node(n);
+			}
+		}
+		size_ = 0;
+	}
+
+	// the elements are relinked, not copied; the hashcodes are reused
+	void rehash(size_type num_buckets)
+	{
+		if (num_buckets == 0) {
+			num_buckets = default_buckets;
+		}
+		bucket_vector new_buckets(num_buckets, nullptr,
+					  buckets_.get_allocator());
+		node *n = nullptr;
+		std::size_t i = 0;
+
+		for (node *&head : buckets_) {
+			while ((n = head) != nullptr) {
+				head = n->next;
+				i = n->hashcode % num_buckets;
+				n->next = new_buckets[i];
+				new_buckets[i] = n;
+			}
+		}
+		buckets_.swap(new_buckets);
+	}
+
+	void reserve(size_type count)
+	{
+		if (collision_load_factor_ > 0.0) {
+			rehash((size_type)(count / collision_load_factor_) + 1);
+		}
+	}
+
+      private:
+	static constexpr size_type default_buckets = 64;
+	static constexpr double default_load_factor = 2.0 / 3.0;
+
+	bucket_vector buckets_;
+	size_type size_;
+	double collision_load_factor_;
+	Hash hash_;
+	Eq eq_;
+	node_alloc alloc_;
+
+	std::size_t bucket_for(std::size_t hashcode) const noexcept
+	{
+		return hashcode % buckets_.size();
+	}
+
+	node *first_node() const noexcept
+	{
+		return buckets_.empty() ? nullptr : buckets_[0];
+	}
+
+	iterator make_iterator(std::size_t i, node *n) noexcept
+	{
+		node **base = buckets_.data();
+		return iterator(base + i, base + buckets_.size(), n);
+	}
+
+	const_iterator make_const_iterator(std::size_t i, node *n) const
+	    noexcept
+	{
+		node *const *base = buckets_.data();
+		return const_iterator(base + i, base + buckets_.size(), n);
+	}
+
+	template <class Q> node *find_node(const Q &key, std::size_t h) const
+	{
+		node *n = nullptr;
+
+		if (buckets_.empty()) {
+			return nullptr;
+		}
+		for (n = buckets_[bucket_for(h)]; n != nullptr; n = n->next) {
+			if (n->hashcode == h && eq_(n->kv.first, key)) {
+				return n;
+			}
+		}
+		return nullptr;
+	}
+
+	template <class... Args> node *create_node(Args &&... args)
+	{
+		node *n = node_traits::allocate(alloc_, 1);
+		try {
+			node_traits::construct(alloc_, n,
+					       std::forward<Args>(args)...);
+		}
+		catch (...) {
+			node_traits::deallocate(alloc_, n, 1);
+			throw;
+		}
+		return n;
+	}
+
+	void destroy_node(node *n) noexcept
+	{
+		node_traits::destroy(alloc_, n);
+		node_traits::deallocate(alloc_, n, 1);
+	}
+
+	// as with ehht.c, grow only when the put collides
+	std::size_t make_room(std::size_t h)
+	{
+		std::size_t i = bucket_for(h);
+
+		if (buckets_[i] != nullptr && collision_load_factor_ > 0.0
+		    && size_ >= (buckets_.size() * collision_load_factor_)) {
+			try {
+				rehash(buckets_.size() * 2);
+			}
+			catch (const std::bad_alloc &) {
+				// a failed resize only lengthens the chain
+			}
+			i = bucket_for(h);
+		}
+		return i;
+	}
+
+	std::pair<iterator, bool> link_node(node *n, std::size_t i)
+	{
+		n->next = buckets_[i];
+		buckets_[i] = n;
+		++size_;
+		return std::pair<iterator, bool>(make_iterator(i, n), true);
+	}
+
+	template <class Q, class... Args>
+	std::pair<iterator, bool> emplace_unique(Q &&key, Args &&... args)
+	{
+		std::size_t h = hash_(key);
+		node *n = nullptr;
+		std::size_t i = 0;
+
+		if (buckets_.empty()) {
+			rehash(default_buckets);
+		}
+		n = find_node(key, h);
+		if (n) {
+			return std::pair<iterator, bool>(make_iterator
+							 (bucket_for(h), n),
+							 false);
+		}
+		i = make_room(h);
+		n = create_node(h, std::piecewise_construct,
+				std::forward_as_tuple(std::forward<Q>(key)),
+				std::forward_as_tuple(std::forward<Args>
+						      (args)...));
+		return link_node(n, i);
+	}
+
+	template <class Q, class M>
+	std::pair<iterator, bool> assign_unique(Q &&key, M &&val)
+	{
+		std::size_t h = hash_(key);
+		node *n = nullptr;
+		std::size_t i = 0;
+
+		if (buckets_.empty()) {
+			rehash(default_buckets);
+		}
+		n = find_node(key, h);
+		if (n) {
+			n->kv.second = std::forward<M>(val);
+			return std::pair<iterator, bool>(make_iterator
+							 (bucket_for(h), n),
+							 false);
+		}
+		i = make_room(h);
+		n = create_node(h, std::forward<Q>(key), std::forward<M>(val));
+		return link_node(n, i);
+	}
+};
+
+template <class K, class V, class H, class E, class A>
+void swap(map<K, V, H, E, A> &a, map<K, V, H, E, A> &b) noexcept
+{
+	a.swap(b);
+}
+
+// a std::pmr::memory_resource which allocates from a eembed_allocator
+class eembed_resource : public std::pmr::memory_resource {
+      public:
+	// if ea is NULL, eembed_global_alloctor will be used
+	explicit eembed_resource(struct eembed_allocator *ea = nullptr)
+	: ea_(ea ? ea : eembed_global_allocator)
+	{
+	}
+
+	struct eembed_allocator *allocator() const noexcept
+	{
+		return ea_;
+	}
+
+      private:
+	struct eembed_allocator *ea_;
+
+	void *do_allocate(std::size_t bytes, std::size_t alignment) override
+	{
+		void *ptr = nullptr;
+
+		// eembed allocators return malloc-aligned memory
+		if (alignment > alignof(std::max_align_t)) {
+			throw std::bad_alloc();
+		}
+		ptr = ea_->malloc(ea_, bytes);
+		if (!ptr) {
+			throw std::bad_alloc();
+		}
+		return ptr;
+	}
+
+	void do_deallocate(void *ptr, std::size_t bytes,
+			   std::size_t alignment) override
+	{
+		(void)bytes;
+		(void)alignment;
+		ea_->free(ea_, ptr);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const
+	    noexcept override
+	{
+		const eembed_resource *o =
+		    dynamic_cast<const eembed_resource *>(&other);
+		return o && o->ea_ == ea_;
+	}
+};
+
+namespace pmr {
+template <class K, class V, class Hash = ehht::hash<K>,
+	  class Eq = std::equal_to<>>
+using map = ehht::map<K, V, Hash, Eq,
+		      std::pmr::polymorphic_allocator<std::pair<const K, V>>>;
+}
+
+}				// namespace ehht
+
+#endif // EHHT_HPP
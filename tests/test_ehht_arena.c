@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_arena.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+#define Test_ehht_arena_chunk 1024
+
+int test_ehht_arena_terminated(struct ehht_key each_key, void *each_val,
+			       void *context)
+{
+	unsigned *failures = (unsigned *)context;
+	(void)each_val;
+	*failures += check_size_t(eembed_strlen(each_key.str), each_key.len);
+	return 0;
+}
+
+unsigned test_ehht_arena_check_all(struct ehht *table, size_t from,
+				   size_t to, int expected)
+{
+	char key[20];
+	size_t bad = 0;
+	size_t i = 0;
+
+	for (i = from; i < to; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		if (table->has_key(table, key, eembed_strlen(key))
+		    != expected) {
+			++bad;
+		} else if (expected
+			   && (size_t)table->get(table, key,
+						 eembed_strlen(key)) != i) {
+			++bad;
+		}
+	}
+	return check_size_t(bad, 0);
+}
+
+unsigned test_ehht_arena(void)
+{
+	const size_t bytes_len = 3000 * sizeof(size_t);
+	unsigned char bytes[3000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht *other = NULL;
+	struct ehht_stats stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	char long_key[2 * Test_ehht_arena_chunk];
+	char key[20];
+	size_t allocs_before = 0;
+	size_t round = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_arena_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(0, NULL, &wrap, log);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_arena_end;
+	}
+	failures += check_int(ehht_arena(table, Test_ehht_arena_chunk), 0);
+
+	for (round = 0; round < 3; ++round) {
+		allocs_before = ctx.allocs;
+		for (i = 0; i < 100; ++i) {
+			eembed_ulong_to_str(key, 20, i);
+			table->put(table, key, eembed_strlen(key), (void *)i,
+				   &err);
+		}
+		failures += check_int(err, 0);
+		failures += check_size_t(table->size(table), 100);
+		failures += test_ehht_arena_check_all(table, 0, 100, 1);
+
+		/* far fewer allocations than elements; after the first
+		   round, the kept chunk is reused */
+		failures += check_int((ctx.allocs - allocs_before) < 10, 1);
+
+		/* remove unlinks */
+		for (i = 0; i < 100; i += 2) {
+			eembed_ulong_to_str(key, 20, i);
+			failures +=
+			    check_size_t((size_t)
+					 table->remove(table, key,
+						       eembed_strlen(key)), i);
+		}
+		failures += check_size_t(table->size(table), 50);
+		failures += check_int(table->has_key(table, "0", 1), 0);
+		failures += check_int(table->has_key(table, "1", 1), 1);
+		table->for_each(table, test_ehht_arena_terminated, &failures);
+
+		/* an update does not allocate */
+		allocs_before = ctx.allocs;
+		table->put(table, "1", 1, (void *)1, &err);
+		failures += check_size_t(ctx.allocs, allocs_before);
+
+		/* clear frees all but one chunk */
+		table->clear(table);
+		failures += check_size_t(table->size(table), 0);
+		failures += test_ehht_arena_check_all(table, 0, 100, 0);
+		failures += check_unsigned_int_m(ctx.allocs - ctx.frees, 4,
+						 "table, buckets, chunk");
+	}
+
+	/* an element larger than a chunk gets its own */
+	eembed_memset(long_key, 'k', sizeof(long_key));
+	table->put(table, "a", 1, (void *)1, &err);
+	table->put(table, long_key, sizeof(long_key), (void *)2, &err);
+	table->put(table, "b", 1, (void *)3, &err);
+	failures += check_int(err, 0);
+	failures += check_ptr(table->get(table, long_key, sizeof(long_key)),
+			      (void *)2);
+	failures += check_ptr(table->get(table, "b", 1), (void *)3);
+	ehht_stats(table, &stats);
+	failures += check_int(stats.bytes_elements > sizeof(long_key), 1);
+
+	/* a failed chunk allocation fails the put */
+	for (i = 0; i < 100 && !err; ++i) {
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = 0x01;
+		eembed_ulong_to_str(key, 20, 1000 + i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_int(err, 1);
+	failures += check_int(table->has_key(table, key, eembed_strlen(key)),
+			      0);
+	err = 0;
+
+	/* the mode only changes while empty */
+	failures += check_int(ehht_arena(table, 0), 1);
+
+	/* evicting would free nothing, so no cache limits, in either order */
+	failures += check_int(ehht_cache_limit(table, 10, 0, NULL, NULL), 1);
+	failures += check_int(ehht_cache_limit(table, 0, 0, NULL, NULL), 0);
+	other = ehht_new_custom(0, NULL, &wrap, log);
+	if (check_ptr_not_null(other)) {
+		++failures;
+	} else {
+		failures +=
+		    check_int(ehht_cache_limit(other, 0, 4096, NULL, NULL), 0);
+		failures += check_int(ehht_arena(other, 1024), 1);
+		ehht_free(other);
+	}
+
+	/* merge copies, as elements can not move between arenas */
+	other = ehht_new_custom(0, NULL, &wrap, log);
+	if (check_ptr_not_null(other)) {
+		++failures;
+	} else {
+		other->put(other, "c", 1, (void *)4, &err);
+		failures += check_int(ehht_merge(table, other, NULL, NULL), 0);
+		failures += check_ptr(table->get(table, "c", 1), (void *)4);
+		failures += check_size_t(other->size(other), 0);
+		table->put(table, "d", 1, (void *)5, &err);
+		failures += check_int(ehht_move(other, table, "d", 1), 0);
+		failures += check_ptr(other->get(other, "d", 1), (void *)5);
+		failures += check_int(table->has_key(table, "d", 1), 0);
+		ehht_free(other);
+	}
+
+	/* with inline values and expiry */
+	table->clear(table);
+	failures += check_int(ehht_value_size(table, 16), 0);
+	failures += check_int(ehht_expiry(table, 1, NULL, NULL), 0);
+	for (i = 0; i < 50; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		ehht_put_with_ttl(table, key, eembed_strlen(key), key,
+				  (i % 2) ? 10 : 0, &err);
+	}
+	failures += check_int(err, 0);
+	ehht_expire(table, 20, 1000);
+	failures += check_size_t(table->size(table), 25);
+	table->clear(table);
+	ehht_expire(table, 40, 1000);
+	failures += check_size_t(table->size(table), 0);
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_arena_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_arena)
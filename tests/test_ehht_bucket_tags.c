@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_bucket_tags.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+/* only a few distinct hashcodes, so chains are long and tags collide */
+unsigned int test_ehht_bucket_tags_hash(const char *data, size_t data_len)
+{
+	return (unsigned int)(data_len ? (data[data_len - 1] % 3) : 0);
+}
+
+int test_ehht_bucket_tags_count(struct ehht_key each_key, void *each_val,
+				void *context)
+{
+	size_t *count = (size_t *)context;
+	(void)each_key;
+	(void)each_val;
+	++(*count);
+	return 0;
+}
+
+unsigned test_ehht_bucket_tags_check_all(struct ehht *table, size_t from,
+					 size_t to, int expected)
+{
+	unsigned failures = 0;
+	char key[20];
+	size_t i = 0;
+
+	for (i = from; i < to; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_int(table->has_key(table, key, eembed_strlen(key)),
+			      expected);
+	}
+	return failures;
+}
+
+unsigned test_ehht_bucket_tags(void)
+{
+	const size_t bytes_len = 2000 * sizeof(size_t);
+	unsigned char bytes[2000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_stats stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	char key[20];
+	size_t bytes_buckets = 0;
+	size_t count = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(4, test_ehht_bucket_tags_hash, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_bucket_tags_end;
+	}
+	ehht_buckets_auto_resize_load_factor(table, 0.0);
+
+	/* keys added before the tags are enabled are tagged */
+	for (i = 0; i < 5; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	ehht_stats(table, &stats);
+	bytes_buckets = stats.bytes_buckets;
+
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x01;
+	failures += check_int(ehht_bucket_tags(table, 1), 1);
+	ctx.attempts_to_fail_bitmask = 0;
+
+	failures += check_int(ehht_bucket_tags(table, 1), 0);
+	failures += check_int(ehht_bucket_tags(table, 1), 0);
+	ehht_stats(table, &stats);
+	failures += check_int(stats.bytes_buckets > bytes_buckets, 1);
+	failures +=
+	    check_size_t(stats.bytes_total, ctx.alloc_bytes - ctx.free_bytes);
+	failures += test_ehht_bucket_tags_check_all(table, 0, 5, 1);
+
+	/* chains longer than the tags */
+	for (i = 5; i < 100; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	failures += check_int(err, 0);
+	failures += test_ehht_bucket_tags_check_all(table, 0, 100, 1);
+	failures += test_ehht_bucket_tags_check_all(table, 100, 200, 0);
+	failures += check_int(table->has_key(table, "", 0), 0);
+
+	/* removes from the front, middle and back of chains */
+	for (i = 0; i < 100; i += 3) {
+		eembed_ulong_to_str(key, 20, i);
+		table->remove(table, key, eembed_strlen(key));
+	}
+	for (i = 0; i < 100; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_int(table->has_key(table, key, eembed_strlen(key)),
+			      (i % 3) ? 1 : 0);
+	}
+
+	/* a failed resize keeps the old buckets and tags */
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x02;
+	failures += check_size_t(ehht_buckets_resize(table, 64), 4);
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += test_ehht_bucket_tags_check_all(table, 1, 3, 1);
+
+	failures += check_size_t(ehht_buckets_resize(table, 64), 64);
+	for (i = 0; i < 100; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_int(table->has_key(table, key, eembed_strlen(key)),
+			      (i % 3) ? 1 : 0);
+	}
+	table->for_each(table, test_ehht_bucket_tags_count, &count);
+	failures += check_size_t(count, table->size(table));
+
+	table->clear(table);
+	failures += test_ehht_bucket_tags_check_all(table, 0, 100, 0);
+	table->put(table, "a", 1, NULL, &err);
+	failures += check_int(table->has_key(table, "a", 1), 1);
+
+	failures += check_int(ehht_bucket_tags(table, 0), 0);
+	failures += check_int(table->has_key(table, "a", 1), 1);
+	failures += check_int(ehht_bucket_tags(table, 1), 0);
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_bucket_tags_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_bucket_tags)
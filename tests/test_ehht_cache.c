@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_cache.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+struct test_ehht_cache_evicted {
+	size_t count;
+	size_t val_sum;
+	int saw_hot;
+};
+
+void test_ehht_cache_evict(struct ehht_key key, void *val, void *context)
+{
+	struct test_ehht_cache_evicted *evicted = NULL;
+
+	evicted = (struct test_ehht_cache_evicted *)context;
+	++(evicted->count);
+	evicted->val_sum += (size_t)val;
+	if (key.len == 3 && eembed_strncmp(key.str, "hot", 3) == 0) {
+		evicted->saw_hot = 1;
+	}
+}
+
+unsigned test_ehht_cache(void)
+{
+	const size_t bytes_len = 4000 * sizeof(size_t);
+	unsigned char bytes[4000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht *src = NULL;
+	struct ehht_stats stats;
+	struct test_ehht_cache_evicted evicted;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	char key[20];
+	size_t max_bytes = 0;
+	size_t i = 0;
+	size_t sum = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(32, NULL, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_cache_end;
+	}
+	eembed_memset(&evicted, 0x00, sizeof(evicted));
+
+	failures += check_int(ehht_cache_limit(table, 10, 0,
+					       test_ehht_cache_evict,
+					       &evicted), 0);
+
+	/* a frequently read key survives a stream of new keys */
+	table->put(table, "hot", 3, NULL, &err);
+	for (i = 1; i <= 100; ++i) {
+		failures += check_int(table->has_key(table, "hot", 3), 1);
+		table->get(table, "hot", 3);
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+		failures += check_int(table->has_key(table, key,
+						     eembed_strlen(key)), 1);
+		failures += check_int(table->size(table) <= 10, 1);
+	}
+	failures += check_int(err, 0);
+	failures += check_int(evicted.saw_hot, 0);
+	failures += check_size_t(evicted.count, 91);
+	ehht_stats(table, &stats);
+	failures += check_size_t(stats.evictions, 91);
+	failures += check_size_t(stats.size, 10);
+
+	/* each value is either evicted or still present */
+	sum = evicted.val_sum;
+	for (i = 1; i <= 100; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		sum += (size_t)table->get(table, key, eembed_strlen(key));
+	}
+	failures += check_size_t(sum, (100 * 101) / 2);
+
+	/* lowering the limit evicts at once */
+	failures += check_int(ehht_cache_limit(table, 4, 0,
+					       test_ehht_cache_evict,
+					       &evicted), 0);
+	failures += check_size_t(table->size(table), 4);
+
+	/* a byte budget, which resizes also respect */
+	ehht_stats(table, &stats);
+	max_bytes = 8 * (stats.bytes_elements + stats.bytes_keys) / 4;
+	failures += check_int(ehht_cache_limit(table, 0, max_bytes,
+					       test_ehht_cache_evict,
+					       &evicted), 0);
+	for (i = 1000; i < 1100; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+		ehht_stats(table, &stats);
+		failures +=
+		    check_int(stats.bytes_elements + stats.bytes_keys <=
+			      max_bytes, 1);
+	}
+	failures += check_int(table->size(table) >= 6, 1);
+	ehht_buckets_resize(table, 128);
+	table->put(table, "after", 5, NULL, &err);
+	failures += check_int(table->has_key(table, "after", 5), 1);
+
+	/* reference bits survive a resize: the even keys are read */
+	failures += check_int(ehht_cache_limit(table, 64, 0,
+					       test_ehht_cache_evict,
+					       &evicted), 0);
+	table->clear(table);
+	for (i = 0; i < 64; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	for (i = 0; i < 64; i += 2) {
+		eembed_ulong_to_str(key, 20, i);
+		table->get(table, key, eembed_strlen(key));
+	}
+	ehht_buckets_resize(table, 4 * ehht_buckets_size(table));
+	for (i = 1000; i < 1032; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 64);
+	for (i = 0; i < 64; i += 2) {
+		eembed_ulong_to_str(key, 20, i);
+		failures += check_int(table->has_key(table, key,
+						     eembed_strlen(key)), 1);
+	}
+
+	/* disabled, the table grows again */
+	failures += check_int(ehht_cache_limit(table, 0, 0, NULL, NULL), 0);
+	i = table->size(table);
+	table->put(table, "more", 4, NULL, &err);
+	failures += check_size_t(table->size(table), i + 1);
+
+	/* ehht_merge and ehht_move also keep to the limits */
+	src = ehht_new_custom(32, NULL, &wrap, NULL);
+	if (check_ptr_not_null(src)) {
+		++failures;
+		ehht_free(table);
+		goto test_ehht_cache_end;
+	}
+	failures += check_int(ehht_cache_limit(table, 8, 0,
+					       test_ehht_cache_evict,
+					       &evicted), 0);
+	for (i = 2000; i < 2020; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		src->put(src, key, eembed_strlen(key), NULL, &err);
+	}
+	failures += check_int(ehht_merge(table, src, NULL, NULL), 0);
+	failures += check_size_t(table->size(table), 8);
+	failures += check_size_t(src->size(src), 0);
+	src->put(src, "moved", 5, NULL, &err);
+	failures += check_int(ehht_move(table, src, "moved", 5), 0);
+	failures += check_size_t(table->size(table), 8);
+	failures += check_int(table->has_key(table, "moved", 5), 1);
+	failures += check_int(err, 0);
+	ehht_free(src);
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_cache_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_cache)
@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_clone.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+unsigned test_ehht_clone_fill(struct ehht *table, size_t from, size_t to)
+{
+	char key[20];
+	size_t i = 0;
+	int err = 0;
+
+	for (i = from; i < to; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	return check_int(err, 0);
+}
+
+unsigned test_ehht_clone_check(struct ehht *table, size_t from, size_t to)
+{
+	unsigned failures = 0;
+	char key[20];
+	size_t i = 0;
+	int found = 0;
+
+	for (i = from; i < to; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_size_t((size_t)ehht_lookup(table, key,
+						     eembed_strlen(key),
+						     &found), i);
+		failures += check_int(found, 1);
+	}
+	return failures;
+}
+
+unsigned test_ehht_clone(void)
+{
+	const size_t bytes_len = 4000 * sizeof(size_t);
+	unsigned char bytes[4000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *a = NULL;
+	struct ehht *b = NULL;
+	struct ehht *c = NULL;
+	struct ehht_stats stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	size_t allocs_before = 0;
+	size_t live = 0;
+	size_t i = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_clone_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	a = ehht_new_custom(4, NULL, &wrap, log);
+	b = ehht_new_custom(4, NULL, &wrap, log);
+	if (check_ptr_not_null(a) || check_ptr_not_null(b)) {
+		++failures;
+		goto test_ehht_clone_end;
+	}
+	ehht_bucket_tags(a, 1);
+	failures += test_ehht_clone_fill(a, 0, 60);
+
+	/* sized for the final count: no resizes while copying */
+	c = ehht_clone(a);
+	if (check_ptr_not_null(c)) {
+		++failures;
+		goto test_ehht_clone_end;
+	}
+	ehht_stats(c, &stats);
+	failures += check_size_t(stats.resizes, 0);
+	failures += check_size_t(stats.size, 60);
+	failures += test_ehht_clone_check(c, 0, 60);
+
+	/* the clone is independent of the original */
+	c->remove(c, "7", 1);
+	failures += check_int(a->has_key(a, "7", 1), 1);
+	failures += check_int(c->has_key(c, "7", 1), 0);
+	ehht_free(c);
+	c = NULL;
+
+	/* a failed clone frees what it allocated */
+	live = ctx.allocs - ctx.frees;
+	for (i = 1; i < 12; ++i) {
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = ((unsigned long)1) << i;
+		c = ehht_clone(a);
+		failures += check_ptr(c, NULL);
+	}
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_size_t_m(ctx.allocs - ctx.frees, live,
+				   "clone failure");
+
+	/* move relinks, without allocating */
+	allocs_before = ctx.allocs;
+	failures += check_int(ehht_move(b, a, "5", 1), 0);
+	failures += check_size_t(ctx.allocs - allocs_before, 0);
+	failures += check_int(a->has_key(a, "5", 1), 0);
+	failures += test_ehht_clone_check(b, 5, 6);
+	failures += check_int(ehht_move(b, a, "5", 1), 1);
+	failures += check_int(ehht_move(b, a, "none", 4), 1);
+	failures += test_ehht_clone_fill(a, 5, 6);
+	failures += check_int(ehht_move(b, a, "5", 1), 1);
+	failures += check_size_t(a->size(a), 60);
+
+	/* move into a table which pools its keys copies the element */
+	failures += check_int(ehht_pool_keys(b, 0), 1);
+	b->clear(b);
+	failures += check_int(ehht_pool_keys(b, 1024), 0);
+	for (i = 0; i < 10; ++i) {
+		char key[20];
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_int(ehht_move(b, a, key, eembed_strlen(key)), 0);
+	}
+	failures += check_size_t(a->size(a), 50);
+	failures += test_ehht_clone_check(b, 0, 10);
+
+	/* swap exchanges the contents */
+	ehht_swap(a, b);
+	failures += check_size_t(a->size(a), 10);
+	failures += check_size_t(b->size(b), 50);
+	failures += test_ehht_clone_check(a, 0, 10);
+	failures += test_ehht_clone_check(b, 10, 60);
+
+	ehht_free(a);
+	ehht_free(b);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_clone_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_clone)
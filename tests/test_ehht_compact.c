@@ -0,0 +1,266 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_compact.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+struct test_ehht_compact_order {
+	size_t next;
+	size_t step;
+	size_t jump_at;
+	size_t jump_to;
+	size_t bad;
+	size_t count;
+};
+
+/* the values were put in order of "step", from "next", until "jump_at",
+   then counting up by 1 from "jump_to" */
+int test_ehht_compact_order_each(struct ehht_key each_key, void *each_val,
+				 void *context)
+{
+	struct test_ehht_compact_order *order = NULL;
+
+	order = (struct test_ehht_compact_order *)context;
+	(void)each_key;
+	if ((size_t)each_val != order->next) {
+		++(order->bad);
+	}
+	order->next += order->step;
+	if (order->jump_at && order->next == order->jump_at) {
+		order->next = order->jump_to;
+		order->step = 1;
+	}
+	++(order->count);
+	return 0;
+}
+
+unsigned test_ehht_compact_check_all(struct ehht *table, size_t from,
+				     size_t to, size_t step, int expected)
+{
+	char key[20];
+	size_t bad = 0;
+	size_t i = 0;
+
+	for (i = from; i < to; i += step) {
+		eembed_ulong_to_str(key, 20, i);
+		if (table->has_key(table, key, eembed_strlen(key))
+		    != expected) {
+			++bad;
+		} else if (expected
+			   && (size_t)table->get(table, key,
+						 eembed_strlen(key)) != i) {
+			++bad;
+		}
+	}
+	return check_size_t(bad, 0);
+}
+
+unsigned test_ehht_compact_put_range(struct ehht *table, size_t from,
+				     size_t to, size_t step)
+{
+	char key[20];
+	size_t i = 0;
+	int err = 0;
+
+	for (i = from; i < to && !err; i += step) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	return check_int(err, 0);
+}
+
+unsigned test_ehht_compact(void)
+{
+	const size_t bytes_len = 12000 * sizeof(size_t);
+	unsigned char bytes[12000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_keys *keys = NULL;
+	struct test_ehht_compact_order order;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	char key[20];
+	char long_key[100];
+	char buf[80];
+	size_t live_bytes = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	/* the struct ehht, the table, the index, entries and key bytes */
+	for (i = 0; i < 5; ++i) {
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = (1UL << i);
+		table = ehht_new_compact(0, NULL, &wrap, NULL);
+		failures += check_ptr(table, NULL);
+	}
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "ctor fails");
+
+	/* an index of 8 slots, with room for 5 entries */
+	table = ehht_new_compact(0, NULL, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_compact_end;
+	}
+	failures += test_ehht_compact_put_range(table, 0, 5, 1);
+
+	/* a failed resize fails the put, and leaves the table as it was */
+	for (i = 0; i < 3; ++i) {
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = (1UL << i);
+		table->put(table, "new", 3, NULL, &err);
+		failures += check_int(err, 1);
+		err = 0;
+	}
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_int(table->has_key(table, "new", 3), 0);
+	failures += check_size_t(table->size(table), 5);
+	failures += test_ehht_compact_check_all(table, 0, 5, 1, 1);
+
+	/* as does a failure to grow the key bytes */
+	failures += test_ehht_compact_put_range(table, 5, 7, 1);
+	eembed_memset(long_key, 'k', sizeof(long_key));
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x01;
+	table->put(table, long_key, sizeof(long_key), NULL, &err);
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_int(err, 1);
+	err = 0;
+	failures += check_int(table->has_key(table, long_key, 100), 0);
+	table->put(table, long_key, sizeof(long_key), (void *)7, &err);
+	failures += check_int(err, 0);
+	failures +=
+	    check_size_t((size_t)table->remove(table, long_key, 100), 7);
+	failures += check_size_t(table->size(table), 7);
+	table->clear(table);
+	failures += check_size_t(table->size(table), 0);
+	failures += test_ehht_compact_check_all(table, 0, 7, 1, 0);
+
+	/* for_each is in the order of the first put */
+	failures += test_ehht_compact_put_range(table, 1000, 1100, 1);
+	failures += check_size_t((size_t)table->put(table, "1000", 4,
+						     (void *)1000, &err), 1000);
+	eembed_memset(&order, 0x00, sizeof(order));
+	order.next = 1000;
+	order.step = 1;
+	table->for_each(table, test_ehht_compact_order_each, &order);
+	failures += check_size_t(order.count, 100);
+	failures += check_size_t(order.bad, 0);
+
+	/* removed entries are skipped */
+	for (i = 1001; i < 1100; i += 2) {
+		eembed_ulong_to_str(key, 20, i);
+		failures += check_size_t((size_t)
+					 table->remove(table, key,
+						       eembed_strlen(key)), i);
+	}
+	failures += check_size_t(table->size(table), 50);
+	failures += check_ptr(table->remove(table, "1001", 4), NULL);
+	failures += test_ehht_compact_check_all(table, 1001, 1100, 2, 0);
+	eembed_memset(&order, 0x00, sizeof(order));
+	order.next = 1000;
+	order.step = 2;
+	table->for_each(table, test_ehht_compact_order_each, &order);
+	failures += check_size_t(order.count, 50);
+	failures += check_size_t(order.bad, 0);
+
+	/* past an index of 256 slots, the order and holes survive resizes */
+	failures += test_ehht_compact_put_range(table, 1100, 1600, 2);
+	failures += check_size_t(table->size(table), 300);
+	eembed_memset(&order, 0x00, sizeof(order));
+	order.next = 1000;
+	order.step = 2;
+	table->for_each(table, test_ehht_compact_order_each, &order);
+	failures += check_size_t(order.count, 300);
+	failures += check_size_t(order.bad, 0);
+	failures += test_ehht_compact_check_all(table, 1000, 1600, 2, 1);
+	failures += test_ehht_compact_check_all(table, 1001, 1600, 2, 0);
+
+	keys = table->keys(table, 0);
+	if (check_ptr_not_null(keys)) {
+		++failures;
+	} else {
+		failures += check_size_t(keys->len, 300);
+		failures += check_int(eembed_memcmp(keys->keys[1].str, "1002",
+						    5), 0);
+		table->free_keys(table, keys);
+	}
+	keys = table->keys(table, 1);
+	if (check_ptr_not_null(keys)) {
+		++failures;
+	} else {
+		failures += check_size_t(keys->len, 300);
+		failures += check_int(eembed_memcmp(keys->keys[299].str,
+						    "1598", 5), 0);
+		table->free_keys(table, keys);
+	}
+
+	/* churn does not grow the table: holes are compacted away */
+	live_bytes = ctx.alloc_bytes - ctx.free_bytes;
+	for (i = 0; i < 2000; ++i) {
+		eembed_ulong_to_str(key, 20, 5000 + i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+		table->remove(table, key, eembed_strlen(key));
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 300);
+	failures +=
+	    check_int((ctx.alloc_bytes - ctx.free_bytes) <= (2 * live_bytes),
+		      1);
+	failures += test_ehht_compact_check_all(table, 1000, 1600, 2, 1);
+
+	/* past an index of 65536 slots */
+	if (EEMBED_HOSTED) {
+		failures +=
+		    test_ehht_compact_put_range(table, 100000, 150000, 1);
+		failures += check_size_t(table->size(table), 50300);
+		failures +=
+		    test_ehht_compact_check_all(table, 1000, 1600, 2, 1);
+		failures +=
+		    test_ehht_compact_check_all(table, 100000, 150000, 1, 1);
+		eembed_memset(&order, 0x00, sizeof(order));
+		order.next = 1000;
+		order.step = 2;
+		order.jump_at = 1600;
+		order.jump_to = 100000;
+		table->for_each(table, test_ehht_compact_order_each, &order);
+		failures += check_size_t(order.count, 50300);
+		failures += check_size_t(order.bad, 0);
+	}
+
+	table->clear(table);
+	table->put(table, "a", 1, NULL, &err);
+	table->to_string(table, buf, 80);
+	failures += check_int(buf[0], '{');
+	failures += check_int(buf[2], '\'');
+	failures += check_int(buf[3], 'a');
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_compact_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_compact)
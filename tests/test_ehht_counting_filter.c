@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_counting_filter.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+/* every key has the same hashcode, so the counters saturate */
+unsigned int test_ehht_counting_filter_hash(const char *data, size_t len)
+{
+	(void)data;
+	(void)len;
+	return 42;
+}
+
+unsigned test_ehht_counting_filter_check_all(struct ehht *table, size_t from,
+					     size_t to, size_t step,
+					     int expected)
+{
+	unsigned failures = 0;
+	char key[20];
+	size_t i = 0;
+
+	for (i = from; i < to; i += step) {
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_int(table->has_key(table, key, eembed_strlen(key)),
+			      expected);
+	}
+	return failures;
+}
+
+unsigned test_ehht_counting_filter(void)
+{
+	const size_t bytes_len = 8000 * sizeof(size_t);
+	unsigned char bytes[8000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht *other = NULL;
+	struct ehht_stats stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	char key[20];
+	size_t bytes_buckets = 0;
+	size_t num_buckets = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(64, NULL, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_counting_filter_end;
+	}
+
+	/* keys added before the filter is enabled are counted */
+	for (i = 0; i < 20; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	ehht_stats(table, &stats);
+	bytes_buckets = stats.bytes_buckets;
+
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x01;
+	failures += check_int(ehht_counting_filter(table, 1), 1);
+	ctx.attempts_to_fail_bitmask = 0;
+
+	failures += check_int(ehht_counting_filter(table, 1), 0);
+	failures += check_int(ehht_counting_filter(table, 1), 0);
+	ehht_stats(table, &stats);
+	failures += check_int(stats.bytes_buckets > bytes_buckets, 1);
+	failures +=
+	    check_size_t(stats.bytes_total, ctx.alloc_bytes - ctx.free_bytes);
+	failures += test_ehht_counting_filter_check_all(table, 0, 20, 1, 1);
+
+	/* grows through several resizes, each rebuilding the filter */
+	for (i = 20; i < 400; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	failures += check_int(err, 0);
+	ehht_stats(table, &stats);
+	failures += check_int(stats.resizes > 0, 1);
+	failures += test_ehht_counting_filter_check_all(table, 0, 400, 1, 1);
+
+	/* most misses are rejected by the filter alone */
+	ehht_stats(table, &stats);
+	i = stats.filter_negatives;
+	failures += test_ehht_counting_filter_check_all(table, 400, 1400, 1, 0);
+	ehht_stats(table, &stats);
+	failures += check_int((stats.filter_negatives - i) > 800, 1);
+
+	/* removed keys are forgotten, the others are not */
+	for (i = 0; i < 400; i += 2) {
+		eembed_ulong_to_str(key, 20, i);
+		table->remove(table, key, eembed_strlen(key));
+	}
+	failures += test_ehht_counting_filter_check_all(table, 0, 400, 2, 0);
+	failures += test_ehht_counting_filter_check_all(table, 1, 400, 2, 1);
+
+	/* a failed resize keeps the old buckets and filter */
+	num_buckets = ehht_buckets_size(table);
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x02;
+	failures += check_size_t(ehht_buckets_resize(table, 4 * num_buckets),
+				 num_buckets);
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += test_ehht_counting_filter_check_all(table, 1, 400, 2, 1);
+
+	/* intersect rebuilds the filter of the table it removes from */
+	other = ehht_new();
+	if (check_ptr_not_null(other)) {
+		++failures;
+	} else {
+		for (i = 1; i < 200; i += 2) {
+			eembed_ulong_to_str(key, 20, i);
+			other->put(other, key, eembed_strlen(key), NULL, &err);
+		}
+		failures += check_size_t(ehht_intersect(table, other, NULL,
+							NULL), 100);
+		failures +=
+		    test_ehht_counting_filter_check_all(table, 1, 200, 2, 1);
+		failures +=
+		    test_ehht_counting_filter_check_all(table, 201, 400, 2, 0);
+		ehht_free(other);
+	}
+
+	table->clear(table);
+	failures += test_ehht_counting_filter_check_all(table, 0, 400, 1, 0);
+	failures += check_int(ehht_counting_filter(table, 0), 0);
+	table->put(table, "a", 1, NULL, &err);
+	failures += check_int(table->has_key(table, "a", 1), 1);
+	ehht_free(table);
+
+	/* saturated counters are never decremented, so no false negatives */
+	table = ehht_new_custom(4, test_ehht_counting_filter_hash, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_counting_filter_end;
+	}
+	ehht_buckets_auto_resize_load_factor(table, 0.0);
+	failures += check_int(ehht_counting_filter(table, 1), 0);
+	for (i = 0; i < 40; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	for (i = 0; i < 39; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->remove(table, key, eembed_strlen(key));
+	}
+	failures += check_int(table->has_key(table, "39", 2), 1);
+	table->remove(table, "39", 2);
+	failures += check_int(table->has_key(table, "39", 2), 0);
+	failures += check_size_t(table->size(table), 0);
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_counting_filter_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_counting_filter)
@@ -0,0 +1,246 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_cuckoo.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+/* every key has the same hashcode, so only the two buckets and the
+   stash are available */
+unsigned int test_ehht_cuckoo_hash(const char *data, size_t len)
+{
+	(void)data;
+	(void)len;
+	return 7;
+}
+
+int test_ehht_cuckoo_sum_each(struct ehht_key each_key, void *each_val,
+			      void *context)
+{
+	size_t *sum = (size_t *)context;
+	(void)each_key;
+	*sum += (size_t)each_val;
+	return 0;
+}
+
+unsigned test_ehht_cuckoo_check_all(struct ehht *table, size_t from,
+				    size_t to, size_t step, int expected)
+{
+	unsigned failures = 0;
+	char key[20];
+	size_t i = 0;
+
+	for (i = from; i < to; i += step) {
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_int(table->has_key(table, key, eembed_strlen(key)),
+			      expected);
+		if (expected) {
+			failures +=
+			    check_size_t((size_t)
+					 table->get(table, key,
+						    eembed_strlen(key)), i);
+		}
+	}
+	return failures;
+}
+
+unsigned test_ehht_cuckoo(void)
+{
+	const size_t bytes_len = 12000 * sizeof(size_t);
+	unsigned char bytes[12000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht *chained = NULL;
+	struct ehht_keys *keys = NULL;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	char key[20];
+	char buf[80];
+	size_t sum = 0;
+	size_t i = 0;
+	size_t j = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	for (i = 0; i < 3; ++i) {
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = (1UL << i);
+		table = ehht_new_cuckoo(512, NULL, &wrap, NULL);
+		failures += check_ptr(table, NULL);
+	}
+	ctx.attempts_to_fail_bitmask = 0;
+
+	/* 128 buckets of 4 slots, filled to over 95% */
+	table = ehht_new_cuckoo(512, NULL, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_cuckoo_end;
+	}
+	for (i = 1; i <= 490; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 490);
+	failures += test_ehht_cuckoo_check_all(table, 1, 491, 1, 1);
+	failures += test_ehht_cuckoo_check_all(table, 491, 2000, 1, 0);
+
+	/* an update does not add a key */
+	failures += check_size_t((size_t)table->put(table, "7", 1, (void *)7,
+						     &err), 7);
+	failures += check_size_t(table->size(table), 490);
+
+	/* a failed allocation fails the put */
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x01;
+	table->put(table, "new", 3, NULL, &err);
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_int(err, 1);
+	failures += check_int(table->has_key(table, "new", 3), 0);
+	err = 0;
+
+	table->for_each(table, test_ehht_cuckoo_sum_each, &sum);
+	failures += check_size_t(sum, (490 * 491) / 2);
+
+	for (i = 1; i <= 490; i += 2) {
+		eembed_ulong_to_str(key, 20, i);
+		failures += check_size_t((size_t)
+					 table->remove(table, key,
+						       eembed_strlen(key)), i);
+	}
+	failures += check_size_t(table->size(table), 245);
+	failures += test_ehht_cuckoo_check_all(table, 1, 491, 2, 0);
+	failures += test_ehht_cuckoo_check_all(table, 2, 491, 2, 1);
+
+	/* grows past the capacity */
+	for (i = 1000; i < 3000; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 2245);
+	failures += test_ehht_cuckoo_check_all(table, 2, 491, 2, 1);
+	failures += test_ehht_cuckoo_check_all(table, 1000, 3000, 1, 1);
+
+	keys = table->keys(table, 1);
+	if (check_ptr_not_null(keys)) {
+		++failures;
+	} else {
+		failures += check_size_t(keys->len, 2245);
+		table->free_keys(table, keys);
+	}
+
+	/* swap with a chained table, and back */
+	chained = ehht_new_custom(0, NULL, &wrap, NULL);
+	if (check_ptr_not_null(chained)) {
+		++failures;
+	} else {
+		chained->put(chained, "c", 1, NULL, &err);
+		ehht_swap(table, chained);
+		failures += check_size_t(table->size(table), 1);
+		failures += check_size_t(chained->size(chained), 2245);
+		failures += check_int(chained->has_key(chained, "2", 1), 1);
+		ehht_swap(table, chained);
+		ehht_free(chained);
+	}
+
+	table->clear(table);
+	failures += check_size_t(table->size(table), 0);
+	failures += test_ehht_cuckoo_check_all(table, 1000, 3000, 1, 0);
+	table->put(table, "a", 1, NULL, &err);
+	table->to_string(table, buf, 80);
+	failures += check_int(buf[0], '{');
+	ehht_free(table);
+
+	/* 2 buckets and the stash hold 12 keys of one hashcode, the rest
+	   go to the overflow list */
+	table = ehht_new_cuckoo(0, test_ehht_cuckoo_hash, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_cuckoo_end;
+	}
+	for (i = 0; i < 28; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 28);
+	failures += test_ehht_cuckoo_check_all(table, 0, 28, 1, 1);
+	sum = 0;
+	table->for_each(table, test_ehht_cuckoo_sum_each, &sum);
+	failures += check_size_t(sum, (27 * 28) / 2);
+
+	/* a failed allocation to grow the overflow list fails the put */
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x02;
+	table->put(table, "28", 2, (void *)28, &err);
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_int(err, 1);
+	err = 0;
+	failures += check_size_t(table->size(table), 28);
+
+	/* removing from a bucket lets a stashed key back in */
+	table->remove(table, "0", 1);
+	table->remove(table, "11", 2);
+	table->remove(table, "27", 2);
+	table->put(table, "28", 2, (void *)28, &err);
+	table->put(table, "29", 2, (void *)29, &err);
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 27);
+	failures += test_ehht_cuckoo_check_all(table, 1, 11, 1, 1);
+	failures += test_ehht_cuckoo_check_all(table, 12, 27, 1, 1);
+	failures += test_ehht_cuckoo_check_all(table, 28, 30, 1, 1);
+	failures += test_ehht_cuckoo_check_all(table, 27, 28, 1, 0);
+	ehht_free(table);
+
+	/* keys of "Aa" and "BB" blocks all have the same default hashcode */
+	table = ehht_new_cuckoo(0, NULL, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_cuckoo_end;
+	}
+	for (i = 0; i < 16; ++i) {
+		for (j = 0; j < 4; ++j) {
+			eembed_memcpy(key + (2 * j),
+				      (i & (1U << j)) ? "BB" : "Aa", 2);
+		}
+		table->put(table, key, 8, (void *)i, &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 16);
+	for (i = 0; i < 16; ++i) {
+		for (j = 0; j < 4; ++j) {
+			eembed_memcpy(key + (2 * j),
+				      (i & (1U << j)) ? "BB" : "Aa", 2);
+		}
+		failures += check_size_t((size_t)table->get(table, key, 8), i);
+	}
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_cuckoo_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_cuckoo)
@@ -0,0 +1,188 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_define.c: test for macro-generated type-specialized tables */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht-define.h"
+#include "echeck.h"
+
+static unsigned int test_str_hash(const char *str)
+{
+	unsigned int hash = 5381;
+
+	while (*str) {
+		hash = ((hash << 5) + hash) + ((unsigned char)*str++);
+	}
+	return hash;
+}
+
+static int test_str_eq(const char *a, const char *b)
+{
+	return eembed_strcmp(a, b) == 0;
+}
+
+/* every key collides, so the chains are exercised */
+static unsigned int test_bogus_hash(long key)
+{
+	(void)key;
+	return 7;
+}
+
+#define Test_long_eq(a, b) ((a) == (b))
+
+EHHT_DEFINE(test_str_map, const char *, int, test_str_hash, test_str_eq);
+EHHT_DEFINE(test_long_map, long, const char *, test_bogus_hash, Test_long_eq);
+
+int test_ehht_define_sum(const char *each_key, int *each_val, void *context)
+{
+	int *sum = (int *)context;
+	(void)each_key;
+	*sum += *each_val;
+	*each_val = 0;
+	return 0;
+}
+
+unsigned test_ehht_define_str(void)
+{
+	unsigned failures = 0;
+	struct test_str_map table;
+	const char *keys[] = { "one", "two", "three", "four", "five", NULL };
+	char buf[10];
+	int *val = NULL;
+	int old_val = 0;
+	int sum = 0;
+	int err = 0;
+	int i = 0;
+
+	/* start tiny, so the put calls will need to resize */
+	if (check_int(test_str_map_init(&table, 1, NULL, NULL), 0)) {
+		return 1;
+	}
+
+	for (i = 0; keys[i] != NULL; ++i) {
+		failures +=
+		    check_int(test_str_map_put
+			      (&table, keys[i], i + 1, &old_val, &err), 0);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(test_str_map_size(&table), 5);
+	failures += check_int(table.num_buckets > 1, 1);
+
+	/* lookup by value, not by pointer */
+	eembed_strcpy(buf, "three");
+	val = test_str_map_get(&table, buf);
+	if (check_ptr_not_null(val)) {
+		++failures;
+	} else {
+		failures += check_int(*val, 3);
+	}
+	failures += check_int(test_str_map_has_key(&table, "six"), 0);
+
+	failures +=
+	    check_int(test_str_map_put(&table, "two", 20, &old_val, &err), 1);
+	failures += check_int(old_val, 2);
+
+	old_val = 0;
+	failures += check_int(test_str_map_remove(&table, "one", &old_val), 1);
+	failures += check_int(old_val, 1);
+	failures += check_int(test_str_map_remove(&table, "one", NULL), 0);
+	failures += check_size_t(test_str_map_size(&table), 4);
+
+	test_str_map_for_each(&table, test_ehht_define_sum, &sum);
+	failures += check_int(sum, 20 + 3 + 4 + 5);
+	failures += check_int(*test_str_map_get(&table, "four"), 0);
+
+	test_str_map_clear(&table);
+	failures += check_size_t(test_str_map_size(&table), 0);
+	failures += check_ptr(test_str_map_get(&table, "two"), NULL);
+
+	test_str_map_destroy(&table);
+
+	return failures;
+}
+
+unsigned test_ehht_define_out_of_memory(void)
+{
+	unsigned failures = 0;
+	struct test_long_map table;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	const char *old_val = NULL;
+	const char **val = NULL;
+	int err = 0;
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		return 1;
+	}
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	ctx.attempts_to_fail_bitmask = 1;
+	failures += check_int(test_long_map_init(&table, 4, &wrap, log), 1);
+	test_long_map_destroy(&table);
+
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0;
+	if (check_int(test_long_map_init(&table, 4, &wrap, log), 0)) {
+		return ++failures;
+	}
+	test_long_map_auto_resize_load_factor(&table, 0.0);
+
+	test_long_map_put(&table, 1, "a", &old_val, &err);
+	test_long_map_put(&table, -1, "b", &old_val, &err);
+	failures += check_int(err, 0);
+
+	ctx.attempts_to_fail_bitmask = ((uint64_t)1) << ctx.attempts;
+	failures +=
+	    check_int(test_long_map_put(&table, 2, "c", &old_val, &err), 0);
+	failures += check_int(err, 1);
+	failures += check_size_t(test_long_map_size(&table), 2);
+	failures += check_int(table.num_buckets, 4);
+
+	val = test_long_map_get(&table, -1);
+	if (check_ptr_not_null(val)) {
+		++failures;
+	} else {
+		failures += check_str(*val, "b");
+	}
+
+	test_long_map_destroy(&table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+	return failures;
+}
+
+unsigned test_ehht_define(void)
+{
+	const size_t bytes_len = 250 * sizeof(size_t);
+	unsigned char bytes[250 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+	unsigned failures = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	failures += test_ehht_define_str();
+	failures += test_ehht_define_out_of_memory();
+
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_define)
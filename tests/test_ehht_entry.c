@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_entry.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+unsigned test_ehht_entry(void)
+{
+	const size_t bytes_len = 2000 * sizeof(size_t);
+	unsigned char bytes[2000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	const char *words[] = { "the", "cat", "the", "hat", "the", "cat" };
+	const size_t words_len = 6;
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_op_stats op_stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	void **slot = NULL;
+	void **first = NULL;
+	size_t i = 0;
+	int inserted = 0;
+	int found = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_entry_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(0, NULL, &wrap, log);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_entry_end;
+	}
+
+	/* counting words, one probe per word */
+	for (i = 0; i < words_len; ++i) {
+		slot = ehht_entry(table, words[i], eembed_strlen(words[i]),
+				  &inserted, &err);
+		if (check_ptr_not_null(slot)) {
+			++failures;
+			break;
+		}
+		failures += check_int(inserted, (i < 2 || i == 3) ? 1 : 0);
+		*slot = (void *)(((size_t)*slot) + 1);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 3);
+	failures += check_size_t((size_t)table->get(table, "the", 3), 3);
+	failures += check_size_t((size_t)table->get(table, "cat", 3), 2);
+	failures += check_size_t((size_t)table->get(table, "hat", 3), 1);
+
+	/* the address is stable */
+	first = ehht_entry(table, "the", 3, NULL, &err);
+	ehht_buckets_resize(table, 100);
+	failures += check_ptr(ehht_entry(table, "the", 3, NULL, &err), first);
+
+	/* a NULL value is distinguishable from a missing key */
+	slot = ehht_entry(table, "null", 4, &inserted, &err);
+	failures += check_int(inserted, 1);
+	failures += check_ptr(*slot, NULL);
+	found = 0;
+	failures += check_ptr(ehht_lookup(table, "null", 4, &found), NULL);
+	failures += check_int(found, 1);
+	found = 1;
+	failures += check_ptr(ehht_lookup(table, "none", 4, &found), NULL);
+	failures += check_int(found, 0);
+	failures +=
+	    check_size_t((size_t)ehht_lookup(table, "cat", 3, &found), 2);
+	failures += check_int(found, 1);
+	failures += check_size_t((size_t)ehht_lookup(table, "cat", 3, NULL),
+				 2);
+
+	/* an entry is counted as a put, a lookup as a get */
+	if (ehht_op_stats(table, &op_stats) == 0) {
+		ehht_op_stats_reset(table);
+		ehht_entry(table, "cat", 3, NULL, &err);
+		ehht_lookup(table, "dog", 3, &found);
+		ehht_op_stats(table, &op_stats);
+		failures += check_unsigned_long(op_stats.puts, 1);
+		failures += check_unsigned_long(op_stats.put_updates, 1);
+		failures += check_unsigned_long(op_stats.gets, 1);
+		failures += check_unsigned_long(op_stats.get_misses, 1);
+	}
+
+	/* on allocation failure, NULL and *err is set */
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x01;
+	inserted = 1;
+	failures += check_ptr(ehht_entry(table, "dog", 3, &inserted, &err),
+			      NULL);
+	failures += check_int(err, 1);
+	failures += check_int(inserted, 0);
+	failures += check_int(table->has_key(table, "dog", 3), 0);
+	ctx.attempts_to_fail_bitmask = 0;
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_entry_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_entry)
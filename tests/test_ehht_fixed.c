@@ -0,0 +1,278 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_fixed.c: test for simple OO hashtables with fixed-width keys */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht-fixed.h"
+#include "echeck.h"
+
+struct test_ehht_fixed_sum {
+	uint64_t keys;
+	size_t count;
+};
+
+int test_ehht_fixed_sum_u64(uint64_t each_key, void *each_val, void *context)
+{
+	struct test_ehht_fixed_sum *sum = (struct test_ehht_fixed_sum *)context;
+	(void)each_val;
+	sum->keys += each_key;
+	++(sum->count);
+	return 0;
+}
+
+unsigned test_ehht_fixed_u32(struct eembed_allocator *ea)
+{
+	unsigned failures = 0;
+	struct ehht_u32 *table = NULL;
+	uint32_t keys[40];
+	void *vals[40];
+	char vals_bytes[40];
+	size_t i = 0;
+	int err = 0;
+
+	/* start tiny, so the put calls will need to resize */
+	table = ehht_u32_new(2, ea, NULL);
+	if (check_ptr_not_null(table)) {
+		return 1;
+	}
+
+	for (i = 0; i < 40; ++i) {
+		keys[i] = (uint32_t)(i * 7);
+		failures +=
+		    check_ptr(table->put(table, keys[i], vals_bytes + i, &err),
+			      NULL);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 40);
+
+	for (i = 0; i < 40; ++i) {
+		failures +=
+		    check_ptr(table->get(table, keys[i]), vals_bytes + i);
+	}
+	failures += check_ptr(table->get(table, 1), NULL);
+	failures += check_int(table->has_key(table, 0), 1);
+	failures += check_int(table->has_key(table, 1), 0);
+
+	failures +=
+	    check_ptr(table->put(table, keys[3], vals_bytes, &err),
+		      vals_bytes + 3);
+	failures += check_size_t(table->size(table), 40);
+
+	failures += check_ptr(table->remove(table, keys[3]), vals_bytes);
+	failures += check_ptr(table->remove(table, keys[3]), NULL);
+	failures += check_size_t(table->size(table), 39);
+
+	keys[0] = 1;		/* not present */
+	failures += check_size_t(table->get_many(table, keys, 40, vals), 38);
+	failures += check_ptr(vals[0], NULL);
+	failures += check_ptr(vals[1], vals_bytes + 1);
+	failures += check_ptr(vals[3], NULL);
+	failures += check_ptr(vals[39], vals_bytes + 39);
+
+	table->clear(table);
+	failures += check_size_t(table->size(table), 0);
+	failures += check_ptr(table->get(table, keys[1]), NULL);
+
+	ehht_u32_free(table);
+
+	return failures;
+}
+
+unsigned test_ehht_fixed_u64(struct eembed_allocator *ea)
+{
+	unsigned failures = 0;
+	struct ehht_u64 *table = NULL;
+	struct test_ehht_fixed_sum sum = { 0, 0 };
+	uint64_t big = 0xFFFFFFFF00000000ULL;
+	int err = 0;
+
+	table = ehht_u64_new(0, ea, NULL);
+	if (check_ptr_not_null(table)) {
+		return 1;
+	}
+
+	/* keys which differ only in the high bits must not be confused */
+	table->put(table, big + 1, &big, &err);
+	table->put(table, 1, &sum, &err);
+	table->put(table, 2, &err, &err);
+	failures += check_int(err, 0);
+
+	failures += check_ptr(table->get(table, big + 1), &big);
+	failures += check_ptr(table->get(table, 1), &sum);
+	failures += check_ptr(table->get(table, big + 2), NULL);
+
+	table->for_each(table, test_ehht_fixed_sum_u64, &sum);
+	failures += check_size_t(sum.count, 3);
+	failures += check_int(sum.keys == (big + 1 + 1 + 2), 1);
+
+	ehht_u64_free(table);
+
+	return failures;
+}
+
+unsigned test_ehht_fixed_u128(struct eembed_allocator *ea)
+{
+	unsigned failures = 0;
+	struct ehht_u128 *table = NULL;
+	const unsigned char uuid[16] = {
+		0x12, 0x3e, 0x45, 0x67, 0xe8, 0x9b, 0x12, 0xd3,
+		0xa4, 0x56, 0x42, 0x66, 0x14, 0x17, 0x40, 0x00
+	};
+	struct ehht_u128_key key;
+	struct ehht_u128_key swapped;
+	struct ehht_u128_key keys[2];
+	void *vals[2];
+	int err = 0;
+
+	key = ehht_u128_key_from_bytes(uuid);
+	failures += check_int(key.hi == 0x123e4567e89b12d3ULL, 1);
+	failures += check_int(key.lo == 0xa456426614174000ULL, 1);
+
+	swapped.hi = key.lo;
+	swapped.lo = key.hi;
+
+	table = ehht_u128_new(0, ea, NULL);
+	if (check_ptr_not_null(table)) {
+		return 1;
+	}
+
+	table->put(table, key, &key, &err);
+	failures += check_int(err, 0);
+	failures += check_ptr(table->get(table, key), &key);
+	failures += check_int(table->has_key(table, swapped), 0);
+
+	keys[0] = swapped;
+	keys[1] = key;
+	failures += check_size_t(table->get_many(table, keys, 2, vals), 1);
+	failures += check_ptr(vals[0], NULL);
+	failures += check_ptr(vals[1], &key);
+
+	failures += check_ptr(table->remove(table, key), &key);
+	failures += check_size_t(table->size(table), 0);
+
+	ehht_u128_free(table);
+
+	return failures;
+}
+
+unsigned test_ehht_fixed_ptr(struct eembed_allocator *ea)
+{
+	unsigned failures = 0;
+	struct ehht_ptr *table = NULL;
+	char objects[3];
+	const void *keys[3];
+	void *vals[3];
+	int err = 0;
+
+	table = ehht_ptr_new(0, ea, NULL);
+	if (check_ptr_not_null(table)) {
+		return 1;
+	}
+
+	table->put(table, objects + 0, objects + 2, &err);
+	table->put(table, objects + 1, objects + 1, &err);
+	failures += check_int(err, 0);
+
+	keys[0] = objects + 0;
+	keys[1] = objects + 1;
+	keys[2] = objects + 2;
+	failures += check_size_t(table->get_many(table, keys, 3, vals), 2);
+	failures += check_ptr(vals[0], objects + 2);
+	failures += check_ptr(vals[1], objects + 1);
+	failures += check_ptr(vals[2], NULL);
+
+	ehht_ptr_free(table);
+
+	return failures;
+}
+
+unsigned test_ehht_fixed_out_of_memory(void)
+{
+	unsigned failures = 0;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct ehht_u64 *table = NULL;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	uint64_t i = 0;
+	int err = 0;
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		return 1;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	for (i = 0; i < 3; ++i) {
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = ((uint64_t)1) << i;
+		table = ehht_u64_new(0, &wrap, log);
+		failures += check_ptr(table, NULL);
+	}
+
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0;
+	table = ehht_u64_new(1, &wrap, log);
+	if (check_ptr_not_null(table)) {
+		return ++failures;
+	}
+
+	/* a failed resize is not an error, the chain just grows */
+	table->put(table, 1, &err, &err);
+	ctx.attempts_to_fail_bitmask = ((uint64_t)1) << ctx.attempts;
+	table->put(table, 2, &err, &err);
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 2);
+
+	/* fail both the resize and the element */
+	ctx.attempts_to_fail_bitmask = ((uint64_t)3) << ctx.attempts;
+	table->put(table, 3, &err, &err);
+	failures += check_int(err != 0, 1);
+	failures += check_ptr(table->get(table, 3), NULL);
+	failures += check_size_t(table->size(table), 2);
+
+	ehht_u64_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+	return failures;
+}
+
+unsigned test_ehht_fixed(void)
+{
+	const size_t bytes_len = 500 * sizeof(size_t);
+	unsigned char bytes[500 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+	unsigned failures = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	failures += check_int(ehht_mix32(0) == ehht_mix32(1), 0);
+	failures += check_int(ehht_mix64(1) == ehht_mix64(2), 0);
+
+	failures += test_ehht_fixed_u32(ea);
+	failures += test_ehht_fixed_u64(ea);
+	failures += test_ehht_fixed_u128(ea);
+	failures += test_ehht_fixed_ptr(ea);
+	failures += test_ehht_fixed_out_of_memory();
+
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_fixed)
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// test_ehht_hpp.cpp: test for the header-only C++ template
+// Copyright (C) 2020 Eric Herman <eric@freesa.org>
+// https://github.com/ericherman/libehht
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ehht.hpp"
+#include "echeck.h"
+
+// every key collides, so the chains are exercised
+struct test_bogus_hash {
+	using is_transparent = void;
+
+	std::size_t operator()(std::string_view s) const noexcept
+	{
+		(void)s;
+		return 7;
+	}
+};
+
+struct test_counting_hash {
+	using is_transparent = void;
+	std::size_t *calls;
+
+	std::size_t operator()(std::string_view s) const noexcept
+	{
+		++(*calls);
+		return std::hash<std::string_view>{}(s);
+	}
+};
+
+unsigned test_ehht_hpp_basics(void)
+{
+	unsigned failures = 0;
+	ehht::map<std::string, int> table(2);
+	std::string_view view("two-and-more", 3);
+	int sum = 0;
+
+	for (int i = 0; i < 20; ++i) {
+		table[std::to_string(i)] = i;
+	}
+	failures += check_size_t(table.size(), 20);
+	failures += check_int(table.bucket_count() > 2, 1);
+
+	table.try_emplace("one", 1);
+	table.try_emplace("two", 2);
+	failures += check_int(table.at(view), 2);
+	failures += check_int(table.contains(std::string_view("three")), 0);
+	failures += check_int(table.find("one") != table.end(), 1);
+	failures += check_int(table.find("nine") == table.end(), 1);
+
+	for (const auto &kv : table) {
+		sum += kv.second;
+	}
+	failures += check_int(sum, (19 * 20 / 2) + 1 + 2);
+
+	failures += check_size_t(table.erase(std::string_view("one")), 1);
+	failures += check_size_t(table.erase(std::string_view("one")), 0);
+	failures += check_size_t(table.size(), 21);
+
+	try {
+		table.at("one");
+		failures += check_int(0, 1);
+	}
+	catch (const std::out_of_range &) {
+	}
+
+	table.clear();
+	failures += check_size_t(table.size(), 0);
+	failures += check_int(table.begin() == table.end(), 1);
+
+	return failures;
+}
+
+unsigned test_ehht_hpp_single_lookup(void)
+{
+	unsigned failures = 0;
+	std::size_t calls = 0;
+	test_counting_hash hash = { &calls };
+	ehht::map<std::string, int, test_counting_hash> table(0, hash);
+
+	failures += check_int(table.try_emplace("a", 1).second, 1);
+	failures += check_size_t(calls, 1);
+
+	calls = 0;
+	failures += check_int(table.try_emplace("a", 2).second, 0);
+	failures += check_int(table.at("a"), 1);
+
+	calls = 0;
+	failures += check_int(table.insert_or_assign("a", 3).second, 0);
+	failures += check_size_t(calls, 1);
+	failures += check_int(table.at("a"), 3);
+
+	calls = 0;
+	failures += check_int(table.insert_or_assign("b", 4).second, 1);
+	failures += check_size_t(calls, 1);
+
+	return failures;
+}
+
+unsigned test_ehht_hpp_move_only(void)
+{
+	unsigned failures = 0;
+	ehht::map<std::string, std::unique_ptr<int>, test_bogus_hash> table;
+	std::unique_ptr<int> val(new int(5));
+	bool inserted = false;
+
+	inserted = table.try_emplace("five", std::move(val)).second;
+	failures += check_int(inserted, 1);
+	failures += check_int(*table.at("five"), 5);
+
+	// already present, so val is not moved from
+	val.reset(new int(6));
+	inserted = table.try_emplace("five", std::move(val)).second;
+	failures += check_int(inserted, 0);
+	failures += check_int(val != nullptr, 1);
+
+	table.insert_or_assign("six", std::move(val));
+	table.try_emplace(std::string_view("seven"), new int(7));
+	failures += check_int(*table.at("six"), 6);
+	failures += check_int(*table.at("seven"), 7);
+
+	ehht::map<std::string, std::unique_ptr<int>, test_bogus_hash> other;
+	other = std::move(table);
+	failures += check_size_t(other.size(), 3);
+	failures += check_size_t(table.size(), 0);
+	failures += check_int(*other.at("five"), 5);
+
+	table.try_emplace("eight", new int(8));
+	failures += check_size_t(table.size(), 1);
+
+	return failures;
+}
+
+unsigned test_ehht_hpp_pmr(void)
+{
+	unsigned failures = 0;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+	{
+		ehht::eembed_resource resource(&wrap);
+		ehht::pmr::map<int, std::string> table(&resource);
+
+		for (int i = 0; i < 100; ++i) {
+			table.try_emplace(i, "value");
+		}
+		failures += check_size_t(table.size(), 100);
+		failures += check_int(ctx.allocs > 100, 1);
+
+		// the copy uses the default resource
+		ehht::pmr::map<int, std::string> copy(table);
+		failures += check_size_t(copy.size(), 100);
+
+		// fail a resize, if attempted, and the node
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = 3;
+		try {
+			table.try_emplace(1000, "value");
+			failures += check_int(0, 1);
+		}
+		catch (const std::bad_alloc &) {
+		}
+		failures += check_int(table.contains(1000), 0);
+	}
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+	return failures;
+}
+
+unsigned test_ehht_hpp(void)
+{
+	unsigned failures = 0;
+
+	failures += test_ehht_hpp_basics();
+	failures += test_ehht_hpp_single_lookup();
+	failures += test_ehht_hpp_move_only();
+	failures += test_ehht_hpp_pmr();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_hpp)
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_hugepage.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "ehht-hugepage.h"
+#include "echeck.h"
+
+unsigned test_ehht_hugepage(void)
+{
+	const size_t bytes_len = 2000 * sizeof(size_t);
+	unsigned char bytes[2000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	const size_t mib = 1024 * 1024;
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct ehht_hugepage_context hctx;
+	struct eembed_allocator huge;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	char key[20];
+	unsigned char *small = NULL;
+	unsigned char *big = NULL;
+	unsigned char *zeroed = NULL;
+	size_t mapped_before = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_hugepage_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	/* no pages are reserved for MAP_HUGETLB on most systems, and node 0
+	   may not accept a policy if the kernel lacks NUMA: both fall back */
+	ehht_hugepage_allocator_init(&huge, &hctx, &wrap, 4096,
+				     EHHT_HUGEPAGE_HUGETLB |
+				     EHHT_HUGEPAGE_INTERLEAVE, 0x01);
+
+	/* below the threshold goes to the wrapped allocator */
+	small = (unsigned char *)huge.malloc(&huge, 100);
+	failures += check_ptr_not_null(small);
+	failures += check_size_t(ctx.allocs, 1);
+	failures += check_size_t(hctx.mapped, 0);
+
+	/* at or above is mapped; a huge page and a half crosses a boundary */
+	big = (unsigned char *)huge.malloc(&huge, 3 * mib);
+	if (check_ptr_not_null(big)) {
+		++failures;
+		goto test_ehht_hugepage_end;
+	}
+	failures += check_size_t(ctx.allocs, 1);
+	failures += check_size_t(hctx.mapped, 1);
+	failures += check_int(hctx.bytes_mapped >= 3 * mib, 1);
+	failures += check_int(hctx.hugetlb + hctx.madvised <= hctx.mapped, 1);
+	failures += check_int(hctx.mbind_failures <= hctx.mapped, 1);
+	big[0] = 'a';
+	big[(3 * mib) - 1] = 'z';
+
+	/* growing a mapping keeps its contents */
+	big = (unsigned char *)huge.realloc(&huge, big, 4 * mib);
+	if (check_ptr_not_null(big)) {
+		++failures;
+		goto test_ehht_hugepage_end;
+	}
+	failures += check_int(big[0], 'a');
+	failures += check_int(big[(3 * mib) - 1], 'z');
+	failures += check_size_t(hctx.mapped, 2);
+
+	zeroed = (unsigned char *)huge.calloc(&huge, 1024, 8);
+	failures += check_ptr_not_null(zeroed);
+	if (zeroed) {
+		failures += check_int(zeroed[0] + zeroed[8191], 0);
+	}
+	failures += check_ptr(huge.reallocarray(&huge, NULL, ((size_t)-1), 2),
+			      NULL);
+
+	/* a mapping too large for the address space falls back, and fails */
+	failures += check_ptr(huge.malloc(&huge, ((size_t)-1) / 2), NULL);
+	failures += check_size_t(hctx.fallbacks, 1);
+
+	huge.free(&huge, zeroed);
+	huge.free(&huge, big);
+	huge.free(&huge, small);
+	failures += check_size_t(hctx.bytes_mapped, 0);
+
+	/* a table's bucket array is mapped, its elements are not */
+	mapped_before = hctx.mapped;
+	table = ehht_new_custom(4096, NULL, &huge, log);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_hugepage_end;
+	}
+	failures += check_int(hctx.mapped > mapped_before, 1);
+	for (i = 0; i < 100 && !err; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), table, &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 100);
+	failures += check_ptr(table->get(table, "42", 2), table);
+	ehht_free(table);
+	failures += check_size_t(hctx.bytes_mapped, 0);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_hugepage_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_hugepage)
@@ -25,6 +25,9 @@ unsigned test_ehht_keys(void)
 	size_t size = 0;
 	size_t *found = NULL;
 	const char *e_keys[] = { "foo", "bar", "whiz", "bang", NULL };
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	unsigned allocs = 0;
 
 	if (!EEMBED_HOSTED) {
 		ea = eembed_bytes_allocator(bytes, bytes_len);
@@ -78,6 +81,57 @@ unsigned test_ehht_keys(void)
 		ehht_free(table);
 	}
 
+	/* a snapshot is one allocation, with or without copies */
+	echeck_err_injecting_allocator_init(&wrap, ea, &ctx, eembed_err_log);
+	table = ehht_new_custom(num_buckets, NULL, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_keys_end;
+	}
+	for (i = 0; e_keys[i] != NULL; ++i) {
+		len = eembed_strlen(e_keys[i]);
+		table->put(table, e_keys[i], len, NULL, &err);
+	}
+	for (allocate_copies = 0; allocate_copies < 2; ++allocate_copies) {
+		allocs = ctx.allocs;
+		ks = table->keys(table, allocate_copies);
+		if (check_ptr_not_null(ks)) {
+			++failures;
+			continue;
+		}
+		failures +=
+		    check_unsigned_int_m(ctx.allocs - allocs, 1, "allocs");
+		failures += check_size_t(ks->len, 4);
+		for (i = 0; i < ks->len; ++i) {
+			failures +=
+			    check_size_t(eembed_strlen(ks->keys[i].str),
+					 ks->keys[i].len);
+			failures +=
+			    check_int(table->has_key(table, ks->keys[i].str,
+						     ks->keys[i].len), 1);
+		}
+		table->free_keys(table, ks);
+	}
+
+	/* if the allocation fails, NULL */
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x01;
+	failures += check_ptr(table->keys(table, 1), NULL);
+	ctx.attempts_to_fail_bitmask = 0;
+
+	table->clear(table);
+	ks = table->keys(table, 1);
+	if (check_ptr_not_null(ks)) {
+		++failures;
+	} else {
+		failures += check_size_t(ks->len, 0);
+		table->free_keys(table, ks);
+	}
+	ehht_free(table);
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
 test_ehht_keys_end:
 	if (!EEMBED_HOSTED) {
 		eembed_global_allocator = orig;
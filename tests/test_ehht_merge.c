@@ -0,0 +1,188 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_merge.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+unsigned int test_ehht_merge_other_hash(const char *data, size_t data_len)
+{
+	unsigned int hash = 2166136261U;
+	size_t i = 0;
+
+	for (i = 0; i < data_len; ++i) {
+		hash = (hash ^ (unsigned char)data[i]) * 16777619U;
+	}
+	return hash;
+}
+
+void *test_ehht_merge_sum(struct ehht_key key, void *dst_val, void *src_val,
+			  void *context)
+{
+	size_t *conflicts = (size_t *)context;
+	(void)key;
+	++(*conflicts);
+	return (void *)(((size_t)dst_val) + ((size_t)src_val));
+}
+
+int test_ehht_merge_count(struct ehht_key key, void *val, void *context)
+{
+	size_t *count = (size_t *)context;
+	(void)key;
+	(void)val;
+	++(*count);
+	return 0;
+}
+
+unsigned test_ehht_merge_fill(struct ehht *table, size_t from, size_t to)
+{
+	char key[20];
+	size_t i = 0;
+	int err = 0;
+
+	for (i = from; i < to; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	return check_int(err, 0);
+}
+
+unsigned test_ehht_merge_check(struct ehht *table, size_t from, size_t to,
+			       size_t mult)
+{
+	unsigned failures = 0;
+	char key[20];
+	size_t i = 0;
+
+	for (i = from; i < to; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		failures +=
+		    check_size_t((size_t)table->get(table, key,
+						    eembed_strlen(key)),
+				 i * mult);
+	}
+	return failures;
+}
+
+unsigned test_ehht_merge(void)
+{
+	const size_t bytes_len = 4000 * sizeof(size_t);
+	unsigned char bytes[4000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *a = NULL;
+	struct ehht *b = NULL;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	size_t allocs_before = 0;
+	size_t conflicts = 0;
+	size_t count = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_merge_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	a = ehht_new_custom(256, NULL, &wrap, log);
+	b = ehht_new_custom(0, test_ehht_merge_other_hash, &wrap, log);
+	if (check_ptr_not_null(a) || check_ptr_not_null(b)) {
+		++failures;
+		goto test_ehht_merge_end;
+	}
+	ehht_bucket_tags(a, 1);
+
+	/* relinked: no allocations, overlapping keys are summed */
+	failures += test_ehht_merge_fill(a, 0, 50);
+	failures += test_ehht_merge_fill(b, 25, 75);
+	allocs_before = ctx.allocs;
+	failures += check_int(ehht_merge(a, b, test_ehht_merge_sum,
+					 &conflicts), 0);
+	failures += check_size_t(ctx.allocs - allocs_before, 0);
+	failures += check_size_t(conflicts, 25);
+	failures += check_size_t(a->size(a), 75);
+	failures += check_size_t(b->size(b), 0);
+	failures += test_ehht_merge_check(a, 0, 25, 1);
+	failures += test_ehht_merge_check(a, 25, 50, 2);
+	failures += test_ehht_merge_check(a, 50, 75, 1);
+	failures += check_int(b->has_key(b, "60", 2), 0);
+
+	/* the source remains usable, and the hashcodes were redone */
+	failures += test_ehht_merge_fill(b, 60, 100);
+	failures += check_int(ehht_merge(b, a, NULL, NULL), 0);
+	failures += check_size_t(a->size(a), 0);
+	failures += check_size_t(b->size(b), 100);
+	failures += test_ehht_merge_check(b, 0, 25, 1);
+	failures += test_ehht_merge_check(b, 60, 100, 1);
+
+	/* intersect and subtract */
+	failures += test_ehht_merge_fill(a, 90, 110);
+	count = 0;
+	failures += check_size_t(ehht_intersect(a, b, test_ehht_merge_count,
+						&count), 10);
+	failures += check_size_t(count, 10);
+	failures += check_size_t(a->size(a), 10);
+	failures += test_ehht_merge_check(a, 90, 100, 1);
+	failures += check_size_t(ehht_subtract(b, a, NULL, NULL), 10);
+	failures += check_size_t(b->size(b), 90);
+	failures += check_int(b->has_key(b, "95", 2), 0);
+	failures += check_int(b->has_key(b, "89", 2), 1);
+	failures += check_size_t(ehht_subtract(a, a, NULL, NULL), 10);
+	failures += check_size_t(a->size(a), 0);
+
+	/* pooled keys must be copied, a failed copy leaves the rest */
+	failures += check_int(ehht_pool_keys(a, 1024), 0);
+	failures += test_ehht_merge_fill(a, 0, 5);
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x04;
+	failures += check_int(ehht_merge(a, b, NULL, NULL), 1);
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_int(a->size(a) + b->size(b) >= 90, 1);
+	failures += check_int(b->size(b) > 0, 1);
+	failures += check_int(ehht_merge(a, b, NULL, NULL), 0);
+	failures += check_size_t(a->size(a), 90);
+	failures += check_size_t(b->size(b), 0);
+	failures += test_ehht_merge_check(a, 0, 25, 1);
+	failures += test_ehht_merge_check(a, 25, 50, 2);
+	failures += test_ehht_merge_check(a, 50, 90, 1);
+
+	/* inline values must be the same size */
+	a->clear(a);
+	failures += check_int(ehht_value_size(a, sizeof(size_t)), 0);
+	failures += test_ehht_merge_fill(b, 0, 3);
+	failures += check_int(ehht_merge(a, b, NULL, NULL), 1);
+	failures += check_size_t(b->size(b), 3);
+
+	ehht_free(a);
+	ehht_free(b);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_merge_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_merge)
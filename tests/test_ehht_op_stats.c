@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_op_stats.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+/* every key collides, so the chain walks are predictable */
+unsigned int ehht_constant_bogus_hashcode(const char *data, size_t len)
+{
+	(void)data;
+	(void)len;
+	return 7;
+}
+
+unsigned long test_ehht_op_stats_fake_clock(void *context)
+{
+	unsigned long *ticks = (unsigned long *)context;
+	*ticks += 3;
+	return *ticks;
+}
+
+unsigned test_ehht_op_histogram_buckets(void)
+{
+	unsigned failures = 0;
+	size_t i = 0;
+
+	for (i = 0; i < 4; ++i) {
+		failures += check_unsigned_long(ehht_op_histogram_bucket_min(i),
+						i);
+	}
+	failures += check_unsigned_long(ehht_op_histogram_bucket_min(4), 4);
+	failures += check_unsigned_long(ehht_op_histogram_bucket_min(7), 7);
+	failures += check_unsigned_long(ehht_op_histogram_bucket_min(8), 8);
+	failures += check_unsigned_long(ehht_op_histogram_bucket_min(9), 10);
+	failures += check_unsigned_long(ehht_op_histogram_bucket_min(12), 16);
+	failures += check_unsigned_long(ehht_op_histogram_bucket_min(13), 20);
+	for (i = 1; i < EHHT_OP_HISTOGRAM_LEN; ++i) {
+		failures +=
+		    check_int(ehht_op_histogram_bucket_min(i) >
+			      ehht_op_histogram_bucket_min(i - 1), 1);
+	}
+
+	return failures;
+}
+
+unsigned test_ehht_op_stats(void)
+{
+	const size_t bytes_len = 250 * sizeof(size_t);
+	unsigned char bytes[250 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_op_stats stats;
+	unsigned long ticks = 0;
+	int not_built = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	failures += test_ehht_op_histogram_buckets();
+
+	table = ehht_new_custom(0, ehht_constant_bogus_hashcode, NULL, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_op_stats_end;
+	}
+	ehht_buckets_auto_resize_load_factor(table, 0.0);
+	ehht_set_clock(table, test_ehht_op_stats_fake_clock, &ticks);
+
+	table->put(table, "a", 1, "A", &err);
+	table->put(table, "b", 1, "B", &err);
+	table->put(table, "c", 1, "C", &err);
+	table->put(table, "a", 1, "AA", &err);
+	failures += check_int(err, 0);
+
+	table->get(table, "a", 1);
+	table->get(table, "c", 1);
+	table->get(table, "x", 1);
+	table->has_key(table, "b", 1);
+	table->remove(table, "b", 1);
+	table->remove(table, "y", 1);
+
+	not_built = ehht_op_stats(table, &stats);
+	if (not_built) {
+		/* built without --enable-instrumentation, nothing counted */
+		failures += check_unsigned_long(stats.gets, 0);
+		failures += check_unsigned_long(stats.puts, 0);
+		ehht_op_stats_reset(table);
+		goto test_ehht_op_stats_free;
+	}
+
+	failures += check_unsigned_long(stats.gets, 3);
+	failures += check_unsigned_long(stats.get_hits, 2);
+	failures += check_unsigned_long(stats.get_misses, 1);
+	failures += check_unsigned_long(stats.has_keys, 1);
+	failures += check_unsigned_long(stats.puts, 4);
+	failures += check_unsigned_long(stats.put_updates, 1);
+	failures += check_unsigned_long(stats.removes, 2);
+	failures += check_unsigned_long(stats.remove_hits, 1);
+	failures += check_unsigned_long(stats.allocs, 3);
+	failures += check_int(stats.hashes >= 10, 1);
+	failures += check_int(stats.hash_time > 0, 1);
+
+	failures += check_unsigned_long(stats.get_latency.count, 3);
+	failures += check_unsigned_long(stats.put_latency.count, 4);
+	failures += check_unsigned_long(stats.remove_latency.count, 2);
+	failures += check_int(stats.get_latency.total > 0, 1);
+	failures += check_int(stats.get_latency.max > 0, 1);
+
+	/* chain is "c", "b", "a": 3 visits for "a", 1 for "c", 3 for "x" */
+	failures += check_unsigned_long(stats.nodes_visited.max, 3);
+	failures += check_int(stats.nodes_visited.buckets[0] >= 1, 1);
+	failures += check_int(stats.nodes_visited.buckets[3] >= 3, 1);
+
+	ehht_op_stats_reset(table);
+	failures += check_int(ehht_op_stats(table, &stats), 0);
+	failures += check_unsigned_long(stats.gets, 0);
+	failures += check_unsigned_long(stats.get_latency.count, 0);
+	failures += check_unsigned_long(stats.nodes_visited.max, 0);
+
+test_ehht_op_stats_free:
+	ehht_free(table);
+
+test_ehht_op_stats_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_op_stats)
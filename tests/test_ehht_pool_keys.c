@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_pool_keys.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+int test_ehht_pool_keys_terminated(struct ehht_key each_key, void *each_val,
+				   void *context)
+{
+	unsigned *failures = (unsigned *)context;
+	(void)each_val;
+	*failures += check_size_t(eembed_strlen(each_key.str), each_key.len);
+	return 0;
+}
+
+unsigned test_ehht_pool_keys(void)
+{
+	const size_t bytes_len = 2000 * sizeof(size_t);
+	unsigned char bytes[2000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_stats stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	char long_key[300];
+	char key[20];
+	size_t allocs_before = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_pool_keys_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(0, NULL, &wrap, log);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_pool_keys_end;
+	}
+	ehht_buckets_auto_resize_load_factor(table, 0.0);
+	failures += check_int(ehht_pool_keys(table, 1024), 0);
+
+	/* 40 short keys: one element alloc each, but only one key chunk */
+	allocs_before = ctx.allocs;
+	for (i = 0; i < 40; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), NULL, &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(ctx.allocs - allocs_before, 40 + 1);
+
+	failures += check_int(ehht_pool_keys(table, 0), 1);
+
+	eembed_memset(long_key, 'x', 299);
+	long_key[299] = '\0';
+	table->put(table, long_key, 299, long_key, &err);
+	failures += check_int(err, 0);
+	failures += check_ptr(table->get(table, long_key, 299), long_key);
+
+	table->for_each(table, test_ehht_pool_keys_terminated, &failures);
+
+	ehht_stats(table, &stats);
+	failures +=
+	    check_size_t(stats.bytes_total, ctx.alloc_bytes - ctx.free_bytes);
+
+	/* a removed key's space is reused by a key of the same size */
+	table->remove(table, "12", 2);
+	allocs_before = ctx.allocs;
+	table->put(table, "ab", 2, NULL, &err);
+	failures += check_size_t(ctx.allocs - allocs_before, 1);
+	failures += check_int(table->has_key(table, "ab", 2), 1);
+	failures += check_int(table->has_key(table, "12", 2), 0);
+	failures += check_int(table->has_key(table, "13", 2), 1);
+
+	/* a failed chunk allocation fails the put, and is logged once */
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	eembed_memset(long_key, 'y', 200);
+	for (i = 0; i < 10 && !err; ++i) {
+		ctx.attempts = 0;
+		ctx.attempts_to_fail_bitmask = 0x02;
+		long_key[0] = (char)('a' + i);
+		table->put(table, long_key, 200, NULL, &err);
+	}
+	failures += check_int(err, 1);
+	failures += check_int(table->has_key(table, long_key, 200), 0);
+	failures += check_int(eembed_strstr(logbuf, "Error 13:") != NULL, 1);
+	failures += check_int(eembed_strstr(logbuf, "Error 2:") == NULL, 1);
+	ctx.attempts_to_fail_bitmask = 0;
+
+	table->clear(table);
+	ehht_stats(table, &stats);
+	failures += check_size_t(stats.bytes_keys, 0);
+
+	/* pooling may be disabled once empty */
+	failures += check_int(ehht_pool_keys(table, 0), 0);
+	table->put(table, "z", 1, NULL, &err);
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_pool_keys_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_pool_keys)
@@ -0,0 +1,191 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_reclaim.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+struct test_ehht_reclaim_sync_context {
+	int locked;
+	size_t locks;
+	size_t queued;
+	size_t errors;
+};
+
+void test_ehht_reclaim_sync(void *context, int op)
+{
+	struct test_ehht_reclaim_sync_context *ctx = NULL;
+
+	ctx = (struct test_ehht_reclaim_sync_context *)context;
+	switch (op) {
+	case EHHT_RECLAIM_LOCK:
+		ctx->errors += ctx->locked;
+		ctx->locked = 1;
+		++(ctx->locks);
+		break;
+	case EHHT_RECLAIM_UNLOCK:
+		ctx->errors += !ctx->locked;
+		ctx->locked = 0;
+		break;
+	case EHHT_RECLAIM_QUEUED:
+		ctx->errors += !ctx->locked;
+		++(ctx->queued);
+		break;
+	default:
+		++(ctx->errors);
+	}
+}
+
+struct ehht *test_ehht_reclaim_fill(struct eembed_allocator *ea,
+				    struct eembed_log *log, size_t num_keys,
+				    int mode)
+{
+	struct ehht *table = NULL;
+	char key[20];
+	size_t i = 0;
+	int err = 0;
+
+	table = ehht_new_custom(8, NULL, ea, log);
+	if (!table) {
+		return NULL;
+	}
+	if (mode == 1) {
+		err = ehht_pool_keys(table, 256);
+	} else if (mode == 2) {
+		err = ehht_arena(table, 512);
+	}
+	for (i = 0; i < num_keys && !err; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	if (err) {
+		ehht_free(table);
+		return NULL;
+	}
+	return table;
+}
+
+unsigned test_ehht_reclaim(void)
+{
+	const size_t bytes_len = 4000 * sizeof(size_t);
+	unsigned char bytes[4000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_reclaimer reclaimer;
+	struct test_ehht_reclaim_sync_context sync;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	size_t frees_before = 0;
+	size_t work = 0;
+	size_t steps = 0;
+	int mode = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_reclaim_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+	ehht_reclaimer_init(&reclaimer, NULL, NULL);
+	failures += check_size_t(ehht_reclaim_step(&reclaimer, 10), 0);
+
+	/* individual, pooled key and arena elements */
+	for (mode = 0; mode < 3; ++mode) {
+		table = test_ehht_reclaim_fill(&wrap, log, 100, mode);
+		if (check_ptr_not_null(table)) {
+			++failures;
+			goto test_ehht_reclaim_end;
+		}
+		frees_before = ctx.frees;
+		failures += check_int(ehht_free_async(table, &reclaimer), 0);
+		failures += check_size_t(ctx.frees, frees_before + 1);
+		failures += check_ptr_not_null(reclaimer.head);
+
+		steps = 0;
+		do {
+			frees_before = ctx.frees;
+			work = ehht_reclaim_step(&reclaimer, 7);
+			failures += check_int(work <= 7, 1);
+			/* an element and its key, or the 6 arrays, a unit */
+			failures += check_int(ctx.frees - frees_before
+					      <= (2 * 7) + 6, 1);
+			++steps;
+		} while (work == 7);
+		/* arena elements are freed by the chunk */
+		failures += check_int(steps > (mode == 2 ? 1 : 100 / 7), 1);
+		failures += check_ptr(reclaimer.head, NULL);
+		failures += check_ptr(reclaimer.tail, NULL);
+		failures += check_unsigned_int_m(ctx.frees, ctx.allocs,
+						 "alloc/free");
+	}
+
+	/* oldest first, in one step if the budget allows */
+	table = test_ehht_reclaim_fill(&wrap, log, 10, 0);
+	failures += check_int(ehht_free_async(table, &reclaimer), 0);
+	table = test_ehht_reclaim_fill(&wrap, log, 20, 2);
+	failures += check_int(ehht_free_async(table, &reclaimer), 0);
+	failures += check_int(reclaimer.head != reclaimer.tail, 1);
+	failures += check_int(ehht_reclaim_step(&reclaimer, 1000) < 1000, 1);
+	failures += check_ptr(reclaimer.head, NULL);
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+
+	/* other engines are freed at once */
+	table = ehht_new_compact(10, NULL, &wrap, log);
+	if (check_ptr_not_null(table)) {
+		++failures;
+	} else {
+		ehht_allocator_thread_safe(table, 1);
+		failures += check_int(ehht_free_async(table, &reclaimer), 1);
+		failures += check_ptr(reclaimer.head, NULL);
+	}
+
+	/* a shared reclaimer only takes thread-safe tables */
+	eembed_memset(&sync, 0x00, sizeof(sync));
+	ehht_reclaimer_init(&reclaimer, test_ehht_reclaim_sync, &sync);
+	table = test_ehht_reclaim_fill(&wrap, log, 10, 0);
+	failures += check_int(ehht_free_async(table, &reclaimer), 1);
+	failures += check_size_t(sync.locks, 0);
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+
+	table = test_ehht_reclaim_fill(&wrap, log, 10, 1);
+	ehht_allocator_thread_safe(table, 1);
+	failures += check_int(ehht_free_async(table, &reclaimer), 0);
+	failures += check_size_t(sync.queued, 1);
+	failures += check_size_t(ehht_reclaim_step(&reclaimer, 3), 3);
+	/* put back at the front */
+	failures += check_size_t(sync.queued, 2);
+	while (ehht_reclaim_step(&reclaimer, 3) == 3) ;
+	failures += check_ptr(reclaimer.head, NULL);
+	failures += check_size_t(sync.errors, 0);
+	failures += check_int(sync.locked, 0);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_reclaim_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_reclaim)
@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_reclaim_thread.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include <pthread.h>
+
+#include "ehht.h"
+#include "ehht-reclaim.h"
+#include "echeck.h"
+
+/* makes the wrapped allocator thread-safe, and counts */
+struct test_ehht_locked_context {
+	struct eembed_allocator *real;
+	pthread_mutex_t mutex;
+	size_t allocs;
+	size_t frees;
+	size_t frees_off_main;
+	pthread_t main_thread;
+};
+
+void *test_ehht_locked_malloc(struct eembed_allocator *ea, size_t size)
+{
+	struct test_ehht_locked_context *ctx = NULL;
+	void *ptr = NULL;
+
+	ctx = (struct test_ehht_locked_context *)ea->context;
+	pthread_mutex_lock(&ctx->mutex);
+	ptr = ctx->real->malloc(ctx->real, size);
+	if (ptr) {
+		++(ctx->allocs);
+	}
+	pthread_mutex_unlock(&ctx->mutex);
+	return ptr;
+}
+
+void test_ehht_locked_free(struct eembed_allocator *ea, void *ptr)
+{
+	struct test_ehht_locked_context *ctx = NULL;
+
+	if (!ptr) {
+		return;
+	}
+	ctx = (struct test_ehht_locked_context *)ea->context;
+	pthread_mutex_lock(&ctx->mutex);
+	ctx->real->free(ctx->real, ptr);
+	++(ctx->frees);
+	if (!pthread_equal(pthread_self(), ctx->main_thread)) {
+		++(ctx->frees_off_main);
+	}
+	pthread_mutex_unlock(&ctx->mutex);
+}
+
+unsigned test_ehht_reclaim_thread(void)
+{
+	const size_t bytes_len = 8000 * sizeof(size_t);
+	unsigned char bytes[8000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *tables[4];
+	struct ehht_reclaimer reclaimer;
+	struct ehht_reclaim_thread *rt = NULL;
+	struct test_ehht_locked_context ctx;
+	struct eembed_allocator locked;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	char key[20];
+	size_t frees_before = 0;
+	size_t i = 0;
+	size_t j = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	eembed_memset(&locked, 0x00, sizeof(locked));
+	eembed_memset(&ctx, 0x00, sizeof(ctx));
+	ctx.real = eembed_global_allocator;
+	ctx.main_thread = pthread_self();
+	pthread_mutex_init(&ctx.mutex, NULL);
+	locked.context = &ctx;
+	locked.malloc = test_ehht_locked_malloc;
+	locked.free = test_ehht_locked_free;
+
+	for (i = 0; i < 4; ++i) {
+		tables[i] = ehht_new_custom(0, NULL, &locked, NULL);
+		if (check_ptr_not_null(tables[i])) {
+			++failures;
+			goto test_ehht_reclaim_thread_end;
+		}
+		if (i == 3) {
+			ehht_arena(tables[i], 1024);
+		}
+		for (j = 0; j < 200 && !err; ++j) {
+			eembed_ulong_to_str(key, 20, j);
+			tables[i]->put(tables[i], key, eembed_strlen(key), NULL,
+				       &err);
+		}
+	}
+	failures += check_int(err, 0);
+
+	ehht_reclaimer_init(&reclaimer, NULL, NULL);
+	rt = ehht_reclaim_thread_start(&reclaimer, 16, NULL, NULL);
+	if (check_ptr_not_null(rt)) {
+		++failures;
+		goto test_ehht_reclaim_thread_end;
+	}
+	/* already shared */
+	failures += check_ptr(ehht_reclaim_thread_start(&reclaimer, 16, NULL,
+							log), NULL);
+
+	/* not declared thread-safe, so freed by this thread */
+	frees_before = ctx.frees;
+	failures += check_int(ehht_free_async(tables[0], &reclaimer), 1);
+	failures += check_int(ctx.frees - frees_before > 200, 1);
+
+	for (i = 1; i < 4; ++i) {
+		ehht_allocator_thread_safe(tables[i], 1);
+		failures +=
+		    check_int(ehht_free_async(tables[i], &reclaimer), 0);
+	}
+	/* this thread may help */
+	ehht_reclaim_step(&reclaimer, 10);
+
+	ehht_reclaim_thread_stop(rt);
+	failures += check_ptr(reclaimer.head, NULL);
+	failures += check_int(reclaimer.sync == NULL, 1);
+	failures += check_int(ctx.frees_off_main > 0, 1);
+	failures += check_size_t(ctx.frees, ctx.allocs);
+
+test_ehht_reclaim_thread_end:
+	pthread_mutex_destroy(&ctx.mutex);
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_reclaim_thread)
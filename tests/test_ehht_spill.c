@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_spill.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "ehht-spill.h"
+#include "echeck.h"
+
+#define Test_ehht_spill_num_keys 2000
+#define Test_ehht_spill_budget (16 * 1024)
+
+static int test_ehht_spill_count(struct ehht_key each_key, void *each_val,
+				 void *context)
+{
+	size_t *count = (size_t *)context;
+	(void)each_key;
+	(void)each_val;
+	++(*count);
+	return 0;
+}
+
+unsigned test_ehht_spill(void)
+{
+	const size_t bytes_len = 16000 * sizeof(size_t);
+	unsigned char bytes[16000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_spill_stats stats;
+	struct ehht_keys *keys = NULL;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	char key[20];
+	char batch_strs[10][20];
+	struct ehht_key batch[10];
+	void *vals[10];
+	char big_key[Test_ehht_spill_budget];
+	size_t count = 0;
+	size_t bad = 0;
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_spill_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	/* a budget below the fixed overhead is refused */
+	failures += check_ptr(ehht_new_spill(64, 8, NULL, NULL, &wrap, log),
+			      NULL);
+	failures += check_size_t(ctx.frees, ctx.allocs);
+
+	table = ehht_new_spill(Test_ehht_spill_budget, 64, NULL, NULL, &wrap,
+			       log);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_spill_end;
+	}
+
+	/* far more keys than fit in the budget */
+	for (i = 0; i < Test_ehht_spill_num_keys && !err; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		table->put(table, key, eembed_strlen(key), (void *)(i + 1),
+			   &err);
+	}
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), Test_ehht_spill_num_keys);
+	ehht_spill_stats(table, &stats);
+	failures += check_int(stats.spills > 0, 1);
+	failures += check_int(stats.partitions_spilled > 0, 1);
+	failures += check_int(stats.bytes_peak <= Test_ehht_spill_budget, 1);
+
+	/* every key is found, loading partitions as needed */
+	bad = 0;
+	for (i = 0; i < Test_ehht_spill_num_keys; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		if (table->get(table, key, eembed_strlen(key)) !=
+		    (void *)(i + 1)) {
+			++bad;
+		}
+	}
+	failures += check_size_t(bad, 0);
+	failures += check_int(table->has_key(table, "missing", 7), 0);
+
+	/* updates and removes reach spilled partitions */
+	failures += check_ptr(table->put(table, "7", 1, NULL, &err),
+			      (void *)(7 + 1));
+	failures += check_ptr(table->remove(table, "8", 1), (void *)(8 + 1));
+	failures += check_int(table->has_key(table, "8", 1), 0);
+	failures += check_size_t(table->size(table),
+				 Test_ehht_spill_num_keys - 1);
+
+	/* for_each reads spilled partitions without loading them */
+	ehht_spill_stats(table, &stats);
+	count = 0;
+	table->for_each(table, test_ehht_spill_count, &count);
+	failures += check_size_t(count, Test_ehht_spill_num_keys - 1);
+	i = stats.loads;
+	ehht_spill_stats(table, &stats);
+	failures += check_size_t(stats.loads, i);
+
+	keys = table->keys(table, 0);
+	if (check_ptr_not_null(keys)) {
+		++failures;
+	} else {
+		failures += check_size_t(keys->len,
+					 Test_ehht_spill_num_keys - 1);
+		failures += check_int(keys->keys_copied, 1);
+		table->free_keys(table, keys);
+	}
+
+	/* a batch loads each of its spilled partitions at most once */
+	for (i = 0; i < 10; ++i) {
+		eembed_ulong_to_str(batch_strs[i], 20, i * 150);
+		batch[i].str = batch_strs[i];
+		batch[i].len = eembed_strlen(batch_strs[i]);
+	}
+	batch_strs[9][0] = 'x';
+	ehht_spill_stats(table, &stats);
+	i = stats.loads;
+	failures +=
+	    check_size_t(ehht_spill_get_batch(table, batch, vals, 10, &err), 9);
+	failures += check_int(err, 0);
+	failures += check_ptr(vals[1], (void *)(150 + 1));
+	failures += check_ptr(vals[9], NULL);
+	ehht_spill_stats(table, &stats);
+	failures += check_int(stats.loads - i <= stats.partitions, 1);
+
+	for (i = 0; i < 10; ++i) {
+		batch_strs[i][0] = 'b';
+		batch_strs[i][1] = (char)('0' + i);
+		batch_strs[i][2] = '\0';
+		batch[i].len = 2;
+		vals[i] = batch_strs[i];
+	}
+	failures +=
+	    check_size_t(ehht_spill_put_batch(table, batch, vals, 10, &err),
+			 10);
+	failures += check_int(err, 0);
+	failures += check_ptr(table->get(table, batch[3].str, batch[3].len),
+			      batch_strs[3]);
+
+	/* a key which does not fit in the budget fails the put */
+	eembed_memset(big_key, 'k', sizeof(big_key));
+	failures +=
+	    check_ptr(table->put(table, big_key, sizeof(big_key), NULL, &err),
+		      NULL);
+	failures += check_int(err, 1);
+	err = 0;
+
+	ehht_spill_stats(table, &stats);
+	failures += check_int(stats.bytes_peak <= Test_ehht_spill_budget, 1);
+
+	table->clear(table);
+	failures += check_size_t(table->size(table), 0);
+	failures += check_ptr(table->get(table, "1", 1), NULL);
+	table->put(table, "z", 1, NULL, &err);
+	failures += check_int(err, 0);
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_spill_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_spill)
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_stats.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+/* this fake hashcode function allows easy control of chain lengths */
+unsigned int ehht_first_char_bogus_hashcode(const char *data, size_t len)
+{
+	return (data && len) ? (unsigned int)(data[0]) : 0;
+}
+
+unsigned long test_ehht_stats_fake_clock(void *context)
+{
+	unsigned long *ticks = (unsigned long *)context;
+	return ++(*ticks);
+}
+
+unsigned test_ehht_stats(void)
+{
+	const size_t bytes_len = 250 * sizeof(size_t);
+	unsigned char bytes[250 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_stats stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	ehht_hash_func first_char_func = ehht_first_char_bogus_hashcode;
+	const char *keys[] = { "a1", "a2", "a3", "b1", "c1", NULL };
+	size_t keys_bytes = 0;
+	size_t allocs_before = 0;
+	size_t num_buckets = 10;
+	size_t i = 0;
+	unsigned long ticks = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(num_buckets, first_char_func, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_stats_end;
+	}
+	ehht_buckets_auto_resize_load_factor(table, 0.0);
+	ehht_set_clock(table, test_ehht_stats_fake_clock, &ticks);
+
+	ehht_stats(table, &stats);
+	failures += check_size_t(stats.size, 0);
+	failures += check_size_t(stats.num_buckets, num_buckets);
+	failures += check_size_t(stats.empty_buckets, num_buckets);
+	failures += check_size_t(stats.chain_lengths[0], num_buckets);
+	failures += check_size_t(stats.max_chain_length, 0);
+	failures += check_size_t(stats.resizes, 0);
+	failures += check_unsigned_long(stats.last_resize_time, 0);
+	failures += check_size_t(stats.bytes_elements, 0);
+	failures += check_size_t(stats.bytes_keys, 0);
+
+	for (i = 0; keys[i] != NULL; ++i) {
+		table->put(table, keys[i], eembed_strlen(keys[i]), NULL, &err);
+		failures += check_int(err, 0);
+		keys_bytes += eembed_strlen(keys[i]) + 1;
+	}
+
+	allocs_before = ctx.allocs;
+	ehht_stats(table, &stats);
+	failures += check_size_t_m(ctx.allocs, allocs_before, "allocated");
+
+	failures += check_size_t(stats.size, 5);
+	failures += check_size_t(stats.empty_buckets, num_buckets - 3);
+	failures += check_size_t(stats.chain_lengths[0], num_buckets - 3);
+	failures += check_size_t(stats.chain_lengths[1], 2);
+	failures += check_size_t(stats.chain_lengths[2], 0);
+	failures += check_size_t(stats.chain_lengths[3], 1);
+	failures += check_size_t(stats.max_chain_length, 3);
+	failures += check_int(stats.load_factor == 0.5, 1);
+	failures += check_size_t(stats.bytes_keys, keys_bytes);
+	failures += check_int(stats.bytes_elements > 0, 1);
+	failures += check_int(stats.bytes_buckets > 0, 1);
+	failures +=
+	    check_size_t(stats.bytes_total, ctx.alloc_bytes - ctx.free_bytes);
+
+	ehht_buckets_resize(table, 2 * num_buckets);
+	ehht_stats(table, &stats);
+	failures += check_size_t(stats.num_buckets, 2 * num_buckets);
+	failures += check_size_t(stats.resizes, 1);
+	failures += check_unsigned_long(stats.last_resize_time, ticks);
+	failures += check_int(ticks > 0, 1);
+	failures += check_size_t(stats.max_chain_length, 3);
+	failures +=
+	    check_size_t(stats.bytes_total, ctx.alloc_bytes - ctx.free_bytes);
+
+	ehht_trust_keys_immutable(table, 1);
+	table->clear(table);
+	ehht_stats(table, &stats);
+	failures += check_size_t(stats.size, 0);
+	failures += check_size_t(stats.empty_buckets, 2 * num_buckets);
+	failures += check_size_t(stats.bytes_keys, 0);
+
+	ehht_free(table);
+
+test_ehht_stats_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_stats)
@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_ttl.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+struct test_ehht_ttl_expired {
+	size_t count;
+	size_t val_sum;
+};
+
+void test_ehht_ttl_expire(struct ehht_key key, void *val, void *context)
+{
+	struct test_ehht_ttl_expired *expired = NULL;
+
+	(void)key;
+	expired = (struct test_ehht_ttl_expired *)context;
+	++(expired->count);
+	expired->val_sum += (size_t)val;
+}
+
+unsigned long test_ehht_ttl_clock(void *context)
+{
+	return *((unsigned long *)context);
+}
+
+unsigned test_ehht_ttl(void)
+{
+	const size_t bytes_len = 8000 * sizeof(size_t);
+	unsigned char bytes[8000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht *clone = NULL;
+	struct ehht_stats stats;
+	struct test_ehht_ttl_expired expired;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	char key[20];
+	unsigned long now = 0;
+	size_t i = 0;
+	size_t sum = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(0, NULL, &wrap, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_ttl_end;
+	}
+	eembed_memset(&expired, 0x00, sizeof(expired));
+
+	/* a ttl needs expiry mode */
+	table->put(table, "a", 1, NULL, &err);
+	failures += check_int(err, 0);
+	ehht_put_with_ttl(table, "b", 1, NULL, 5, &err);
+	failures += check_int(err, 1);
+	err = 0;
+	failures += check_int(ehht_expiry(table, 1, NULL, NULL), 1);
+	table->clear(table);
+
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x01;
+	failures += check_int(ehht_expiry(table, 1, NULL, NULL), 1);
+	ctx.attempts_to_fail_bitmask = 0;
+
+	failures += check_int(ehht_expiry(table, 1, test_ehht_ttl_expire,
+					  &expired), 0);
+
+	/* ttls from 1 to 2000 cross several levels of the wheel */
+	for (i = 1; i <= 2000; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		ehht_put_with_ttl(table, key, eembed_strlen(key), (void *)i, i,
+				  &err);
+	}
+	table->put(table, "forever", 7, NULL, &err);
+	ehht_put_with_ttl(table, "zero", 4, NULL, 0, &err);
+	failures += check_int(err, 0);
+	failures += check_size_t(table->size(table), 2002);
+
+	/* nothing has expired yet */
+	failures += check_int(ehht_expire(table, 0, 1000) < 1000, 1);
+	failures += check_size_t(expired.count, 0);
+
+	/* expire in small steps, so each call runs out of budget */
+	for (now = 1; now <= 2000; now += 7) {
+		while (ehht_expire(table, now, 3) == 3) ;
+		failures += check_size_t(table->size(table), 2002 - now);
+		eembed_ulong_to_str(key, 20, now);
+		failures += check_int(table->has_key(table, key,
+						     eembed_strlen(key)), 0);
+		eembed_ulong_to_str(key, 20, now + 1);
+		failures += check_int(table->has_key(table, key,
+						     eembed_strlen(key)),
+				      now < 2000 ? 1 : 0);
+	}
+	while (ehht_expire(table, 2001, 10) == 10) ;
+	failures += check_size_t(expired.count, 2000);
+	for (i = 1; i <= 2000; ++i) {
+		sum += i;
+	}
+	failures += check_size_t(expired.val_sum, sum);
+	failures += check_size_t(table->size(table), 2);
+	failures += check_int(table->has_key(table, "forever", 7), 1);
+	failures += check_int(table->has_key(table, "zero", 4), 1);
+
+	/* with a clock, a lookup sees an expired key as missing */
+	now = 5000;
+	ehht_set_clock(table, test_ehht_ttl_clock, &now);
+	ehht_put_with_ttl(table, "soon", 4, (void *)10, 10, &err);
+	ehht_put_with_ttl(table, "later", 5, NULL, 1000000, &err);
+	failures += check_int(table->has_key(table, "soon", 4), 1);
+	now = 5010;
+	failures += check_int(table->has_key(table, "soon", 4), 0);
+	failures += check_size_t(expired.count, 2001);
+	failures += check_size_t(table->size(table), 3);
+
+	/* a put_with_ttl on an existing key changes its expiry */
+	ehht_put_with_ttl(table, "later", 5, NULL, 5, &err);
+	ehht_put_with_ttl(table, "forever", 7, NULL, 0, &err);
+	ehht_put_with_ttl(table, "zero", 4, NULL, 1, &err);
+	ehht_put_with_ttl(table, "zero", 4, NULL, 0, &err);
+
+	/* expired keys are not cloned */
+	now = 5015;
+	clone = ehht_clone(table);
+	if (check_ptr_not_null(clone)) {
+		++failures;
+	} else {
+		failures += check_size_t(clone->size(clone), 2);
+		failures += check_int(clone->has_key(clone, "later", 5), 0);
+		ehht_free(clone);
+	}
+
+	eembed_memset(&expired, 0x00, sizeof(expired));
+	failures += check_int(ehht_expire(table, now, 100) < 100, 1);
+	failures += check_size_t(expired.count, 1);
+	failures += check_int(table->has_key(table, "later", 5), 0);
+	failures += check_size_t(table->size(table), 2);
+
+	ehht_stats(table, &stats);
+	failures += check_size_t(stats.expirations, 2002);
+	failures +=
+	    check_size_t(stats.bytes_total, ctx.alloc_bytes - ctx.free_bytes);
+
+	/* the mode may change only when the table is empty */
+	failures += check_int(ehht_expiry(table, 2, NULL, NULL), 1);
+	table->clear(table);
+	failures += check_int(ehht_expiry(table, 0, NULL, NULL), 0);
+	ehht_put_with_ttl(table, "x", 1, NULL, 5, &err);
+	failures += check_int(err, 1);
+	err = 0;
+
+	/* with longer ticks, a key expires within the tick holding it */
+	failures += check_int(ehht_expiry(table, 10, test_ehht_ttl_expire,
+					  &expired), 0);
+	eembed_memset(&expired, 0x00, sizeof(expired));
+	ehht_put_with_ttl(table, "p", 1, NULL, 15, &err);
+	ehht_put_with_ttl(table, "q", 1, NULL, 17, &err);
+	ehht_put_with_ttl(table, "r", 1, NULL, 25, &err);
+	failures += check_int(err, 0);
+	failures += check_int(ehht_expire(table, now + 14, 100) < 100, 1);
+	failures += check_size_t(expired.count, 0);
+	failures += check_int(ehht_expire(table, now + 15, 100) < 100, 1);
+	failures += check_size_t(expired.count, 1);
+	failures += check_size_t(table->size(table), 2);
+	failures += check_int(ehht_expire(table, now + 18, 1) == 1, 1);
+	failures += check_int(ehht_expire(table, now + 18, 100) < 100, 1);
+	failures += check_size_t(expired.count, 2);
+	failures += check_int(table->has_key(table, "r", 1), 1);
+	failures += check_int(ehht_expire(table, now + 25, 100) < 100, 1);
+	failures += check_size_t(expired.count, 3);
+	failures += check_size_t(table->size(table), 0);
+
+	/* merge and move skip expired keys, and keep expiry if they can */
+	clone = ehht_new_custom(0, NULL, &wrap, NULL);
+	if (check_ptr_not_null(clone)) {
+		++failures;
+		goto test_ehht_ttl_end;
+	}
+	ehht_put_with_ttl(table, "old", 3, NULL, 5, &err);
+	ehht_put_with_ttl(table, "new", 3, NULL, 100, &err);
+	failures += check_int(err, 0);
+	now += 50;
+	failures += check_int(ehht_merge(clone, table, NULL, NULL), 0);
+	failures += check_size_t(table->size(table), 0);
+	failures += check_size_t(expired.count, 4);
+	failures += check_size_t(clone->size(clone), 1);
+	failures += check_int(clone->has_key(clone, "old", 3), 0);
+	failures += check_int(clone->has_key(clone, "new", 3), 1);
+	ehht_free(clone);
+
+	clone = ehht_new_custom(0, NULL, &wrap, NULL);
+	if (check_ptr_not_null(clone)) {
+		++failures;
+		goto test_ehht_ttl_end;
+	}
+	ehht_set_clock(clone, test_ehht_ttl_clock, &now);
+	failures += check_int(ehht_expiry(clone, 1, NULL, NULL), 0);
+	ehht_put_with_ttl(table, "merged", 6, NULL, 10, &err);
+	ehht_put_with_ttl(table, "moved", 5, NULL, 20, &err);
+	ehht_put_with_ttl(table, "stale", 5, NULL, 5, &err);
+	failures += check_int(err, 0);
+	failures += check_int(ehht_move(clone, table, "moved", 5), 0);
+	now += 5;
+	failures += check_int(ehht_move(clone, table, "stale", 5), 1);
+	failures += check_int(ehht_merge(clone, table, NULL, NULL), 0);
+	failures += check_size_t(clone->size(clone), 2);
+	failures += check_int(ehht_expire(clone, now + 5, 100) < 100, 1);
+	failures += check_int(clone->has_key(clone, "merged", 6), 0);
+	failures += check_int(clone->has_key(clone, "moved", 5), 1);
+	failures += check_int(ehht_expire(clone, now + 15, 100) < 100, 1);
+	failures += check_size_t(clone->size(clone), 0);
+	ehht_free(clone);
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_ttl_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_ttl)
@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_value_size.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+struct test_ehht_value {
+	unsigned long count;
+	double weight;
+	char tag[3];
+};
+
+int test_ehht_value_size_sum(struct ehht_key each_key, void *each_val,
+			     void *context)
+{
+	unsigned long *sum = (unsigned long *)context;
+	struct test_ehht_value *value = (struct test_ehht_value *)each_val;
+	(void)each_key;
+	*sum += value->count;
+	return 0;
+}
+
+unsigned test_ehht_value_size(void)
+{
+	const size_t bytes_len = 2000 * sizeof(size_t);
+	unsigned char bytes[2000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct ehht_stats stats;
+	struct echeck_err_injecting_context ctx;
+	struct eembed_allocator wrap;
+	struct eembed_log slog;
+	struct eembed_str_buf str_buf;
+	struct eembed_log *log = NULL;
+	char logbuf[250];
+	struct test_ehht_value value;
+	struct test_ehht_value *slot = NULL;
+	struct test_ehht_value *first = NULL;
+	void **ptr_slot = NULL;
+	size_t allocs_before = 0;
+	unsigned long sum = 0;
+	char key[20];
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	log = eembed_char_buf_log_init(&slog, &str_buf, logbuf, 250);
+	if (check_ptr_not_null(log)) {
+		++failures;
+		goto test_ehht_value_size_end;
+	}
+
+	echeck_err_injecting_allocator_init(&wrap, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	table = ehht_new_custom(2, NULL, &wrap, log);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_value_size_end;
+	}
+	failures +=
+	    check_int(ehht_value_size(table, sizeof(struct test_ehht_value)),
+		      0);
+
+	/* the value is copied in, one allocation per element */
+	eembed_memset(&value, 0x00, sizeof(value));
+	value.count = 1;
+	value.weight = 0.5;
+	allocs_before = ctx.allocs;
+	first = (struct test_ehht_value *)table->put(table, "a", 1, &value,
+						     &err);
+	failures += check_int(err, 0);
+	failures += check_size_t(ctx.allocs - allocs_before, 2);
+	failures += check_int(first != &value, 1);
+	failures += check_ptr(table->get(table, "a", 1), first);
+	value.count = 99;
+	failures += check_unsigned_long(first->count, 1);
+
+	failures += check_int(ehht_value_size(table, 4), 1);
+
+	/* slots are zeroed, and may be updated in place */
+	slot = (struct test_ehht_value *)ehht_put_slot(table, "b", 1, &err);
+	failures += check_unsigned_long(slot->count, 0);
+	slot->count = 2;
+	slot->tag[0] = 'b';
+	failures += check_ptr(ehht_put_slot(table, "b", 1, &err), slot);
+	failures += check_unsigned_long(slot->count, 2);
+
+	/* addresses are stable across resizes */
+	for (i = 0; i < 100; ++i) {
+		eembed_ulong_to_str(key, 20, i);
+		slot = (struct test_ehht_value *)
+		    ehht_put_slot(table, key, eembed_strlen(key), &err);
+		slot->count = 10;
+	}
+	failures += check_int(err, 0);
+	failures += check_int(ehht_buckets_size(table) > 2, 1);
+	failures += check_ptr(table->get(table, "a", 1), first);
+	failures += check_unsigned_long(first->count, 1);
+	failures += check_int(first->weight == 0.5, 1);
+
+	table->for_each(table, test_ehht_value_size_sum, &sum);
+	failures += check_unsigned_long(sum, 1 + 2 + (100 * 10));
+
+	/* overwriting copies into the same storage */
+	value.count = 3;
+	failures += check_ptr(table->put(table, "a", 1, &value, &err), first);
+	failures += check_unsigned_long(first->count, 3);
+	table->put(table, "a", 1, NULL, &err);
+	failures += check_unsigned_long(first->count, 0);
+
+	failures += check_ptr(table->remove(table, "a", 1), NULL);
+	failures += check_int(table->has_key(table, "a", 1), 0);
+
+	ehht_stats(table, &stats);
+	failures +=
+	    check_size_t(stats.bytes_total, ctx.alloc_bytes - ctx.free_bytes);
+
+	/* a failed allocation returns NULL */
+	ctx.attempts = 0;
+	ctx.attempts_to_fail_bitmask = 0x03;
+	failures += check_ptr(table->put(table, "x", 1, &value, &err), NULL);
+	failures += check_int(err, 1);
+	failures += check_ptr(ehht_put_slot(table, "x", 1, &err), NULL);
+	ctx.attempts_to_fail_bitmask = 0;
+	err = 0;
+
+	/* without a value_size, the slot is the value pointer */
+	table->clear(table);
+	failures += check_int(ehht_value_size(table, 0), 0);
+	ptr_slot = (void **)ehht_put_slot(table, "p", 1, &err);
+	failures += check_ptr(*ptr_slot, NULL);
+	*ptr_slot = &value;
+	failures += check_ptr(table->get(table, "p", 1), &value);
+	failures += check_ptr(table->remove(table, "p", 1), &value);
+
+	ehht_free(table);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+test_ehht_value_size_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_value_size)
@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test_ehht_write.c: test for a simple OO hashtable */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+/* https://github.com/ericherman/libehht */
+
+#include "ehht.h"
+#include "echeck.h"
+
+#define Test_ehht_write_out_len 4096
+
+struct test_ehht_write_sink {
+	char out[Test_ehht_write_out_len];
+	size_t len;
+	size_t calls;
+	size_t max_len;
+	size_t fail_at_call;
+};
+
+int test_ehht_write_collect(void *context, const char *bytes, size_t len)
+{
+	struct test_ehht_write_sink *sink = NULL;
+
+	sink = (struct test_ehht_write_sink *)context;
+	++(sink->calls);
+	if (sink->calls == sink->fail_at_call) {
+		return 7;
+	}
+	if (len > sink->max_len) {
+		sink->max_len = len;
+	}
+	if (sink->len + len >= Test_ehht_write_out_len) {
+		return 1;
+	}
+	eembed_memcpy(sink->out + sink->len, bytes, len);
+	sink->len += len;
+	sink->out[sink->len] = '\0';
+	return 0;
+}
+
+/* writes the value as a JSON string of its decimal digits */
+size_t test_ehht_write_quoted(void *val, char *buf, size_t buf_len,
+			      void *context)
+{
+	char digits[25];
+	size_t len = 0;
+
+	(void)context;
+	eembed_ulong_to_str(digits, 25, (unsigned long)(size_t)val);
+	len = eembed_strlen(digits) + 2;
+	if (len <= buf_len) {
+		buf[0] = '"';
+		eembed_memcpy(buf + 1, digits, len - 2);
+		buf[len - 1] = '"';
+	}
+	return len;
+}
+
+/* larger than any buffer */
+size_t test_ehht_write_too_big(void *val, char *buf, size_t buf_len,
+			       void *context)
+{
+	(void)val;
+	(void)buf;
+	(void)context;
+	return buf_len + 1;
+}
+
+unsigned test_ehht_write_expect(struct test_ehht_write_sink *sink,
+				const char *expected)
+{
+	unsigned failures = 0;
+
+	failures += check_size_t(sink->len, eembed_strlen(expected));
+	failures += check_int(eembed_strcmp(sink->out, expected), 0);
+	return failures;
+}
+
+unsigned test_ehht_write(void)
+{
+	const size_t bytes_len = 4000 * sizeof(size_t);
+	unsigned char bytes[4000 * sizeof(size_t)];
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator *ea = NULL;
+
+	unsigned failures = 0;
+	struct ehht *table = NULL;
+	struct test_ehht_write_sink sink;
+	char buf[EHHT_WRITE_MIN_BUF_LEN];
+	char key[20];
+	size_t i = 0;
+	int err = 0;
+
+	if (!EEMBED_HOSTED) {
+		ea = eembed_bytes_allocator(bytes, bytes_len);
+		if (check_ptr_not_null(ea)) {
+			return 1;
+		}
+		eembed_global_allocator = ea;
+	}
+
+	/* compact tables write in insertion order */
+	table = ehht_new_compact(0, NULL, NULL, NULL);
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_write_end;
+	}
+
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_JSON, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, NULL, NULL), 0);
+	failures += test_ehht_write_expect(&sink, "{\n}\n");
+
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_TEXT, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, NULL, NULL), 0);
+	failures += check_size_t(sink.calls, 0);
+
+	table->put(table, "a", 1, NULL, &err);
+	table->put(table, "q\"b\\", 4, (void *)12, &err);
+	table->put(table, "t\tn\n\001", 5, (void *)3, &err);
+	failures += check_int(err, 0);
+
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_JSON, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, NULL, NULL), 0);
+	failures += test_ehht_write_expect(&sink, "{\n"
+					   "\"a\": null,\n"
+					   "\"q\\\"b\\\\\": 12,\n"
+					   "\"t\\tn\\n\\u0001\": 3\n" "}\n");
+
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_JSON, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, test_ehht_write_quoted,
+					 NULL), 0);
+	failures += test_ehht_write_expect(&sink, "{\n"
+					   "\"a\": \"0\",\n"
+					   "\"q\\\"b\\\\\": \"12\",\n"
+					   "\"t\\tn\\n\\u0001\": \"3\"\n"
+					   "}\n");
+
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_TEXT, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, test_ehht_write_quoted,
+					 NULL), 0);
+	failures += test_ehht_write_expect(&sink, "a\t\"0\"\n"
+					   "q\"b\\\\\t\"12\"\n"
+					   "t\\tn\\n\\x01\t\"3\"\n");
+
+	/* the default text value is the pointer in hex */
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_TEXT, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, NULL, NULL), 0);
+	failures += check_int(eembed_memcmp(sink.out, "a\t0x000", 7), 0);
+	failures += check_int(sink.out[sink.len - 2], '3');
+
+	/* many entries pass through the small buffer in full chunks */
+	for (i = 0; i < 100; ++i) {
+		eembed_ulong_to_str(key, 20, 1000 + i);
+		table->put(table, key, eembed_strlen(key), (void *)i, &err);
+	}
+	failures += check_int(err, 0);
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_JSON, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, NULL, NULL), 0);
+	failures += check_size_t(sink.max_len, sizeof(buf));
+	failures += check_int(sink.calls > 10, 1);
+	failures += check_size_t(sink.calls,
+				 (sink.len + sizeof(buf) - 1) / sizeof(buf));
+	failures += check_int(eembed_strstr(sink.out, "\"1099\": 99\n}\n")
+			      != NULL, 1);
+
+	/* a write which fails stops the output */
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	sink.fail_at_call = 3;
+	failures += check_int(ehht_write(table, EHHT_WRITE_JSON, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, NULL, NULL), 7);
+	failures += check_size_t(sink.calls, 3);
+
+	/* as does a value which does not fit */
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_TEXT, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, test_ehht_write_too_big,
+					 NULL) != 0, 1);
+
+	/* invalid arguments */
+	failures += check_int(ehht_write(table, EHHT_WRITE_TEXT, buf,
+					 EHHT_WRITE_MIN_BUF_LEN - 1,
+					 test_ehht_write_collect, &sink, NULL,
+					 NULL) != 0, 1);
+	failures += check_int(ehht_write(table, 2, buf, sizeof(buf),
+					 test_ehht_write_collect, &sink, NULL,
+					 NULL) != 0, 1);
+	ehht_free(table);
+
+	/* any "struct ehht" */
+	table = ehht_new();
+	if (check_ptr_not_null(table)) {
+		++failures;
+		goto test_ehht_write_end;
+	}
+	table->put(table, "x", 1, (void *)5, &err);
+	table->put(table, "y", 1, (void *)5, &err);
+	eembed_memset(&sink, 0x00, sizeof(sink));
+	failures += check_int(ehht_write(table, EHHT_WRITE_JSON, buf,
+					 sizeof(buf), test_ehht_write_collect,
+					 &sink, NULL, NULL), 0);
+	failures += check_size_t(sink.len, eembed_strlen("{\n\"x\": 5,\n"
+							 "\"y\": 5\n}\n"));
+	ehht_free(table);
+
+test_ehht_write_end:
+	if (!EEMBED_HOSTED) {
+		eembed_global_allocator = orig;
+	}
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ehht_write)
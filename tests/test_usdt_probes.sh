@@ -0,0 +1,36 @@
+#!/bin/bash
+# SPDX-License-Identifier: LGPL-3.0-or-later
+# test_usdt_probes.sh: check the static tracepoints are in libehht.so
+# Copyright (C) 2020 Eric Herman <eric@freesa.org>
+# https://github.com/ericherman/libehht
+
+LIBEHHT_SO=${LIBEHHT_SO:-.libs/libehht.so}
+
+if [ ! -e "$LIBEHHT_SO" ]; then
+	echo "$LIBEHHT_SO not found"
+	exit 1
+fi
+
+# 77: skipped
+if ! command -v readelf >/dev/null 2>&1; then
+	echo "readelf not found"
+	exit 77
+fi
+
+NOTES=$(readelf --notes "$LIBEHHT_SO")
+FAILURES=0
+for PROBE in resize__start resize__end malloc__fail long__chain evict; do
+	if ! echo "$NOTES" | grep -q "Name: $PROBE\$"; then
+		echo "probe 'ehht:$PROBE' not found in $LIBEHHT_SO"
+		FAILURES=$(( $FAILURES + 1 ))
+	fi
+done
+if ! echo "$NOTES" | grep -q "Provider: ehht\$"; then
+	echo "provider 'ehht' not found in $LIBEHHT_SO"
+	FAILURES=$(( $FAILURES + 1 ))
+fi
+
+if [ $FAILURES -ne 0 ]; then
+	exit 1
+fi
+exit 0